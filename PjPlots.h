@@ -1,12 +1,114 @@
 #include <array>
+#include <concepts>
 #include <vector>
 #include <span>
+#include <string>
 #include <string_view>
+#include <charconv>
 #include <variant>
 #include <exception>
 #include <stdexcept>
 #include <stdint.h>
 #include <numeric>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <new>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <cstddef>
+#include <chrono>
+#include <cstring>
+#include <coroutine>
+#include <deque>
+#include <functional>
+#include <future>
+#include <stop_token>
+#include <optional>
+
+// SIMD back-ends for the rasterizer kernels, define PJPLOT_DISABLE_SIMD to force the scalar path
+#if !defined(PJPLOT_DISABLE_SIMD)
+#  if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define PJPLOT_SIMD_X86 1
+#    include <immintrin.h>
+#    if defined(_MSC_VER)
+#      include <intrin.h>
+#    endif
+#  elif defined(__aarch64__) || defined(_M_ARM64)
+#    define PJPLOT_SIMD_NEON 1
+#    include <arm_neon.h>
+#  endif
+#endif
+
+// allows AVX2 kernels to be compiled without -mavx2, they are only called after a runtime CPU check
+#if defined(__GNUC__) || defined(__clang__)
+#  define PJPLOT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#  define PJPLOT_TARGET_AVX2
+#endif
+
+// marks a loop whose iterations are independent, so it is vectorized without runtime aliasing checks
+#if defined(__clang__)
+#  define PJPLOT_IVDEP _Pragma("clang loop vectorize(enable)")
+#elif defined(__GNUC__)
+#  define PJPLOT_IVDEP _Pragma("GCC ivdep")
+#elif defined(_MSC_VER)
+#  define PJPLOT_IVDEP __pragma(loop(ivdep))
+#else
+#  define PJPLOT_IVDEP
+#endif
+
+// memory mapped input files, define PJPLOT_DISABLE_MMAP to leave out the platform headers
+#if !defined(PJPLOT_DISABLE_MMAP)
+#  if defined(_WIN32)
+#    define PJPLOT_MMAP_WIN32 1
+#    ifndef WIN32_LEAN_AND_MEAN
+#      define WIN32_LEAN_AND_MEAN
+#    endif
+#    ifndef NOMINMAX
+#      define NOMINMAX
+#    endif
+#    ifndef NOGDI
+#      define NOGDI // wingdi.h defines an RGB macro
+#    endif
+#    include <windows.h>
+#  elif defined(__unix__) || defined(__APPLE__)
+#    define PJPLOT_MMAP_POSIX 1
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#  endif
+#endif
+
+// bounds checks on ArrayNd::operator(), on in debug builds; define PJPLOT_CHECKED_ACCESS to 0 or 1 to override
+#if !defined(PJPLOT_CHECKED_ACCESS)
+#  if defined(NDEBUG)
+#    define PJPLOT_CHECKED_ACCESS 0
+#  else
+#    define PJPLOT_CHECKED_ACCESS 1
+#  endif
+#endif
+
+// render pipeline instrumentation, define PJPLOT_ENABLE_INSTRUMENTATION to record the stages of every plot into the
+// FrameProfiler set on the Factory. Without it the hooks expand to nothing and the profiler stays empty.
+#if defined(PJPLOT_ENABLE_INSTRUMENTATION)
+#  define PJPLOT_PROFILE_SCOPE(name, profiler) const ::PjPlot::ProfileScope name(profiler)
+#  define PJPLOT_PROFILE_STAGE(name, stage) ::PjPlot::StageTimer name(stage)
+#  define PJPLOT_PROFILE_BYTES(name, num_bytes) name.add_bytes(num_bytes)
+#  define PJPLOT_PROFILE_ALLOCATION(num_bytes) ::PjPlot::FrameProfiler::record_allocation(num_bytes)
+#else
+#  define PJPLOT_PROFILE_SCOPE(name, profiler) static_cast<void>(0)
+#  define PJPLOT_PROFILE_STAGE(name, stage) static_cast<void>(0)
+#  define PJPLOT_PROFILE_BYTES(name, num_bytes) static_cast<void>(0)
+#  define PJPLOT_PROFILE_ALLOCATION(num_bytes) static_cast<void>(0)
+#endif
 
 
 
@@ -29,6 +131,138 @@ namespace PjPlot {
         T z;
     };
 
+    // axis-aligned pixel rectangle, (x, y) is the top-left corner
+    struct Rect {
+        size_t x;
+        size_t y;
+        size_t width;
+        size_t height;
+
+        [[nodiscard]] constexpr auto is_empty() const noexcept -> bool {
+            return width == 0 || height == 0;
+        }
+
+        // overlap of two rectangles, empty if they do not intersect
+        [[nodiscard]] constexpr auto intersect(const Rect& other) const noexcept -> Rect {
+            const size_t left = x > other.x ? x : other.x;
+            const size_t top = y > other.y ? y : other.y;
+            const size_t right = x + width < other.x + other.width ? x + width : other.x + other.width;
+            const size_t bottom = y + height < other.y + other.height ? y + height : other.y + other.height;
+            if (right <= left || bottom <= top) {
+                return Rect{left, top, 0, 0};
+            }
+            return Rect{left, top, right - left, bottom - top};
+        }
+    };
+
+    // Tracks the regions of an image that changed since the last reset as a short list of bounding boxes, so callers
+    // can upload or send only what was redrawn. Overlapping or touching boxes are merged, and once the list is full
+    // a new box is merged into whichever existing box grows the least.
+    class DamageRegion {
+    public:
+        static constexpr size_t k_max_num_rects = 8;
+
+        constexpr DamageRegion() = default;
+
+        constexpr void add(Rect rect) noexcept {
+            if (rect.is_empty()) {
+                return;
+            }
+            for (size_t i = 0; i < m_num_rects;) {
+                if (touches(m_rects[i], rect)) {
+                    rect = unite(rect, m_rects[i]);
+                    m_rects[i] = m_rects[--m_num_rects];
+                    i = 0;
+                } else {
+                    ++i;
+                }
+            }
+            if (m_num_rects < k_max_num_rects) {
+                m_rects[m_num_rects++] = rect;
+                return;
+            }
+            size_t best = 0;
+            size_t best_growth = std::numeric_limits<size_t>::max();
+            for (size_t i = 0; i < m_num_rects; ++i) {
+                const size_t growth = area(unite(m_rects[i], rect)) - area(m_rects[i]);
+                if (growth < best_growth) {
+                    best = i;
+                    best_growth = growth;
+                }
+            }
+            m_rects[best] = unite(m_rects[best], rect);
+        }
+
+        [[nodiscard]] constexpr auto get_rects() const noexcept -> std::span<const Rect> {
+            return std::span<const Rect>(m_rects.data(), m_num_rects);
+        }
+
+        // single box covering every damaged region
+        [[nodiscard]] constexpr auto get_bounds() const noexcept -> Rect {
+            if (m_num_rects == 0) {
+                return Rect{0, 0, 0, 0};
+            }
+            Rect res = m_rects[0];
+            for (size_t i = 1; i < m_num_rects; ++i) {
+                res = unite(res, m_rects[i]);
+            }
+            return res;
+        }
+
+        [[nodiscard]] constexpr auto is_empty() const noexcept -> bool {
+            return m_num_rects == 0;
+        }
+
+        constexpr void reset() noexcept {
+            m_num_rects = 0;
+        }
+
+    private:
+        [[nodiscard]] constexpr static auto unite(const Rect& a, const Rect& b) noexcept -> Rect {
+            const size_t left = std::min(a.x, b.x);
+            const size_t top = std::min(a.y, b.y);
+            const size_t right = std::max(a.x + a.width, b.x + b.width);
+            const size_t bottom = std::max(a.y + a.height, b.y + b.height);
+            return Rect{left, top, right - left, bottom - top};
+        }
+
+        // overlapping or sharing an edge
+        [[nodiscard]] constexpr static auto touches(const Rect& a, const Rect& b) noexcept -> bool {
+            return a.x <= b.x + b.width && b.x <= a.x + a.width && a.y <= b.y + b.height && b.y <= a.y + a.height;
+        }
+
+        [[nodiscard]] constexpr static auto area(const Rect& rect) noexcept -> size_t {
+            return rect.width * rect.height;
+        }
+
+        std::array<Rect, k_max_num_rects> m_rects{};
+        size_t m_num_rects = 0;
+    };
+
+#ifdef PJPLOT_ENABLE_TESTS
+    // little compile-time test to ensure touching rects merge and overflow keeps every rect covered
+    consteval static auto test_damage_region() -> bool {
+        DamageRegion damage;
+        damage.add(Rect{0, 0, 10, 10});
+        damage.add(Rect{10, 0, 5, 5});
+        if (damage.get_rects().size() != 1 || damage.get_bounds().width != 15) {
+            return false;
+        }
+        for (size_t i = 0; i < 3 * DamageRegion::k_max_num_rects; ++i) {
+            damage.add(Rect{i * 20, 100, 1, 1});
+            bool is_covered = false;
+            for (const auto& rect : damage.get_rects()) {
+                is_covered |= rect.x <= i * 20 && i * 20 < rect.x + rect.width && rect.y <= 100 && 100 < rect.y + rect.height;
+            }
+            if (!is_covered || damage.get_rects().size() > DamageRegion::k_max_num_rects) {
+                return false;
+            }
+        }
+        return true;
+    }
+    static_assert(test_damage_region(), "Error: damage region lost a rect");
+#endif
+
     struct RGB {
         uint8_t r;
         uint8_t g;
@@ -40,6 +274,7 @@ namespace PjPlot {
         constexpr RGBA(uint8_t r, uint8_t g, uint8_t b, uint8_t a) 
         : m_r(r), m_g(g), m_b(b), m_a(a) {
         }
+        [[nodiscard]] constexpr auto operator==(const RGBA&) const -> bool = default;
         uint8_t m_r;
         uint8_t m_g;
         uint8_t m_b;
@@ -111,6 +346,23 @@ namespace PjPlot {
     template <typename T>
     concept UnderlyingType = AllowedType<T>;
 
+    // one series of any of the arithmetic sample types, a list of these plots mixed-type data without converting it
+    using v_SeriesSpan = std::variant<std::span<const int>, std::span<const uint8_t>, std::span<const uint32_t>, std::span<const float>, std::span<const double>>;
+
+#ifdef PJPLOT_ENABLE_TESTS
+    // little compile-time test to ensure every arithmetic allowed type can be passed as a series
+    template <size_t I = 0>
+    consteval static auto test_series_span() -> bool {
+        if constexpr (I < std::variant_size_v<v_AllowedTypes>) {
+            using T = std::variant_alternative_t<I, v_AllowedTypes>;
+            static_assert(!std::is_arithmetic_v<T> || is_in_variant_v<std::span<const T>, v_SeriesSpan>, "Error: sample type missing from v_SeriesSpan");
+            return test_series_span<I+1>();
+        }
+        return true;
+    }
+    constexpr static bool series_span_test = test_series_span();
+#endif
+
 
     template <size_t Length>
     struct StaticSize1 {
@@ -158,20 +410,47 @@ namespace PjPlot {
         return res;
     }
 
+    // row-major strides of an N-D size, the last dimension is contiguous
+    template <size_t N>
+    constexpr inline auto size_strides_array(const std::array<size_t, N>& sizes) noexcept {
+        std::array<size_t, N> strides;
+        size_t stride = 1;
+        for (size_t i = N; i-- > 0;) {
+            strides[i] = stride;
+            stride *= sizes[i];
+        }
+        return strides;
+    }
+
+    template <size_t N, std::array<size_t, N> Sizes>
+    requires (N > 3)
+    struct StaticSizeN;
+
+    // size of a slice of an N-D static size, chosen by specialization so StaticSizeN<3, ...> is never named
+    template <size_t N, std::array<size_t, N> Sizes>
+    struct StaticSizeNSlice {
+        using type = StaticSizeN<N-1, slice_size_array(Sizes)>;
+    };
+
+    template <std::array<size_t, 4> Sizes>
+    struct StaticSizeNSlice<4, Sizes> {
+        using type = StaticSize3<Sizes[1], Sizes[2], Sizes[3]>;
+    };
+
     template <size_t N, std::array<size_t, N> Sizes>
     requires (N > 3)
     struct StaticSizeN {
         using is_static_size = std::true_type;
         using is_size_type = std::true_type;
 
-        static constexpr size_t nele() {return std::accumulate(Sizes.begin(), Sizes.end(), 1, std::multiplies<size_t>());}
+        static constexpr size_t nele() {return std::accumulate(Sizes.begin(), Sizes.end(), size_t{1}, std::multiplies<size_t>());}
         static constexpr size_t dims = N;
+        static constexpr std::array<size_t, N> k_strides = size_strides_array(Sizes);
 
-        using SliceType = std::conditional_t<
-            (N == 4),
-            StaticSize3<Sizes[1], Sizes[2], Sizes[3]>,
-            StaticSizeN<N-1, slice_size_array(Sizes)>
-        >;
+        static constexpr size_t extent(size_t dim) {return Sizes[dim];}
+        static constexpr size_t stride(size_t dim) {return k_strides[dim];}
+
+        using SliceType = typename StaticSizeNSlice<N, Sizes>::type;
         [[nodiscard]] auto slice() const noexcept {
             return SliceType();
         }
@@ -182,10 +461,11 @@ namespace PjPlot {
         using is_static_size = std::false_type;
         using is_size_type = std::true_type;
 
+        constexpr DynamicSize1() = default;
         constexpr DynamicSize1(size_t length) : m_length(length) {}
 
-        size_t length() {return m_length;}
-        size_t nele() {return m_length;}
+        constexpr size_t length() const {return m_length;}
+        constexpr size_t nele() const {return m_length;}
         size_t m_length = 0;
         static constexpr size_t dims = 1;
         using SliceType = void;
@@ -196,11 +476,12 @@ namespace PjPlot {
         using is_static_size = std::false_type;
         using is_size_type = std::true_type;
 
+        constexpr DynamicSize2() = default;
         constexpr DynamicSize2(size_t rows, size_t cols) : m_rows(rows), m_cols(cols) {}
 
-        constexpr size_t rows() {return m_rows;}
-        constexpr size_t cols() {return m_cols;}
-        constexpr size_t nele() {return rows()*cols();}
+        constexpr size_t rows() const {return m_rows;}
+        constexpr size_t cols() const {return m_cols;}
+        constexpr size_t nele() const {return rows()*cols();}
         size_t m_rows = 0;
         size_t m_cols = 0;
         static constexpr size_t dims = 2;
@@ -215,49 +496,94 @@ namespace PjPlot {
         using is_static_size = std::false_type;
         using is_size_type = std::true_type;
 
+        constexpr DynamicSize3() = default;
         constexpr DynamicSize3(size_t slices, size_t rows, size_t cols) : m_slices(slices), m_rows(rows), m_cols(cols) {}
 
-        constexpr size_t slices() {return m_slices;}
-        constexpr size_t rows() {return m_rows;}
-        constexpr size_t cols() {return m_cols;}
-        constexpr size_t nele() {return slices()*rows()*cols();}
+        constexpr size_t slices() const {return m_slices;}
+        constexpr size_t rows() const {return m_rows;}
+        constexpr size_t cols() const {return m_cols;}
+        constexpr size_t nele() const {return slices()*rows()*cols();}
         size_t m_slices = 0;
         size_t m_rows = 0;
         size_t m_cols = 0;
         static constexpr size_t dims = 3;
-        using SliceType = DynamicSize1;
+        using SliceType = DynamicSize2;
         [[nodiscard]] auto slice() const noexcept {
             return DynamicSize2(m_rows, m_cols);
         }
     };
     
+    template <size_t N>
+    requires (N > 3)
+    struct DynamicSizeN;
+
+    template <size_t N>
+    struct DynamicSizeNSlice {
+        using type = DynamicSizeN<N-1>;
+    };
+
+    template <>
+    struct DynamicSizeNSlice<4> {
+        using type = DynamicSize3;
+    };
+
     template <size_t N>
     requires (N > 3)
     struct DynamicSizeN {
-        using is_static_size = std::true_type;
+        static constexpr bool is_dynamic = true;
+        using is_static_size = std::false_type;
         using is_size_type = std::true_type;
-        constexpr DynamicSizeN(std::array<size_t, N>&& sizes) : m_sizes(sizes) {}
+        constexpr DynamicSizeN(const std::array<size_t, N>& sizes) : m_sizes(sizes), m_strides(size_strides_array(sizes)) {}
 
-        constexpr size_t nele() {return std::accumulate(m_sizes.begin(), m_sizes.end(), 1, std::multiplies<size_t>());}
+        constexpr size_t nele() const {return m_strides[0] * m_sizes[0];}
+        constexpr size_t extent(size_t dim) const {return m_sizes[dim];}
+        constexpr size_t stride(size_t dim) const {return m_strides[dim];}
         std::array<size_t, N> m_sizes;
+        std::array<size_t, N> m_strides; ///< computed once, so indexing does not multiply the sizes per access
         static constexpr size_t dims = N;
 
-        using SliceType = std::conditional_t<
-            (N == 4),
-            DynamicSize3,
-            DynamicSizeN<N-1>                      // Dynamic size: std::vector
-        >;
+        using SliceType = typename DynamicSizeNSlice<N>::type;
 
         [[nodiscard]] auto slice() const noexcept {
             if constexpr (N == 4) {
                 return DynamicSize3(m_sizes[1], m_sizes[2], m_sizes[3]);
             } else {
-                return DynamicSizeN(slice_size_array(m_sizes));
+                return DynamicSizeN<N-1>(slice_size_array(m_sizes));
+            }
+        }
+    };
+
+    // Bounds checking policies for element access. The checked policy throws std::out_of_range, the unchecked one
+    // compiles to nothing so an index is a single multiply-add per dimension with no branches.
+    struct CheckedAccess {
+        static constexpr bool is_checked = true;
+
+        static constexpr void check(size_t idx, size_t extent, const char* message) {
+            if (idx >= extent) {
+                throw std::out_of_range(message);
             }
-            
         }
     };
 
+    struct UncheckedAccess {
+        static constexpr bool is_checked = false;
+
+        static constexpr void check(size_t, size_t, const char*) noexcept {}
+    };
+
+    template <typename T>
+    concept AccessPolicy = requires (size_t idx) {
+        { T::is_checked } -> std::convertible_to<bool>;
+        T::check(idx, idx, "");
+    };
+
+    // policy of ArrayNd::operator(), see PJPLOT_CHECKED_ACCESS
+#if PJPLOT_CHECKED_ACCESS
+    using DefaultAccess = CheckedAccess;
+#else
+    using DefaultAccess = UncheckedAccess;
+#endif
+
     template <typename T>
     concept Size1 = requires {
         typename T::is_size_type;  // Ensures the type has the is_size_type trait
@@ -265,10 +591,9 @@ namespace PjPlot {
         T::dims == 1;
     };
 
-    [[nodiscard]] inline constexpr auto calculate_linear_idx(Size1 auto dims, size_t idx) -> size_t {
-        if constexpr (idx >= dims.length()) {
-            throw std::out_of_range("Index out of range");
-        }
+    template <AccessPolicy Access = DefaultAccess>
+    [[nodiscard]] inline constexpr auto calculate_linear_idx(Size1 auto dims, size_t idx) noexcept(!Access::is_checked) -> size_t {
+        Access::check(idx, dims.length(), "Index out of range");
         return idx;
     }
 
@@ -281,15 +606,11 @@ namespace PjPlot {
         T::dims == 2;
     };
 
-    [[nodiscard]] inline constexpr auto calculate_linear_idx(Size2 auto dims, size_t row, size_t col) -> size_t {
-        if constexpr (row >= dims.rows()) {
-            throw std::out_of_range("Row index out of range");
-        }
-        if constexpr (col >= dims.cols()) {
-            throw std::out_of_range("Column index out of range");
-        }
-        const auto row_idx = row * dims.cols();
-        return row_idx + col;
+    template <AccessPolicy Access = DefaultAccess>
+    [[nodiscard]] inline constexpr auto calculate_linear_idx(Size2 auto dims, size_t row, size_t col) noexcept(!Access::is_checked) -> size_t {
+        Access::check(row, dims.rows(), "Row index out of range");
+        Access::check(col, dims.cols(), "Column index out of range");
+        return row * dims.cols() + col;
     }
 
 
@@ -303,20 +624,41 @@ namespace PjPlot {
         T::dims == 3;
     };
 
-    [[nodiscard]] inline constexpr auto calculate_linear_idx(Size3 auto dims, size_t slice, size_t row, size_t col) -> size_t {
-        if constexpr (slice >= dims.slices()) {
-            throw std::out_of_range("Slice index out of range");
-        }
-        if constexpr (row >= dims.rows()) {
-            throw std::out_of_range("Row index out of range");
-        }
-        if constexpr (col >= dims.cols()) {
-            throw std::out_of_range("Column index out of range");
+    template <AccessPolicy Access = DefaultAccess>
+    [[nodiscard]] inline constexpr auto calculate_linear_idx(Size3 auto dims, size_t slice, size_t row, size_t col) noexcept(!Access::is_checked) -> size_t {
+        Access::check(slice, dims.slices(), "Slice index out of range");
+        Access::check(row, dims.rows(), "Row index out of range");
+        Access::check(col, dims.cols(), "Column index out of range");
+        return (slice * dims.rows() + row) * dims.cols() + col;
+    }
+
+    // 4-D and higher sizes index through their stride table, one multiply-add per dimension
+    template <AccessPolicy Access = DefaultAccess, typename Size, std::convertible_to<size_t>... Idx>
+    requires (Size::dims > 3 && sizeof...(Idx) == Size::dims)
+    [[nodiscard]] inline constexpr auto calculate_linear_idx(const Size& dims, Idx... idx) noexcept(!Access::is_checked) -> size_t {
+        const std::array<size_t, Size::dims> indices{static_cast<size_t>(idx)...};
+        size_t linear_idx = 0;
+        for (size_t dim = 0; dim < Size::dims; ++dim) {
+            Access::check(indices[dim], dims.extent(dim), "Index out of range");
+            linear_idx += indices[dim] * dims.stride(dim);
         }
-        const auto slice_idx = slice * dims.rows() * dims.cols();
-        const auto row_idx = row * dims.cols();
-        return slice_idx + row_idx + col;
+        return linear_idx;
+    }
+
+#ifdef PJPLOT_ENABLE_TESTS
+    // the stride tables agree with row-major indexing, and both policies compute the same index
+    consteval auto test_linear_idx() -> bool {
+        using Static4 = StaticSizeN<4, std::array<size_t, 4>{2, 3, 4, 5}>;
+        const DynamicSizeN<5> dynamic5({2, 3, 4, 5, 6});
+        return Static4::k_strides == std::array<size_t, 4>{60, 20, 5, 1}
+            && calculate_linear_idx<UncheckedAccess>(Static4{}, 1, 2, 3, 4) == 119
+            && calculate_linear_idx<CheckedAccess>(dynamic5, 1, 2, 3, 4, 5) == 719
+            && dynamic5.nele() == 720
+            && calculate_linear_idx<UncheckedAccess>(DynamicSize3(3, 4, 5), 2, 3, 4) == 59
+            && calculate_linear_idx<CheckedAccess>(StaticSize2<4, 5>{}, 3, 4) == 19;
     }
+    static_assert(test_linear_idx());
+#endif
 
 
     // helper function to unpack an array of indices and call the correct overload of calculate_linear_idx
@@ -366,7 +708,7 @@ namespace PjPlot {
          * 
          * @return const std::string& The stored failure message.
          */
-        [[nodiscard]] constexpr auto get_message() noexcept -> const std::string& {
+        [[nodiscard]] constexpr auto get_message() const noexcept -> const std::string& {
             return m_message;
         }
 
@@ -470,6 +812,15 @@ namespace PjPlot {
             return std::get<T>(m_value);
         }
 
+        /**
+         * @brief Checks whether the result holds a failure indication.
+         * 
+         * @return bool True if the result is a failure, in which case get_value() throws.
+         */
+        [[nodiscard]] constexpr auto is_failure() const noexcept -> bool {
+            return std::holds_alternative<FailureType>(m_value);
+        }
+
     private:
         std::variant<T, FailureType> m_value; ///< Holds either the successful value or a failure indication.
     };
@@ -484,442 +835,8584 @@ namespace PjPlot {
         }
     }
 
-    // Type trait to select storage type based on size (static or dynamic) and ownership (owning or non-owning)
-    template <typename T, SizeN Size, bool IsOwning = true>
-    using StorageType = std::conditional_t<
-        IsOwning, // If owning, select std::array or std::vector
-        std::conditional_t<
-            (Size::is_static_size::value),
-            std::array<T, get_static_nele<Size>()>, // Static size: std::array
-            std::vector<T>                          // Dynamic size: std::vector
-        >,
-        std::span<T> // If not owning, use std::span for both static and dynamic sizes
-    >;
+    // anything the encoders and exporters can hand their output to, called with consecutive pieces of the file
+    template <typename Sink>
+    concept ByteSink = std::invocable<Sink&, std::span<const uint8_t>>;
 
-    template <typename T, SizeN Size, bool IsOwning = true>
-    class ArrayNd {
-        using is_static_size = Size::is_static_size;
-    public:
-        using is_array_type = std::true_type;
+    enum class ImageFormat {
+        PPM, QOI, PNG, COUNT
+    };
 
-        // SFINAE constructor for when a static size type is provided
-        constexpr ArrayNd(Size size) noexcept 
-        requires (is_static_size::value && IsOwning) : m_size(size), m_data() {}
+    [[nodiscard]] inline auto to_string(ImageFormat val) -> std::string_view {
+        switch (val) {
+            case ImageFormat::PPM:
+                return "ppm";
+            case ImageFormat::QOI:
+                return "qoi";
+            case ImageFormat::PNG:
+                return "png";
+            default:
+                throw std::invalid_argument("Error: unsupported image format");
+        }
+    }
 
-        // SFINAE constructor for when a dynamic size type is provided
-        constexpr ArrayNd(Size size) noexcept 
-        requires (!is_static_size::value && IsOwning) : m_size(size), m_data(std::vector<T>(size.nele())) {}
+    // NONE writes PNG pixel data as stored deflate blocks straight from the image, FAST runs a single pass
+    // fixed-Huffman deflate. PPM and QOI have a single encoding and ignore the level.
+    enum class CompressionLevel {
+        NONE, FAST, COUNT
+    };
 
-        // SFINAE constructor for when a view (non-owning) is created
-        constexpr ArrayNd(Size size, T* data) noexcept 
-        requires (!IsOwning) : m_size(size), m_data(std::span<T>(data, data +size.nele())) {}
+    [[nodiscard]] inline auto to_string(CompressionLevel val) -> std::string_view {
+        switch (val) {
+            case CompressionLevel::NONE:
+                return "none";
+            case CompressionLevel::FAST:
+                return "fast";
+            default:
+                throw std::invalid_argument("Error: unsupported compression level");
+        }
+    }
 
-        constexpr void resize(Size new_size) 
-        requires (IsOwning && !is_static_size::value) {
-            m_size = new_size;
-            m_data.resize(new_size.nele());
+    // true when the instrumentation hooks are compiled in, see PJPLOT_ENABLE_INSTRUMENTATION
+#if defined(PJPLOT_ENABLE_INSTRUMENTATION)
+    inline constexpr bool k_instrumentation_enabled = true;
+#else
+    inline constexpr bool k_instrumentation_enabled = false;
+#endif
+
+    // Stages of the render pipeline timed by the instrumentation hooks. Stages nest: PLOT covers a whole get_plot
+    // call, and RASTERIZE includes the underlay and overlay drawn with the series.
+    enum class RenderStage {
+        PLOT,       ///< one Factory::get_plot call
+        GRID_LAYER, ///< looking up, or building, the cached grid layer
+        DECIMATE,   ///< the pass over the samples finding the value range and reducing them to columns, bars or bounds
+        RASTERIZE,  ///< drawing the series
+        UNDERLAY,   ///< background and gridlines
+        OVERLAY,    ///< axes, ticks, labels and title
+        ENCODE,     ///< ImageEncoder::encode
+        COUNT
+    };
+
+    [[nodiscard]] inline auto to_string(RenderStage val) -> std::string_view {
+        switch (val) {
+            case RenderStage::PLOT:
+                return "plot";
+            case RenderStage::GRID_LAYER:
+                return "grid_layer";
+            case RenderStage::DECIMATE:
+                return "decimate";
+            case RenderStage::RASTERIZE:
+                return "rasterize";
+            case RenderStage::UNDERLAY:
+                return "underlay";
+            case RenderStage::OVERLAY:
+                return "overlay";
+            case RenderStage::ENCODE:
+                return "encode";
+            default:
+                throw std::invalid_argument("Error: unsupported render stage");
         }
+    }
 
-        [[nodiscard]] constexpr auto to_string() const noexcept -> std::string_view {
+    // one timed stage, times are in nanoseconds since the profiler was created
+    struct StageEvent {
+        RenderStage m_stage = RenderStage::PLOT;
+        uint32_t m_frame = 0;         ///< get_plot call the stage belongs to
+        uint32_t m_thread = 0;        ///< small id of the thread that ran the stage, in order of first use
+        int64_t m_start_ns = 0;
+        int64_t m_duration_ns = 0;
+        size_t m_bytes = 0;           ///< sample bytes read and pixel bytes written by the stage
+        size_t m_allocations = 0;     ///< heap buffers of the library's allocators and scratch on any thread while the stage ran, not of std containers
+        size_t m_allocated_bytes = 0;
+    };
 
-            // Handle the case of dimensions from 1 to 9
-            switch (Size::dims) {
-                case 1: return "1-D array";
-                case 2: return "2-D array";
-                case 3: return "3-D array";
-                case 4: return "4-D array";
-                case 5: return "5-D array";
-                case 6: return "6-D array";
-                case 7: return "7-D array";
-                case 8: return "8-D array";
-                case 9: return "9-D array";
-                default: return "N-D array";  // Default case for higher dimensions
+    struct StageTotals {
+        size_t m_calls = 0;
+        int64_t m_wall_ns = 0;
+        size_t m_bytes = 0;
+        size_t m_allocations = 0;
+        size_t m_allocated_bytes = 0;
+
+        constexpr void add(const StageEvent& event) noexcept {
+            ++m_calls;
+            m_wall_ns += event.m_duration_ns;
+            m_bytes += event.m_bytes;
+            m_allocations += event.m_allocations;
+            m_allocated_bytes += event.m_allocated_bytes;
+        }
+    };
+
+    // per-stage totals over one frame or over every frame recorded
+    struct FrameReport {
+        std::array<StageTotals, static_cast<size_t>(RenderStage::COUNT)> m_stages{};
+
+        [[nodiscard]] constexpr auto get(RenderStage stage) const -> const StageTotals& {
+            if (stage >= RenderStage::COUNT) {
+                throw std::invalid_argument("Error: unsupported render stage");
             }
+            return m_stages[static_cast<size_t>(stage)];
         }
+    };
+
+    // Collects the stage events of every frame rendered while it is active on a thread, see ProfileScope. Recording
+    // takes a lock per stage, so it is meant for finding where a frame's time goes rather than for leaving on.
+    class FrameProfiler {
+    public:
+        // the profiler and frame the calling thread records into, m_profiler is nullptr when none is active
+        struct ActiveFrame {
+            FrameProfiler* m_profiler = nullptr;
+            uint32_t m_frame = 0;
+        };
+
+        FrameProfiler() : m_epoch(std::chrono::steady_clock::now()) {
 
-        // Getter for the number of elements
-        [[nodiscard]] constexpr auto nele() const noexcept -> size_t {
-            return m_size.nele();
         }
 
-        // Getter for the type as a string (using to_string)
-        [[nodiscard]] constexpr auto type_s() const noexcept -> std::string_view {
-            return PjPlot::to_string<T>();
+        FrameProfiler(const FrameProfiler&) = delete;
+        auto operator=(const FrameProfiler&) -> FrameProfiler& = delete;
+
+        [[nodiscard]] static auto get_active() noexcept -> ActiveFrame& {
+            thread_local ActiveFrame active;
+            return active;
         }
 
-        // Const getter for array data as std::span
-        [[nodiscard]] auto data() const noexcept -> std::span<const T> {
-            return std::span<const T>(m_data.data(), m_data.size());
+        // count a buffer allocated by the library against the profiler active on the calling thread, if any. Only
+        // AlignedAllocator, FramePool, FrameArena and thread scratch report here, other heap use is not seen.
+        static void record_allocation(size_t num_bytes) noexcept {
+            FrameProfiler* profiler = get_active().m_profiler;
+            if (profiler != nullptr) {
+                profiler->m_num_allocations.fetch_add(1, std::memory_order_relaxed);
+                profiler->m_num_allocated_bytes.fetch_add(num_bytes, std::memory_order_relaxed);
+            }
         }
 
-        // Non-const getter for array data as std::span
-        [[nodiscard]] auto data() noexcept -> std::span<T> {
-            return std::span<T>(m_data.data(), m_data.size());
+        // small id of the calling thread, assigned on first use
+        [[nodiscard]] static auto get_thread_id() noexcept -> uint32_t {
+            static std::atomic<uint32_t> next_id{0};
+            thread_local const uint32_t id = next_id.fetch_add(1, std::memory_order_relaxed);
+            return id;
         }
 
-        // Iterator support
-        using iterator = T*;
-        using const_iterator = const T*;
+        [[nodiscard]] auto begin_frame() noexcept -> uint32_t {
+            return m_num_frames.fetch_add(1, std::memory_order_relaxed);
+        }
 
-        // Begin and end functions for non-const and const access
-        [[nodiscard]] constexpr auto begin() noexcept -> iterator {
-            return m_data.data();
+        [[nodiscard]] auto get_num_frames() const noexcept -> uint32_t {
+            return m_num_frames.load(std::memory_order_relaxed);
         }
 
-        [[nodiscard]] constexpr auto end() noexcept -> iterator {
-            return m_data.data() + m_data.size();
+        [[nodiscard]] auto get_now_ns() const noexcept -> int64_t {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_epoch).count();
         }
 
-        [[nodiscard]] constexpr auto begin() const noexcept -> const_iterator {
-            return m_data.data();
+        // allocations counted so far, as {number of buffers, bytes}
+        [[nodiscard]] auto get_allocations() const noexcept -> std::pair<size_t, size_t> {
+            return {m_num_allocations.load(std::memory_order_relaxed), m_num_allocated_bytes.load(std::memory_order_relaxed)};
         }
 
-        [[nodiscard]] constexpr auto end() const noexcept -> const_iterator {
-            return m_data.data() + m_data.size();
+        // events that could not be stored because memory ran out
+        [[nodiscard]] auto get_num_dropped() const noexcept -> size_t {
+            return m_num_dropped.load(std::memory_order_relaxed);
         }
 
-        // Element-wise access operator (non-const)
-        template <typename... Args>
-        [[nodiscard]] inline auto operator()(Args... args) -> T& {
-            static_assert(sizeof...(args) == m_size.dims, "Incorrect number of arguments");
-            return m_data[calculate_linear_idx(m_size, args...)];
-        }        
+        void record(const StageEvent& event) noexcept {
+            try {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_events.push_back(event);
+            } catch (...) {
+                m_num_dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
 
-        // Element-wise access operator (const)
-        template <typename... Args>
-        [[nodiscard]] auto operator()(Args... args) const -> const T& {
-            static_assert(sizeof...(args) == m_size.dims, "Incorrect number of arguments");
-            return m_data[calculate_linear_idx(m_size, args...)];
+        [[nodiscard]] auto get_events() const -> std::vector<StageEvent> {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_events;
         }
 
-        [[nodiscard]] constexpr auto operator[](size_t idx) -> decltype(auto) {
-            if constexpr (Size::dims > 1) {
-                auto slice_size = m_size.slice();
-                // return a contiguous view to the slice at the next lowest dimension
-                return ArrayNd<T, typename Size::SliceType, false>(slice_size, m_data.data() + idx * slice_size.nele());
-            } else {
-                // return reference to single value at the given index
-                T& ref = m_data[idx];
-                return ref;
+        [[nodiscard]] auto get_frame_report(uint32_t frame) const -> FrameReport {
+            FrameReport report;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& event : m_events) {
+                if (event.m_frame == frame) {
+                    report.m_stages[static_cast<size_t>(event.m_stage)].add(event);
+                }
             }
+            return report;
         }
 
-        [[nodiscard]] constexpr auto operator[](size_t idx) const -> decltype(auto) {
-            if constexpr (Size::dims > 1) {
-                auto slice_size = m_size.slice();
-                // return a contiguous view to the slice at the next lowest dimension
-                return ArrayNd<const T, typename Size::SliceType, false>(slice_size, m_data.data() + idx * slice_size.nele());
-            } else {
-                // return reference to single value at the given index
-                const T& ref = m_data[idx];
-                return ref;
+        [[nodiscard]] auto get_report() const -> FrameReport {
+            FrameReport report;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const auto& event : m_events) {
+                report.m_stages[static_cast<size_t>(event.m_stage)].add(event);
             }
+            return report;
         }
 
-    protected:
-        Size m_size;
-        StorageType<T, Size, IsOwning> m_data;
-    };
-
-    template <typename T, Size1 Size>
-    using Array1d = ArrayNd<T, Size>;
-
-    template <typename T, Size2 Size>
-    class Mat2 : public ArrayNd<T, Size> {
-    public:
+        // forget the events, frame numbering and allocation counts carry on
+        void clear() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_events.clear();
+        }
 
-        constexpr Mat2(Size size) noexcept 
-        : ArrayNd<T, Size>(size) {}
+        // the events in the Chrome trace event format, which chrome://tracing and Perfetto open directly
+        template <ByteSink Sink>
+        void write_chrome_trace(Sink&& sink) const {
+            constexpr size_t k_flush_bytes = 16384;
+            const auto events = get_events();
+            std::string out = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+            for (size_t i = 0; i < events.size(); ++i) {
+                const auto& event = events[i];
+                out += i == 0 ? "\n" : ",\n";
+                out += "{\"name\":\"";
+                out += to_string(event.m_stage);
+                out += "\",\"cat\":\"pjplot\",\"ph\":\"X\",\"pid\":0,\"tid\":";
+                append_number(out, event.m_thread);
+                out += ",\"ts\":";
+                append_micros(out, event.m_start_ns);
+                out += ",\"dur\":";
+                append_micros(out, event.m_duration_ns);
+                out += ",\"args\":{\"frame\":";
+                append_number(out, event.m_frame);
+                out += ",\"bytes\":";
+                append_number(out, event.m_bytes);
+                out += ",\"allocations\":";
+                append_number(out, event.m_allocations);
+                out += ",\"allocated_bytes\":";
+                append_number(out, event.m_allocated_bytes);
+                out += "}}";
+                if (out.size() >= k_flush_bytes) {
+                    sink(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(out.data()), out.size()));
+                    out.clear();
+                }
+            }
+            out += "\n]}\n";
+            sink(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(out.data()), out.size()));
+        }
 
-        // Getter for the number of columns
-        [[nodiscard]] constexpr auto cols() const noexcept -> size_t {
-            return ArrayNd<T, Size>::cols();
+    private:
+        static void append_number(std::string& out, uint64_t val) {
+            std::array<char, 24> buffer;
+            const auto res = std::to_chars(buffer.data(), buffer.data() + buffer.size(), val);
+            out.append(buffer.data(), res.ptr);
         }
 
-        // Getter for the number of rows
-        [[nodiscard]] constexpr auto rows() const noexcept -> size_t {
-            return ArrayNd<T, Size>::rows();
+        // trace event times are in microseconds
+        static void append_micros(std::string& out, int64_t ns) {
+            std::array<char, 32> buffer;
+            const auto res = std::to_chars(buffer.data(), buffer.data() + buffer.size(), static_cast<double>(ns) / 1000.0, std::chars_format::fixed, 3);
+            out.append(buffer.data(), res.ptr);
         }
-    };
 
-    template <typename T, Size2 Size>
-    using Mat2View = ArrayNd<T, Size, false>;
+        std::chrono::steady_clock::time_point m_epoch;
+        mutable std::mutex m_mutex;
+        std::vector<StageEvent> m_events;
+        std::atomic<uint32_t> m_num_frames{0};
+        std::atomic<size_t> m_num_allocations{0};
+        std::atomic<size_t> m_num_allocated_bytes{0};
+        std::atomic<size_t> m_num_dropped{0};
+    };
 
-    template <typename T, Size3 Size>
-    class Mat3 : public ArrayNd<T, Size> {
+    // Makes profiler the active one of the calling thread for the lifetime of the scope. The outermost scope of a
+    // profiler begins a new frame, nested scopes continue it, and a nullptr profiler leaves the thread as it was.
+    class ProfileScope {
     public:
+        constexpr explicit ProfileScope(FrameProfiler* profiler) noexcept {
+            if (!std::is_constant_evaluated() && profiler != nullptr) {
+                auto& active = FrameProfiler::get_active();
+                m_previous = active;
+                m_is_installed = true;
+                if (active.m_profiler != profiler) {
+                    active = FrameProfiler::ActiveFrame{profiler, profiler->begin_frame()};
+                }
+            }
+        }
 
-        constexpr Mat3(Size size) noexcept 
-        : ArrayNd<T, Size>(size) {}
-
-        // Getter for the number of slices
-        [[nodiscard]] constexpr auto slices() const noexcept -> size_t {
-            return ArrayNd<T, Size>::slices();
+        // continue a frame begun on another thread, e.g. in a thread pool task
+        explicit ProfileScope(FrameProfiler::ActiveFrame frame) noexcept
+        : m_previous(FrameProfiler::get_active()), m_is_installed(true) {
+            FrameProfiler::get_active() = frame;
         }
 
-        // Getter for the number of columns
+        ProfileScope(const ProfileScope&) = delete;
+        auto operator=(const ProfileScope&) -> ProfileScope& = delete;
+
+        constexpr ~ProfileScope() {
+            if (!std::is_constant_evaluated() && m_is_installed) {
+                FrameProfiler::get_active() = m_previous;
+            }
+        }
+
+    private:
+        FrameProfiler::ActiveFrame m_previous{};
+        bool m_is_installed = false;
+    };
+
+    // Scoped timer recording one stage event into the profiler active on the calling thread when it is destroyed.
+    // It does nothing when no profiler is active or during constant evaluation.
+    class StageTimer {
+    public:
+        constexpr explicit StageTimer(RenderStage stage) noexcept
+        : m_stage(stage) {
+            if (!std::is_constant_evaluated()) {
+                start(FrameProfiler::get_active());
+            }
+        }
+
+        // time a stage of the caller's own into profiler, in the active frame when profiler is active
+        StageTimer(FrameProfiler& profiler, RenderStage stage) noexcept
+        : m_stage(stage) {
+            const auto& active = FrameProfiler::get_active();
+            start(active.m_profiler == &profiler ? active : FrameProfiler::ActiveFrame{&profiler, profiler.begin_frame()});
+        }
+
+        StageTimer(const StageTimer&) = delete;
+        auto operator=(const StageTimer&) -> StageTimer& = delete;
+
+        constexpr ~StageTimer() {
+            if (!std::is_constant_evaluated() && m_frame.m_profiler != nullptr) {
+                stop();
+            }
+        }
+
+        constexpr void add_bytes(size_t num_bytes) noexcept {
+            m_bytes += num_bytes;
+        }
+
+    private:
+        void start(FrameProfiler::ActiveFrame frame) noexcept {
+            m_frame = frame;
+            if (m_frame.m_profiler != nullptr) {
+                m_allocations = m_frame.m_profiler->get_allocations();
+                m_start_ns = m_frame.m_profiler->get_now_ns();
+            }
+        }
+
+        void stop() noexcept {
+            FrameProfiler& profiler = *m_frame.m_profiler;
+            const int64_t end_ns = profiler.get_now_ns();
+            const auto allocations = profiler.get_allocations();
+            profiler.record(StageEvent{
+                m_stage, m_frame.m_frame, FrameProfiler::get_thread_id(), m_start_ns, end_ns - m_start_ns, m_bytes,
+                allocations.first - m_allocations.first, allocations.second - m_allocations.second});
+        }
+
+        RenderStage m_stage;
+        FrameProfiler::ActiveFrame m_frame{};
+        int64_t m_start_ns = 0;
+        size_t m_bytes = 0;
+        std::pair<size_t, size_t> m_allocations{};
+    };
+
+#ifdef PJPLOT_ENABLE_TESTS
+    // the timer is inert during constant evaluation, so the hooks can sit in constexpr render paths
+    consteval auto test_stage_timer_constexpr() -> bool {
+        StageTimer timer(RenderStage::RASTERIZE);
+        timer.add_bytes(4);
+        const ProfileScope scope(nullptr);
+        return true;
+    }
+    static_assert(test_stage_timer_constexpr());
+#endif
+
+    // Allocator policy for dynamic arrays whose storage must start on an Alignment byte boundary, 64 by default so
+    // image rows handed to the SIMD kernels never start part way through a cache line
+    template <typename T, size_t Alignment = 64>
+    struct AlignedAllocator {
+        static_assert(std::has_single_bit(Alignment) && Alignment >= alignof(T), "Error: alignment must be a power of two no smaller than alignof(T)");
+
+        using value_type = T;
+
+        template <typename U>
+        struct rebind {
+            using other = AlignedAllocator<U, Alignment>;
+        };
+
+        constexpr AlignedAllocator() noexcept = default;
+
+        template <typename U>
+        constexpr AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+        [[nodiscard]] auto allocate(size_t n) -> T* {
+            if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+                throw std::bad_array_new_length();
+            }
+            PJPLOT_PROFILE_ALLOCATION(n * sizeof(T));
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+        }
+
+        void deallocate(T* ptr, size_t) noexcept {
+            ::operator delete(ptr, std::align_val_t(Alignment));
+        }
+
+        template <typename U>
+        [[nodiscard]] constexpr auto operator==(const AlignedAllocator<U, Alignment>&) const noexcept -> bool {
+            return true;
+        }
+    };
+
+    // Per-thread cache of recently freed, 64 byte aligned buffers. Charts tend to be re-rendered at the same size
+    // every frame, so a freed image buffer is handed straight to the next allocation of the same size instead of
+    // going back to the heap. Buffers may be freed on any thread, they join that thread's cache.
+    class FramePool {
+    public:
+        static constexpr size_t k_alignment = 64;
+        static constexpr size_t k_max_num_cached = 8;
+
+        [[nodiscard]] static auto allocate(size_t num_bytes) -> void* {
+            auto& cache = get_cache();
+            for (size_t i = cache.m_num_cached; i-- > 0;) {
+                if (cache.m_blocks[i].m_num_bytes == num_bytes) {
+                    void* ptr = cache.m_blocks[i].m_ptr;
+                    std::copy(cache.m_blocks.begin() + i + 1, cache.m_blocks.begin() + cache.m_num_cached, cache.m_blocks.begin() + i);
+                    --cache.m_num_cached;
+                    return ptr;
+                }
+            }
+            PJPLOT_PROFILE_ALLOCATION(num_bytes);
+            return ::operator new(num_bytes, std::align_val_t(k_alignment));
+        }
+
+        static void deallocate(void* ptr, size_t num_bytes) noexcept {
+            auto& cache = get_cache();
+            if (cache.m_is_closed) {
+                ::operator delete(ptr, std::align_val_t(k_alignment));
+                return;
+            }
+            if (cache.m_num_cached == k_max_num_cached) {
+                // evict the least recently freed block
+                ::operator delete(cache.m_blocks[0].m_ptr, std::align_val_t(k_alignment));
+                std::copy(cache.m_blocks.begin() + 1, cache.m_blocks.end(), cache.m_blocks.begin());
+                --cache.m_num_cached;
+            }
+            cache.m_blocks[cache.m_num_cached++] = Block{ptr, num_bytes};
+        }
+
+        // give every cached buffer of the calling thread back to the heap
+        static void release() noexcept {
+            auto& cache = get_cache();
+            for (size_t i = 0; i < cache.m_num_cached; ++i) {
+                ::operator delete(cache.m_blocks[i].m_ptr, std::align_val_t(k_alignment));
+            }
+            cache.m_num_cached = 0;
+        }
+
+        // number of buffers cached by the calling thread
+        [[nodiscard]] static auto get_num_cached() noexcept -> size_t {
+            return get_cache().m_num_cached;
+        }
+
+    private:
+        struct Block {
+            void* m_ptr = nullptr;
+            size_t m_num_bytes = 0;
+        };
+
+        // trivially destructible, so buffers freed by other thread_local objects during thread exit still find it
+        struct Cache {
+            std::array<Block, k_max_num_cached> m_blocks{};
+            size_t m_num_cached = 0;
+            bool m_is_closed = false;
+        };
+
+        struct CacheGuard {
+            ~CacheGuard() {
+                release();
+                get_cache().m_is_closed = true;
+            }
+        };
+
+        [[nodiscard]] static auto get_cache() noexcept -> Cache& {
+            thread_local Cache cache;
+            thread_local CacheGuard guard;
+            (void) guard;
+            return cache;
+        }
+    };
+
+    // Allocator policy backed by the FramePool, steady-state rendering of same-sized images does no heap allocation
+    template <typename T>
+    struct FramePoolAllocator {
+        static_assert(alignof(T) <= FramePool::k_alignment, "Error: frame pool buffers are only 64 byte aligned");
+
+        using value_type = T;
+
+        constexpr FramePoolAllocator() noexcept = default;
+
+        template <typename U>
+        constexpr FramePoolAllocator(const FramePoolAllocator<U>&) noexcept {}
+
+        [[nodiscard]] auto allocate(size_t n) -> T* {
+            if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+                throw std::bad_array_new_length();
+            }
+            return static_cast<T*>(FramePool::allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T* ptr, size_t n) noexcept {
+            FramePool::deallocate(ptr, n * sizeof(T));
+        }
+
+        template <typename U>
+        [[nodiscard]] constexpr auto operator==(const FramePoolAllocator<U>&) const noexcept -> bool {
+            return true;
+        }
+    };
+
+    // Allocator adaptor turning the value-initialization std::vector does on resize into default-initialization.
+    // Trivial element types such as RGBA are then left uninitialized, for buffers that are fully overwritten anyway.
+    template <typename Base>
+    struct DefaultInitAllocator : Base {
+        using value_type = typename std::allocator_traits<Base>::value_type;
+
+        template <typename U>
+        struct rebind {
+            using other = DefaultInitAllocator<typename std::allocator_traits<Base>::template rebind_alloc<U>>;
+        };
+
+        constexpr DefaultInitAllocator() noexcept = default;
+
+        template <typename Other>
+        constexpr DefaultInitAllocator(const DefaultInitAllocator<Other>& other) noexcept
+        : Base(static_cast<const Other&>(other)) {}
+
+        template <typename U>
+        constexpr void construct(U* ptr) noexcept(std::is_nothrow_default_constructible_v<U>) {
+            ::new (static_cast<void*>(ptr)) U;
+        }
+
+        template <typename U, typename... Args>
+        constexpr void construct(U* ptr, Args&&... args) {
+            std::allocator_traits<Base>::construct(static_cast<Base&>(*this), ptr, std::forward<Args>(args)...);
+        }
+    };
+
+    // Tag selecting the constructors that leave elements uninitialized, see ArrayNd(Size, UninitializedTag)
+    struct UninitializedTag {};
+
+    inline constexpr UninitializedTag k_uninitialized{};
+
+    // Lazy element-wise expression over arrays, e.g. (samples - mean) / deviation * gain. An expression only holds its
+    // operands and computes element idx of the flat row-major result on demand, so assigning it to an ArrayNd or
+    // handing it to a chart engine reads every operand once in a single fused loop, with no buffer per operation.
+    template <typename T>
+    concept ArrayExpression = requires (const T& expr, size_t idx) {
+        typename T::is_array_expression;
+        typename T::value_type;
+        { expr.nele() } -> std::convertible_to<size_t>;
+        { expr[idx] } -> std::convertible_to<typename T::value_type>;
+    };
+
+    // Type trait to select storage type based on size (static or dynamic) and ownership (owning or non-owning).
+    // Allocator is the allocation policy of dynamic owning storage and is unused otherwise.
+    template <typename T, SizeN Size, bool IsOwning = true, typename Allocator = std::allocator<T>>
+    using StorageType = std::conditional_t<
+        IsOwning, // If owning, select std::array or std::vector
+        std::conditional_t<
+            (Size::is_static_size::value),
+            std::array<T, get_static_nele<Size>()>, // Static size: std::array
+            std::vector<T, Allocator>               // Dynamic size: std::vector
+        >,
+        std::span<T> // If not owning, use std::span for both static and dynamic sizes
+    >;
+
+    template <typename T, SizeN Size, bool IsOwning = true, typename Allocator = std::allocator<T>>
+    class ArrayNd {
+        using is_static_size = Size::is_static_size;
+    public:
+        using is_array_type = std::true_type;
+
+        // SFINAE constructor for an empty dynamic array, or a value-initialized static one
+        constexpr ArrayNd() noexcept 
+        requires (IsOwning && std::is_default_constructible_v<Size>) : m_size(), m_data() {}
+
+        // SFINAE constructor for when a static size type is provided
+        constexpr ArrayNd(Size size) noexcept 
+        requires (is_static_size::value && IsOwning) : m_size(size), m_data() {}
+
+        // SFINAE constructor for when a dynamic size type is provided, value-initialized whatever the allocator
+        constexpr ArrayNd(Size size) 
+        requires (!is_static_size::value && IsOwning) : m_size(size), m_data(size.nele(), T{}) {}
+
+        // Allocate without initializing, for buffers such as render targets that are completely overwritten before
+        // being read. Static sizes are left default-initialized. Dynamic sizes are too when the allocator is a
+        // DefaultInitAllocator, as it is for images by default (DefaultImageAllocator); other allocators give no way
+        // around std::vector value-initializing and still do.
+        constexpr ArrayNd(Size size, UninitializedTag) noexcept 
+        requires (is_static_size::value && IsOwning) : m_size(size) {}
+
+        constexpr ArrayNd(Size size, UninitializedTag) 
+        requires (!is_static_size::value && IsOwning) : m_size(size), m_data(size.nele()) {}
+
+        // SFINAE constructor for when a view (non-owning) is created
+        constexpr ArrayNd(Size size, T* data) noexcept 
+        requires (!IsOwning) : m_size(size), m_data(std::span<T>(data, data +size.nele())) {}
+
+        constexpr void resize(Size new_size) 
+        requires (IsOwning && !is_static_size::value) {
+            m_size = new_size;
+            m_data.resize(new_size.nele(), T{});
+        }
+
+        // evaluate an expression into the array, see assign()
+        template <ArrayExpression Expr>
+            requires (!std::is_const_v<T>)
+        constexpr auto operator=(const Expr& expr) -> ArrayNd& {
+            assign(expr);
+            return *this;
+        }
+
+        // Evaluate an expression with as many elements as the array in one fused, vectorizable loop. Element i of
+        // the expression only reads element i of its operands, so the expression may also read this array.
+        template <ArrayExpression Expr>
+            requires (!std::is_const_v<T>)
+        constexpr void assign(const Expr& expr) {
+            const size_t n = nele();
+            if (expr.nele() != n) {
+                throw std::invalid_argument("Error: expression and array have different numbers of elements");
+            }
+            T* dst = m_data.data();
+            PJPLOT_IVDEP
+            for (size_t i = 0; i < n; ++i) {
+                dst[i] = static_cast<T>(expr[i]);
+            }
+        }
+
+        [[nodiscard]] constexpr auto to_string() const noexcept -> std::string_view {
+
+            // Handle the case of dimensions from 1 to 9
+            switch (Size::dims) {
+                case 1: return "1-D array";
+                case 2: return "2-D array";
+                case 3: return "3-D array";
+                case 4: return "4-D array";
+                case 5: return "5-D array";
+                case 6: return "6-D array";
+                case 7: return "7-D array";
+                case 8: return "8-D array";
+                case 9: return "9-D array";
+                default: return "N-D array";  // Default case for higher dimensions
+            }
+        }
+
+        // Getter for the number of elements
+        [[nodiscard]] constexpr auto nele() const noexcept -> size_t {
+            return m_size.nele();
+        }
+
+        // Getter for the size, e.g. the rows and columns of a Mat2View
+        [[nodiscard]] constexpr auto get_size() const noexcept -> const Size& {
+            return m_size;
+        }
+
+        // Getter for the size type describing the shape of the array
+        [[nodiscard]] constexpr auto shape() const noexcept -> Size {
+            return m_size;
+        }
+
+        // Getter for the type as a string (using to_string)
+        [[nodiscard]] constexpr auto type_s() const noexcept -> std::string_view {
+            return PjPlot::to_string<T>();
+        }
+
+        // Const getter for array data as std::span
+        [[nodiscard]] constexpr auto data() const noexcept -> std::span<const T> {
+            return std::span<const T>(m_data.data(), m_data.size());
+        }
+
+        // Non-const getter for array data as std::span
+        [[nodiscard]] constexpr auto data() noexcept -> std::span<T> {
+            return std::span<T>(m_data.data(), m_data.size());
+        }
+
+        // Iterator support
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        // Begin and end functions for non-const and const access
+        [[nodiscard]] constexpr auto begin() noexcept -> iterator {
+            return m_data.data();
+        }
+
+        [[nodiscard]] constexpr auto end() noexcept -> iterator {
+            return m_data.data() + m_data.size();
+        }
+
+        [[nodiscard]] constexpr auto begin() const noexcept -> const_iterator {
+            return m_data.data();
+        }
+
+        [[nodiscard]] constexpr auto end() const noexcept -> const_iterator {
+            return m_data.data() + m_data.size();
+        }
+
+        // Element-wise access operator (non-const), bounds checked only under the DefaultAccess policy
+        template <typename... Args>
+        [[nodiscard]] constexpr auto operator()(Args... args) noexcept(!DefaultAccess::is_checked) -> T& {
+            static_assert(sizeof...(args) == Size::dims, "Incorrect number of arguments");
+            return m_data[calculate_linear_idx<DefaultAccess>(m_size, args...)];
+        }
+
+        // Element-wise access operator (const)
+        template <typename... Args>
+        [[nodiscard]] constexpr auto operator()(Args... args) const noexcept(!DefaultAccess::is_checked) -> const T& {
+            static_assert(sizeof...(args) == Size::dims, "Incorrect number of arguments");
+            return m_data[calculate_linear_idx<DefaultAccess>(m_size, args...)];
+        }
+
+        // element access that always checks the indices, throws std::out_of_range
+        template <typename... Args>
+        [[nodiscard]] constexpr auto at(Args... args) -> T& {
+            static_assert(sizeof...(args) == Size::dims, "Incorrect number of arguments");
+            return m_data[calculate_linear_idx<CheckedAccess>(m_size, args...)];
+        }
+
+        template <typename... Args>
+        [[nodiscard]] constexpr auto at(Args... args) const -> const T& {
+            static_assert(sizeof...(args) == Size::dims, "Incorrect number of arguments");
+            return m_data[calculate_linear_idx<CheckedAccess>(m_size, args...)];
+        }
+
+        // element access that never checks the indices, whatever PJPLOT_CHECKED_ACCESS selects
+        template <typename... Args>
+        [[nodiscard]] constexpr auto get_unchecked(Args... args) noexcept -> T& {
+            static_assert(sizeof...(args) == Size::dims, "Incorrect number of arguments");
+            return m_data[calculate_linear_idx<UncheckedAccess>(m_size, args...)];
+        }
+
+        template <typename... Args>
+        [[nodiscard]] constexpr auto get_unchecked(Args... args) const noexcept -> const T& {
+            static_assert(sizeof...(args) == Size::dims, "Incorrect number of arguments");
+            return m_data[calculate_linear_idx<UncheckedAccess>(m_size, args...)];
+        }
+
+        [[nodiscard]] constexpr auto operator[](size_t idx) -> decltype(auto) {
+            if constexpr (Size::dims > 1) {
+                auto slice_size = m_size.slice();
+                // return a contiguous view to the slice at the next lowest dimension
+                return ArrayNd<T, typename Size::SliceType, false>(slice_size, m_data.data() + idx * slice_size.nele());
+            } else {
+                // return reference to single value at the given index
+                T& ref = m_data[idx];
+                return ref;
+            }
+        }
+
+        [[nodiscard]] constexpr auto operator[](size_t idx) const -> decltype(auto) {
+            if constexpr (Size::dims > 1) {
+                auto slice_size = m_size.slice();
+                // return a contiguous view to the slice at the next lowest dimension
+                return ArrayNd<const T, typename Size::SliceType, false>(slice_size, m_data.data() + idx * slice_size.nele());
+            } else {
+                // return reference to single value at the given index
+                const T& ref = m_data[idx];
+                return ref;
+            }
+        }
+
+    protected:
+        Size m_size;
+        StorageType<T, Size, IsOwning, Allocator> m_data;
+    };
+
+    template <typename T, Size1 Size>
+    using Array1d = ArrayNd<T, Size>;
+
+    template <typename T, Size2 Size, typename Allocator = std::allocator<T>>
+    class Mat2 : public ArrayNd<T, Size, true, Allocator> {
+    public:
+        using ArrayNd<T, Size, true, Allocator>::operator=;
+
+        constexpr Mat2() noexcept = default;
+
+        constexpr Mat2(Size size) noexcept(Size::is_static_size::value) 
+        : ArrayNd<T, Size, true, Allocator>(size) {}
+
+        constexpr Mat2(Size size, UninitializedTag tag) noexcept(Size::is_static_size::value) 
+        : ArrayNd<T, Size, true, Allocator>(size, tag) {}
+
+        // Getter for the number of columns
         [[nodiscard]] constexpr auto cols() const noexcept -> size_t {
-            return ArrayNd<T, Size>::cols();
+            return this->m_size.cols();
         }
 
         // Getter for the number of rows
         [[nodiscard]] constexpr auto rows() const noexcept -> size_t {
-            return ArrayNd<T, Size>::rows();
+            return this->m_size.rows();
+        }
+    };
+
+    template <typename T, Size2 Size>
+    using Mat2View = ArrayNd<T, Size, false>;
+
+    template <typename T, Size3 Size, typename Allocator = std::allocator<T>>
+    class Mat3 : public ArrayNd<T, Size, true, Allocator> {
+    public:
+        using ArrayNd<T, Size, true, Allocator>::operator=;
+
+        constexpr Mat3() noexcept = default;
+
+        constexpr Mat3(Size size) noexcept(Size::is_static_size::value) 
+        : ArrayNd<T, Size, true, Allocator>(size) {}
+
+        constexpr Mat3(Size size, UninitializedTag tag) noexcept(Size::is_static_size::value) 
+        : ArrayNd<T, Size, true, Allocator>(size, tag) {}
+
+        // Getter for the number of slices
+        [[nodiscard]] constexpr auto slices() const noexcept -> size_t {
+            return this->m_size.slices();
+        }
+
+        // Getter for the number of columns
+        [[nodiscard]] constexpr auto cols() const noexcept -> size_t {
+            return this->m_size.cols();
+        }
+
+        // Getter for the number of rows
+        [[nodiscard]] constexpr auto rows() const noexcept -> size_t {
+            return this->m_size.rows();
+        }
+    };
+
+    // Allocator of images unless another is given, so the k_uninitialized constructors of render targets really
+    // leave the pixels uninitialized; constructing from a size alone still value-initializes them
+    template <typename T>
+    using DefaultImageAllocator = DefaultInitAllocator<std::allocator<T>>;
+
+    // Alias for an image type (e.g., RGBA matrix)
+    template <Size2 Size, typename Allocator = DefaultImageAllocator<RGBA>>
+    using Img2 = Mat2<RGBA, Size, Allocator>;
+
+    template <Size2 Size, typename Allocator = std::allocator<float>>
+    using Img2F = Mat2<float, Size, Allocator>;
+
+    // render target images whose buffers are recycled through the calling thread's FramePool. The pixels are
+    // left uninitialized when constructed with k_uninitialized, the renderers draw every pixel.
+    template <Size2 Size>
+    using PooledImg2 = Img2<Size, DefaultInitAllocator<FramePoolAllocator<RGBA>>>;
+
+    // Bump allocator for the transient buffers of a frame: decimated columns, span and extent tables, per-thread
+    // layers and tile scratch. Allocations are 64 byte aligned and taken lock-free from one block; a frame that
+    // outgrows it spills into extra blocks under a lock, and the next reset folds them into a single block of the
+    // high-water size, so over a steady stream of frames the arena settles on one block and makes no heap calls.
+    // The arena of a Factory is reset when its last frame in flight ends, see ArenaScope; resetting is O(1) once it
+    // has settled.
+    // Memory is never handed back before reset(), so element types must be trivially destructible.
+    class FrameArena {
+    public:
+        static constexpr size_t k_alignment = 64;
+        static constexpr size_t k_min_block_bytes = size_t{64} << 10;
+
+        // the arena the calling thread's renders draw their scratch from, m_arena is nullptr when none is bound
+        struct ActiveFrame {
+            FrameArena* m_arena = nullptr;
+        };
+
+        constexpr FrameArena() noexcept {
+            if (!std::is_constant_evaluated()) {
+                m_generation = get_next_generation();
+            }
+        }
+
+        // copies start empty, the memory belongs to one arena
+        constexpr FrameArena(const FrameArena&) noexcept
+        : FrameArena() {}
+
+        constexpr auto operator=(const FrameArena&) noexcept -> FrameArena& {
+            return *this;
+        }
+
+        constexpr ~FrameArena() {
+            if (!std::is_constant_evaluated()) {
+                free_blocks();
+            }
+        }
+
+        [[nodiscard]] static auto get_active() noexcept -> ActiveFrame& {
+            thread_local ActiveFrame active;
+            return active;
+        }
+
+        // size rounded up to the alignment, thread safe while frames are in flight
+        [[nodiscard]] auto allocate_bytes(size_t num_bytes) -> void* {
+            if (num_bytes > std::numeric_limits<size_t>::max() - k_alignment) {
+                throw std::bad_array_new_length();
+            }
+            const size_t size = (num_bytes + k_alignment - 1) & ~(k_alignment - 1);
+            const size_t offset = m_offset.fetch_add(size, std::memory_order_relaxed);
+            if (offset <= m_capacity && size <= m_capacity - offset) {
+                return m_block + offset;
+            }
+            return allocate_spill(size);
+        }
+
+        // n default-initialized elements, valid until the arena is reset
+        template <typename T>
+        [[nodiscard]] auto allocate(size_t n) -> std::span<T> {
+            static_assert(std::is_trivially_destructible_v<T> && alignof(T) <= k_alignment, "Error: arena elements must be trivially destructible and at most 64 byte aligned");
+            if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+                throw std::bad_array_new_length();
+            }
+            T* data = static_cast<T*>(allocate_bytes(n * sizeof(T)));
+            std::uninitialized_default_construct_n(data, n);
+            return std::span<T>(data, n);
+        }
+
+        // a non-owning array of size in arena memory, e.g. a Mat2View of per-pixel counts
+        template <typename T, SizeN Size>
+        [[nodiscard]] auto allocate_view(Size size) -> ArrayNd<T, Size, false> {
+            return ArrayNd<T, Size, false>(size, allocate<T>(size.nele()).data());
+        }
+
+        // Start with room for num_bytes, so even the first frames take their scratch without heap calls; no frame may be in flight
+        void reserve(size_t num_bytes) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            check_idle();
+            if (num_bytes > m_capacity) {
+                const size_t used = get_used_locked();
+                free_blocks();
+                m_block = allocate_block(std::max(num_bytes, used));
+                m_capacity = std::max(num_bytes, used);
+                m_generation = get_next_generation();
+            }
+        }
+
+        // Forget every allocation, folding spilled blocks into one of the size used; no frame may be in flight
+        void reset() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            check_idle();
+            reset_locked();
+        }
+
+        // give every block back to the heap; no frame may be in flight
+        void release() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            check_idle();
+            free_blocks();
+            m_generation = get_next_generation();
+        }
+
+        // Frames in flight share the arena, it is reset when the last of them ends. Use ArenaScope rather than these.
+        void begin_frame() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_num_frames;
+        }
+
+        void end_frame() noexcept {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_num_frames == 0) {
+                reset_locked();
+            }
+        }
+
+        // changes whenever the arena is reset, so buffers handed out earlier can be recognised as stale
+        [[nodiscard]] auto get_generation() const noexcept -> uint64_t {
+            return m_generation;
+        }
+
+        // bytes held from the heap, and bytes handed out since the last reset
+        [[nodiscard]] auto get_capacity() const -> size_t {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_capacity + m_spill_capacity;
+        }
+
+        [[nodiscard]] auto get_used() const -> size_t {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return get_used_locked();
+        }
+
+        // blocks held from the heap, 1 once the arena has settled
+        [[nodiscard]] auto get_num_blocks() const -> size_t {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            size_t num_blocks = m_block != nullptr ? 1 : 0;
+            for (const SpillBlock* block = m_spill; block != nullptr; block = block->m_next) {
+                ++num_blocks;
+            }
+            return num_blocks;
+        }
+
+    private:
+        // header at the start of a spilled block, the allocations follow it
+        struct SpillBlock {
+            SpillBlock* m_next = nullptr;
+            size_t m_capacity = 0;
+            size_t m_used = 0;
+        };
+
+        static constexpr size_t k_header_bytes = (sizeof(SpillBlock) + k_alignment - 1) & ~(k_alignment - 1);
+
+        [[nodiscard]] static auto get_next_generation() noexcept -> uint64_t {
+            static std::atomic<uint64_t> next_generation{1};
+            return next_generation.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] static auto allocate_block(size_t num_bytes) -> std::byte* {
+            PJPLOT_PROFILE_ALLOCATION(num_bytes);
+            return static_cast<std::byte*>(::operator new(num_bytes, std::align_val_t(k_alignment)));
+        }
+
+        void check_idle() const {
+            if (m_num_frames != 0) {
+                throw std::invalid_argument("Error: the frame arena is in use by a frame");
+            }
+        }
+
+        [[nodiscard]] auto allocate_spill(size_t size) -> void* {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_spill == nullptr || size > m_spill->m_capacity - m_spill->m_used) {
+                // each spilled block at least doubles the arena, so a frame of any size needs few of them
+                const size_t capacity = std::max({size, m_capacity + m_spill_capacity, k_min_block_bytes});
+                auto* block = reinterpret_cast<SpillBlock*>(allocate_block(k_header_bytes + capacity));
+                *block = SpillBlock{m_spill, capacity, 0};
+                m_spill = block;
+                m_spill_capacity += capacity;
+            }
+            std::byte* data = reinterpret_cast<std::byte*>(m_spill) + k_header_bytes + m_spill->m_used;
+            m_spill->m_used += size;
+            m_spill_used += size;
+            return data;
+        }
+
+        [[nodiscard]] auto get_used_locked() const noexcept -> size_t {
+            return std::min(m_offset.load(std::memory_order_relaxed), m_capacity) + m_spill_used;
+        }
+
+        void reset_locked() noexcept {
+            if (m_spill != nullptr) {
+                // folding is best effort, the arena keeps spilling when the heap refuses the larger block
+                const size_t used = get_used_locked();
+                std::byte* block = nullptr;
+                try {
+                    block = allocate_block(used);
+                } catch (const std::bad_alloc&) {
+                }
+                if (block != nullptr) {
+                    free_blocks();
+                    m_block = block;
+                    m_capacity = used;
+                } else {
+                    free_spill();
+                }
+            }
+            m_offset.store(0, std::memory_order_relaxed);
+            m_generation = get_next_generation();
+        }
+
+        void free_spill() noexcept {
+            while (m_spill != nullptr) {
+                SpillBlock* next = m_spill->m_next;
+                ::operator delete(m_spill, std::align_val_t(k_alignment));
+                m_spill = next;
+            }
+            m_spill_capacity = 0;
+            m_spill_used = 0;
+        }
+
+        void free_blocks() noexcept {
+            free_spill();
+            if (m_block != nullptr) {
+                ::operator delete(m_block, std::align_val_t(k_alignment));
+            }
+            m_block = nullptr;
+            m_capacity = 0;
+            m_offset.store(0, std::memory_order_relaxed);
+        }
+
+        std::byte* m_block = nullptr;
+        size_t m_capacity = 0;
+        std::atomic<size_t> m_offset{0};
+        SpillBlock* m_spill = nullptr;  ///< most recent first, only touched under the lock
+        size_t m_spill_capacity = 0;
+        size_t m_spill_used = 0;
+        size_t m_num_frames = 0;
+        uint64_t m_generation = 0;
+        mutable std::mutex m_mutex;
+    };
+
+    // Binds an arena to the calling thread for the duration of a frame, so the renders it runs draw their scratch
+    // from the arena instead of the thread's own buffers. The arena is reset when the last frame using it ends.
+    class ArenaScope {
+    public:
+        constexpr explicit ArenaScope(FrameArena* arena) {
+            if (!std::is_constant_evaluated() && arena != nullptr) {
+                arena->begin_frame();
+                m_previous = FrameArena::get_active();
+                m_frame = arena;
+                FrameArena::get_active() = FrameArena::ActiveFrame{arena};
+            }
+        }
+
+        // continue a frame begun on another thread, e.g. in a thread pool task
+        explicit ArenaScope(FrameArena::ActiveFrame frame) noexcept
+        : m_previous(FrameArena::get_active()), m_is_installed(true) {
+            FrameArena::get_active() = frame;
+        }
+
+        ArenaScope(const ArenaScope&) = delete;
+        auto operator=(const ArenaScope&) -> ArenaScope& = delete;
+
+        constexpr ~ArenaScope() {
+            if (!std::is_constant_evaluated() && (m_frame != nullptr || m_is_installed)) {
+                FrameArena::get_active() = m_previous;
+                if (m_frame != nullptr) {
+                    m_frame->end_frame();
+                }
+            }
+        }
+
+    private:
+        FrameArena::ActiveFrame m_previous{};
+        FrameArena* m_frame = nullptr;  ///< arena whose frame this scope began
+        bool m_is_installed = false;
+    };
+
+    enum class Colour {
+        WHITE, BLACK, COUNT
+    };
+
+
+    template <typename T, Size3 Size>
+    using Mat3View = ArrayNd<T, Size, false>;
+
+    // extents of a 1-D, 2-D or 3-D size type, outermost dimension first
+    template <SizeN Size>
+        requires (Size::dims <= 3)
+    [[nodiscard]] constexpr auto get_extents(const Size& size) noexcept -> std::array<size_t, Size::dims> {
+        if constexpr (Size::dims == 1) {
+            return {size.length()};
+        } else if constexpr (Size::dims == 2) {
+            return {size.rows(), size.cols()};
+        } else {
+            return {size.slices(), size.rows(), size.cols()};
+        }
+    }
+
+    // size type with the two dimensions of a 2-D size swapped
+    template <Size2 Size>
+    struct TransposedSize;
+
+    template <size_t Rows, size_t Cols>
+    struct TransposedSize<StaticSize2<Rows, Cols>> {
+        using type = StaticSize2<Cols, Rows>;
+        [[nodiscard]] constexpr static auto create(StaticSize2<Rows, Cols>) noexcept -> type {
+            return type{};
+        }
+    };
+
+    template <>
+    struct TransposedSize<DynamicSize2> {
+        using type = DynamicSize2;
+        [[nodiscard]] constexpr static auto create(DynamicSize2 size) noexcept -> type {
+            return DynamicSize2(size.cols(), size.rows());
+        }
+    };
+
+    // Non-owning view with an element stride per dimension, for column-major, interleaved or transposed data that is
+    // read in place rather than copied into a dense ArrayNd first. Like std::span, constness lives in T.
+    template <typename T, SizeN Size>
+        requires (Size::dims <= 3)
+    class StridedView {
+    public:
+        using Strides = std::array<size_t, Size::dims>;
+
+        constexpr StridedView(Size size, T* data, Strides strides) noexcept
+        : m_size(size), m_data(data), m_strides(strides) {
+
+        }
+
+        // the usual dense row-major layout, as used by ArrayNd
+        [[nodiscard]] constexpr static auto dense(Size size, T* data) noexcept -> StridedView {
+            const auto extents = get_extents(size);
+            Strides strides{};
+            size_t stride = 1;
+            for (size_t dim = Size::dims; dim-- > 0;) {
+                strides[dim] = stride;
+                stride *= extents[dim];
+            }
+            return StridedView(size, data, strides);
+        }
+
+        template <typename U, bool IsOwning, typename Allocator>
+            requires std::is_convertible_v<const U*, T*>
+        [[nodiscard]] constexpr static auto dense(const ArrayNd<U, Size, IsOwning, Allocator>& arr) noexcept -> StridedView {
+            return dense(arr.shape(), arr.data().data());
+        }
+
+        [[nodiscard]] constexpr auto shape() const noexcept -> Size {
+            return m_size;
+        }
+
+        [[nodiscard]] constexpr auto nele() const noexcept -> size_t {
+            return m_size.nele();
+        }
+
+        // stride in elements between neighbours along each dimension
+        [[nodiscard]] constexpr auto get_strides() const noexcept -> const Strides& {
+            return m_strides;
+        }
+
+        // pointer to the first element
+        [[nodiscard]] constexpr auto data() const noexcept -> T* {
+            return m_data;
+        }
+
+        // true when the view has the dense row-major layout, i.e. could be a span over nele() elements
+        [[nodiscard]] constexpr auto is_contiguous() const noexcept -> bool {
+            return m_strides == dense(m_size, m_data).m_strides;
+        }
+
+        // number of elements of a 1-D view, so it can stand in for a std::span of samples
+        [[nodiscard]] constexpr auto size() const noexcept -> size_t
+        requires (Size::dims == 1) {
+            return m_size.length();
+        }
+
+        template <typename... Args>
+        [[nodiscard]] constexpr auto operator()(Args... args) const noexcept -> T& {
+            static_assert(sizeof...(args) == Size::dims, "Incorrect number of arguments");
+            const std::array<size_t, Size::dims> idx = {static_cast<size_t>(args)...};
+            size_t offset = 0;
+            for (size_t dim = 0; dim < Size::dims; ++dim) {
+                offset += idx[dim] * m_strides[dim];
+            }
+            return m_data[offset];
+        }
+
+        [[nodiscard]] constexpr auto operator[](size_t idx) const noexcept -> decltype(auto) {
+            if constexpr (Size::dims > 1) {
+                // view of the slice at the next lowest dimension, keeping its strides
+                std::array<size_t, Size::dims - 1> strides{};
+                std::copy(m_strides.begin() + 1, m_strides.end(), strides.begin());
+                return StridedView<T, typename Size::SliceType>(m_size.slice(), m_data + idx * m_strides[0], strides);
+            } else {
+                T& ref = m_data[idx * m_strides[0]];
+                return ref;
+            }
+        }
+
+        // the same elements with rows and columns swapped, no data is moved
+        [[nodiscard]] constexpr auto transposed() const noexcept
+        requires (Size::dims == 2) {
+            return StridedView<T, typename TransposedSize<Size>::type>(TransposedSize<Size>::create(m_size), m_data, {m_strides[1], m_strides[0]});
+        }
+
+        // 1-D view down column col of a 2-D view
+        [[nodiscard]] constexpr auto column(size_t col) const noexcept -> StridedView<T, DynamicSize1>
+        requires (Size::dims == 2) {
+            return StridedView<T, DynamicSize1>(DynamicSize1(m_size.rows()), m_data + col * m_strides[1], {m_strides[0]});
+        }
+
+    private:
+        Size m_size;
+        T* m_data = nullptr;
+        Strides m_strides{};
+    };
+
+    // (num_series x series_length) view over samples stored sample-major, i.e. all series' first samples, then all
+    // their second samples and so on, as delivered by interleaved acquisition hardware and audio APIs
+    template <typename T>
+    [[nodiscard]] constexpr auto make_interleaved_view(T* data, size_t num_series, size_t series_length) noexcept -> StridedView<T, DynamicSize2> {
+        return StridedView<T, DynamicSize2>(DynamicSize2(num_series, series_length), data, {1, num_series});
+    }
+
+    // elements an engine evaluates at a time where it needs an expression as contiguous samples, e.g. for the
+    // vectorized bar summaries, small enough for the stack and the L1 cache
+    inline constexpr size_t k_expression_block = 256;
+
+    // leaf of an expression, the elements of a dense array or span read in place. Like a view it must not outlive them.
+    template <typename T, SizeN Size>
+    class ArrayOperand {
+    public:
+        using is_array_expression = std::true_type;
+        using value_type = std::remove_const_t<T>;
+
+        constexpr ArrayOperand(Size size, const value_type* data) noexcept
+        : m_size(size), m_data(data) {
+
+        }
+
+        [[nodiscard]] constexpr auto shape() const noexcept -> Size {
+            return m_size;
+        }
+
+        [[nodiscard]] constexpr auto nele() const noexcept -> size_t {
+            return m_size.nele();
+        }
+
+        [[nodiscard]] constexpr auto size() const noexcept -> size_t {
+            return m_size.nele();
+        }
+
+        [[nodiscard]] constexpr auto operator[](size_t idx) const noexcept -> value_type {
+            return m_data[idx];
+        }
+
+    private:
+        Size m_size;
+        const value_type* m_data = nullptr;
+    };
+
+    // dense arrays of arithmetic samples, which take part in expressions as an ArrayOperand
+    template <typename T>
+    concept ArithmeticArray = requires (const T& arr) {
+        typename T::is_array_type;
+        { arr.shape() } -> SizeN;
+        { arr.data().data() };
+    } && std::is_arithmetic_v<std::remove_cvref_t<decltype(*std::declval<const T&>().data().data())>>;
+
+    template <typename T>
+    concept ExpressionOperand = ArrayExpression<T> || ArithmeticArray<T>;
+
+    template <typename T>
+    concept ScalarOperand = std::is_arithmetic_v<T>;
+
+    // the operands of a binary expression, at least one of them an array or expression
+    template <typename Lhs, typename Rhs>
+    concept ExpressionOperands = (ExpressionOperand<Lhs> && (ExpressionOperand<Rhs> || ScalarOperand<Rhs>)) || (ScalarOperand<Lhs> && ExpressionOperand<Rhs>);
+
+    // view a span of samples as a 1-D expression
+    template <typename T>
+        requires std::is_arithmetic_v<T>
+    [[nodiscard]] constexpr auto as_expression(std::span<const T> samples) noexcept -> ArrayOperand<T, DynamicSize1> {
+        return ArrayOperand<T, DynamicSize1>(DynamicSize1(samples.size()), samples.data());
+    }
+
+    template <ArithmeticArray T>
+    [[nodiscard]] constexpr auto as_expression(const T& arr) noexcept {
+        using ValueType = std::remove_cvref_t<decltype(*arr.data().data())>;
+        return ArrayOperand<ValueType, decltype(arr.shape())>(arr.shape(), arr.data().data());
+    }
+
+    // the form an operand is stored in by an expression node: arrays become leaves, expressions and scalars are copied
+    template <typename T>
+    [[nodiscard]] constexpr auto to_operand(const T& operand) noexcept {
+        if constexpr (ArithmeticArray<T>) {
+            return as_expression(operand);
+        } else {
+            return operand;
+        }
+    }
+
+    template <typename T>
+    using operand_t = decltype(to_operand(std::declval<const T&>()));
+
+    template <typename T>
+    [[nodiscard]] constexpr auto get_operand_element(const T& operand, size_t idx) noexcept {
+        if constexpr (ScalarOperand<T>) {
+            return operand;
+        } else {
+            return operand[idx];
+        }
+    }
+
+    template <typename T>
+    using operand_value_t = decltype(get_operand_element(std::declval<const T&>(), size_t{}));
+
+    // the element-wise operations of expressions
+    struct AddOp {
+        template <typename A, typename B>
+        [[nodiscard]] constexpr static auto apply(A lhs, B rhs) noexcept {
+            return lhs + rhs;
+        }
+    };
+
+    struct SubtractOp {
+        template <typename A, typename B>
+        [[nodiscard]] constexpr static auto apply(A lhs, B rhs) noexcept {
+            return lhs - rhs;
+        }
+    };
+
+    struct MultiplyOp {
+        template <typename A, typename B>
+        [[nodiscard]] constexpr static auto apply(A lhs, B rhs) noexcept {
+            return lhs * rhs;
+        }
+    };
+
+    struct DivideOp {
+        template <typename A, typename B>
+        [[nodiscard]] constexpr static auto apply(A lhs, B rhs) noexcept {
+            return lhs / rhs;
+        }
+    };
+
+    struct NegateOp {
+        template <typename A>
+        [[nodiscard]] constexpr static auto apply(A val) noexcept {
+            return -val;
+        }
+    };
+
+    struct AbsOp {
+        template <typename A>
+        [[nodiscard]] constexpr static auto apply(A val) noexcept {
+            return val < A{} ? static_cast<A>(-val) : val;
+        }
+    };
+
+    struct SqrtOp {
+        template <typename A>
+        [[nodiscard]] static auto apply(A val) noexcept {
+            return std::sqrt(val);
+        }
+    };
+
+    struct ExpOp {
+        template <typename A>
+        [[nodiscard]] static auto apply(A val) noexcept {
+            return std::exp(val);
+        }
+    };
+
+    struct LogOp {
+        template <typename A>
+        [[nodiscard]] static auto apply(A val) noexcept {
+            return std::log(val);
+        }
+    };
+
+    struct Log10Op {
+        template <typename A>
+        [[nodiscard]] static auto apply(A val) noexcept {
+            return std::log10(val);
+        }
+    };
+
+    struct SinOp {
+        template <typename A>
+        [[nodiscard]] static auto apply(A val) noexcept {
+            return std::sin(val);
+        }
+    };
+
+    struct CosOp {
+        template <typename A>
+        [[nodiscard]] static auto apply(A val) noexcept {
+            return std::cos(val);
+        }
+    };
+
+    // Op applied to two operands, either of which may be a scalar. Array operands must have the same number of
+    // elements, the shape is taken from the left one.
+    template <typename Op, typename Lhs, typename Rhs>
+    class BinaryExpression {
+    public:
+        using is_array_expression = std::true_type;
+        using value_type = decltype(Op::apply(std::declval<operand_value_t<Lhs>>(), std::declval<operand_value_t<Rhs>>()));
+
+        constexpr BinaryExpression(Lhs lhs, Rhs rhs)
+        : m_lhs(lhs), m_rhs(rhs) {
+            if constexpr (ArrayExpression<Lhs> && ArrayExpression<Rhs>) {
+                if (m_lhs.nele() != m_rhs.nele()) {
+                    throw std::invalid_argument("Error: expression operands have different numbers of elements");
+                }
+            }
+        }
+
+        [[nodiscard]] constexpr auto shape() const noexcept {
+            if constexpr (ArrayExpression<Lhs>) {
+                return m_lhs.shape();
+            } else {
+                return m_rhs.shape();
+            }
+        }
+
+        [[nodiscard]] constexpr auto nele() const noexcept -> size_t {
+            if constexpr (ArrayExpression<Lhs>) {
+                return m_lhs.nele();
+            } else {
+                return m_rhs.nele();
+            }
+        }
+
+        [[nodiscard]] constexpr auto size() const noexcept -> size_t {
+            return nele();
+        }
+
+        [[nodiscard]] constexpr auto operator[](size_t idx) const noexcept -> value_type {
+            return Op::apply(get_operand_element(m_lhs, idx), get_operand_element(m_rhs, idx));
+        }
+
+    private:
+        Lhs m_lhs;
+        Rhs m_rhs;
+    };
+
+    // Op applied to every element of an operand
+    template <typename Op, typename Operand>
+    class UnaryExpression {
+    public:
+        using is_array_expression = std::true_type;
+        using value_type = decltype(Op::apply(std::declval<operand_value_t<Operand>>()));
+
+        constexpr explicit UnaryExpression(Operand operand) noexcept
+        : m_operand(operand) {
+
+        }
+
+        [[nodiscard]] constexpr auto shape() const noexcept {
+            return m_operand.shape();
+        }
+
+        [[nodiscard]] constexpr auto nele() const noexcept -> size_t {
+            return m_operand.nele();
+        }
+
+        [[nodiscard]] constexpr auto size() const noexcept -> size_t {
+            return nele();
+        }
+
+        [[nodiscard]] constexpr auto operator[](size_t idx) const noexcept -> value_type {
+            return Op::apply(m_operand[idx]);
+        }
+
+    private:
+        Operand m_operand;
+    };
+
+    // Elements [offset, offset + length) of an expression as a 1-D expression, e.g. one series of a flat sample
+    // layout, which the chart engines read like a span. It refers to the expression, which must outlive it.
+    template <ArrayExpression Expr>
+    class ExpressionSlice {
+    public:
+        using is_array_expression = std::true_type;
+        using value_type = typename Expr::value_type;
+
+        constexpr ExpressionSlice(const Expr& expr, size_t offset, size_t length) noexcept
+        : m_expr(&expr), m_offset(offset), m_length(length) {
+
+        }
+
+        [[nodiscard]] constexpr auto shape() const noexcept -> DynamicSize1 {
+            return DynamicSize1(m_length);
+        }
+
+        [[nodiscard]] constexpr auto nele() const noexcept -> size_t {
+            return m_length;
+        }
+
+        [[nodiscard]] constexpr auto size() const noexcept -> size_t {
+            return m_length;
+        }
+
+        [[nodiscard]] constexpr auto operator[](size_t idx) const noexcept -> value_type {
+            return (*m_expr)[m_offset + idx];
+        }
+
+    private:
+        const Expr* m_expr = nullptr;
+        size_t m_offset = 0;
+        size_t m_length = 0;
+    };
+
+    template <typename Op, typename Lhs, typename Rhs>
+    [[nodiscard]] constexpr auto make_binary_expression(const Lhs& lhs, const Rhs& rhs) {
+        return BinaryExpression<Op, operand_t<Lhs>, operand_t<Rhs>>(to_operand(lhs), to_operand(rhs));
+    }
+
+    template <typename Op, typename Operand>
+    [[nodiscard]] constexpr auto make_unary_expression(const Operand& operand) noexcept {
+        return UnaryExpression<Op, operand_t<Operand>>(to_operand(operand));
+    }
+
+    template <typename Lhs, typename Rhs>
+        requires ExpressionOperands<Lhs, Rhs>
+    [[nodiscard]] constexpr auto operator+(const Lhs& lhs, const Rhs& rhs) {
+        return make_binary_expression<AddOp>(lhs, rhs);
+    }
+
+    template <typename Lhs, typename Rhs>
+        requires ExpressionOperands<Lhs, Rhs>
+    [[nodiscard]] constexpr auto operator-(const Lhs& lhs, const Rhs& rhs) {
+        return make_binary_expression<SubtractOp>(lhs, rhs);
+    }
+
+    template <typename Lhs, typename Rhs>
+        requires ExpressionOperands<Lhs, Rhs>
+    [[nodiscard]] constexpr auto operator*(const Lhs& lhs, const Rhs& rhs) {
+        return make_binary_expression<MultiplyOp>(lhs, rhs);
+    }
+
+    template <typename Lhs, typename Rhs>
+        requires ExpressionOperands<Lhs, Rhs>
+    [[nodiscard]] constexpr auto operator/(const Lhs& lhs, const Rhs& rhs) {
+        return make_binary_expression<DivideOp>(lhs, rhs);
+    }
+
+    template <ExpressionOperand Operand>
+    [[nodiscard]] constexpr auto operator-(const Operand& operand) noexcept {
+        return make_unary_expression<NegateOp>(operand);
+    }
+
+    template <ExpressionOperand Operand>
+    [[nodiscard]] constexpr auto abs(const Operand& operand) noexcept {
+        return make_unary_expression<AbsOp>(operand);
+    }
+
+    template <ExpressionOperand Operand>
+    [[nodiscard]] constexpr auto sqrt(const Operand& operand) noexcept {
+        return make_unary_expression<SqrtOp>(operand);
+    }
+
+    template <ExpressionOperand Operand>
+    [[nodiscard]] constexpr auto exp(const Operand& operand) noexcept {
+        return make_unary_expression<ExpOp>(operand);
+    }
+
+    template <ExpressionOperand Operand>
+    [[nodiscard]] constexpr auto log(const Operand& operand) noexcept {
+        return make_unary_expression<LogOp>(operand);
+    }
+
+    template <ExpressionOperand Operand>
+    [[nodiscard]] constexpr auto log10(const Operand& operand) noexcept {
+        return make_unary_expression<Log10Op>(operand);
+    }
+
+    template <ExpressionOperand Operand>
+    [[nodiscard]] constexpr auto sin(const Operand& operand) noexcept {
+        return make_unary_expression<SinOp>(operand);
+    }
+
+    template <ExpressionOperand Operand>
+    [[nodiscard]] constexpr auto cos(const Operand& operand) noexcept {
+        return make_unary_expression<CosOp>(operand);
+    }
+
+    // materialise an expression into a dense array of its shape and element type
+    template <ArrayExpression Expr>
+    [[nodiscard]] constexpr auto evaluate(const Expr& expr) {
+        using Size = std::remove_cvref_t<decltype(expr.shape())>;
+        ArrayNd<typename Expr::value_type, Size> res(expr.shape(), k_uninitialized);
+        res.assign(expr);
+        return res;
+    }
+
+#ifdef PJPLOT_ENABLE_TESTS
+    // little compile-time test to ensure expressions are evaluated element-wise with scalars broadcast
+    consteval static auto test_array_expression() -> bool {
+        ArrayNd<int, StaticSize2<2, 3>> a;
+        ArrayNd<double, StaticSize2<2, 3>> b;
+        for (size_t i = 0; i < a.nele(); ++i) {
+            a.data()[i] = static_cast<int>(i);
+            b.data()[i] = 0.5 * static_cast<double>(i);
+        }
+        const auto expr = -(a - 1) * b / 2.0 + abs(a - 3);
+        const auto res = evaluate(expr);
+        for (size_t i = 0; i < res.nele(); ++i) {
+            const auto val = static_cast<double>(i);
+            if (res.data()[i] != -(val - 1.0) * 0.5 * val / 2.0 + (val < 3.0 ? 3.0 - val : val - 3.0)) {
+                return false;
+            }
+        }
+        a = a * 2 + 1; // reads the array it is assigned to
+        return a(1, 2) == 11 && ExpressionSlice(expr, 3, 2)[1] == expr[4];
+    }
+    static_assert(test_array_expression(), "Error: array expression evaluated incorrectly");
+#endif
+
+    enum class AccessHint {
+        NORMAL, SEQUENTIAL, RANDOM, WILL_NEED, COUNT
+    };
+
+    [[nodiscard]] inline auto to_string(AccessHint val) -> std::string_view {
+        switch (val) {
+            case AccessHint::NORMAL:
+                return "normal";
+            case AccessHint::SEQUENTIAL:
+                return "sequential";
+            case AccessHint::RANDOM:
+                return "random";
+            case AccessHint::WILL_NEED:
+                return "will need";
+            default:
+                throw std::invalid_argument("Error: unsupported access hint");
+        }
+    }
+
+    // A read-only memory mapping of a whole file. Views created from it read samples straight from the page cache
+    // and must not outlive the mapping. Move only, the file is unmapped on destruction.
+    class MappedFile {
+    public:
+        MappedFile() noexcept = default;
+
+        MappedFile(const MappedFile&) = delete;
+        auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+        MappedFile(MappedFile&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0))
+#if defined(PJPLOT_MMAP_WIN32)
+        , m_file(std::exchange(other.m_file, INVALID_HANDLE_VALUE)), m_mapping(std::exchange(other.m_mapping, nullptr))
+#endif
+        {
+
+        }
+
+        auto operator=(MappedFile&& other) noexcept -> MappedFile& {
+            if (this != &other) {
+                close();
+                m_data = std::exchange(other.m_data, nullptr);
+                m_size = std::exchange(other.m_size, 0);
+#if defined(PJPLOT_MMAP_WIN32)
+                m_file = std::exchange(other.m_file, INVALID_HANDLE_VALUE);
+                m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+            }
+            return *this;
+        }
+
+        ~MappedFile() {
+            close();
+        }
+
+        // map the file at path, hint describes how it will be read first, e.g. by a decimation pass
+        [[nodiscard]] static auto open(const std::string& path, AccessHint hint = AccessHint::SEQUENTIAL) -> ResultWithValue<MappedFile> {
+            MappedFile file;
+#if defined(PJPLOT_MMAP_POSIX)
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return ResultWithValue<MappedFile>::Failure("Error: could not open " + path);
+            }
+            struct stat info{};
+            if (::fstat(fd, &info) != 0) {
+                ::close(fd);
+                return ResultWithValue<MappedFile>::Failure("Error: could not read the size of " + path);
+            }
+            file.m_size = static_cast<size_t>(info.st_size);
+            if (file.m_size > 0) {
+                void* data = ::mmap(nullptr, file.m_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (data == MAP_FAILED) {
+                    ::close(fd);
+                    return ResultWithValue<MappedFile>::Failure("Error: could not map " + path);
+                }
+                file.m_data = static_cast<const std::byte*>(data);
+            }
+            // the mapping keeps its own reference to the file
+            ::close(fd);
+#elif defined(PJPLOT_MMAP_WIN32)
+            const DWORD flags = hint == AccessHint::SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : hint == AccessHint::RANDOM ? FILE_FLAG_RANDOM_ACCESS : FILE_ATTRIBUTE_NORMAL;
+            file.m_file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+            if (file.m_file == INVALID_HANDLE_VALUE) {
+                return ResultWithValue<MappedFile>::Failure("Error: could not open " + path);
+            }
+            LARGE_INTEGER size{};
+            if (::GetFileSizeEx(file.m_file, &size) == 0) {
+                return ResultWithValue<MappedFile>::Failure("Error: could not read the size of " + path);
+            }
+            file.m_size = static_cast<size_t>(size.QuadPart);
+            if (file.m_size > 0) {
+                file.m_mapping = ::CreateFileMappingA(file.m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (file.m_mapping == nullptr) {
+                    return ResultWithValue<MappedFile>::Failure("Error: could not map " + path);
+                }
+                file.m_data = static_cast<const std::byte*>(::MapViewOfFile(file.m_mapping, FILE_MAP_READ, 0, 0, 0));
+                if (file.m_data == nullptr) {
+                    return ResultWithValue<MappedFile>::Failure("Error: could not map " + path);
+                }
+            }
+#else
+            return ResultWithValue<MappedFile>::Failure("Error: memory mapped files are not supported on this platform, could not map " + path);
+#endif
+            file.advise(hint);
+            return ResultWithValue<MappedFile>(std::move(file));
+        }
+
+        // Tell the OS how bytes [byte_offset, byte_offset + num_bytes) are about to be read, e.g. SEQUENTIAL ahead of
+        // a decimation pass so pages are read ahead and dropped early. Only a hint, failures are ignored.
+        void advise(AccessHint hint, size_t byte_offset = 0, size_t num_bytes = std::numeric_limits<size_t>::max()) const noexcept {
+            if (m_data == nullptr || byte_offset >= m_size) {
+                return;
+            }
+            num_bytes = std::min(num_bytes, m_size - byte_offset);
+#if defined(PJPLOT_MMAP_POSIX)
+            // madvise wants a page aligned start
+            const auto page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+            const size_t begin = byte_offset / page * page;
+            int advice = MADV_NORMAL;
+            switch (hint) {
+                case AccessHint::SEQUENTIAL:
+                    advice = MADV_SEQUENTIAL;
+                    break;
+                case AccessHint::RANDOM:
+                    advice = MADV_RANDOM;
+                    break;
+                case AccessHint::WILL_NEED:
+                    advice = MADV_WILLNEED;
+                    break;
+                default:
+                    break;
+            }
+            ::madvise(const_cast<std::byte*>(m_data) + begin, byte_offset + num_bytes - begin, advice);
+#elif defined(PJPLOT_MMAP_WIN32) && defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+            // the access pattern was given to CreateFile, prefetching is the only hint left to give
+            if (hint == AccessHint::SEQUENTIAL || hint == AccessHint::WILL_NEED) {
+                WIN32_MEMORY_RANGE_ENTRY range{const_cast<std::byte*>(m_data) + byte_offset, num_bytes};
+                ::PrefetchVirtualMemory(::GetCurrentProcess(), 1, &range, 0);
+            }
+#else
+            (void) hint;
+#endif
+        }
+
+        [[nodiscard]] auto get_bytes() const noexcept -> std::span<const std::byte> {
+            return std::span<const std::byte>(m_data, m_size);
+        }
+
+        [[nodiscard]] auto size_bytes() const noexcept -> size_t {
+            return m_size;
+        }
+
+        // the file from byte_offset on as samples of type T, trailing bytes that don't make up a whole sample are left out
+        template <typename T>
+        [[nodiscard]] auto as_span(size_t byte_offset = 0) const -> std::span<const T> {
+            static_assert(std::is_trivially_copyable_v<T>, "Error: mapped samples must be trivially copyable");
+            if (byte_offset > m_size) {
+                throw std::invalid_argument("Error: byte offset is past the end of the mapped file");
+            }
+            if (m_data == nullptr) {
+                return {};
+            }
+            if (reinterpret_cast<uintptr_t>(m_data + byte_offset) % alignof(T) != 0) {
+                throw std::invalid_argument("Error: byte offset is not aligned for the sample type");
+            }
+            return std::span<const T>(reinterpret_cast<const T*>(m_data + byte_offset), (m_size - byte_offset) / sizeof(T));
+        }
+
+        // a non-owning array of the given shape over the file from byte_offset on
+        template <typename T, SizeN Size>
+        [[nodiscard]] auto view(Size size, size_t byte_offset = 0) const -> ArrayNd<const T, Size, false> {
+            const auto samples = as_span<T>(byte_offset);
+            if (samples.size() < size.nele()) {
+                throw std::invalid_argument("Error: mapped file is smaller than the requested shape");
+            }
+            return ArrayNd<const T, Size, false>(size, samples.data());
+        }
+
+    private:
+        void close() noexcept {
+#if defined(PJPLOT_MMAP_POSIX)
+            if (m_data != nullptr) {
+                ::munmap(const_cast<std::byte*>(m_data), m_size);
+            }
+#elif defined(PJPLOT_MMAP_WIN32)
+            if (m_data != nullptr) {
+                ::UnmapViewOfFile(m_data);
+            }
+            if (m_mapping != nullptr) {
+                ::CloseHandle(m_mapping);
+            }
+            if (m_file != INVALID_HANDLE_VALUE) {
+                ::CloseHandle(m_file);
+            }
+            m_file = INVALID_HANDLE_VALUE;
+            m_mapping = nullptr;
+#endif
+            m_data = nullptr;
+            m_size = 0;
+        }
+
+        const std::byte* m_data = nullptr;
+        size_t m_size = 0;
+#if defined(PJPLOT_MMAP_WIN32)
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+#endif
+    };
+
+    template <Colour Val>
+        requires (Val < Colour::COUNT)
+    [[nodiscard]] constexpr static auto to_string() -> std::string_view {
+        if constexpr (Val == Colour::WHITE) {
+            return "white";
+        } else if constexpr (Val == Colour::BLACK) {
+            return "black";
+        } else {
+            static_assert(always_false<std::integral_constant<Colour, Val>>::value, "Error: unhandled type");
+        }
+    }
+
+#ifdef PJPLOT_ENABLE_TESTS
+    // little compile-time test to ensure all colour types are handled
+    template <size_t I = 0>
+    consteval static auto test_colour_to_string() -> bool{
+        if constexpr (I < static_cast<size_t>(Colour::COUNT)) {
+            constexpr auto s = to_string<static_cast<Colour>(I)>();
+            return test_colour_to_string<I+1>();
+        }
+        return true;
+    }
+    constexpr static bool to_colour_to_string_test = test_colour_to_string();
+#endif
+
+    // runtime version 
+    [[nodiscard]] inline auto to_string(Colour val) -> std::string_view {
+        switch (val) {
+            case Colour::WHITE:
+                return to_string<Colour::WHITE>();
+            case Colour::BLACK:
+                return to_string<Colour::BLACK>();
+            default:
+                // important for catching UB
+                throw std::invalid_argument("Error: unsupported colour type");
+        }
+    }
+
+    // convert a colour to the pixel value written into an Img2
+    [[nodiscard]] constexpr auto to_rgba(Colour val) -> RGBA {
+        switch (val) {
+            case Colour::WHITE:
+                return RGBA(255, 255, 255, 255);
+            case Colour::BLACK:
+                return RGBA(0, 0, 0, 255);
+            default:
+                throw std::invalid_argument("Error: unsupported colour type");
+        }
+    }
+
+    // colours cycled through for each series of a multi-series chart, chosen to be visible on both a white and black background
+    inline constexpr std::array<RGBA, 8> k_series_palette = {
+        RGBA(31, 119, 180, 255),
+        RGBA(255, 127, 14, 255),
+        RGBA(44, 160, 44, 255),
+        RGBA(214, 39, 40, 255),
+        RGBA(148, 103, 189, 255),
+        RGBA(140, 86, 75, 255),
+        RGBA(227, 119, 194, 255),
+        RGBA(23, 190, 207, 255),
+    };
+
+    [[nodiscard]] constexpr auto get_series_colour(size_t series_idx) noexcept -> RGBA {
+        return k_series_palette[series_idx % k_series_palette.size()];
+    }
+
+    // the instruction sets the rasterizer kernels can be dispatched to at runtime
+    enum class SimdLevel {
+        SCALAR, SSE2, AVX2, NEON, COUNT
+    };
+
+    [[nodiscard]] inline auto to_string(SimdLevel val) -> std::string_view {
+        switch (val) {
+            case SimdLevel::SCALAR:
+                return "scalar";
+            case SimdLevel::SSE2:
+                return "sse2";
+            case SimdLevel::AVX2:
+                return "avx2";
+            case SimdLevel::NEON:
+                return "neon";
+            default:
+                throw std::invalid_argument("Error: unsupported simd level");
+        }
+    }
+
+    // query the best instruction set supported by both the build and the CPU we are running on
+    [[nodiscard]] inline auto detect_simd_level() noexcept -> SimdLevel {
+#if defined(PJPLOT_SIMD_X86)
+#  if defined(_MSC_VER) && !defined(__clang__)
+        std::array<int, 4> info = {};
+        __cpuid(info.data(), 0);
+        if (info[0] >= 7) {
+            __cpuid(info.data(), 1);
+            const bool has_osxsave = (info[2] & (1 << 27)) != 0;
+            const bool has_avx = (info[2] & (1 << 28)) != 0;
+            // the OS must also save the upper halves of the ymm registers
+            if (has_osxsave && has_avx && (_xgetbv(0) & 0x6) == 0x6) {
+                __cpuidex(info.data(), 7, 0);
+                if ((info[1] & (1 << 5)) != 0) {
+                    return SimdLevel::AVX2;
+                }
+            }
+        }
+        return SimdLevel::SSE2;
+#  else
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return SimdLevel::AVX2;
+        }
+        return SimdLevel::SSE2;
+#  endif
+#elif defined(PJPLOT_SIMD_NEON)
+        return SimdLevel::NEON;
+#else
+        return SimdLevel::SCALAR;
+#endif
+    }
+
+    // cached result of detect_simd_level(), the CPU is only queried once per process
+    [[nodiscard]] inline auto get_simd_level() noexcept -> SimdLevel {
+        static const SimdLevel level = detect_simd_level();
+        return level;
+    }
+
+    // Span fill kernels: for one image row at height y, write colour to every column x for which lo[x] <= y <= hi[x].
+    // The rasterizers reduce each primitive to a vertical [lo, hi] run per column, so a row is filled with a
+    // compare + select over x and no per-pixel branching. Pixel is RGBA, or a palette index for an IndexedImg2.
+    template <typename Pixel>
+    constexpr void span_fill_row_scalar(Pixel* row, const int32_t* lo, const int32_t* hi, int32_t y, Pixel colour, size_t n) noexcept {
+        for (size_t x = 0; x < n; ++x) {
+            row[x] = (lo[x] <= y && y <= hi[x]) ? colour : row[x];
+        }
+    }
+
+#if defined(PJPLOT_SIMD_X86)
+    inline void span_fill_row_sse2(RGBA* row, const int32_t* lo, const int32_t* hi, int32_t y, RGBA colour, size_t n) noexcept {
+        const __m128i v_y = _mm_set1_epi32(y);
+        const __m128i v_colour = _mm_set1_epi32(std::bit_cast<int32_t>(colour));
+        size_t x = 0;
+        for (; x + 4 <= n; x += 4) {
+            const __m128i v_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo + x));
+            const __m128i v_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi + x));
+            const __m128i outside = _mm_or_si128(_mm_cmpgt_epi32(v_lo, v_y), _mm_cmpgt_epi32(v_y, v_hi));
+            auto* dst = reinterpret_cast<__m128i*>(row + x);
+            const __m128i px = _mm_loadu_si128(dst);
+            _mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(outside, px), _mm_andnot_si128(outside, v_colour)));
+        }
+        span_fill_row_scalar(row + x, lo + x, hi + x, y, colour, n - x);
+    }
+
+    PJPLOT_TARGET_AVX2 inline void span_fill_row_avx2(RGBA* row, const int32_t* lo, const int32_t* hi, int32_t y, RGBA colour, size_t n) noexcept {
+        const __m256i v_y = _mm256_set1_epi32(y);
+        const __m256i v_colour = _mm256_set1_epi32(std::bit_cast<int32_t>(colour));
+        size_t x = 0;
+        for (; x + 8 <= n; x += 8) {
+            const __m256i v_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo + x));
+            const __m256i v_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hi + x));
+            const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(v_lo, v_y), _mm256_cmpgt_epi32(v_y, v_hi));
+            auto* dst = reinterpret_cast<__m256i*>(row + x);
+            const __m256i px = _mm256_loadu_si256(dst);
+            _mm256_storeu_si256(dst, _mm256_blendv_epi8(v_colour, px, outside));
+        }
+        span_fill_row_scalar(row + x, lo + x, hi + x, y, colour, n - x);
+    }
+
+    // Palette index kernels: the 32-bit lo/hi comparisons of 16 (or 32) columns are narrowed with saturating packs into
+    // one vector of byte masks, so an indexed row is written a full vector at a time.
+    inline auto span_outside_sse2(const int32_t* lo, const int32_t* hi, __m128i v_y) noexcept -> __m128i {
+        const __m128i v_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo));
+        const __m128i v_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi));
+        return _mm_or_si128(_mm_cmpgt_epi32(v_lo, v_y), _mm_cmpgt_epi32(v_y, v_hi));
+    }
+
+    inline void span_fill_row_sse2(uint8_t* row, const int32_t* lo, const int32_t* hi, int32_t y, uint8_t index, size_t n) noexcept {
+        const __m128i v_y = _mm_set1_epi32(y);
+        const __m128i v_index = _mm_set1_epi8(static_cast<char>(index));
+        size_t x = 0;
+        for (; x + 16 <= n; x += 16) {
+            const __m128i outside = _mm_packs_epi16(
+                _mm_packs_epi32(span_outside_sse2(lo + x, hi + x, v_y), span_outside_sse2(lo + x + 4, hi + x + 4, v_y)),
+                _mm_packs_epi32(span_outside_sse2(lo + x + 8, hi + x + 8, v_y), span_outside_sse2(lo + x + 12, hi + x + 12, v_y)));
+            auto* dst = reinterpret_cast<__m128i*>(row + x);
+            const __m128i px = _mm_loadu_si128(dst);
+            _mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(outside, px), _mm_andnot_si128(outside, v_index)));
+        }
+        span_fill_row_scalar(row + x, lo + x, hi + x, y, index, n - x);
+    }
+
+    PJPLOT_TARGET_AVX2 inline auto span_outside_avx2(const int32_t* lo, const int32_t* hi, __m256i v_y) noexcept -> __m256i {
+        const __m256i v_lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo));
+        const __m256i v_hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hi));
+        return _mm256_or_si256(_mm256_cmpgt_epi32(v_lo, v_y), _mm256_cmpgt_epi32(v_y, v_hi));
+    }
+
+    PJPLOT_TARGET_AVX2 inline void span_fill_row_avx2(uint8_t* row, const int32_t* lo, const int32_t* hi, int32_t y, uint8_t index, size_t n) noexcept {
+        const __m256i v_y = _mm256_set1_epi32(y);
+        const __m256i v_index = _mm256_set1_epi8(static_cast<char>(index));
+        // the packs work within 128-bit lanes, leaving the eight groups of four columns interleaved
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        size_t x = 0;
+        for (; x + 32 <= n; x += 32) {
+            const __m256i packed = _mm256_packs_epi16(
+                _mm256_packs_epi32(span_outside_avx2(lo + x, hi + x, v_y), span_outside_avx2(lo + x + 8, hi + x + 8, v_y)),
+                _mm256_packs_epi32(span_outside_avx2(lo + x + 16, hi + x + 16, v_y), span_outside_avx2(lo + x + 24, hi + x + 24, v_y)));
+            const __m256i outside = _mm256_permutevar8x32_epi32(packed, order);
+            auto* dst = reinterpret_cast<__m256i*>(row + x);
+            const __m256i px = _mm256_loadu_si256(dst);
+            _mm256_storeu_si256(dst, _mm256_blendv_epi8(v_index, px, outside));
+        }
+        span_fill_row_sse2(row + x, lo + x, hi + x, y, index, n - x);
+    }
+#endif
+
+#if defined(PJPLOT_SIMD_NEON)
+    inline void span_fill_row_neon(RGBA* row, const int32_t* lo, const int32_t* hi, int32_t y, RGBA colour, size_t n) noexcept {
+        const int32x4_t v_y = vdupq_n_s32(y);
+        const uint32x4_t v_colour = vdupq_n_u32(std::bit_cast<uint32_t>(colour));
+        size_t x = 0;
+        for (; x + 4 <= n; x += 4) {
+            const uint32x4_t inside = vandq_u32(vcleq_s32(vld1q_s32(lo + x), v_y), vcgeq_s32(vld1q_s32(hi + x), v_y));
+            auto* dst = reinterpret_cast<uint32_t*>(row + x);
+            vst1q_u32(dst, vbslq_u32(inside, v_colour, vld1q_u32(dst)));
+        }
+        span_fill_row_scalar(row + x, lo + x, hi + x, y, colour, n - x);
+    }
+
+    inline void span_fill_row_neon(uint8_t* row, const int32_t* lo, const int32_t* hi, int32_t y, uint8_t index, size_t n) noexcept {
+        const int32x4_t v_y = vdupq_n_s32(y);
+        const uint8x16_t v_index = vdupq_n_u8(index);
+        const auto inside = [&](size_t i) {
+            return vandq_u32(vcleq_s32(vld1q_s32(lo + i), v_y), vcgeq_s32(vld1q_s32(hi + i), v_y));
+        };
+        size_t x = 0;
+        for (; x + 16 <= n; x += 16) {
+            const uint16x8_t low = vcombine_u16(vmovn_u32(inside(x)), vmovn_u32(inside(x + 4)));
+            const uint16x8_t high = vcombine_u16(vmovn_u32(inside(x + 8)), vmovn_u32(inside(x + 12)));
+            const uint8x16_t mask = vcombine_u8(vmovn_u16(low), vmovn_u16(high));
+            vst1q_u8(row + x, vbslq_u8(mask, v_index, vld1q_u8(row + x)));
+        }
+        span_fill_row_scalar(row + x, lo + x, hi + x, y, index, n - x);
+    }
+#endif
+
+    using SpanFillFn = void (*)(RGBA*, const int32_t*, const int32_t*, int32_t, RGBA, size_t);
+
+    [[nodiscard]] inline auto select_span_fill(SimdLevel level) noexcept -> SpanFillFn {
+        switch (level) {
+#if defined(PJPLOT_SIMD_X86)
+            case SimdLevel::AVX2:
+                return &span_fill_row_avx2;
+            case SimdLevel::SSE2:
+                return &span_fill_row_sse2;
+#endif
+#if defined(PJPLOT_SIMD_NEON)
+            case SimdLevel::NEON:
+                return &span_fill_row_neon;
+#endif
+            default:
+                return [](RGBA* row, const int32_t* lo, const int32_t* hi, int32_t y, RGBA colour, size_t n) noexcept {
+                    span_fill_row_scalar(row, lo, hi, y, colour, n);
+                };
+        }
+    }
+
+    // the span fill kernel for this CPU, resolved once on first use
+    [[nodiscard]] inline auto get_span_fill() noexcept -> SpanFillFn {
+        static const SpanFillFn fn = select_span_fill(get_simd_level());
+        return fn;
+    }
+
+    using IndexedSpanFillFn = void (*)(uint8_t*, const int32_t*, const int32_t*, int32_t, uint8_t, size_t);
+
+    [[nodiscard]] inline auto select_indexed_span_fill(SimdLevel level) noexcept -> IndexedSpanFillFn {
+        switch (level) {
+#if defined(PJPLOT_SIMD_X86)
+            case SimdLevel::AVX2:
+                return &span_fill_row_avx2;
+            case SimdLevel::SSE2:
+                return &span_fill_row_sse2;
+#endif
+#if defined(PJPLOT_SIMD_NEON)
+            case SimdLevel::NEON:
+                return &span_fill_row_neon;
+#endif
+            default:
+                return [](uint8_t* row, const int32_t* lo, const int32_t* hi, int32_t y, uint8_t index, size_t n) noexcept {
+                    span_fill_row_scalar(row, lo, hi, y, index, n);
+                };
+        }
+    }
+
+    [[nodiscard]] inline auto get_indexed_span_fill() noexcept -> IndexedSpanFillFn {
+        static const IndexedSpanFillFn fn = select_indexed_span_fill(get_simd_level());
+        return fn;
+    }
+
+    // span fill usable from constant evaluation, falling back to the scalar kernel at compile time
+    template <typename Pixel>
+    constexpr void span_fill_row(Pixel* row, const int32_t* lo, const int32_t* hi, int32_t y, Pixel colour, size_t n) noexcept {
+        if (std::is_constant_evaluated()) {
+            span_fill_row_scalar(row, lo, hi, y, colour, n);
+        } else if constexpr (std::is_same_v<Pixel, RGBA>) {
+            get_span_fill()(row, lo, hi, y, colour, n);
+        } else {
+            get_indexed_span_fill()(row, lo, hi, y, colour, n);
+        }
+    }
+
+    // Fixed width span fill: rows [rows.x, rows.y] of a block N columns wide, N known at compile time. The kernel
+    // is picked once per block instead of once per row and inlined with a constant width, so the vector loop has a
+    // fixed trip count and the N % lanes tail is unrolled.
+    template <size_t N, typename Pixel>
+    constexpr void span_fill_rows_scalar(Pixel* pixels, size_t stride, const int32_t* lo, const int32_t* hi, Vec2<int32_t> rows, Pixel colour) noexcept {
+        for (int32_t y = rows.x; y <= rows.y; ++y) {
+            span_fill_row_scalar(pixels + static_cast<size_t>(y) * stride, lo, hi, y, colour, N);
+        }
+    }
+
+#if defined(PJPLOT_SIMD_X86)
+    template <size_t N, typename Pixel>
+    inline void span_fill_rows_sse2(Pixel* pixels, size_t stride, const int32_t* lo, const int32_t* hi, Vec2<int32_t> rows, Pixel colour) noexcept {
+        for (int32_t y = rows.x; y <= rows.y; ++y) {
+            span_fill_row_sse2(pixels + static_cast<size_t>(y) * stride, lo, hi, y, colour, N);
+        }
+    }
+
+    template <size_t N, typename Pixel>
+    PJPLOT_TARGET_AVX2 inline void span_fill_rows_avx2(Pixel* pixels, size_t stride, const int32_t* lo, const int32_t* hi, Vec2<int32_t> rows, Pixel colour) noexcept {
+        for (int32_t y = rows.x; y <= rows.y; ++y) {
+            span_fill_row_avx2(pixels + static_cast<size_t>(y) * stride, lo, hi, y, colour, N);
+        }
+    }
+#endif
+
+#if defined(PJPLOT_SIMD_NEON)
+    template <size_t N, typename Pixel>
+    inline void span_fill_rows_neon(Pixel* pixels, size_t stride, const int32_t* lo, const int32_t* hi, Vec2<int32_t> rows, Pixel colour) noexcept {
+        for (int32_t y = rows.x; y <= rows.y; ++y) {
+            span_fill_row_neon(pixels + static_cast<size_t>(y) * stride, lo, hi, y, colour, N);
+        }
+    }
+#endif
+
+    template <size_t N, typename Pixel>
+    constexpr void span_fill_rows_fixed(Pixel* pixels, size_t stride, const int32_t* lo, const int32_t* hi, Vec2<int32_t> rows, Pixel colour) noexcept {
+        if (std::is_constant_evaluated()) {
+            span_fill_rows_scalar<N>(pixels, stride, lo, hi, rows, colour);
+            return;
+        }
+        switch (get_simd_level()) {
+#if defined(PJPLOT_SIMD_X86)
+            case SimdLevel::AVX2:
+                span_fill_rows_avx2<N>(pixels, stride, lo, hi, rows, colour);
+                return;
+            case SimdLevel::SSE2:
+                span_fill_rows_sse2<N>(pixels, stride, lo, hi, rows, colour);
+                return;
+#endif
+#if defined(PJPLOT_SIMD_NEON)
+            case SimdLevel::NEON:
+                span_fill_rows_neon<N>(pixels, stride, lo, hi, rows, colour);
+                return;
+#endif
+            default:
+                span_fill_rows_scalar<N>(pixels, stride, lo, hi, rows, colour);
+        }
+    }
+
+    // Coverage kernels for anti-aliased lines: the line crosses column x over the continuous rows [top[x], bottom[x]],
+    // pixel centres at integer rows, and is drawn a pixel thick, so row y is covered by
+    // min(y, bottom[x]) - max(y, top[x]) + 1 clamped to [0, 1]. A shallow line splits its coverage between the two
+    // rows nearest to it as in Wu's algorithm and a steep one covers its run fully, fading out at both ends.
+    inline void coverage_row_scalar(float* coverage, const float* top, const float* bottom, float y, size_t n) noexcept {
+        for (size_t x = 0; x < n; ++x) {
+            coverage[x] = std::clamp(std::min(y, bottom[x]) - std::max(y, top[x]) + 1.0F, 0.0F, 1.0F);
+        }
+    }
+
+    // blend colour over a row of pixels by their coverage, quantised to 1/256 steps so every kernel matches exactly
+    inline void blend_row_scalar(RGBA* row, const float* coverage, RGBA colour, size_t n) noexcept {
+        const auto mix = [](uint8_t dst, uint8_t src, uint32_t weight) {
+            return static_cast<uint8_t>((dst * (256 - weight) + src * weight) >> 8);
+        };
+        for (size_t x = 0; x < n; ++x) {
+            const auto weight = static_cast<uint32_t>(coverage[x] * 256.0F + 0.5F);
+            if (weight == 0) {
+                continue;
+            }
+            const RGBA px = row[x];
+            row[x] = RGBA(mix(px.m_r, colour.m_r, weight), mix(px.m_g, colour.m_g, weight), mix(px.m_b, colour.m_b, weight), mix(px.m_a, colour.m_a, weight));
+        }
+    }
+
+#if defined(PJPLOT_SIMD_X86)
+    inline void coverage_row_sse2(float* coverage, const float* top, const float* bottom, float y, size_t n) noexcept {
+        const __m128 v_y = _mm_set1_ps(y);
+        const __m128 v_one = _mm_set1_ps(1.0F);
+        const __m128 v_zero = _mm_setzero_ps();
+        size_t x = 0;
+        for (; x + 4 <= n; x += 4) {
+            const __m128 v_top = _mm_loadu_ps(top + x);
+            const __m128 v_bottom = _mm_loadu_ps(bottom + x);
+            const __m128 covered = _mm_add_ps(_mm_sub_ps(_mm_min_ps(v_y, v_bottom), _mm_max_ps(v_y, v_top)), v_one);
+            _mm_storeu_ps(coverage + x, _mm_max_ps(v_zero, _mm_min_ps(v_one, covered)));
+        }
+        coverage_row_scalar(coverage + x, top + x, bottom + x, y, n - x);
+    }
+
+    // four pixels at a time in 16-bit lanes, skipping the groups the line does not touch
+    inline void blend_row_sse2(RGBA* row, const float* coverage, RGBA colour, size_t n) noexcept {
+        const __m128i v_zero = _mm_setzero_si128();
+        const __m128i v_full = _mm_set1_epi16(256);
+        const __m128i v_colour = _mm_unpacklo_epi8(_mm_set1_epi32(std::bit_cast<int32_t>(colour)), v_zero);
+        const __m128 v_scale = _mm_set1_ps(256.0F);
+        const __m128 v_half = _mm_set1_ps(0.5F);
+        size_t x = 0;
+        for (; x + 4 <= n; x += 4) {
+            const __m128i weight = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(coverage + x), v_scale), v_half));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(weight, v_zero)) == 0xFFFF) {
+                continue;
+            }
+            // spread the weight of each pixel over its four channels
+            const __m128i pairs = _mm_unpacklo_epi16(_mm_packs_epi32(weight, weight), _mm_packs_epi32(weight, weight));
+            const __m128i w_lo = _mm_unpacklo_epi32(pairs, pairs);
+            const __m128i w_hi = _mm_unpackhi_epi32(pairs, pairs);
+            auto* dst = reinterpret_cast<__m128i*>(row + x);
+            const __m128i px = _mm_loadu_si128(dst);
+            const __m128i px_lo = _mm_unpacklo_epi8(px, v_zero);
+            const __m128i px_hi = _mm_unpackhi_epi8(px, v_zero);
+            const __m128i res_lo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(px_lo, _mm_sub_epi16(v_full, w_lo)), _mm_mullo_epi16(v_colour, w_lo)), 8);
+            const __m128i res_hi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(px_hi, _mm_sub_epi16(v_full, w_hi)), _mm_mullo_epi16(v_colour, w_hi)), 8);
+            _mm_storeu_si128(dst, _mm_packus_epi16(res_lo, res_hi));
+        }
+        blend_row_scalar(row + x, coverage + x, colour, n - x);
+    }
+#endif
+
+#if defined(PJPLOT_SIMD_NEON)
+    inline void coverage_row_neon(float* coverage, const float* top, const float* bottom, float y, size_t n) noexcept {
+        const float32x4_t v_y = vdupq_n_f32(y);
+        const float32x4_t v_one = vdupq_n_f32(1.0F);
+        const float32x4_t v_zero = vdupq_n_f32(0.0F);
+        size_t x = 0;
+        for (; x + 4 <= n; x += 4) {
+            const float32x4_t covered = vaddq_f32(vsubq_f32(vminq_f32(v_y, vld1q_f32(bottom + x)), vmaxq_f32(v_y, vld1q_f32(top + x))), v_one);
+            vst1q_f32(coverage + x, vmaxq_f32(v_zero, vminq_f32(v_one, covered)));
+        }
+        coverage_row_scalar(coverage + x, top + x, bottom + x, y, n - x);
+    }
+#endif
+
+    using CoverageRowFn = void (*)(float*, const float*, const float*, float, size_t);
+    using BlendRowFn = void (*)(RGBA*, const float*, RGBA, size_t);
+
+    [[nodiscard]] inline auto select_coverage_row(SimdLevel level) noexcept -> CoverageRowFn {
+        switch (level) {
+#if defined(PJPLOT_SIMD_X86)
+            case SimdLevel::AVX2:
+            case SimdLevel::SSE2:
+                return &coverage_row_sse2;
+#endif
+#if defined(PJPLOT_SIMD_NEON)
+            case SimdLevel::NEON:
+                return &coverage_row_neon;
+#endif
+            default:
+                return &coverage_row_scalar;
+        }
+    }
+
+    [[nodiscard]] inline auto select_blend_row(SimdLevel level) noexcept -> BlendRowFn {
+        switch (level) {
+#if defined(PJPLOT_SIMD_X86)
+            case SimdLevel::AVX2:
+            case SimdLevel::SSE2:
+                return &blend_row_sse2;
+#endif
+            default:
+                return &blend_row_scalar;
+        }
+    }
+
+    // the coverage and blend kernels for this CPU, resolved once on first use
+    [[nodiscard]] inline auto get_coverage_row() noexcept -> CoverageRowFn {
+        static const CoverageRowFn fn = select_coverage_row(get_simd_level());
+        return fn;
+    }
+
+    [[nodiscard]] inline auto get_blend_row() noexcept -> BlendRowFn {
+        static const BlendRowFn fn = select_blend_row(get_simd_level());
+        return fn;
+    }
+
+    // a class to store the options for the grid, including whether to show x, y, x labels and y labels
+    class GridOptions {
+    public:
+        constexpr GridOptions() = default;
+
+
+        constexpr GridOptions(size_t border_pixels, bool show_x, bool show_y, bool show_x_labels, bool show_y_labels, bool show_minor_gridlines, bool show_major_gridlines) 
+        : m_border_pixels(border_pixels), m_show_x(show_x), m_show_y(show_y), m_show_x_labels(show_x_labels), m_show_y_labels(show_y_labels), m_show_minor_gridlines(show_minor_gridlines), m_show_major_gridlines(show_major_gridlines) {
+
+        }
+
+        constexpr void set_border_pixels(size_t border_pixels) {
+            m_border_pixels = border_pixels;
+        }
+
+        constexpr void set_show_x(bool show_x) {
+            m_show_x = show_x;
+        }
+
+        constexpr void set_show_y(bool show_y) {
+            m_show_y = show_y;
+        }
+
+        constexpr void set_show_x_labels(bool show_x_labels) {
+            m_show_x_labels = show_x_labels;
+        }
+
+        constexpr void set_show_y_labels(bool show_y_labels) {
+            m_show_y_labels = show_y_labels;
+        }
+
+        constexpr void set_show_minor_gridlines(bool show_minor_gridlines) {
+            m_show_minor_gridlines = show_minor_gridlines;
+        }
+
+        constexpr void set_show_major_gridlines(bool show_major_gridlines) {
+            m_show_major_gridlines = show_major_gridlines;
+        }
+
+        [[nodiscard]] constexpr auto get_border_pixels() const noexcept -> size_t {
+            return m_border_pixels;
+        }
+
+        [[nodiscard]] constexpr auto get_show_x() const noexcept -> bool {
+            return m_show_x;
+        }
+
+        [[nodiscard]] constexpr auto get_show_y() const noexcept -> bool {
+            return m_show_y;
+        }
+
+        [[nodiscard]] constexpr auto get_show_x_labels() const noexcept -> bool {
+            return m_show_x_labels;
+        }
+
+        [[nodiscard]] constexpr auto get_show_y_labels() const noexcept -> bool {
+            return m_show_y_labels;
+        }
+
+        [[nodiscard]] constexpr auto get_show_minor_gridlines() const noexcept -> bool {
+            return m_show_minor_gridlines;
+        }
+
+        [[nodiscard]] constexpr auto get_show_major_gridlines() const noexcept -> bool {
+            return m_show_major_gridlines;
+        }   
+
+        // text drawn centred above the plot, empty for none
+        constexpr void set_title(std::string_view title) {
+            m_title = title;
+        }
+
+        // axis captions, drawn below the x axis and up the left of the y axis when the labels are shown
+        constexpr void set_x_label(std::string_view label) {
+            m_x_label = label;
+        }
+
+        constexpr void set_y_label(std::string_view label) {
+            m_y_label = label;
+        }
+
+        [[nodiscard]] constexpr auto get_title() const noexcept -> std::string_view {
+            return m_title;
+        }
+
+        [[nodiscard]] constexpr auto get_x_label() const noexcept -> std::string_view {
+            return m_x_label;
+        }
+
+        [[nodiscard]] constexpr auto get_y_label() const noexcept -> std::string_view {
+            return m_y_label;
+        }
+
+        [[nodiscard]] constexpr auto operator==(const GridOptions&) const -> bool = default;
+
+    private:
+
+        size_t m_border_pixels = 0;
+        bool m_show_x = true;
+        bool m_show_y = true;
+        bool m_show_x_labels = true;
+        bool m_show_y_labels = true;
+        bool m_show_minor_gridlines = true;
+        bool m_show_major_gridlines = true;
+        std::string m_title;
+        std::string m_x_label;
+        std::string m_y_label;
+    };  
+
+    // true for samples that can be placed on an axis, NaN and infinite values are skipped by the renderers
+    template <typename T>
+    [[nodiscard]] constexpr auto is_finite_sample(T val) noexcept -> bool {
+        if constexpr (std::is_floating_point_v<T>) {
+            return val == val && val != std::numeric_limits<T>::infinity() && val != -std::numeric_limits<T>::infinity();
+        } else {
+            return true;
+        }
+    }
+
+    // minimum and maximum of the finite values in a set of samples, used to scale the value axis
+    struct ValueRange {
+        double m_min = std::numeric_limits<double>::infinity();
+        double m_max = -std::numeric_limits<double>::infinity();
+
+        [[nodiscard]] constexpr auto is_empty() const noexcept -> bool {
+            return m_min > m_max;
+        }
+
+        [[nodiscard]] constexpr auto operator==(const ValueRange&) const -> bool = default;
+
+        template <typename T>
+        constexpr void include(T val) noexcept {
+            if (is_finite_sample(val)) {
+                const auto val_d = static_cast<double>(val);
+                m_min = val_d < m_min ? val_d : m_min;
+                m_max = val_d > m_max ? val_d : m_max;
+            }
+        }
+    };
+
+    // Series is anything indexable with a size(), e.g. std::span or a 1-D StridedView
+    template <typename Series>
+    [[nodiscard]] constexpr auto compute_value_range(const Series& data) noexcept -> ValueRange {
+        ValueRange range;
+        for (size_t i = 0; i < data.size(); ++i) {
+            range.include(data[i]);
+        }
+        return range;
+    }
+
+    // value range and number of skipped samples of a series, computed in the same pass as its decimation
+    struct SeriesStats {
+        ValueRange m_range;
+        size_t m_num_non_finite = 0; ///< NaN and infinite samples, which are not drawn
+    };
+
+    // bit k of a validity bitmap, least significant bit first within each byte as in Apache Arrow
+    [[nodiscard]] constexpr auto is_bit_set(const uint8_t* bits, size_t k) noexcept -> bool {
+        return ((bits[k / 8] >> (k % 8)) & 1U) != 0;
+    }
+
+    // Samples [first, first + size) of a sample array with a validity bitmap, bit first + k covering element k. It
+    // reads like a 1-D expression of doubles in which invalid samples are NaN, so every engine skips them exactly
+    // like missing float samples. Like a view it must not outlive the samples and the bitmap.
+    template <typename T>
+    class MaskedSeries {
+    public:
+        using is_array_expression = std::true_type;
+        using value_type = double;
+
+        constexpr MaskedSeries(const T* values, const uint8_t* validity, size_t first, size_t size) noexcept
+        : m_values(values + first), m_validity(validity), m_first(first), m_size(size) {
+
+        }
+
+        [[nodiscard]] constexpr auto nele() const noexcept -> size_t {
+            return m_size;
+        }
+
+        [[nodiscard]] constexpr auto size() const noexcept -> size_t {
+            return m_size;
+        }
+
+        [[nodiscard]] constexpr auto operator[](size_t idx) const noexcept -> double {
+            return is_bit_set(m_validity, m_first + idx) ? static_cast<double>(m_values[idx]) : std::numeric_limits<double>::quiet_NaN();
+        }
+
+    private:
+        const T* m_values;
+        const uint8_t* m_validity;
+        size_t m_first;
+        size_t m_size;
+    };
+
+    // Non-owning structure-of-arrays view of a set of series: the samples of every series back to back in one array,
+    // series i being samples [offset(i), offset(i + 1)), with optional x-values and a validity bitmap laid out like
+    // the samples, one x-value and one bit per sample. The series share one x axis, sample k sitting at its x-value,
+    // or at position k of its series without x-values, so a short series ends early instead of being stretched
+    // across the plot. x-values must be ascending within each series. Like std::span it refers to memory it does
+    // not own, see MultiSeries for the owning container.
+    template <typename T>
+    class MultiSeriesView {
+    public:
+        using value_type = T;
+
+        constexpr MultiSeriesView() noexcept = default;
+
+        // The flat layout of Chart::Params, num_series series of series_length samples back to back, read in place.
+        // Series are found by arithmetic, there is no offset table.
+        [[nodiscard]] constexpr static auto from_flat(std::span<const T> values, size_t series_length, size_t num_series) -> MultiSeriesView {
+            if (values.size() < series_length * num_series) {
+                throw std::invalid_argument("Error: plot data is smaller than series_length * num_series");
+            }
+            MultiSeriesView view;
+            view.m_values = values.data();
+            view.m_num_series = num_series;
+            view.m_series_length = series_length;
+            return view;
+        }
+
+        // Series of any length, offsets holding num_series + 1 ascending positions in values starting at 0, series i
+        // being values[offsets[i], offsets[i + 1]). The offsets are referred to, not copied.
+        [[nodiscard]] constexpr static auto from_offsets(std::span<const T> values, std::span<const size_t> offsets) -> MultiSeriesView {
+            if (offsets.empty() || offsets[0] != 0 || offsets.back() > values.size()) {
+                throw std::invalid_argument("Error: series offsets must start at 0 and end within the samples");
+            }
+            MultiSeriesView view;
+            view.m_values = values.data();
+            view.m_offsets = offsets.data();
+            view.m_num_series = offsets.size() - 1;
+            size_t min_length = std::numeric_limits<size_t>::max();
+            for (size_t series_idx = 0; series_idx < view.m_num_series; ++series_idx) {
+                if (offsets[series_idx + 1] < offsets[series_idx]) {
+                    throw std::invalid_argument("Error: series offsets must be ascending");
+                }
+                const size_t length = offsets[series_idx + 1] - offsets[series_idx];
+                min_length = std::min(min_length, length);
+                view.m_series_length = std::max(view.m_series_length, length);
+            }
+            view.m_is_ragged = view.m_num_series > 0 && min_length != view.m_series_length;
+            return view;
+        }
+
+        // the same series placed at x_values, one per sample of the view
+        [[nodiscard]] constexpr auto with_x_values(std::span<const double> x_values) const -> MultiSeriesView {
+            if (x_values.size() < get_num_samples()) {
+                throw std::invalid_argument("Error: fewer x-values than samples");
+            }
+            MultiSeriesView view = *this;
+            view.m_x_values = x_values.data();
+            return view;
+        }
+
+        // the same series with only the samples whose bit is set in validity drawn, see is_bit_set()
+        [[nodiscard]] constexpr auto with_validity(std::span<const uint8_t> validity) const -> MultiSeriesView {
+            if (validity.size() < (get_num_samples() + 7) / 8) {
+                throw std::invalid_argument("Error: validity bitmap is smaller than the number of samples");
+            }
+            MultiSeriesView view = *this;
+            view.m_validity = validity.data();
+            return view;
+        }
+
+        [[nodiscard]] constexpr auto get_num_series() const noexcept -> size_t {
+            return m_num_series;
+        }
+
+        // position of the first sample of series series_idx in the sample array, get_num_series() giving the end
+        [[nodiscard]] constexpr auto get_series_offset(size_t series_idx) const noexcept -> size_t {
+            return m_offsets != nullptr ? m_offsets[series_idx] : series_idx * m_series_length;
+        }
+
+        [[nodiscard]] constexpr auto get_series_length(size_t series_idx) const noexcept -> size_t {
+            return get_series_offset(series_idx + 1) - get_series_offset(series_idx);
+        }
+
+        // samples in the longest series
+        [[nodiscard]] constexpr auto get_max_series_length() const noexcept -> size_t {
+            return m_series_length;
+        }
+
+        // samples in all series
+        [[nodiscard]] constexpr auto get_num_samples() const noexcept -> size_t {
+            return get_series_offset(m_num_series);
+        }
+
+        [[nodiscard]] constexpr auto get_samples(size_t series_idx) const noexcept -> std::span<const T> {
+            return std::span<const T>(m_values + get_series_offset(series_idx), get_series_length(series_idx));
+        }
+
+        // the x-values of series series_idx, empty when the view has none
+        [[nodiscard]] constexpr auto get_x_values(size_t series_idx) const noexcept -> std::span<const double> {
+            return m_x_values != nullptr ? std::span<const double>(m_x_values + get_series_offset(series_idx), get_series_length(series_idx)) : std::span<const double>();
+        }
+
+        // the x-values of every series, back to back like the samples
+        [[nodiscard]] constexpr auto get_x_values() const noexcept -> std::span<const double> {
+            return m_x_values != nullptr ? std::span<const double>(m_x_values, get_num_samples()) : std::span<const double>();
+        }
+
+        // the validity bitmap, nullptr when every sample is valid
+        [[nodiscard]] constexpr auto get_validity() const noexcept -> const uint8_t* {
+            return m_validity;
+        }
+
+        // the samples of series series_idx with invalid ones read as NaN, only meaningful with a validity bitmap
+        [[nodiscard]] constexpr auto get_masked_samples(size_t series_idx) const noexcept -> MaskedSeries<T> {
+            return MaskedSeries<T>(m_values, m_validity, get_series_offset(series_idx), get_series_length(series_idx));
+        }
+
+        // every sample of the view as one run, see get_masked_samples()
+        [[nodiscard]] constexpr auto get_masked_samples() const noexcept -> MaskedSeries<T> {
+            return MaskedSeries<T>(m_values, m_validity, 0, get_num_samples());
+        }
+
+        [[nodiscard]] constexpr auto data() const noexcept -> const T* {
+            return m_values;
+        }
+
+        [[nodiscard]] constexpr auto has_x_values() const noexcept -> bool {
+            return m_x_values != nullptr;
+        }
+
+        [[nodiscard]] constexpr auto has_validity() const noexcept -> bool {
+            return m_validity != nullptr;
+        }
+
+        // true when the series have different lengths
+        [[nodiscard]] constexpr auto is_ragged() const noexcept -> bool {
+            return m_is_ragged;
+        }
+
+        // True when samples cannot be placed by their index in an equal length series alone, i.e. the series have
+        // x-values or different lengths, and the renderers bin them into columns by position instead.
+        [[nodiscard]] constexpr auto is_positioned() const noexcept -> bool {
+            return has_x_values() || is_ragged();
+        }
+
+        // the series holding sample idx of the sample array
+        [[nodiscard]] constexpr auto get_series_index(size_t idx) const noexcept -> size_t {
+            if (m_offsets == nullptr) {
+                return m_series_length > 0 ? idx / m_series_length : 0;
+            }
+            return static_cast<size_t>(std::upper_bound(m_offsets + 1, m_offsets + m_num_series + 1, idx) - (m_offsets + 1));
+        }
+
+        // The x axis shared by the series: from the first to the last finite x-value of any series, the x-values
+        // being ascending, or the sample positions of the longest series without x-values.
+        [[nodiscard]] constexpr auto get_x_range() const noexcept -> ValueRange {
+            ValueRange range;
+            if (!has_x_values()) {
+                if (m_series_length > 0) {
+                    range = ValueRange{0.0, static_cast<double>(m_series_length - 1)};
+                }
+                return range;
+            }
+            for (size_t series_idx = 0; series_idx < m_num_series; ++series_idx) {
+                const auto x_values = get_x_values(series_idx);
+                const auto first = std::find_if(x_values.begin(), x_values.end(), [](double x) { return is_finite_sample(x); });
+                const auto last = std::find_if(x_values.rbegin(), x_values.rend(), [](double x) { return is_finite_sample(x); });
+                if (first != x_values.end()) {
+                    range.include(*first);
+                    range.include(*last);
+                }
+            }
+            return range;
+        }
+
+    private:
+        const T* m_values = nullptr;
+        const size_t* m_offsets = nullptr;   ///< num_series + 1 entries, nullptr for series_length samples per series
+        const double* m_x_values = nullptr;  ///< one per sample, nullptr to place samples by index
+        const uint8_t* m_validity = nullptr; ///< one bit per sample, nullptr when every sample is valid
+        size_t m_num_series = 0;
+        size_t m_series_length = 0;          ///< samples per series, the longest series with offsets
+        bool m_is_ragged = false;
+    };
+
+    // Owning storage of a MultiSeriesView as a structure of arrays over ArrayNd: one array with the samples of all
+    // series back to back, one with their offsets and, once a series needs them, one with the x-values and one with
+    // the validity bitmap. Series of different lengths take exactly their own samples, with no padding to the longest.
+    template <typename T, typename Allocator = std::allocator<T>>
+    class MultiSeries {
+    public:
+        MultiSeries()
+        : m_offsets(DynamicSize1(1)) {
+
+        }
+
+        // Append a series and return its index. x_values is empty, placing the samples at their index in the series,
+        // or holds one x-value per sample.
+        auto add_series(std::span<const T> samples, std::span<const double> x_values = {}) -> size_t {
+            if (!x_values.empty() && x_values.size() != samples.size()) {
+                throw std::invalid_argument("Error: a series needs one x-value per sample");
+            }
+            const size_t series_idx = get_num_series();
+            const size_t begin = get_num_samples();
+            const size_t end = begin + samples.size();
+            m_samples.resize(DynamicSize1(end));
+            std::copy(samples.begin(), samples.end(), m_samples.begin() + begin);
+            m_offsets.resize(DynamicSize1(series_idx + 2));
+            m_offsets[series_idx + 1] = end;
+            if (!x_values.empty() || m_x_values.nele() > 0) {
+                // the first series with x-values gives the earlier ones their sample positions
+                const bool is_first = m_x_values.nele() == 0;
+                m_x_values.resize(DynamicSize1(end));
+                for (size_t idx = 0; is_first && idx < series_idx; ++idx) {
+                    for (size_t k = m_offsets[idx]; k < m_offsets[idx + 1]; ++k) {
+                        m_x_values[k] = static_cast<double>(k - m_offsets[idx]);
+                    }
+                }
+                for (size_t k = 0; k < samples.size(); ++k) {
+                    m_x_values[begin + k] = x_values.empty() ? static_cast<double>(k) : x_values[k];
+                }
+            }
+            if (m_validity.nele() > 0) {
+                m_validity.resize(DynamicSize1((end + 7) / 8));
+                for (size_t k = begin; k < end; ++k) {
+                    set_bit(k, true);
+                }
+            }
+            return series_idx;
+        }
+
+        // Mark sample k of series series_idx valid or invalid, e.g. a dropout, which breaks the line there. The
+        // bitmap is allocated the first time a sample is invalidated.
+        void set_valid(size_t series_idx, size_t k, bool is_valid) {
+            if (series_idx >= get_num_series() || k >= get_series_length(series_idx)) {
+                throw std::out_of_range("Error: sample index out of range");
+            }
+            if (m_validity.nele() == 0) {
+                if (is_valid) {
+                    return;
+                }
+                m_validity.resize(DynamicSize1((get_num_samples() + 7) / 8));
+                std::fill(m_validity.begin(), m_validity.end(), uint8_t{0xFF});
+            }
+            set_bit(m_offsets[series_idx] + k, is_valid);
+        }
+
+        [[nodiscard]] auto is_valid(size_t series_idx, size_t k) const noexcept -> bool {
+            return m_validity.nele() == 0 || is_bit_set(m_validity.data().data(), m_offsets[series_idx] + k);
+        }
+
+        void clear() {
+            m_samples.resize(DynamicSize1(0));
+            m_offsets.resize(DynamicSize1(1));
+            m_x_values.resize(DynamicSize1(0));
+            m_validity.resize(DynamicSize1(0));
+        }
+
+        [[nodiscard]] auto get_num_series() const noexcept -> size_t {
+            return m_offsets.nele() - 1;
+        }
+
+        [[nodiscard]] auto get_num_samples() const noexcept -> size_t {
+            return m_samples.nele();
+        }
+
+        [[nodiscard]] auto get_series_length(size_t series_idx) const noexcept -> size_t {
+            return m_offsets[series_idx + 1] - m_offsets[series_idx];
+        }
+
+        // the samples of series series_idx, writable in place
+        [[nodiscard]] auto get_samples(size_t series_idx) noexcept -> std::span<T> {
+            return m_samples.data().subspan(m_offsets[series_idx], get_series_length(series_idx));
+        }
+
+        [[nodiscard]] auto get_samples(size_t series_idx) const noexcept -> std::span<const T> {
+            return m_samples.data().subspan(m_offsets[series_idx], get_series_length(series_idx));
+        }
+
+        // view of the series for the renderers, valid until the next add_series(), set_valid() or clear()
+        [[nodiscard]] auto get_view() const -> MultiSeriesView<T> {
+            auto view = MultiSeriesView<T>::from_offsets(m_samples.data(), m_offsets.data());
+            if (m_x_values.nele() > 0) {
+                view = view.with_x_values(m_x_values.data());
+            }
+            if (m_validity.nele() > 0) {
+                view = view.with_validity(m_validity.data());
+            }
+            return view;
+        }
+
+    private:
+        void set_bit(size_t idx, bool is_set) noexcept {
+            const auto mask = static_cast<uint8_t>(1U << (idx % 8));
+            m_validity[idx / 8] = static_cast<uint8_t>(is_set ? m_validity[idx / 8] | mask : m_validity[idx / 8] & ~mask);
+        }
+
+        ArrayNd<T, DynamicSize1, true, Allocator> m_samples;
+        ArrayNd<size_t, DynamicSize1> m_offsets;  ///< num_series + 1 entries, starting at 0
+        ArrayNd<double, DynamicSize1> m_x_values; ///< empty until a series is added with x-values
+        ArrayNd<uint8_t, DynamicSize1> m_validity; ///< empty until a sample is invalidated
+    };
+
+#ifdef PJPLOT_ENABLE_TESTS
+    // little compile-time test to ensure ragged views find their series and mask invalid samples
+    consteval static auto test_multi_series_view() -> bool {
+        const std::array<int, 6> values = {1, 2, 3, 4, 5, 6};
+        const std::array<size_t, 4> offsets = {0, 3, 3, 6};
+        const std::array<uint8_t, 1> validity = {0b110111};
+        const auto view = MultiSeriesView<int>::from_offsets(values, offsets).with_validity(validity);
+        const auto flat = MultiSeriesView<int>::from_flat(values, 2, 3);
+        const auto masked = view.get_masked_samples(2);
+        return view.is_ragged() && view.get_max_series_length() == 3 && view.get_series_length(1) == 0
+            && view.get_series_index(2) == 0 && view.get_series_index(3) == 2 && masked[0] != masked[0] && masked[1] == 5.0
+            && !flat.is_positioned() && flat.get_samples(2)[1] == 6 && flat.get_series_index(5) == 2;
+    }
+    static_assert(test_multi_series_view(), "Error: multi-series view laid out incorrectly");
+#endif
+
+    // Stats of series rendered before, keyed by the address, length and stride of their samples, so repeated renders
+    // of unchanged data skip the range scan. The cache cannot see samples change in place: call invalidate() or
+    // clear() after writing to data it has seen. Safe to use from several threads at once.
+    class RangeCache {
+    public:
+        static constexpr size_t k_capacity = 64;
+
+        struct Key {
+            const void* m_data = nullptr;
+            size_t m_length = 0;
+            size_t m_stride_bytes = 0;
+
+            [[nodiscard]] constexpr auto operator==(const Key&) const -> bool = default;
+        };
+
+        // key of length samples starting at data, stride elements apart
+        template <typename T>
+        [[nodiscard]] static auto make_key(const T* data, size_t length, size_t stride = 1) noexcept -> Key {
+            return Key{data, length, stride * sizeof(T)};
+        }
+
+        [[nodiscard]] auto find(const Key& key, SeriesStats& stats) const -> bool {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < m_num_entries; ++i) {
+                if (m_entries[i].m_key == key) {
+                    stats = m_entries[i].m_stats;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // add or update the stats of key, replacing the oldest entry once the cache is full
+        void insert(const Key& key, const SeriesStats& stats) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < m_num_entries; ++i) {
+                if (m_entries[i].m_key == key) {
+                    m_entries[i].m_stats = stats;
+                    return;
+                }
+            }
+            if (m_num_entries < k_capacity) {
+                m_entries[m_num_entries++] = Entry{key, stats};
+            } else {
+                m_entries[m_next] = Entry{key, stats};
+                m_next = (m_next + 1) % k_capacity;
+            }
+        }
+
+        // forget every entry whose samples may overlap the size_bytes bytes at data
+        void invalidate(const void* data, size_t size_bytes) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const auto begin = reinterpret_cast<uintptr_t>(data);
+            for (size_t i = 0; i < m_num_entries;) {
+                const auto entry_begin = reinterpret_cast<uintptr_t>(m_entries[i].m_key.m_data);
+                const size_t entry_size = m_entries[i].m_key.m_length * m_entries[i].m_key.m_stride_bytes;
+                if (entry_begin < begin + size_bytes && begin < entry_begin + entry_size) {
+                    m_entries[i] = m_entries[--m_num_entries];
+                } else {
+                    ++i;
+                }
+            }
+            m_next = 0;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_num_entries = 0;
+            m_next = 0;
+        }
+
+        [[nodiscard]] auto size() const -> size_t {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_num_entries;
+        }
+
+    private:
+        struct Entry {
+            Key m_key;
+            SeriesStats m_stats;
+        };
+
+        mutable std::mutex m_mutex;
+        std::array<Entry, k_capacity> m_entries{};
+        size_t m_num_entries = 0;
+        size_t m_next = 0; ///< entry replaced next once the cache is full
+    };
+
+    // how scatter charts draw their points
+    enum class ScatterMode {
+        AUTO,    ///< markers, switching to density above AppearanceOptions::get_density_threshold() points
+        MARKERS, ///< a square marker per point in the colour of its series
+        DENSITY, ///< per-pixel point counts tone mapped through k_density_ramp, for clouds too dense for markers
+        COUNT
+    };
+
+    [[nodiscard]] inline auto to_string(ScatterMode val) -> std::string_view {
+        switch (val) {
+            case ScatterMode::AUTO:
+                return "auto";
+            case ScatterMode::MARKERS:
+                return "markers";
+            case ScatterMode::DENSITY:
+                return "density";
+            default:
+                throw std::invalid_argument("Error: unsupported scatter mode");
+        }
+    }
+
+    // how bar charts turn the samples of a series into bar heights
+    enum class BarAggregation {
+        SUM,       ///< each bar covers an equal run of consecutive samples, reduced to their sum
+        MEAN,      ///< as SUM, reduced to their mean
+        MIN,       ///< as SUM, reduced to their minimum
+        MAX,       ///< as SUM, reduced to their maximum
+        HISTOGRAM, ///< bar i counts the samples in bin i of equal width bins spanning the range of the data
+        COUNT
+    };
+
+    [[nodiscard]] inline auto to_string(BarAggregation val) -> std::string_view {
+        switch (val) {
+            case BarAggregation::SUM:
+                return "sum";
+            case BarAggregation::MEAN:
+                return "mean";
+            case BarAggregation::MIN:
+                return "min";
+            case BarAggregation::MAX:
+                return "max";
+            case BarAggregation::HISTOGRAM:
+                return "histogram";
+            default:
+                throw std::invalid_argument("Error: unsupported bar aggregation");
+        }
+    }
+
+    // how line charts draw their series
+    enum class LineMode {
+        ALIASED,      ///< a solid run of whole pixels per column, the fast path
+        ANTI_ALIASED, ///< fractional pixel coverage blended over the background, for publication output
+        COUNT
+    };
+
+    [[nodiscard]] inline auto to_string(LineMode val) -> std::string_view {
+        switch (val) {
+            case LineMode::ALIASED:
+                return "aliased";
+            case LineMode::ANTI_ALIASED:
+                return "anti_aliased";
+            default:
+                throw std::invalid_argument("Error: unsupported line mode");
+        }
+    }
+
+    class AppearanceOptions {
+    public:
+        constexpr AppearanceOptions(){}
+
+        [[nodiscard]] constexpr static auto create(Colour background, Colour text) noexcept-> ResultWithValue<AppearanceOptions> {
+            if (background < Colour::COUNT && text < Colour::COUNT) {
+                return ResultWithValue<AppearanceOptions>(AppearanceOptions(background, text));
+            } else {
+                return ResultWithValue<AppearanceOptions>::Failure("Error: invalid colour type");
+            }
+        }
+        constexpr void set_background_colour(Colour background) {
+            m_background_colour = background;
+        }
+
+        constexpr void set_text_colour(Colour text) {
+            m_text_colour = text;
+        }
+
+        [[nodiscard]] constexpr auto get_background_colour() const noexcept {
+            return m_background_colour;
+        }
+
+        [[nodiscard]] constexpr auto get_text_colour() const noexcept {
+            return m_text_colour;
+        }
+
+        // fix the value axis of line and bar charts to range instead of fitting it to the data, which also skips the
+        // range scan; an empty ValueRange, the default, fits the data
+        constexpr void set_value_range(ValueRange range) {
+            m_value_range = range;
+        }
+
+        [[nodiscard]] constexpr auto get_value_range() const noexcept -> ValueRange {
+            return m_value_range;
+        }
+
+        constexpr void set_line_mode(LineMode mode) {
+            m_line_mode = mode;
+        }
+
+        [[nodiscard]] constexpr auto get_line_mode() const noexcept -> LineMode {
+            return m_line_mode;
+        }
+
+        // scatter markers are (2 * radius + 1) pixels square
+        constexpr void set_marker_radius(size_t radius) {
+            m_marker_radius = radius;
+        }
+
+        constexpr void set_scatter_mode(ScatterMode mode) {
+            m_scatter_mode = mode;
+        }
+
+        // number of points above which ScatterMode::AUTO draws a density plot instead of markers
+        constexpr void set_density_threshold(size_t num_points) {
+            m_density_threshold = num_points;
+        }
+
+        constexpr void set_bar_aggregation(BarAggregation aggregation) {
+            m_bar_aggregation = aggregation;
+        }
+
+        // bars drawn per series, 0 picks one per sample (or BarRasterizer::k_default_num_bins for histograms),
+        // in both cases limited so that every bar is at least a pixel wide
+        constexpr void set_num_bars(size_t num_bars) {
+            m_num_bars = num_bars;
+        }
+
+        [[nodiscard]] constexpr auto get_bar_aggregation() const noexcept -> BarAggregation {
+            return m_bar_aggregation;
+        }
+
+        [[nodiscard]] constexpr auto get_num_bars() const noexcept -> size_t {
+            return m_num_bars;
+        }
+
+        [[nodiscard]] constexpr auto get_marker_radius() const noexcept -> size_t {
+            return m_marker_radius;
+        }
+
+        [[nodiscard]] constexpr auto get_scatter_mode() const noexcept -> ScatterMode {
+            return m_scatter_mode;
+        }
+
+        [[nodiscard]] constexpr auto get_density_threshold() const noexcept -> size_t {
+            return m_density_threshold;
+        }
+
+        [[nodiscard]] constexpr auto operator==(const AppearanceOptions&) const -> bool = default;
+
+    private:
+
+        constexpr AppearanceOptions(Colour background, Colour text) 
+        : m_background_colour(background), m_text_colour(text) {
+
+        }
+
+        Colour m_background_colour = Colour::WHITE;
+        Colour m_text_colour = Colour::BLACK;
+        ValueRange m_value_range{};
+        LineMode m_line_mode = LineMode::ALIASED;
+        size_t m_marker_radius = 1;
+        ScatterMode m_scatter_mode = ScatterMode::AUTO;
+        size_t m_density_threshold = size_t(1) << 20;
+        BarAggregation m_bar_aggregation = BarAggregation::MEAN;
+        size_t m_num_bars = 0;
+    };
+
+    // linear blend between two colours, t = 0 gives a and t = 1 gives b
+    [[nodiscard]] constexpr auto mix_rgba(RGBA a, RGBA b, double t) noexcept -> RGBA {
+        const auto mix = [t](uint8_t lhs, uint8_t rhs) {
+            return static_cast<uint8_t>(static_cast<double>(lhs) + (static_cast<double>(rhs) - static_cast<double>(lhs)) * t + 0.5);
+        };
+        return RGBA(mix(a.m_r, b.m_r), mix(a.m_g, b.m_g), mix(a.m_b, b.m_b), mix(a.m_a, b.m_a));
+    }
+
+    // fill the part of rect inside clip, Pixel being RGBA or the palette index of an IndexedImg2
+    template <typename Pixel>
+    constexpr void fill_rect(Pixel* pixels, size_t stride, Rect rect, Pixel colour, Rect clip) noexcept {
+        const Rect area = rect.intersect(clip);
+        for (size_t row = area.y; row < area.y + area.height; ++row) {
+            Pixel* dst = pixels + row * stride + area.x;
+            std::fill(dst, dst + area.width, colour);
+        }
+    }
+
+    // The colours of an IndexedImg2, at most 256 so every pixel is a one byte index. A chart draws a handful of
+    // colours, the background, text, gridlines and series, and Palette::create() lays out exactly those.
+    class Palette {
+    public:
+        static constexpr size_t k_capacity = 256;
+
+        constexpr Palette() = default;
+
+        // the colours a chart drawn with appearance writes: background, text, major and minor gridlines, then the
+        // series colours, with duplicates merged
+        [[nodiscard]] constexpr static auto create(const AppearanceOptions& appearance) -> Palette {
+            const auto background = to_rgba(appearance.get_background_colour());
+            const auto text = to_rgba(appearance.get_text_colour());
+            Palette res;
+            res.add(background);
+            res.add(text);
+            res.add(mix_rgba(background, text, 0.25));
+            res.add(mix_rgba(background, text, 0.1));
+            for (const auto colour : k_series_palette) {
+                res.add(colour);
+            }
+            return res;
+        }
+
+        // the index of colour, appended unless the palette already holds it
+        constexpr auto add(RGBA colour) -> uint8_t {
+            if (const auto idx = find(colour); idx < m_size) {
+                return static_cast<uint8_t>(idx);
+            }
+            if (m_size == k_capacity) {
+                throw std::invalid_argument("Error: palette is full");
+            }
+            m_colours[m_size] = colour;
+            return static_cast<uint8_t>(m_size++);
+        }
+
+        // the index of colour, or the nearest colour when the palette does not hold it exactly
+        [[nodiscard]] constexpr auto get_index(RGBA colour) const noexcept -> uint8_t {
+            if (const auto idx = find(colour); idx < m_size) {
+                return static_cast<uint8_t>(idx);
+            }
+            const auto distance = [colour](RGBA other) {
+                const auto diff = [](uint8_t lhs, uint8_t rhs) {
+                    const int val = static_cast<int>(lhs) - static_cast<int>(rhs);
+                    return val * val;
+                };
+                return diff(colour.m_r, other.m_r) + diff(colour.m_g, other.m_g) + diff(colour.m_b, other.m_b) + diff(colour.m_a, other.m_a);
+            };
+            size_t best = 0;
+            for (size_t idx = 1; idx < m_size; ++idx) {
+                best = distance(m_colours[idx]) < distance(m_colours[best]) ? idx : best;
+            }
+            return static_cast<uint8_t>(best);
+        }
+
+        // index of colour, size() if the palette does not hold it
+        [[nodiscard]] constexpr auto find(RGBA colour) const noexcept -> size_t {
+            for (size_t idx = 0; idx < m_size; ++idx) {
+                if (m_colours[idx] == colour) {
+                    return idx;
+                }
+            }
+            return m_size;
+        }
+
+        [[nodiscard]] constexpr auto operator[](size_t idx) const noexcept -> RGBA {
+            return m_colours[idx];
+        }
+
+        [[nodiscard]] constexpr auto size() const noexcept -> size_t {
+            return m_size;
+        }
+
+        [[nodiscard]] constexpr auto get_colours() const noexcept -> std::span<const RGBA> {
+            return std::span<const RGBA>(m_colours.data(), m_size);
+        }
+
+        // the full table of 256 entries, indices past size() map to transparent black
+        [[nodiscard]] constexpr auto get_table() const noexcept -> const std::array<RGBA, k_capacity>& {
+            return m_colours;
+        }
+
+        [[nodiscard]] constexpr auto is_opaque() const noexcept -> bool {
+            return std::all_of(m_colours.begin(), m_colours.begin() + static_cast<std::ptrdiff_t>(m_size), [](RGBA colour) { return colour.m_a == 255; });
+        }
+
+        [[nodiscard]] constexpr auto operator==(const Palette& other) const noexcept -> bool = default;
+
+    private:
+        std::array<RGBA, k_capacity> m_colours{};
+        size_t m_size = 0;
+    };
+
+    // the value an image of Pixel stores for colour, its palette index for an indexed image
+    template <typename Pixel>
+    [[nodiscard]] constexpr auto to_pixel(RGBA colour, const Palette* palette) noexcept -> Pixel {
+        if constexpr (std::is_same_v<Pixel, RGBA>) {
+            return colour;
+        } else {
+            return palette->get_index(colour);
+        }
+    }
+
+    // copy n RGBA pixels into an image of Pixel, looking each run of one colour up in the palette once
+    template <typename Pixel>
+    constexpr void copy_pixels(const RGBA* src, size_t n, Pixel* dst, const Palette* palette) noexcept {
+        if constexpr (std::is_same_v<Pixel, RGBA>) {
+            std::copy(src, src + n, dst);
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                const size_t run = i;
+                const uint8_t index = palette->get_index(src[i]);
+                while (i + 1 < n && src[i + 1] == src[run]) {
+                    ++i;
+                }
+                std::fill(dst + run, dst + i + 1, index);
+            }
+        }
+    }
+
+    // An 8-bit palette image: a Mat2 of indices into a shared Palette. The chart engines draw indices straight into
+    // it, a quarter of the bytes of an Img2, and colours are only looked up by to_rgba() or the encoders.
+    template <Size2 Size, typename Allocator = DefaultImageAllocator<uint8_t>>
+    class IndexedImg2 : public Mat2<uint8_t, Size, Allocator> {
+    public:
+        using Mat2<uint8_t, Size, Allocator>::operator=;
+
+        IndexedImg2() noexcept = default;
+
+        explicit IndexedImg2(Size size) noexcept(Size::is_static_size::value)
+        : Mat2<uint8_t, Size, Allocator>(size) {}
+
+        IndexedImg2(Size size, UninitializedTag tag) noexcept(Size::is_static_size::value)
+        : Mat2<uint8_t, Size, Allocator>(size, tag) {}
+
+        // nullptr until the image is drawn or given a palette
+        [[nodiscard]] auto get_palette() const noexcept -> const std::shared_ptr<const Palette>& {
+            return m_palette;
+        }
+
+        void set_palette(std::shared_ptr<const Palette> palette) noexcept {
+            m_palette = std::move(palette);
+        }
+
+        // use palette, keeping the current one when it is equal so redrawing in the same colours does not allocate
+        void set_palette(const Palette& palette) {
+            if (!m_palette || *m_palette != palette) {
+                m_palette = std::make_shared<const Palette>(palette);
+            }
+        }
+
+        [[nodiscard]] auto get_colour(size_t row, size_t col) const noexcept -> RGBA {
+            return m_palette->get_table()[this->data()[row * this->cols() + col]];
+        }
+
+        // expand to an RGBA image of the same size
+        [[nodiscard]] auto to_rgba() const -> Img2<Size> {
+            if (!m_palette) {
+                throw std::invalid_argument("Error: indexed image has no palette");
+            }
+            Img2<Size> res(this->m_size, k_uninitialized);
+            const auto& table = m_palette->get_table();
+            const uint8_t* src = this->data().data();
+            RGBA* dst = res.data().data();
+            const size_t nele = this->rows() * this->cols();
+            PJPLOT_IVDEP
+            for (size_t i = 0; i < nele; ++i) {
+                dst[i] = table[src[i]];
+            }
+            return res;
+        }
+
+    private:
+        std::shared_ptr<const Palette> m_palette;
+    };
+
+    // Built-in 5x7 bitmap font for printable ASCII, starting at ' '. Each glyph is 7 rows of 5 bits, the most
+    // significant of the 5 being the leftmost pixel.
+    inline constexpr std::array<std::array<uint8_t, 7>, 95> k_font_5x7 = {
+        std::array<uint8_t, 7>{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+        std::array<uint8_t, 7>{0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04}, // '!'
+        std::array<uint8_t, 7>{0x0A, 0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00}, // '"'
+        std::array<uint8_t, 7>{0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A}, // '#'
+        std::array<uint8_t, 7>{0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04}, // '$'
+        std::array<uint8_t, 7>{0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}, // '%'
+        std::array<uint8_t, 7>{0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D}, // '&'
+        std::array<uint8_t, 7>{0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00}, // '''
+        std::array<uint8_t, 7>{0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}, // '('
+        std::array<uint8_t, 7>{0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}, // ')'
+        std::array<uint8_t, 7>{0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00}, // '*'
+        std::array<uint8_t, 7>{0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00}, // '+'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08}, // ','
+        std::array<uint8_t, 7>{0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}, // '-'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}, // '.'
+        std::array<uint8_t, 7>{0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}, // '/'
+        std::array<uint8_t, 7>{0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}, // '0'
+        std::array<uint8_t, 7>{0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}, // '1'
+        std::array<uint8_t, 7>{0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}, // '2'
+        std::array<uint8_t, 7>{0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}, // '3'
+        std::array<uint8_t, 7>{0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}, // '4'
+        std::array<uint8_t, 7>{0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}, // '5'
+        std::array<uint8_t, 7>{0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}, // '6'
+        std::array<uint8_t, 7>{0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}, // '7'
+        std::array<uint8_t, 7>{0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}, // '8'
+        std::array<uint8_t, 7>{0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}, // '9'
+        std::array<uint8_t, 7>{0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}, // ':'
+        std::array<uint8_t, 7>{0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08}, // ';'
+        std::array<uint8_t, 7>{0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02}, // '<'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00}, // '='
+        std::array<uint8_t, 7>{0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08}, // '>'
+        std::array<uint8_t, 7>{0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04}, // '?'
+        std::array<uint8_t, 7>{0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E}, // '@'
+        std::array<uint8_t, 7>{0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // 'A'
+        std::array<uint8_t, 7>{0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}, // 'B'
+        std::array<uint8_t, 7>{0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}, // 'C'
+        std::array<uint8_t, 7>{0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}, // 'D'
+        std::array<uint8_t, 7>{0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}, // 'E'
+        std::array<uint8_t, 7>{0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}, // 'F'
+        std::array<uint8_t, 7>{0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}, // 'G'
+        std::array<uint8_t, 7>{0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}, // 'H'
+        std::array<uint8_t, 7>{0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 'I'
+        std::array<uint8_t, 7>{0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}, // 'J'
+        std::array<uint8_t, 7>{0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}, // 'K'
+        std::array<uint8_t, 7>{0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}, // 'L'
+        std::array<uint8_t, 7>{0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}, // 'M'
+        std::array<uint8_t, 7>{0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}, // 'N'
+        std::array<uint8_t, 7>{0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // 'O'
+        std::array<uint8_t, 7>{0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}, // 'P'
+        std::array<uint8_t, 7>{0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}, // 'Q'
+        std::array<uint8_t, 7>{0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}, // 'R'
+        std::array<uint8_t, 7>{0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}, // 'S'
+        std::array<uint8_t, 7>{0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // 'T'
+        std::array<uint8_t, 7>{0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}, // 'U'
+        std::array<uint8_t, 7>{0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}, // 'V'
+        std::array<uint8_t, 7>{0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}, // 'W'
+        std::array<uint8_t, 7>{0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}, // 'X'
+        std::array<uint8_t, 7>{0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}, // 'Y'
+        std::array<uint8_t, 7>{0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}, // 'Z'
+        std::array<uint8_t, 7>{0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E}, // '['
+        std::array<uint8_t, 7>{0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00}, // '\'
+        std::array<uint8_t, 7>{0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E}, // ']'
+        std::array<uint8_t, 7>{0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00}, // '^'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F}, // '_'
+        std::array<uint8_t, 7>{0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00}, // '`'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F}, // 'a'
+        std::array<uint8_t, 7>{0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E}, // 'b'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E}, // 'c'
+        std::array<uint8_t, 7>{0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F}, // 'd'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E}, // 'e'
+        std::array<uint8_t, 7>{0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08}, // 'f'
+        std::array<uint8_t, 7>{0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x0E}, // 'g'
+        std::array<uint8_t, 7>{0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11}, // 'h'
+        std::array<uint8_t, 7>{0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E}, // 'i'
+        std::array<uint8_t, 7>{0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0C}, // 'j'
+        std::array<uint8_t, 7>{0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12}, // 'k'
+        std::array<uint8_t, 7>{0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}, // 'l'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11}, // 'm'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11}, // 'n'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E}, // 'o'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x1E, 0x11, 0x1E, 0x10, 0x10}, // 'p'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x0D, 0x13, 0x0F, 0x01, 0x01}, // 'q'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10}, // 'r'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E}, // 's'
+        std::array<uint8_t, 7>{0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06}, // 't'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D}, // 'u'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04}, // 'v'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A}, // 'w'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11}, // 'x'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E}, // 'y'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F}, // 'z'
+        std::array<uint8_t, 7>{0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02}, // '{'
+        std::array<uint8_t, 7>{0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}, // '|'
+        std::array<uint8_t, 7>{0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08}, // '}'
+        std::array<uint8_t, 7>{0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00}, // '~'
+    };
+
+#ifdef PJPLOT_ENABLE_TESTS
+    // little compile-time test to ensure no glyph of the font spills into the gap between glyphs
+    consteval static auto test_font_width() -> bool {
+        for (const auto& glyph : k_font_5x7) {
+            for (const auto row : glyph) {
+                if (row >= (1 << 5)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    constexpr static bool font_width_test = test_font_width();
+    static_assert(font_width_test);
+#endif
+
+    // Every glyph of k_font_5x7 scaled up by an integer factor and precomposed in the text colour over an opaque
+    // background. The glyphs are stacked in one Mat2 as contiguous tiles that include the gap to the next glyph,
+    // so drawing a string is a row copy per glyph and nothing is rasterized per frame.
+    class GlyphAtlas {
+    public:
+        static constexpr char k_first_char = ' ';
+        static constexpr size_t k_num_glyphs = k_font_5x7.size();
+        static constexpr size_t k_font_rows = 7;
+        static constexpr size_t k_font_cols = 5;
+        static constexpr size_t k_advance = 6; ///< font columns per glyph, including the gap
+
+        GlyphAtlas() = default;
+
+        [[nodiscard]] static auto create(size_t scale, RGBA text, RGBA background) -> GlyphAtlas {
+            if (scale == 0) {
+                throw std::invalid_argument("Error: glyph scale must be at least 1");
+            }
+            GlyphAtlas res;
+            res.m_scale = scale;
+            res.m_tiles = Mat2<RGBA, DynamicSize2>(DynamicSize2(k_num_glyphs * res.glyph_rows(), res.glyph_cols()));
+            std::fill(res.m_tiles.begin(), res.m_tiles.end(), background);
+            const Rect bounds{0, 0, res.m_tiles.cols(), res.m_tiles.rows()};
+            for (size_t glyph = 0; glyph < k_num_glyphs; ++glyph) {
+                for (size_t row = 0; row < k_font_rows; ++row) {
+                    for (size_t col = 0; col < k_font_cols; ++col) {
+                        if ((k_font_5x7[glyph][row] >> (k_font_cols - 1 - col) & 1) != 0) {
+                            fill_rect(res.m_tiles.data().data(), res.m_tiles.cols(), Rect{col * scale, (glyph * k_font_rows + row) * scale, scale, scale}, text, bounds);
+                        }
+                    }
+                }
+            }
+            return res;
+        }
+
+        [[nodiscard]] auto get_scale() const noexcept -> size_t {
+            return m_scale;
+        }
+
+        // size of a glyph tile in pixels
+        [[nodiscard]] auto glyph_rows() const noexcept -> size_t {
+            return k_font_rows * m_scale;
+        }
+
+        [[nodiscard]] auto glyph_cols() const noexcept -> size_t {
+            return k_advance * m_scale;
+        }
+
+        [[nodiscard]] auto text_width(std::string_view text) const noexcept -> size_t {
+            return text.size() * glyph_cols();
+        }
+
+        // the glyph_rows() x glyph_cols() tile of ch, characters outside the font are drawn as '?'
+        [[nodiscard]] auto get_glyph(char ch) const noexcept -> const RGBA* {
+            const auto idx = static_cast<size_t>(static_cast<unsigned char>(ch)) - static_cast<size_t>(k_first_char);
+            const size_t glyph = idx < k_num_glyphs ? idx : static_cast<size_t>('?' - k_first_char);
+            return m_tiles.data().data() + glyph * glyph_rows() * glyph_cols();
+        }
+
+        // draw text with its top-left corner at pos, limited to clip, returning the region written. Indexed images
+        // take the palette the glyph colours are mapped through.
+        template <typename Pixel>
+        auto draw_text(Pixel* pixels, size_t stride, std::string_view text, Vec2<size_t> pos, Rect clip, const Palette* palette = nullptr) const noexcept -> Rect {
+            const Rect area = Rect{pos.x, pos.y, text_width(text), glyph_rows()}.intersect(clip);
+            const size_t cols = glyph_cols();
+            for (size_t x = area.x; x < area.x + area.width;) {
+                const size_t offset = (x - pos.x) % cols;
+                const size_t n = std::min(cols - offset, area.x + area.width - x);
+                const RGBA* tile = get_glyph(text[(x - pos.x) / cols]) + offset;
+                for (size_t row = area.y; row < area.y + area.height; ++row) {
+                    copy_pixels(tile + (row - pos.y) * cols, n, pixels + row * stride + x, palette);
+                }
+                x += n;
+            }
+            return area;
+        }
+
+    private:
+        Mat2<RGBA, DynamicSize2> m_tiles;
+        size_t m_scale = 0;
+    };
+
+    // Keeps the most recently used glyph atlases keyed by scale and colours, so every grid layer drawing text in
+    // the same style shares one atlas. Lookups are thread-safe, get_shared() is the cache the grid layers use.
+    class GlyphCache {
+    public:
+        static constexpr size_t k_capacity = 8;
+
+        GlyphCache() = default;
+
+        GlyphCache(const GlyphCache&) = delete;
+        auto operator=(const GlyphCache&) -> GlyphCache& = delete;
+
+        [[nodiscard]] static auto get_shared() -> GlyphCache& {
+            static GlyphCache cache;
+            return cache;
+        }
+
+        [[nodiscard]] auto get(size_t scale, RGBA text, RGBA background) -> std::shared_ptr<const GlyphAtlas> {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_clock;
+            Entry* oldest = &m_entries[0];
+            for (auto& entry : m_entries) {
+                if (entry.m_atlas && entry.m_scale == scale && entry.m_text == text && entry.m_background == background) {
+                    entry.m_last_use = m_clock;
+                    return entry.m_atlas;
+                }
+                oldest = entry.m_last_use < oldest->m_last_use ? &entry : oldest;
+            }
+            *oldest = Entry{scale, text, background, std::make_shared<const GlyphAtlas>(GlyphAtlas::create(scale, text, background)), m_clock};
+            return oldest->m_atlas;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_entries = {};
+        }
+
+    private:
+        struct Entry {
+            size_t m_scale = 0;
+            RGBA m_text{};
+            RGBA m_background{};
+            std::shared_ptr<const GlyphAtlas> m_atlas;
+            uint64_t m_last_use = 0;
+        };
+
+        std::mutex m_mutex;
+        std::array<Entry, k_capacity> m_entries{};
+        uint64_t m_clock = 0;
+    };
+
+    // longest tick label format_tick_label() writes
+    inline constexpr size_t k_max_tick_label = 16;
+
+    // Format a tick value into buf without allocating, with at most 4 significant digits in the shorter of fixed and
+    // scientific notation. Values within a billionth of the tick step from zero print as 0 rather than as rounding noise.
+    [[nodiscard]] inline auto format_tick_label(std::array<char, k_max_tick_label>& buf, double value, double step) noexcept -> std::string_view {
+        if (std::abs(value) < std::abs(step) * 1e-9) {
+            value = 0.0;
+        }
+        const auto res = std::to_chars(buf.data(), buf.data() + buf.size(), value, std::chars_format::general, 4);
+        if (res.ec != std::errc()) {
+            return {};
+        }
+        return std::string_view(buf.data(), static_cast<size_t>(res.ptr - buf.data()));
+    }
+
+    // a class to store the image elements for the grid, including lines, labels and ticks
+    // each element has a pair of x and y coordinates (representing the top-left corner), and a Mat2 of RGBA values
+    // the purpose is to quickly draw the grid on the image without having to iterate over the entire image
+    // can support either dynamic memory or static memory for each of the grid elements depending on user requirements
+    //
+    // The axes, ticks, labels and title live in a border of GridOptions::get_border_pixels() around the plot area,
+    // gridlines are drawn inside it behind the series. Everything is rasterized once by create() and each frame
+    // only fills the gridline/axis rectangles and copies the element tiles, clipped to the rows being drawn.
+    template <Size2 TitleSize, Size2 LabelSize, Size2 TickSize>
+    class GridData {
+    public:
+        static constexpr size_t k_max_num_labels = 2;
+        static constexpr size_t k_max_num_ticks = 20;
+        static constexpr size_t k_num_ticks_per_axis = 5;
+        static constexpr size_t k_max_num_lines = 4 * k_num_ticks_per_axis;
+        static constexpr size_t k_border_per_text_scale = 40; ///< border pixels per unit of text scale
+
+        struct GridLine {
+            Rect m_rect;
+            RGBA m_colour;
+        };
+
+        constexpr GridData() = default;
+
+        // lay out and rasterize the grid for a rows x cols image, an empty border gives an empty grid and a plot
+        // area covering the whole image
+        [[nodiscard]] static auto create(const GridOptions& grid, const AppearanceOptions& appearance, size_t rows, size_t cols) -> GridData {
+            GridData res;
+            res.m_rows = rows;
+            res.m_cols = cols;
+            const size_t border = grid.get_border_pixels();
+            if (border == 0 || 2 * border >= rows || 2 * border >= cols) {
+                res.m_plot_area = Rect{0, 0, cols, rows};
+                return res;
+            }
+            const Rect plot{border, border, cols - 2 * border, rows - 2 * border};
+            res.m_plot_area = plot;
+
+            const auto background = to_rgba(appearance.get_background_colour());
+            const auto text = to_rgba(appearance.get_text_colour());
+            const auto major = mix_rgba(background, text, 0.25);
+            const auto minor = mix_rgba(background, text, 0.1);
+            const size_t half_border = std::max<size_t>(border / 2, 1);
+            const size_t tick_length = std::min(half_border, std::max<size_t>(border / 8, 2));
+            // text is drawn once the border fits the tick labels and an axis label below each other
+            const size_t text_scale = std::max<size_t>(border / k_border_per_text_scale, 1);
+            if (border >= 3 * GlyphAtlas::k_font_rows * text_scale) {
+                res.m_atlas = GlyphCache::get_shared().get(text_scale, text, background);
+            }
+            // axis labels take a text line plus padding, or half the border without text
+            const size_t label_size = res.m_atlas ? res.m_atlas->glyph_rows() + 2 * text_scale : half_border;
+
+            for (size_t tick = 0; tick < k_num_ticks_per_axis; ++tick) {
+                const size_t x = plot.x + tick * (plot.width - 1) / (k_num_ticks_per_axis - 1);
+                const size_t y = plot.y + tick * (plot.height - 1) / (k_num_ticks_per_axis - 1);
+                res.m_tick_x[tick] = x;
+                res.m_tick_y[tick] = y;
+                if (grid.get_show_x()) {
+                    if (grid.get_show_major_gridlines()) {
+                        res.add_gridline(Rect{x, plot.y, 1, plot.height}, major);
+                    }
+                    if (grid.get_show_minor_gridlines() && tick + 1 < k_num_ticks_per_axis) {
+                        const size_t next = plot.x + (tick + 1) * (plot.width - 1) / (k_num_ticks_per_axis - 1);
+                        res.add_gridline(Rect{(x + next) / 2, plot.y, 1, plot.height}, minor);
+                    }
+                    // x ticks hang below the x axis
+                    auto tile = make_tile<TickSize>(half_border, std::max<size_t>(plot.width / k_num_ticks_per_axis, 1), background);
+                    fill_rect(tile.data().data(), tile.cols(), Rect{tile.cols() / 2, 0, 1, tick_length}, text, Rect{0, 0, tile.cols(), tile.rows()});
+                    res.add_tick(std::move(tile), x, plot.y + plot.height + 1, true);
+                }
+                if (grid.get_show_y()) {
+                    if (grid.get_show_major_gridlines()) {
+                        res.add_gridline(Rect{plot.x, y, plot.width, 1}, major);
+                    }
+                    if (grid.get_show_minor_gridlines() && tick + 1 < k_num_ticks_per_axis) {
+                        const size_t next = plot.y + (tick + 1) * (plot.height - 1) / (k_num_ticks_per_axis - 1);
+                        res.add_gridline(Rect{plot.x, (y + next) / 2, plot.width, 1}, minor);
+                    }
+                    // y ticks stick out to the left of the y axis
+                    auto tile = make_tile<TickSize>(std::max<size_t>(plot.height / k_num_ticks_per_axis, 1), half_border, background);
+                    const size_t length = std::min(tick_length, tile.cols());
+                    fill_rect(tile.data().data(), tile.cols(), Rect{tile.cols() - length, tile.rows() / 2, length, 1}, text, Rect{0, 0, tile.cols(), tile.rows()});
+                    res.add_tick(std::move(tile), plot.x - 1, y, false);
+                }
+            }
+            if (grid.get_show_x()) {
+                res.m_axes[res.m_num_axes++] = GridLine{Rect{plot.x - 1, plot.y + plot.height, plot.width + 1, 1}, text};
+            }
+            if (grid.get_show_y()) {
+                res.m_axes[res.m_num_axes++] = GridLine{Rect{plot.x - 1, plot.y, 1, plot.height + 1}, text};
+            }
+            if (grid.get_show_x_labels()) {
+                auto tile = make_tile<LabelSize>(label_size, plot.width, background);
+                res.draw_centred(tile, grid.get_x_label(), false);
+                res.m_labels[res.m_num_labels++] = GridElement<Mat2<RGBA, LabelSize>>{std::move(tile), Vec2<size_t>{plot.x, rows - label_size}};
+            }
+            if (grid.get_show_y_labels()) {
+                auto tile = make_tile<LabelSize>(plot.height, label_size, background);
+                res.draw_centred(tile, grid.get_y_label(), true);
+                res.m_labels[res.m_num_labels++] = GridElement<Mat2<RGBA, LabelSize>>{std::move(tile), Vec2<size_t>{0, plot.y}};
+            }
+            auto title = make_tile<TitleSize>(half_border, plot.width, background);
+            res.draw_centred(title, grid.get_title(), false);
+            res.m_title = GridElement<Mat2<RGBA, TitleSize>>{std::move(title), Vec2<size_t>{plot.x, 0}};
+            res.m_has_title = true;
+
+            // tick labels hang below the x tick marks and end left of the y tick marks, clear of the axis labels
+            if (res.m_atlas) {
+                const size_t gap = tick_length + text_scale + 1;
+                const size_t x_label_top = grid.get_show_x_labels() ? rows - label_size : rows;
+                const size_t y_label_right = grid.get_show_y_labels() ? label_size : 0;
+                res.m_x_tick_label_area = grid.get_show_x_labels() && grid.get_show_x() ? Rect{0, plot.y + plot.height + gap, cols, res.m_atlas->glyph_rows()}.intersect(Rect{0, 0, cols, x_label_top}) : Rect{};
+                res.m_y_tick_label_area = grid.get_show_y_labels() && grid.get_show_y() && plot.x > y_label_right + gap ? Rect{y_label_right, 0, plot.x - gap - y_label_right, rows} : Rect{};
+            }
+            return res;
+        }
+
+        // size of the image the grid was laid out for
+        [[nodiscard]] constexpr auto rows() const noexcept -> size_t {
+            return m_rows;
+        }
+
+        [[nodiscard]] constexpr auto cols() const noexcept -> size_t {
+            return m_cols;
+        }
+
+        // region of the image left for the series
+        [[nodiscard]] constexpr auto get_plot_area() const noexcept -> Rect {
+            return m_plot_area;
+        }
+
+        [[nodiscard]] constexpr auto is_empty() const noexcept -> bool {
+            return m_num_gridlines == 0 && m_num_axes == 0 && m_num_ticks == 0 && m_num_labels == 0 && !m_has_title;
+        }
+
+        // rectangles and colours of the gridlines drawn behind the series
+        [[nodiscard]] constexpr auto get_gridlines() const noexcept -> std::span<const GridLine> {
+            return std::span<const GridLine>(m_gridlines.data(), m_num_gridlines);
+        }
+
+        // draw the gridlines that sit behind the series, limited to the image region clip.
+        // The pixels written are reported to damage when given. Indexed images map colours through palette.
+        template <typename Pixel>
+        constexpr void draw_underlay(Pixel* pixels, size_t stride, Rect clip, DamageRegion* damage = nullptr, const Palette* palette = nullptr) const noexcept {
+            for (size_t i = 0; i < m_num_gridlines; ++i) {
+                fill_rect(pixels, stride, m_gridlines[i].m_rect, to_pixel<Pixel>(m_gridlines[i].m_colour, palette), clip);
+                report(damage, m_gridlines[i].m_rect.intersect(clip));
+            }
+        }
+
+        // draw the axes, ticks, labels and title on top of the series, limited to the image region clip
+        template <typename Pixel>
+        constexpr void draw_overlay(Pixel* pixels, size_t stride, Rect clip, DamageRegion* damage = nullptr, const Palette* palette = nullptr) const noexcept {
+            for (size_t i = 0; i < m_num_axes; ++i) {
+                fill_rect(pixels, stride, m_axes[i].m_rect, to_pixel<Pixel>(m_axes[i].m_colour, palette), clip);
+                report(damage, m_axes[i].m_rect.intersect(clip));
+            }
+            for (size_t i = 0; i < m_num_ticks; ++i) {
+                report(damage, blit(m_ticks[i], pixels, stride, clip, palette));
+            }
+            for (size_t i = 0; i < m_num_labels; ++i) {
+                report(damage, blit(m_labels[i], pixels, stride, clip, palette));
+            }
+            if (m_has_title) {
+                report(damage, blit(m_title, pixels, stride, clip, palette));
+            }
+        }
+
+        // Draw the values of the ticks for a horizontal axis spanning x_range and a value axis spanning y_range,
+        // limited to clip. Labels are formatted into stack buffers and copied from the glyph atlas, so this is
+        // cheap enough to redraw every frame; an empty range draws no labels for its axis.
+        template <typename Pixel>
+        constexpr void draw_tick_labels(Pixel* pixels, size_t stride, Rect clip, ValueRange x_range, ValueRange y_range, DamageRegion* damage = nullptr, const Palette* palette = nullptr) const noexcept {
+            if (std::is_constant_evaluated() || !m_atlas) {
+                return;
+            }
+            std::array<char, k_max_tick_label> buf{};
+            const size_t text_rows = m_atlas->glyph_rows();
+            if (!x_range.is_empty() && !m_x_tick_label_area.is_empty()) {
+                const Rect area = m_x_tick_label_area.intersect(clip);
+                const auto [first, step] = get_tick_values(x_range, false);
+                for (size_t tick = 0; tick < k_num_ticks_per_axis; ++tick) {
+                    const auto label = format_tick_label(buf, first + static_cast<double>(tick) * step, step);
+                    const size_t width = m_atlas->text_width(label);
+                    const size_t x = m_tick_x[tick] - std::min(m_tick_x[tick], width / 2);
+                    report(damage, m_atlas->draw_text(pixels, stride, label, Vec2<size_t>{x, m_x_tick_label_area.y}, area, palette));
+                }
+            }
+            if (!y_range.is_empty() && !m_y_tick_label_area.is_empty()) {
+                const Rect area = m_y_tick_label_area.intersect(clip);
+                const size_t right = m_y_tick_label_area.x + m_y_tick_label_area.width;
+                const auto [first, step] = get_tick_values(y_range, true);
+                for (size_t tick = 0; tick < k_num_ticks_per_axis; ++tick) {
+                    const auto label = format_tick_label(buf, first + static_cast<double>(tick) * step, step);
+                    const size_t x = right - std::min(right, m_atlas->text_width(label));
+                    const size_t y = m_tick_y[tick] - std::min(m_tick_y[tick], text_rows / 2);
+                    report(damage, m_atlas->draw_text(pixels, stride, label, Vec2<size_t>{x, y}, area, palette));
+                }
+            }
+        }
+
+    private:
+        template <typename T>
+        struct GridElement {
+            T m_element;
+            Vec2<size_t> m_offset;
+        };
+
+        // a tile of the requested size for dynamic element sizes, static element sizes keep their own size
+        template <Size2 ElementSize>
+        [[nodiscard]] static auto make_tile(size_t rows, size_t cols, RGBA background) -> Mat2<RGBA, ElementSize> {
+            Mat2<RGBA, ElementSize> tile = [rows, cols]() {
+                if constexpr (ElementSize::is_static_size::value) {
+                    return Mat2<RGBA, ElementSize>(ElementSize{});
+                } else {
+                    return Mat2<RGBA, ElementSize>(ElementSize(rows, cols));
+                }
+            }();
+            std::fill(tile.begin(), tile.end(), background);
+            return tile;
+        }
+
+        // value of the first tick and the step between ticks, flat ranges padded as by ValueTransform::create().
+        // The y ticks run down the image, from the top of the value axis.
+        [[nodiscard]] constexpr static auto get_tick_values(ValueRange range, bool is_value_axis) noexcept -> std::pair<double, double> {
+            if (range.m_min == range.m_max) {
+                range.m_min -= 0.5;
+                range.m_max += 0.5;
+            }
+            const double step = (range.m_max - range.m_min) / static_cast<double>(k_num_ticks_per_axis - 1);
+            return is_value_axis ? std::pair{range.m_max, -step} : std::pair{range.m_min, step};
+        }
+
+        // draw text centred in a tile, reading bottom to top when rotated, clipped to the tile
+        template <Size2 ElementSize>
+        void draw_centred(Mat2<RGBA, ElementSize>& tile, std::string_view text, bool is_rotated) const {
+            if (!m_atlas || text.empty()) {
+                return;
+            }
+            const size_t text_rows = m_atlas->glyph_rows();
+            const size_t text_cols = m_atlas->text_width(text);
+            if (!is_rotated) {
+                const Vec2<size_t> pos{(tile.cols() - std::min(tile.cols(), text_cols)) / 2, (tile.rows() - std::min(tile.rows(), text_rows)) / 2};
+                m_atlas->draw_text(tile.data().data(), tile.cols(), text, pos, Rect{0, 0, tile.cols(), tile.rows()});
+                return;
+            }
+            // draw the line of text upright, then turn it a quarter anticlockwise into the tile
+            Mat2<RGBA, DynamicSize2> line(DynamicSize2(text_rows, text_cols));
+            m_atlas->draw_text(line.data().data(), text_cols, text, Vec2<size_t>{0, 0}, Rect{0, 0, text_cols, text_rows});
+            const size_t row_offset = (tile.rows() - std::min(tile.rows(), text_cols)) / 2;
+            const size_t col_offset = (tile.cols() - std::min(tile.cols(), text_rows)) / 2;
+            const auto* src = line.data().data();
+            auto* dst = tile.data().data();
+            for (size_t row = 0; row < std::min(tile.rows(), text_cols); ++row) {
+                for (size_t col = 0; col < std::min(tile.cols(), text_rows); ++col) {
+                    dst[(row_offset + row) * tile.cols() + col_offset + col] = src[col * text_cols + text_cols - 1 - row];
+                }
+            }
+        }
+
+        void add_gridline(Rect rect, RGBA colour) {
+            if (m_num_gridlines < k_max_num_lines) {
+                m_gridlines[m_num_gridlines++] = GridLine{rect, colour};
+            }
+        }
+
+        // place a tick tile so that its mark lines up with the tick position (x, y)
+        void add_tick(Mat2<RGBA, TickSize>&& tile, size_t x, size_t y, bool is_x_tick) {
+            if (m_num_ticks == k_max_num_ticks) {
+                return;
+            }
+            const Vec2<size_t> offset = is_x_tick
+                ? Vec2<size_t>{x - std::min(x, tile.cols() / 2), y}
+                : Vec2<size_t>{x - std::min(x, tile.cols()), y - std::min(y, tile.rows() / 2)};
+            m_ticks[m_num_ticks++] = GridElement<Mat2<RGBA, TickSize>>{std::move(tile), offset};
+        }
+
+        constexpr static void report(DamageRegion* damage, Rect rect) noexcept {
+            if (damage != nullptr) {
+                damage->add(rect);
+            }
+        }
+
+        // copy an element into the image, clipped to the image and to clip, returning the region written
+        template <typename T, typename Pixel>
+        constexpr auto blit(const GridElement<T>& element, Pixel* pixels, size_t stride, Rect clip, const Palette* palette) const noexcept -> Rect {
+            const auto& tile = element.m_element;
+            const Rect area = Rect{element.m_offset.x, element.m_offset.y, tile.cols(), tile.rows()}.intersect(clip).intersect(Rect{0, 0, m_cols, m_rows});
+            const RGBA* src = tile.data().data();
+            for (size_t row = area.y; row < area.y + area.height; ++row) {
+                const RGBA* src_row = src + (row - element.m_offset.y) * tile.cols() + (area.x - element.m_offset.x);
+                copy_pixels(src_row, area.width, pixels + row * stride + area.x, palette);
+            }
+            return area;
+        }
+
+        GridElement<Mat2<RGBA, TitleSize>> m_title;
+        ArrayNd<GridElement<Mat2<RGBA, LabelSize>>, StaticSize1<k_max_num_labels>> m_labels;
+        ArrayNd<GridElement<Mat2<RGBA, TickSize>>, StaticSize1<k_max_num_ticks>> m_ticks;
+        std::array<GridLine, k_max_num_lines> m_gridlines{};
+        std::array<GridLine, 2> m_axes{};
+        size_t m_num_labels = 0;
+        size_t m_num_ticks = 0;
+        size_t m_num_gridlines = 0;
+        size_t m_num_axes = 0;
+        bool m_has_title = false;
+        Rect m_plot_area{};
+        size_t m_rows = 0;
+        size_t m_cols = 0;
+        std::shared_ptr<const GlyphAtlas> m_atlas; ///< nullptr when the border is too narrow for text
+        std::array<size_t, k_num_ticks_per_axis> m_tick_x{};
+        std::array<size_t, k_num_ticks_per_axis> m_tick_y{};
+        Rect m_x_tick_label_area{}; ///< the row of x tick labels, empty when they are hidden
+        Rect m_y_tick_label_area{}; ///< the columns left of the y ticks, labels are right aligned in them
+    };
+
+    // grid layout used by the chart engines, every element sized to fit the image
+    using GridLayer = GridData<DynamicSize2, DynamicSize2, DynamicSize2>;
+
+    // Keeps the most recently used grid layers keyed by options and image size, so live charts that redraw
+    // identical axes every frame rasterize them once. Lookups are thread-safe, copies start with an empty cache.
+    class GridCache {
+    public:
+        static constexpr size_t k_capacity = 4;
+
+        constexpr GridCache() = default;
+
+        GridCache(const GridCache&) {}
+
+        auto operator=(const GridCache&) -> GridCache& {
+            return *this;
+        }
+
+        [[nodiscard]] auto get(const GridOptions& grid, const AppearanceOptions& appearance, size_t rows, size_t cols) -> std::shared_ptr<const GridLayer> {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_clock;
+            Entry* oldest = &m_entries[0];
+            for (auto& entry : m_entries) {
+                if (entry.m_layer && entry.m_grid == grid && entry.m_appearance == appearance && entry.m_rows == rows && entry.m_cols == cols) {
+                    entry.m_last_use = m_clock;
+                    return entry.m_layer;
+                }
+                oldest = entry.m_last_use < oldest->m_last_use ? &entry : oldest;
+            }
+            *oldest = Entry{grid, appearance, rows, cols, std::make_shared<const GridLayer>(GridLayer::create(grid, appearance, rows, cols)), m_clock};
+            return oldest->m_layer;
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_entries = {};
+        }
+
+    private:
+        struct Entry {
+            GridOptions m_grid;
+            AppearanceOptions m_appearance;
+            size_t m_rows = 0;
+            size_t m_cols = 0;
+            std::shared_ptr<const GridLayer> m_layer;
+            uint64_t m_last_use = 0;
+        };
+
+        std::mutex m_mutex;
+        std::array<Entry, k_capacity> m_entries{};
+        uint64_t m_clock = 0;
+    };
+
+
+
+    // A small work-stealing thread pool shared by the renderers. Each worker owns a bounded task ring, parallel_for
+    // deals tasks round-robin across the rings and idle workers steal from each other. The calling thread helps
+    // with the tasks of its own batch until it is complete, never with another caller's, so nested parallel_for
+    // calls cannot deadlock and a pool without workers simply runs everything inline.
+    class ThreadPool {
+    public:
+        static constexpr size_t k_queue_capacity = 256;
+
+        explicit ThreadPool(size_t num_threads) {
+            m_workers.reserve(num_threads);
+            for (size_t i = 0; i < num_threads; ++i) {
+                m_workers.push_back(std::make_unique<Worker>());
+            }
+            for (size_t i = 0; i < num_threads; ++i) {
+                m_workers[i]->m_thread = std::thread([this, i]() { worker_loop(i); });
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+
+        // jobs still queued by submit() run before the workers are joined
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(m_sleep_mutex);
+                m_stop = true;
+            }
+            m_sleep_cv.notify_all();
+            for (auto& worker : m_workers) {
+                worker->m_thread.join();
+            }
+        }
+
+        // process-wide pool with one worker per hardware thread besides the caller, started on first use
+        [[nodiscard]] static auto get_shared() -> ThreadPool& {
+            static ThreadPool pool(std::max<size_t>(std::thread::hardware_concurrency(), 1) - 1);
+            return pool;
+        }
+
+        // number of threads taking part in a parallel_for, including the calling thread
+        [[nodiscard]] auto get_concurrency() const noexcept -> size_t {
+            return m_workers.size() + 1;
+        }
+
+        // call fn(idx) for every idx in [0, num_tasks) and block until all calls have returned,
+        // the first exception thrown by a task is rethrown here
+        template <typename Fn>
+        void parallel_for(size_t num_tasks, const Fn& fn) {
+            // tasks run by the workers draw their scratch from the arena of the frame that queued them
+            const auto arena = FrameArena::get_active();
+            if (arena.m_arena != nullptr && !m_workers.empty() && num_tasks >= 2) {
+                run_profiled(num_tasks, [&fn, arena](size_t idx) {
+                    const ArenaScope scope(arena);
+                    fn(idx);
+                });
+                return;
+            }
+            run_profiled(num_tasks, fn);
+        }
+
+        // Queue fn() to run once on a worker and return without waiting for it, e.g. a whole render started by
+        // Factory::get_plot_async. Jobs run in submission order, only on workers that have no parallel_for task to
+        // help with, and never inside another thread's wait. fn must not throw. Without workers fn runs here instead.
+        template <typename Fn>
+        void submit(Fn&& fn) {
+            if (m_workers.empty()) {
+                fn();
+                return;
+            }
+            auto job = std::make_unique<JobFor<std::decay_t<Fn>>>(std::forward<Fn>(fn));
+            {
+                std::lock_guard<std::mutex> lock(m_sleep_mutex);
+                m_jobs.push_back(job.get());
+            }
+            job.release();
+            m_sleep_cv.notify_one();
+        }
+
+    private:
+        template <typename Fn>
+        void run_profiled(size_t num_tasks, const Fn& fn) {
+#if defined(PJPLOT_ENABLE_INSTRUMENTATION)
+            // tasks run by the workers record into the frame that queued them
+            const auto frame = FrameProfiler::get_active();
+            if (frame.m_profiler != nullptr && !m_workers.empty() && num_tasks >= 2) {
+                run_batch(num_tasks, [&fn, frame](size_t idx) {
+                    const ProfileScope scope(frame);
+                    fn(idx);
+                });
+                return;
+            }
+#endif
+            run_batch(num_tasks, fn);
+        }
+
+        template <typename Fn>
+        void run_batch(size_t num_tasks, const Fn& fn) {
+            if (m_workers.empty() || num_tasks < 2) {
+                for (size_t idx = 0; idx < num_tasks; ++idx) {
+                    fn(idx);
+                }
+                return;
+            }
+            Batch batch;
+            batch.m_invoke = [](const void* ctx, size_t idx) { (*static_cast<const Fn*>(ctx))(idx); };
+            batch.m_ctx = &fn;
+            batch.m_remaining = num_tasks;
+
+            for (size_t idx = 0; idx < num_tasks; ++idx) {
+                if (!push(idx % m_workers.size(), Task{&batch, idx})) {
+                    // queue full, run the task here instead
+                    run(Task{&batch, idx});
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            }
+            m_sleep_cv.notify_all();
+
+            // Help with this batch only. The caller may hold thread scratch across the parallel_for, which a task of
+            // another caller's batch, e.g. a whole chart of a get_plots() call, would reuse underneath it.
+            Task task;
+            while (steal_from_batch(batch, task)) {
+                run(task);
+            }
+            std::unique_lock<std::mutex> lock(batch.m_mutex);
+            batch.m_done_cv.wait(lock, [&batch]() { return batch.m_remaining == 0; });
+            if (batch.m_error) {
+                std::rethrow_exception(batch.m_error);
+            }
+        }
+
+        struct Batch {
+            void (*m_invoke)(const void*, size_t) = nullptr;
+            const void* m_ctx = nullptr;
+            std::mutex m_mutex;
+            std::condition_variable m_done_cv;
+            size_t m_remaining = 0;
+            std::exception_ptr m_error;
+        };
+
+        // a job queued by submit(), deleting itself once it has run
+        struct Job {
+            void (*m_run)(Job*) noexcept = nullptr;
+        };
+
+        template <typename Fn>
+        struct JobFor : Job {
+            explicit JobFor(Fn fn) : Job{&JobFor::run_once}, m_fn(std::move(fn)) {
+
+            }
+
+            static void run_once(Job* job) noexcept {
+                auto* self = static_cast<JobFor*>(job);
+                self->m_fn();
+                delete self;
+            }
+
+            Fn m_fn;
+        };
+
+        struct Task {
+            Batch* m_batch = nullptr;
+            size_t m_idx = 0;
+        };
+
+        struct Worker {
+            std::mutex m_mutex;
+            std::array<Task, k_queue_capacity> m_tasks{};
+            size_t m_head = 0;
+            size_t m_count = 0;
+            std::thread m_thread;
+        };
+
+        [[nodiscard]] auto push(size_t worker_idx, Task task) -> bool {
+            auto& worker = *m_workers[worker_idx];
+            std::lock_guard<std::mutex> lock(worker.m_mutex);
+            if (worker.m_count == k_queue_capacity) {
+                return false;
+            }
+            worker.m_tasks[(worker.m_head + worker.m_count) % k_queue_capacity] = task;
+            ++worker.m_count;
+            m_queued.fetch_add(1, std::memory_order_release);
+            return true;
+        }
+
+        // pop the most recently pushed task of a worker's own ring
+        [[nodiscard]] auto pop_local(size_t worker_idx, Task& task) -> bool {
+            auto& worker = *m_workers[worker_idx];
+            std::lock_guard<std::mutex> lock(worker.m_mutex);
+            if (worker.m_count == 0) {
+                return false;
+            }
+            --worker.m_count;
+            task = worker.m_tasks[(worker.m_head + worker.m_count) % k_queue_capacity];
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // take the oldest task from any ring, starting the search at first_idx
+        [[nodiscard]] auto steal(size_t first_idx, Task& task) -> bool {
+            for (size_t i = 0; i < m_workers.size(); ++i) {
+                auto& worker = *m_workers[(first_idx + i) % m_workers.size()];
+                std::lock_guard<std::mutex> lock(worker.m_mutex);
+                if (worker.m_count == 0) {
+                    continue;
+                }
+                task = worker.m_tasks[worker.m_head];
+                worker.m_head = (worker.m_head + 1) % k_queue_capacity;
+                --worker.m_count;
+                m_queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        // take the oldest task of batch from any ring, closing the gap it leaves behind
+        [[nodiscard]] auto steal_from_batch(const Batch& batch, Task& task) -> bool {
+            for (auto& worker_ptr : m_workers) {
+                auto& worker = *worker_ptr;
+                std::lock_guard<std::mutex> lock(worker.m_mutex);
+                for (size_t i = 0; i < worker.m_count; ++i) {
+                    if (worker.m_tasks[(worker.m_head + i) % k_queue_capacity].m_batch != &batch) {
+                        continue;
+                    }
+                    task = worker.m_tasks[(worker.m_head + i) % k_queue_capacity];
+                    for (size_t j = i + 1; j < worker.m_count; ++j) {
+                        worker.m_tasks[(worker.m_head + j - 1) % k_queue_capacity] = worker.m_tasks[(worker.m_head + j) % k_queue_capacity];
+                    }
+                    --worker.m_count;
+                    m_queued.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static void run(Task task) noexcept {
+            Batch& batch = *task.m_batch;
+            std::exception_ptr error;
+            try {
+                batch.m_invoke(batch.m_ctx, task.m_idx);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // the batch lives on the stack of the thread waiting for it, it must not be touched after unlocking
+            std::lock_guard<std::mutex> lock(batch.m_mutex);
+            if (error && !batch.m_error) {
+                batch.m_error = error;
+            }
+            if (--batch.m_remaining == 0) {
+                batch.m_done_cv.notify_all();
+            }
+        }
+
+        void worker_loop(size_t worker_idx) {
+            for (;;) {
+                Task task;
+                if (pop_local(worker_idx, task) || steal(worker_idx + 1, task)) {
+                    run(task);
+                    continue;
+                }
+                Job* job = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(m_sleep_mutex);
+                    m_sleep_cv.wait(lock, [this]() { return m_stop || !m_jobs.empty() || m_queued.load(std::memory_order_acquire) > 0; });
+                    if (m_queued.load(std::memory_order_acquire) > 0) {
+                        continue;
+                    }
+                    if (m_jobs.empty()) {
+                        return;
+                    }
+                    job = m_jobs.front();
+                    m_jobs.pop_front();
+                }
+                job->m_run(job);
+            }
+        }
+
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::atomic<size_t> m_queued{0};
+        std::mutex m_sleep_mutex;
+        std::condition_variable m_sleep_cv;
+        std::deque<Job*> m_jobs;
+        bool m_stop = false;
+    };
+
+    // how a single plot is split across the thread pool
+    enum class ExecutionPolicy {
+        SEQUENTIAL,         ///< render on the calling thread only
+        PARALLEL_SERIES,    ///< contiguous groups of series draw into their own layer, composited in series order
+        PARALLEL_ROW_TILES, ///< each task fills the background and every series for a band of image rows
+        COUNT
+    };
+
+    [[nodiscard]] inline auto to_string(ExecutionPolicy val) -> std::string_view {
+        switch (val) {
+            case ExecutionPolicy::SEQUENTIAL:
+                return "sequential";
+            case ExecutionPolicy::PARALLEL_SERIES:
+                return "parallel series";
+            case ExecutionPolicy::PARALLEL_ROW_TILES:
+                return "parallel row tiles";
+            default:
+                throw std::invalid_argument("Error: unsupported execution policy");
+        }
+    }
+
+    class ExecutionOptions {
+    public:
+        constexpr ExecutionOptions() = default;
+
+        constexpr explicit ExecutionOptions(ExecutionPolicy policy, ThreadPool* pool = nullptr) 
+        : m_policy(policy), m_pool(pool) {
+
+        }
+
+        constexpr void set_policy(ExecutionPolicy policy) {
+            m_policy = policy;
+        }
+
+        // pool used by the parallel policies, nullptr selects ThreadPool::get_shared()
+        constexpr void set_thread_pool(ThreadPool* pool) {
+            m_pool = pool;
+        }
+
+        constexpr void set_tile_rows(size_t tile_rows) {
+            m_tile_rows = std::max<size_t>(tile_rows, 1);
+        }
+
+        // cache of series stats consulted before scanning the samples for the value range, nullptr disables it
+        constexpr void set_range_cache(RangeCache* cache) {
+            m_range_cache = cache;
+        }
+
+        [[nodiscard]] constexpr auto get_policy() const noexcept -> ExecutionPolicy {
+            return m_policy;
+        }
+
+        [[nodiscard]] auto get_thread_pool() const -> ThreadPool& {
+            return m_pool != nullptr ? *m_pool : ThreadPool::get_shared();
+        }
+
+        [[nodiscard]] constexpr auto get_tile_rows() const noexcept -> size_t {
+            return m_tile_rows;
+        }
+
+        [[nodiscard]] constexpr auto get_range_cache() const noexcept -> RangeCache* {
+            return m_range_cache;
+        }
+
+    private:
+        ExecutionPolicy m_policy = ExecutionPolicy::SEQUENTIAL;
+        ThreadPool* m_pool = nullptr;
+        size_t m_tile_rows = 64;
+        RangeCache* m_range_cache = nullptr;
+    };
+
+    // the error an AsyncPlot completes with when its stop token was triggered before the stage producing it started
+    class PlotCancelledException : public std::exception {
+    public:
+        const char* what() const noexcept override {
+            return "Error: the plot was cancelled";
+        }
+    };
+
+    // The result of Factory::get_plot_async, produced by a job on a thread pool. It can be waited on like a future,
+    // handed on as a std::future, or co_awaited, resuming the coroutine on the pool thread that completed the job.
+    // then() queues a further stage, e.g. encoding the image, as a job of its own, so the worker that finished this
+    // render picks up the next chart's while another worker encodes this one. Stages that have not started when the
+    // stop token is triggered, say because the client disconnected, complete with PlotCancelledException.
+    template <typename T>
+    class AsyncPlot {
+    public:
+        AsyncPlot() = default;
+
+        [[nodiscard]] auto valid() const noexcept -> bool {
+            return m_state != nullptr && m_state->m_future.valid();
+        }
+
+        [[nodiscard]] auto is_ready() const -> bool {
+            check_valid();
+            std::lock_guard<std::mutex> lock(m_state->m_mutex);
+            return m_state->m_is_done;
+        }
+
+        void wait() const {
+            check_valid();
+            m_state->m_future.wait();
+        }
+
+        // block until the result is ready and take it, rethrowing the error of a failed or cancelled stage
+        [[nodiscard]] auto get() -> T {
+            check_valid();
+            return m_state->m_future.get();
+        }
+
+        // the result as a plain std::future, after which this plot is no longer valid
+        [[nodiscard]] auto get_future() -> std::future<T> {
+            check_valid();
+            return std::move(m_state->m_future);
+        }
+
+        // Queue fn(result) on the same pool once the result is ready. The returned plot holds what fn returns, or the
+        // error of this stage, and shares its stop token.
+        template <typename Fn>
+            requires std::invocable<Fn&, T> && (!std::is_void_v<std::invoke_result_t<Fn&, T>>)
+        [[nodiscard]] auto then(Fn fn) && -> AsyncPlot<std::invoke_result_t<Fn&, T>> {
+            using Result = std::invoke_result_t<Fn&, T>;
+            check_valid();
+            auto state = std::move(m_state);
+            auto next = std::make_shared<typename AsyncPlot<Result>::State>(*state->m_pool, state->m_stop);
+            auto job = [state, next, fn = std::make_shared<Fn>(std::move(fn))]() noexcept {
+#if defined(PJPLOT_ENABLE_INSTRUMENTATION)
+                // the stage records into the frame of the render it follows
+                const ProfileScope scope(state->m_frame);
+                next->m_frame = state->m_frame;
+#endif
+                next->complete([&]() { return (*fn)(state->m_future.get()); });
+            };
+            state->on_done([pool = state->m_pool, job = std::move(job)]() { pool->submit(job); });
+            return AsyncPlot<Result>(std::move(next));
+        }
+
+        [[nodiscard]] auto await_ready() const -> bool {
+            return is_ready();
+        }
+
+        // stay suspended until the job completing the result resumes handle, unless the result arrived meanwhile
+        [[nodiscard]] auto await_suspend(std::coroutine_handle<> handle) -> bool {
+            check_valid();
+            return m_state->try_set_continuation([handle]() { handle.resume(); });
+        }
+
+        [[nodiscard]] auto await_resume() -> T {
+            return get();
+        }
+
+    private:
+        template <typename> friend class AsyncPlot;
+        friend class Factory;
+
+        struct State {
+            State(ThreadPool& pool, std::stop_token stop)
+            : m_pool(&pool), m_stop(std::move(stop)), m_future(m_promise.get_future()) {
+
+            }
+
+            // publish make() as the result, or the error it or a triggered stop token raises, then run the continuation
+            template <typename Make>
+            void complete(const Make& make) noexcept {
+                try {
+                    if (m_stop.stop_requested()) {
+                        throw PlotCancelledException();
+                    }
+                    m_promise.set_value(make());
+                } catch (...) {
+                    m_promise.set_exception(std::current_exception());
+                }
+                std::function<void()> continuation;
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_is_done = true;
+                    continuation = std::move(m_continuation);
+                }
+                if (continuation) {
+                    continuation();
+                }
+            }
+
+            // store fn to be run by complete(), false when the result is already there and fn was not stored
+            [[nodiscard]] auto try_set_continuation(std::function<void()> fn) -> bool {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_is_done) {
+                    return false;
+                }
+                if (m_continuation) {
+                    throw std::invalid_argument("Error: an async plot can only be awaited or continued once");
+                }
+                m_continuation = std::move(fn);
+                return true;
+            }
+
+            // run fn once the result is ready, here if it already is
+            void on_done(std::function<void()> fn) {
+                if (!try_set_continuation(fn)) {
+                    fn();
+                }
+            }
+
+            ThreadPool* m_pool;
+            std::stop_token m_stop;
+            std::promise<T> m_promise;
+            std::future<T> m_future;
+            std::mutex m_mutex;
+            std::function<void()> m_continuation;
+            bool m_is_done = false;
+#if defined(PJPLOT_ENABLE_INSTRUMENTATION)
+            FrameProfiler::ActiveFrame m_frame{};
+#endif
+        };
+
+        explicit AsyncPlot(std::shared_ptr<State> state) noexcept
+        : m_state(std::move(state)) {
+
+        }
+
+        void check_valid() const {
+            if (!valid()) {
+                throw std::invalid_argument("Error: the async plot has no result, it was moved from or already taken");
+            }
+        }
+
+        std::shared_ptr<State> m_state;
+    };
+
+    // per-thread scratch storage reused across calls, so steady-state rendering does not allocate.
+    // Tag distinguishes buffers of the same element type that are in use at the same time. Inside a frame bound to
+    // a FrameArena the buffer comes from the arena and is reused until the arena is reset, otherwise it is the
+    // thread's own and lives as long as the thread.
+    template <typename T, typename Tag = T>
+    [[nodiscard]] inline auto get_thread_scratch(size_t n) -> std::span<T> {
+        FrameArena* arena = FrameArena::get_active().m_arena;
+        if (arena != nullptr) {
+            struct ArenaBuffer {
+                T* m_data = nullptr;
+                size_t m_size = 0;
+                uint64_t m_generation = 0;
+            };
+            thread_local ArenaBuffer arena_buffer;
+            if (arena_buffer.m_generation != arena->get_generation() || arena_buffer.m_size < n) {
+                arena_buffer = ArenaBuffer{arena->allocate<T>(n).data(), n, arena->get_generation()};
+            }
+            return std::span<T>(arena_buffer.m_data, n);
+        }
+        thread_local std::vector<T> buffer;
+        if (buffer.size() < n) {
+            PJPLOT_PROFILE_ALLOCATION(n * sizeof(T));
+            buffer.resize(n);
+        }
+        return std::span<T>(buffer.data(), n);
+    }
+
+    // call fn(idx) for idx in [0, num_tasks), on the calling thread only for the sequential policy
+    template <typename Fn>
+    void for_each_task(const ExecutionOptions& execution, size_t num_tasks, const Fn& fn) {
+        if (execution.get_policy() == ExecutionPolicy::SEQUENTIAL) {
+            for (size_t idx = 0; idx < num_tasks; ++idx) {
+                fn(idx);
+            }
+        } else {
+            execution.get_thread_pool().parallel_for(num_tasks, fn);
+        }
+    }
+
+    // An image being drawn by one of the chart engines, the background colour and the grid layer drawn with it.
+    // Pixel is RGBA, or uint8_t for an IndexedImg2 whose palette maps every colour drawn to its index.
+    template <typename Pixel>
+    struct BasicRenderFrame {
+        Pixel* m_pixels = nullptr;
+        size_t m_rows = 0;
+        size_t m_cols = 0;
+        Rect m_plot_area{};               ///< region the series are confined to
+        Pixel m_background{};
+        const GridLayer* m_grid = nullptr; ///< optional, nullptr draws no grid
+        DamageRegion* m_damage = nullptr;  ///< optional, receives every region drawn through the frame
+        ValueRange m_value_range{};        ///< fixed value axis, empty to fit the data; the engines set it to the axis drawn
+        LineMode m_line_mode = LineMode::ALIASED;
+        ValueRange m_x_range{};            ///< horizontal axis labelled by the overlay, empty for no x tick labels
+        const Palette* m_palette = nullptr; ///< required for indexed frames, unused for RGBA
+
+        [[nodiscard]] constexpr static auto create(Pixel* pixels, size_t rows, size_t cols, const AppearanceOptions& appearance, const GridLayer* grid, DamageRegion* damage = nullptr, const Palette* palette = nullptr) -> BasicRenderFrame {
+            if (grid != nullptr && (grid->rows() != rows || grid->cols() != cols)) {
+                throw std::invalid_argument("Error: grid layer was created for a different image size");
+            }
+            if (!std::is_same_v<Pixel, RGBA> && palette == nullptr) {
+                throw std::invalid_argument("Error: indexed frames require a palette");
+            }
+            const Rect plot = grid != nullptr ? grid->get_plot_area() : Rect{0, 0, cols, rows};
+            const auto background = PjPlot::to_pixel<Pixel>(to_rgba(appearance.get_background_colour()), palette);
+            return BasicRenderFrame{pixels, rows, cols, plot, background, grid, damage, appearance.get_value_range(), appearance.get_line_mode(), ValueRange{}, palette};
+        }
+
+        // the pixel value of colour in this frame
+        [[nodiscard]] constexpr auto to_pixel(RGBA colour) const noexcept -> Pixel {
+            return PjPlot::to_pixel<Pixel>(colour, m_palette);
+        }
+
+        // record a region drawn outside of the frame helpers, e.g. by a chart engine
+        constexpr void report(Rect rect) const noexcept {
+            if (m_damage != nullptr) {
+                m_damage->add(rect.intersect(Rect{0, 0, m_cols, m_rows}));
+            }
+        }
+
+        // top-left pixel of the plot area
+        [[nodiscard]] constexpr auto plot_origin() const noexcept -> Pixel* {
+            return m_pixels + m_plot_area.y * m_cols + m_plot_area.x;
+        }
+
+        // fill the background and the gridlines behind the series for image rows [row_begin, row_end)
+        constexpr void draw_underlay(size_t row_begin, size_t row_end) const noexcept {
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::UNDERLAY);
+            PJPLOT_PROFILE_BYTES(timer, (row_end - row_begin) * m_cols * sizeof(Pixel));
+            std::fill(m_pixels + row_begin * m_cols, m_pixels + row_end * m_cols, m_background);
+            report(Rect{0, row_begin, m_cols, row_end - row_begin});
+            if (m_grid != nullptr) {
+                m_grid->draw_underlay(m_pixels, m_cols, Rect{0, row_begin, m_cols, row_end - row_begin}, nullptr, m_palette);
+            }
+        }
+
+        // fill the background and the gridlines behind the series inside clip only
+        constexpr void draw_underlay(Rect clip) const noexcept {
+            report(clip);
+            draw_underlay(m_pixels, m_cols, clip);
+        }
+
+        // As above, into pixels that address the image in rows of stride pixels instead of the frame's own, e.g. a
+        // tile buffer offset back to the image origin so that only the pixels inside clip are real.
+        constexpr void draw_underlay(Pixel* pixels, size_t stride, Rect clip) const noexcept {
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::UNDERLAY);
+            PJPLOT_PROFILE_BYTES(timer, clip.width * clip.height * sizeof(Pixel));
+            fill_rect(pixels, stride, clip, m_background, Rect{0, 0, m_cols, m_rows});
+            if (m_grid != nullptr) {
+                m_grid->draw_underlay(pixels, stride, clip, nullptr, m_palette);
+            }
+        }
+
+        // draw the axes, ticks, tick labels, axis labels and title over the series for image rows [row_begin, row_end)
+        constexpr void draw_overlay(size_t row_begin, size_t row_end) const noexcept {
+            draw_overlay(m_pixels, m_cols, Rect{0, row_begin, m_cols, row_end - row_begin});
+        }
+
+        // draw the overlay inside clip only, into pixels addressing the image as for draw_underlay() above
+        constexpr void draw_overlay(Pixel* pixels, size_t stride, Rect clip) const noexcept {
+            if (m_grid != nullptr) {
+                PJPLOT_PROFILE_STAGE(timer, RenderStage::OVERLAY);
+                m_grid->draw_overlay(pixels, stride, clip, m_damage, m_palette);
+                m_grid->draw_tick_labels(pixels, stride, clip, m_x_range, m_value_range, m_damage, m_palette);
+            }
+        }
+    };
+
+    using RenderFrame = BasicRenderFrame<RGBA>;
+    using IndexedRenderFrame = BasicRenderFrame<uint8_t>;
+
+    // maps a data value onto an image row, with the value axis pointing up the image
+    class ValueTransform {
+    public:
+        constexpr ValueTransform() = default;
+
+        [[nodiscard]] constexpr static auto create(ValueRange range, size_t rows) noexcept -> ValueTransform {
+            if (range.m_min == range.m_max) {
+                // flat series are drawn through the middle of the plot
+                range.m_min -= 0.5;
+                range.m_max += 0.5;
+            }
+            const auto max_row = static_cast<double>(rows - 1);
+            const double scale = max_row / (range.m_max - range.m_min);
+            return ValueTransform(scale, max_row + range.m_min * scale, static_cast<int32_t>(rows - 1));
+        }
+
+        [[nodiscard]] constexpr auto to_row(double val) const noexcept -> int32_t {
+            const double row = m_offset - val * m_scale;
+            if (!(row > 0.0)) {
+                return 0;
+            }
+            if (row >= static_cast<double>(m_max_row)) {
+                return m_max_row;
+            }
+            return static_cast<int32_t>(row + 0.5);
+        }
+
+        // the fractional row of val, clamped to the plot, for drawing with sub-pixel precision
+        [[nodiscard]] constexpr auto to_row_exact(double val) const noexcept -> double {
+            return std::clamp(m_offset - val * m_scale, 0.0, static_cast<double>(m_max_row));
+        }
+
+        // for a transform created over a number of columns, maps a value onto a column with the axis pointing right
+        [[nodiscard]] constexpr auto to_col(double val) const noexcept -> int32_t {
+            return m_max_row - to_row(val);
+        }
+
+    private:
+        constexpr ValueTransform(double scale, double offset, int32_t max_row)
+        : m_scale(scale), m_offset(offset), m_max_row(max_row) {}
+
+        double m_scale = 0.0;
+        double m_offset = 0.0;
+        int32_t m_max_row = 0;
+    };
+
+    // summary of the samples that fall into one output column, produced by the min/max decimation stage
+    template <typename T>
+    struct ColumnSummary {
+        T m_min{};
+        T m_max{};
+        T m_first{};
+        T m_last{};
+        size_t m_count = 0; ///< number of finite samples in the column
+
+        [[nodiscard]] constexpr auto is_empty() const noexcept -> bool {
+            return m_count == 0;
+        }
+    };
+
+    // Reduces a series to one ColumnSummary per output column in a single streaming pass, so drawing cost depends on
+    // the output width rather than the series length. Column c owns the samples nearest to it, i.e. those in
+    // [(c - 0.5) * step, (c + 0.5) * step] with step = (len - 1) / (out_cols - 1), matching the line rasterizer.
+    class MinMaxDecimator {
+    public:
+        // index of the first sample owned by column col, column col owns [column_begin(col), column_begin(col + 1))
+        [[nodiscard]] constexpr static auto column_begin(size_t col, size_t len, size_t out_cols) noexcept -> size_t {
+            if (col == 0) {
+                return 0;
+            }
+            if (col >= out_cols || len < 2) {
+                return len;
+            }
+            // ceil((2 * col - 1) * (len - 1) / (2 * (out_cols - 1))) in integer arithmetic
+            const size_t num = (2 * col - 1) * (len - 1);
+            const size_t den = 2 * (out_cols - 1);
+            return (num + den - 1) / den;
+        }
+
+        // decimate columns [col_begin, col_begin + n) of an out_cols wide output into out
+        template <typename Series, typename T>
+        constexpr static void decimate(const Series& series, size_t out_cols, size_t col_begin, size_t n, ColumnSummary<T>* out) noexcept {
+            const size_t len = series.size();
+            size_t k = column_begin(col_begin, len, out_cols);
+            for (size_t i = 0; i < n; ++i) {
+                const size_t k_end = column_begin(col_begin + i + 1, len, out_cols);
+                ColumnSummary<T> summary;
+                for (; k < k_end; ++k) {
+                    const T val = series[k];
+                    if (!is_finite_sample(val)) {
+                        continue;
+                    }
+                    if (summary.m_count == 0) {
+                        summary.m_first = val;
+                        summary.m_min = val;
+                        summary.m_max = val;
+                    }
+                    summary.m_last = val;
+                    summary.m_min = val < summary.m_min ? val : summary.m_min;
+                    summary.m_max = val > summary.m_max ? val : summary.m_max;
+                    ++summary.m_count;
+                }
+                out[i] = summary;
+            }
+        }
+
+        // ArrayNd transform for a single series
+        template <typename T, Size1 InSize, bool IsOwning, Size1 OutSize>
+        [[nodiscard]] constexpr static auto apply(const ArrayNd<T, InSize, IsOwning>& input, OutSize out_size) -> ArrayNd<ColumnSummary<std::remove_const_t<T>>, OutSize> {
+            ArrayNd<ColumnSummary<std::remove_const_t<T>>, OutSize> res(out_size);
+            decimate(input.data(), out_size.length(), 0, out_size.length(), res.data().data());
+            return res;
+        }
+
+        // ArrayNd transform for a (num_series x series_length) matrix, producing a (num_series x out_cols) matrix
+        template <typename T, Size2 InSize, bool IsOwning, Size2 OutSize>
+        [[nodiscard]] constexpr static auto apply(const ArrayNd<T, InSize, IsOwning>& input, OutSize out_size) -> Mat2<ColumnSummary<std::remove_const_t<T>>, OutSize> {
+            const auto in_size = input.shape();
+            if (in_size.rows() != out_size.rows()) {
+                throw std::invalid_argument("Error: decimation must preserve the number of series");
+            }
+            Mat2<ColumnSummary<std::remove_const_t<T>>, OutSize> res(out_size);
+            for (size_t row = 0; row < in_size.rows(); ++row) {
+                decimate(input[row].data(), out_size.cols(), 0, out_size.cols(), res[row].data().data());
+            }
+            return res;
+        }
+    };
+
+#ifdef PJPLOT_ENABLE_TESTS
+    // little compile-time test to ensure the decimation columns partition the series, every sample is owned exactly once
+    consteval static auto test_column_partition() -> bool {
+        constexpr std::array<size_t, 6> lengths = {1, 2, 7, 600, 1001, 12345};
+        constexpr std::array<size_t, 4> widths = {1, 2, 3, 600};
+        for (const auto len : lengths) {
+            for (const auto cols : widths) {
+                if (MinMaxDecimator::column_begin(0, len, cols) != 0 || MinMaxDecimator::column_begin(cols, len, cols) != len) {
+                    return false;
+                }
+                for (size_t col = 0; col < cols; ++col) {
+                    if (MinMaxDecimator::column_begin(col, len, cols) > MinMaxDecimator::column_begin(col + 1, len, cols)) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+    constexpr static bool column_partition_test = test_column_partition();
+    static_assert(column_partition_test);
+#endif
+
+    // min/max pyramid over a long series, defined with the bar summaries it is built from
+    template <typename T>
+        requires std::is_arithmetic_v<T>
+    class LodIndex;
+
+    // The row runs of every series across the plot area: series s covers plot row y in column c when
+    // lo <= y <= hi, the lo rows of its columns followed by the hi rows at m_spans + 2 * s * m_width.
+    struct SeriesSpans {
+        const int32_t* m_spans = nullptr;
+        const Vec2<int32_t>* m_bounds = nullptr; ///< per series, the first and last row of each block of columns
+        size_t m_num_series = 0;
+        size_t m_width = 0;
+    };
+
+    // The fractional row extent of every anti-aliased series across the plot area, laid out like SeriesSpans with
+    // the top rows of its columns followed by the bottom rows.
+    struct SeriesExtents {
+        const float* m_extents = nullptr;
+        const Vec2<int32_t>* m_bounds = nullptr;
+        size_t m_num_series = 0;
+        size_t m_width = 0;
+    };
+
+    // A chart laid out once for the whole image, with its axes fitted and every series reduced to row runs, so that
+    // any region of it can be drawn on its own, e.g. one tile of a poster at a time by TiledRenderer. The runs live
+    // in the thread scratch of the thread that prepared the chart, which must not render anything else until the
+    // regions are drawn.
+    struct PreparedChart {
+        RenderFrame m_frame;         ///< the whole image, m_pixels is unused
+        SeriesSpans m_spans{};       ///< aliased series
+        SeriesExtents m_extents{};   ///< anti-aliased series
+    };
+
+    // Rasterizes line series straight into a caller-owned RGBA image without allocating.
+    // The image is processed in blocks of k_block_cols columns: for each series the run of rows the line passes
+    // through in every column of the block is computed into stack buffers, then only the rows touched by the
+    // block are filled using the vectorized span kernel.
+    class LineRasterizer {
+    public:
+        static constexpr size_t k_block_cols = 256;
+
+        // Calls sink(i, range) with the range of values the line passes through in columns col_begin + i of
+        // [col_begin, col_begin + n) of an out_cols wide plot, range being empty where the column has no samples.
+        // Column c covers the sample interval [(c - 0.5) * step, (c + 0.5) * step], so the range spans the
+        // interpolated values at both edges plus every sample in between, which keeps adjacent columns connected.
+        template <typename Series, typename Sink>
+        constexpr static void visit_column_ranges(const Series& series, size_t out_cols, size_t col_begin, size_t n, Sink&& sink) noexcept {
+            const size_t len = series.size();
+            const double last = len > 0 ? static_cast<double>(len - 1) : 0.0;
+            const double step = out_cols > 1 ? last / static_cast<double>(out_cols - 1) : 0.0;
+
+            for (size_t i = 0; i < n; ++i) {
+                ValueRange range;
+                if (len > 0) {
+                    const auto col = static_cast<double>(col_begin + i);
+                    const double t_begin = out_cols > 1 ? std::max(0.0, (col - 0.5) * step) : 0.0;
+                    const double t_end = out_cols > 1 ? std::min(last, (col + 0.5) * step) : last;
+                    range.include(interpolate(series, t_begin));
+                    range.include(interpolate(series, t_end));
+                    auto k = static_cast<size_t>(t_begin);
+                    k += static_cast<double>(k) < t_begin ? 1 : 0;
+                    for (const auto k_end = static_cast<size_t>(t_end); k <= k_end; ++k) {
+                        range.include(series[k]);
+                    }
+                }
+                sink(i, range);
+            }
+        }
+
+        // Equivalent of visit_column_ranges for n columns from their summaries, summaries[offset] being the first
+        // column of the block. Each range is widened to the midpoints shared with its neighbours to keep the line
+        // connected, so the num_summaries summaries must include the neighbours of the block where the plot has them.
+        template <typename T, typename Sink>
+        constexpr static void visit_summarised_ranges(const ColumnSummary<T>* summaries, size_t num_summaries, size_t offset, size_t n, Sink&& sink) noexcept {
+            for (size_t i = 0; i < n; ++i) {
+                const size_t idx = offset + i;
+                const auto& summary = summaries[idx];
+                ValueRange range;
+                if (!summary.is_empty()) {
+                    range.include(summary.m_min);
+                    range.include(summary.m_max);
+                    if (idx > 0 && !summaries[idx - 1].is_empty()) {
+                        range.include((static_cast<double>(summaries[idx - 1].m_last) + static_cast<double>(summary.m_first)) * 0.5);
+                    }
+                    if (idx + 1 < num_summaries && !summaries[idx + 1].is_empty()) {
+                        range.include((static_cast<double>(summary.m_last) + static_cast<double>(summaries[idx + 1].m_first)) * 0.5);
+                    }
+                }
+                sink(i, range);
+            }
+        }
+
+        // The column ranges of a block, decimating first when there is more than one sample per column. columns,
+        // when given, are the out_cols column summaries of the series from compute_stats() and replace the decimation.
+        template <typename Series, typename Sink>
+        constexpr static void visit_block_ranges(const Series& series, size_t out_cols, size_t col_begin, size_t n, const ColumnSummary<double>* columns, Sink&& sink) noexcept {
+            if (columns != nullptr) {
+                visit_summarised_ranges(columns, out_cols, col_begin, n, sink);
+                return;
+            }
+            if (series.size() > out_cols) {
+                visit_decimated_ranges(series, out_cols, col_begin, n, sink);
+                return;
+            }
+            visit_column_ranges(series, out_cols, col_begin, n, sink);
+        }
+
+        // the column ranges of a block from its min/max/first/last summaries, decimated on the fly
+        template <typename Series, typename Sink>
+        constexpr static void visit_decimated_ranges(const Series& series, size_t out_cols, size_t col_begin, size_t n, Sink&& sink) noexcept {
+            using ValueType = std::remove_cvref_t<decltype(series[0])>;
+            // decimate one extra column either side of the block for the connections to its neighbours
+            const size_t first_col = col_begin > 0 ? col_begin - 1 : 0;
+            const size_t last_col = std::min(out_cols, col_begin + n + 1);
+            std::array<ColumnSummary<ValueType>, k_block_cols + 2> summaries{};
+            MinMaxDecimator::decimate(series, out_cols, first_col, last_col - first_col, summaries.data());
+            visit_summarised_ranges(summaries.data(), last_col - first_col, col_begin - first_col, n, sink);
+        }
+
+        // Computes the [lo, hi] row run of the line in columns [col_begin, col_begin + n) of an out_cols wide plot
+        // from visit_column_ranges(). Returns the first and last row touched by the block, first > last if the block is empty.
+        template <typename Series>
+        [[nodiscard]] constexpr static auto compute_spans(const Series& series, const ValueTransform& transform, size_t out_cols, size_t col_begin, size_t n, int32_t* lo, int32_t* hi) noexcept -> Vec2<int32_t> {
+            RowSpanSink sink{transform, lo, hi};
+            visit_column_ranges(series, out_cols, col_begin, n, sink);
+            return sink.m_bounds;
+        }
+
+        // Equivalent of compute_spans for series much longer than the plot is wide, working from the min/max/first/last
+        // summary of each column.
+        template <typename Series>
+        [[nodiscard]] constexpr static auto compute_spans_decimated(const Series& series, const ValueTransform& transform, size_t out_cols, size_t col_begin, size_t n, int32_t* lo, int32_t* hi) noexcept -> Vec2<int32_t> {
+            RowSpanSink sink{transform, lo, hi};
+            visit_decimated_ranges(series, out_cols, col_begin, n, sink);
+            return sink.m_bounds;
+        }
+
+        // The row runs of n columns from their summaries, see visit_summarised_ranges().
+        template <typename T>
+        [[nodiscard]] constexpr static auto compute_spans_summarised(const ColumnSummary<T>* summaries, size_t num_summaries, size_t offset, const ValueTransform& transform, size_t n, int32_t* lo, int32_t* hi) noexcept -> Vec2<int32_t> {
+            RowSpanSink sink{transform, lo, hi};
+            visit_summarised_ranges(summaries, num_summaries, offset, n, sink);
+            return sink.m_bounds;
+        }
+
+        // Compute the row runs of a block, see visit_block_ranges().
+        template <typename Series>
+        [[nodiscard]] constexpr static auto compute_block(const Series& series, const ValueTransform& transform, size_t out_cols, size_t col_begin, size_t n, int32_t* lo, int32_t* hi, const ColumnSummary<double>* columns = nullptr) noexcept -> Vec2<int32_t> {
+            RowSpanSink sink{transform, lo, hi};
+            visit_block_ranges(series, out_cols, col_begin, n, columns, sink);
+            return sink.m_bounds;
+        }
+
+        // The stats of a series drawn into an out_cols wide plot. Series with more samples than columns are decimated
+        // into columns, when given, in the same pass, leaving the out_cols summaries for compute_block().
+        template <typename Series>
+        [[nodiscard]] constexpr static auto compute_stats(const Series& series, size_t out_cols, ColumnSummary<double>* columns = nullptr) noexcept -> SeriesStats {
+            SeriesStats stats;
+            if (columns == nullptr || out_cols == 0 || series.size() <= out_cols) {
+                for (size_t k = 0; k < series.size(); ++k) {
+                    stats.m_range.include(series[k]);
+                    stats.m_num_non_finite += is_finite_sample(series[k]) ? 0 : 1;
+                }
+                return stats;
+            }
+            MinMaxDecimator::decimate(series, out_cols, 0, out_cols, columns);
+            size_t num_finite = 0;
+            for (size_t col = 0; col < out_cols; ++col) {
+                if (!columns[col].is_empty()) {
+                    stats.m_range.include(columns[col].m_min);
+                    stats.m_range.include(columns[col].m_max);
+                    num_finite += columns[col].m_count;
+                }
+            }
+            stats.m_num_non_finite = series.size() - num_finite;
+            return stats;
+        }
+
+        // fill the rows [bounds.x, bounds.y] of a block previously computed by compute_spans
+        template <typename Pixel>
+        constexpr static void fill_spans(Pixel* pixels, size_t stride, size_t col_begin, size_t n, const int32_t* lo, const int32_t* hi, Vec2<int32_t> bounds, Pixel colour) noexcept {
+            for (int32_t y = bounds.x; y <= bounds.y; ++y) {
+                span_fill_row(pixels + static_cast<size_t>(y) * stride + col_begin, lo, hi, y, colour, n);
+            }
+        }
+
+        // Fill the row runs of every series, in series order, inside the image region clip. pixels address the
+        // image in rows of stride pixels, see BasicRenderFrame::draw_underlay().
+        template <typename Pixel>
+        static void fill_series_spans(const SeriesSpans& spans, const BasicRenderFrame<Pixel>& frame, Pixel* pixels, size_t stride, Rect clip) noexcept {
+            const Rect plot = frame.m_plot_area;
+            const Rect area = plot.intersect(clip);
+            if (area.is_empty()) {
+                return;
+            }
+            const size_t width = spans.m_width;
+            const size_t num_blocks = (width + k_block_cols - 1) / k_block_cols;
+            // the region in plot area coordinates
+            const auto first_row = static_cast<int32_t>(area.y - plot.y);
+            const auto last_row = first_row + static_cast<int32_t>(area.height) - 1;
+            const size_t col_first = area.x - plot.x;
+            const size_t col_end = col_first + area.width;
+            Pixel* origin = pixels + plot.y * stride + plot.x;
+            for (size_t series_idx = 0; series_idx < spans.m_num_series; ++series_idx) {
+                const int32_t* lo = spans.m_spans + 2 * series_idx * width;
+                const int32_t* hi = lo + width;
+                const auto colour = frame.to_pixel(get_series_colour(series_idx));
+                for (size_t block = col_first / k_block_cols; block * k_block_cols < col_end; ++block) {
+                    const size_t col_begin = std::max(block * k_block_cols, col_first);
+                    const size_t n = std::min((block + 1) * k_block_cols, col_end) - col_begin;
+                    const auto block_bounds = spans.m_bounds[series_idx * num_blocks + block];
+                    const Vec2<int32_t> clipped{std::max(block_bounds.x, first_row), std::min(block_bounds.y, last_row)};
+                    fill_spans(origin, stride, col_begin, n, lo + col_begin, hi + col_begin, clipped, colour);
+                }
+            }
+        }
+
+        // Lay out num_series series of series_length samples, back to back, for the image of target and reduce them
+        // to row runs without drawing anything, so that regions of the chart can be drawn one at a time.
+        template <typename ElementType>
+        static auto prepare_chart(std::span<const ElementType> plot_data, size_t series_length, size_t num_series, const ExecutionOptions& execution, const RenderFrame& target) -> PreparedChart {
+            return prepare_series_set(dense_view(plot_data, series_length, num_series), execution, target);
+        }
+
+        // Draw the part of a prepared line or bar chart inside the image region clip, exactly as the whole chart
+        // renders there. pixels address the image in rows of stride pixels, see BasicRenderFrame::draw_underlay().
+        static void draw_chart(const PreparedChart& chart, RGBA* pixels, size_t stride, Rect clip) {
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::RASTERIZE);
+            PJPLOT_PROFILE_BYTES(timer, clip.width * clip.height * sizeof(RGBA));
+            const RenderFrame& frame = chart.m_frame;
+            frame.draw_underlay(pixels, stride, clip);
+            fill_series_spans(chart.m_spans, frame, pixels, stride, clip);
+            blend_series_extents(chart.m_extents, frame, pixels, stride, clip);
+            frame.draw_overlay(pixels, stride, clip);
+        }
+
+        template <typename ElementType, Size2 OutSize, typename Allocator>
+        constexpr static void render(std::span<const ElementType> plot_data, size_t series_length, size_t num_series, const AppearanceOptions& appearance, Img2<OutSize, Allocator>& img_out) {
+            render<ElementType, OutSize>(plot_data, series_length, num_series, appearance, ExecutionOptions(), nullptr, img_out);
+        }
+
+        template <typename ElementType, Size2 OutSize, typename Allocator>
+        constexpr static void render(std::span<const ElementType> plot_data, size_t series_length, size_t num_series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) {
+            render_sized<OutSize>(dense_view(plot_data, series_length, num_series), execution, grid, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+        }
+
+        // render the rows of a (num_series x series_length) strided view, e.g. interleaved or column-major samples
+        template <typename ElementType, Size2 ViewSize, Size2 OutSize, typename Allocator>
+        constexpr static void render(const StridedView<const ElementType, ViewSize>& series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) {
+            const auto& strides = series.get_strides();
+            const auto view = StridedView<const ElementType, DynamicSize2>(DynamicSize2(series.shape().rows(), series.shape().cols()), series.data(), {strides[0], strides[1]});
+            render_sized<OutSize>(view, execution, grid, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+        }
+
+        // Render num_charts charts stored back to back in plot_data, chart i is drawn into target(i) which must point
+        // to rows * cols pixels, RGBA or the indices of palette. Validation, colour and grid setup happen once and
+        // the charts are rendered in parallel, one task per chart, unless the policy is sequential. Each task draws a
+        // whole chart sequentially with the scratch of the thread running it, which is only safe because a thread
+        // waiting for its own parallel_for never runs tasks of another batch, see ThreadPool::run_batch().
+        template <typename ElementType, typename TargetFn>
+        static void render_batch(std::span<const ElementType> plot_data, size_t num_charts, size_t series_length, size_t num_series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, const TargetFn& target, size_t rows, size_t cols, const Palette* palette = nullptr) {
+            static_assert(std::is_arithmetic_v<ElementType>, "Error: line charts require arithmetic sample types");
+            using Pixel = std::remove_pointer_t<std::invoke_result_t<const TargetFn&, size_t>>;
+            const size_t chart_nele = series_length * num_series;
+            if (plot_data.size() < chart_nele * num_charts) {
+                throw std::invalid_argument("Error: plot data is smaller than num_charts * series_length * num_series");
+            }
+            const auto shared_frame = BasicRenderFrame<Pixel>::create(nullptr, rows, cols, appearance, grid, nullptr, palette);
+            const auto render_chart = [&](size_t chart_idx) {
+                BasicRenderFrame<Pixel> frame = shared_frame;
+                frame.m_pixels = target(chart_idx);
+                render_into(plot_data.subspan(chart_idx * chart_nele, chart_nele), series_length, num_series, ExecutionOptions(), frame);
+            };
+            if (execution.get_policy() == ExecutionPolicy::SEQUENTIAL) {
+                for (size_t chart_idx = 0; chart_idx < num_charts; ++chart_idx) {
+                    render_chart(chart_idx);
+                }
+            } else {
+                execution.get_thread_pool().parallel_for(num_charts, render_chart);
+            }
+        }
+
+        // render into a frame owned by the caller
+        template <typename ElementType, typename Pixel>
+        constexpr static void render_into(std::span<const ElementType> plot_data, size_t series_length, size_t num_series, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target) {
+            render_into(dense_view(plot_data, series_length, num_series), execution, target);
+        }
+
+        // as render_into(), drawing with the fixed width block kernels when OutSize is static and the frame has no grid
+        template <Size2 OutSize, typename ElementType, typename Pixel>
+        constexpr static void render_into_sized(std::span<const ElementType> plot_data, size_t series_length, size_t num_series, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target) {
+            render_sized<OutSize>(dense_view(plot_data, series_length, num_series), execution, target.m_grid, target);
+        }
+
+        // render into a frame owned by the caller, series i is row i of data
+        template <typename ElementType, typename Pixel>
+        constexpr static void render_into(const StridedView<const ElementType, DynamicSize2>& data, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target) {
+            static_assert(std::is_arithmetic_v<ElementType>, "Error: line charts require arithmetic sample types");
+            render_series_set(data, execution, target);
+        }
+
+        // Render a list of series that may each have a different sample type and length. Samples are read in their
+        // own type, decimated in it and only converted to screen space per column, so there is no double copy.
+        template <typename Pixel>
+        constexpr static void render_into(std::span<const v_SeriesSpan> series, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target) {
+            render_series_set(series, execution, target);
+        }
+
+        template <Size2 OutSize, typename Allocator>
+        constexpr static void render(std::span<const v_SeriesSpan> series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) {
+            render_sized<OutSize>(series, execution, grid, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+        }
+
+        // Render an expression laid out like plot_data above, e.g. (samples - mean) / deviation. Its elements are
+        // computed as the range pass decimates them, so the result is never materialised. Expressions have no address
+        // to key on, so they bypass the range cache.
+        template <ArrayExpression Expr, Size2 OutSize, typename Allocator>
+        constexpr static void render(const Expr& plot_data, size_t series_length, size_t num_series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) {
+            render_sized<OutSize>(expression_rows(plot_data, series_length, num_series), execution, grid, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+        }
+
+        template <ArrayExpression Expr, typename Pixel>
+        constexpr static void render_into(const Expr& plot_data, size_t series_length, size_t num_series, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target) {
+            render_series_set(expression_rows(plot_data, series_length, num_series), execution, target);
+        }
+
+        // Render the series of a MultiSeriesView. Equal length series without x-values are drawn like a flat buffer,
+        // the others are placed on the shared x axis by prepare_positioned().
+        template <typename T, Size2 OutSize, typename Allocator>
+        static void render(const MultiSeriesView<T>& data, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) {
+            static_assert(std::is_arithmetic_v<T>, "Error: line charts require arithmetic sample types");
+            render_sized<OutSize>(data, execution, grid, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+        }
+
+        template <typename T, typename Pixel>
+        static void render_into(const MultiSeriesView<T>& data, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target) {
+            static_assert(std::is_arithmetic_v<T>, "Error: line charts require arithmetic sample types");
+            render_series_set(data, execution, target);
+        }
+
+        // Render samples [x_begin, x_end) of a long series indexed by index, the x axis showing sample positions.
+        // Zoomed out windows are drawn from the pyramid level matching their zoom and the samples are only read
+        // once a column holds fewer than 2^(base_level + 1) of them, so a frame costs time proportional to the width.
+        template <typename ElementType, Size2 OutSize, typename Allocator>
+        static void render(const LodIndex<ElementType>& index, std::type_identity_t<std::span<const ElementType>> samples, size_t x_begin, size_t x_end, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) {
+            render_into(index, samples, x_begin, x_end, execution, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+        }
+
+        template <typename ElementType, typename Pixel>
+        static void render_into(const LodIndex<ElementType>& index, std::type_identity_t<std::span<const ElementType>> samples, size_t x_begin, size_t x_end, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target) {
+            const size_t width = target.m_plot_area.width;
+            auto summaries = get_thread_scratch<ColumnSummary<double>, LodIndex<ElementType>>(width);
+            const bool is_summarised = index.summarise_columns(samples, x_begin, x_end, width, summaries.data());
+            const auto window = dense_view(samples.subspan(x_begin, x_end - x_begin), x_end - x_begin, 1);
+            const ValueRange x_range{static_cast<double>(x_begin), static_cast<double>(x_end - 1)};
+            if (!is_summarised) {
+                render_series_set(window, execution, target, x_range);
+                return;
+            }
+            target.report(Rect{0, 0, target.m_cols, target.m_rows});
+            BasicRenderFrame<Pixel> frame = target;
+            frame.m_damage = nullptr;
+            ValueRange range = frame.m_value_range;
+            if (range.is_empty()) {
+                for (const auto& summary : summaries) {
+                    if (!summary.is_empty()) {
+                        range.include(summary.m_min);
+                        range.include(summary.m_max);
+                    }
+                }
+            }
+            // every column is summarised, so the samples of the window are not read again
+            const uint8_t is_built = 1;
+            rasterize_series_set(window, range, x_range, DecimatedColumns{summaries.data(), &is_built, width}, execution, frame);
+        }
+
+    private:
+        struct CoverageTag {};
+
+        // turns column ranges into the whole pixel [lo, hi] runs of the span kernels
+        struct RowSpanSink {
+            const ValueTransform& m_transform;
+            int32_t* m_lo;
+            int32_t* m_hi;
+            Vec2<int32_t> m_bounds{std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min()};
+
+            constexpr void operator()(size_t i, const ValueRange& range) noexcept {
+                if (range.is_empty()) {
+                    m_lo[i] = std::numeric_limits<int32_t>::max();
+                    m_hi[i] = std::numeric_limits<int32_t>::min();
+                    return;
+                }
+                m_lo[i] = m_transform.to_row(range.m_max);
+                m_hi[i] = m_transform.to_row(range.m_min);
+                m_bounds.x = std::min(m_bounds.x, m_lo[i]);
+                m_bounds.y = std::max(m_bounds.y, m_hi[i]);
+            }
+        };
+
+        // turns column ranges into the fractional [top, bottom] rows of the coverage kernels, m_bounds being the
+        // rows with any coverage
+        struct CoverageSpanSink {
+            const ValueTransform& m_transform;
+            float* m_top;
+            float* m_bottom;
+            Vec2<int32_t> m_bounds{std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min()};
+
+            void operator()(size_t i, const ValueRange& range) noexcept {
+                if (range.is_empty()) {
+                    m_top[i] = std::numeric_limits<float>::max();
+                    m_bottom[i] = std::numeric_limits<float>::lowest();
+                    return;
+                }
+                m_top[i] = static_cast<float>(m_transform.to_row_exact(range.m_max));
+                m_bottom[i] = static_cast<float>(m_transform.to_row_exact(range.m_min));
+                m_bounds.x = std::min(m_bounds.x, static_cast<int32_t>(m_top[i]));
+                m_bounds.y = std::max(m_bounds.y, static_cast<int32_t>(std::ceil(m_bottom[i])));
+            }
+        };
+
+        // series series_idx of an expression is the run of series_length elements starting at series_idx * series_length
+        template <typename Expr>
+        struct ExpressionRows {
+            const Expr* m_expr = nullptr;
+            size_t m_series_length = 0;
+            size_t m_num_series = 0;
+        };
+
+        template <ArrayExpression Expr>
+        [[nodiscard]] constexpr static auto expression_rows(const Expr& plot_data, size_t series_length, size_t num_series) -> ExpressionRows<Expr> {
+            static_assert(std::is_arithmetic_v<typename Expr::value_type>, "Error: line charts require arithmetic sample types");
+            if (plot_data.nele() < series_length * num_series) {
+                throw std::invalid_argument("Error: plot data is smaller than series_length * num_series");
+            }
+            return ExpressionRows<Expr>{&plot_data, series_length, num_series};
+        }
+
+        // validate a (num_series x series_length) sample buffer and view it one series per row
+        template <typename ElementType>
+        [[nodiscard]] constexpr static auto dense_view(std::span<const ElementType> plot_data, size_t series_length, size_t num_series) -> StridedView<const ElementType, DynamicSize2> {
+            static_assert(std::is_arithmetic_v<ElementType>, "Error: line charts require arithmetic sample types");
+            if (plot_data.size() < series_length * num_series) {
+                throw std::invalid_argument("Error: plot data is smaller than series_length * num_series");
+            }
+            return StridedView<const ElementType, DynamicSize2>::dense(DynamicSize2(num_series, series_length), plot_data.data());
+        }
+
+        // Without a grid layer the plot area is the whole image, so a static output size fixes the plot width at
+        // compile time and the series are drawn with the fixed width block kernels.
+        template <Size2 OutSize, typename SeriesSet, typename Pixel>
+        constexpr static void render_sized(const SeriesSet& data, const ExecutionOptions& execution, const GridLayer* grid, const BasicRenderFrame<Pixel>& target) {
+            if constexpr (OutSize::is_static_size::value) {
+                if (grid == nullptr) {
+                    render_series_set<OutSize::cols()>(data, execution, target);
+                    return;
+                }
+            }
+            render_series_set(data, execution, target);
+        }
+
+        // Per-column summaries built by the range pass for the series longer than the plot is wide, so the block loop
+        // reads them instead of decimating the samples a second time.
+        struct DecimatedColumns {
+            const ColumnSummary<double>* m_columns = nullptr; ///< width summaries per series
+            const uint8_t* m_is_built = nullptr;              ///< per series, 0 where no summaries were built
+            size_t m_width = 0;
+
+            [[nodiscard]] constexpr auto get(size_t series_idx) const noexcept -> const ColumnSummary<double>* {
+                return m_is_built != nullptr && m_is_built[series_idx] != 0 ? m_columns + series_idx * m_width : nullptr;
+            }
+        };
+
+        // SeriesSet is a 2-D StridedView with one series per row, a list of v_SeriesSpan, the ExpressionRows of an
+        // expression or a MultiSeriesView.
+        // StaticWidth is the plot width when known at compile time, 0 otherwise.
+        // The x axis counts samples from 0 unless x_range is given.
+        template <size_t StaticWidth = 0, typename SeriesSet, typename Pixel>
+        constexpr static void render_series_set(const SeriesSet& data, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target, ValueRange x_range = ValueRange{}) {
+            // a full render rewrites every pixel, so the damage is reported once here rather than from the workers
+            target.report(Rect{0, 0, target.m_cols, target.m_rows});
+            BasicRenderFrame<Pixel> frame = target;
+            frame.m_damage = nullptr;
+            if (x_range.is_empty()) {
+                x_range = get_x_range(data);
+            }
+            DecimatedColumns columns;
+            const ValueRange range = prepare_columns(data, x_range, execution, frame, columns);
+            rasterize_series_set<StaticWidth>(data, range, x_range, columns, execution, frame);
+        }
+
+        // Draw the series of data on the value axis range, columns holding whatever summaries the range pass built.
+        // A palette has no room for blends, so indexed frames always draw aliased lines, and their layers would have
+        // no transparent index, so they split parallel work by row tiles whatever the policy.
+        template <size_t StaticWidth = 0, typename SeriesSet, typename Pixel>
+        constexpr static void rasterize_series_set(const SeriesSet& data, ValueRange range, ValueRange x_range, const DecimatedColumns& columns, const ExecutionOptions& execution, BasicRenderFrame<Pixel> frame) {
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::RASTERIZE);
+            PJPLOT_PROFILE_BYTES(timer, frame.m_rows * frame.m_cols * sizeof(Pixel));
+            constexpr bool is_rgba = std::is_same_v<Pixel, RGBA>;
+            const size_t num_series = get_num_series(data);
+            const Rect plot = frame.m_plot_area;
+            frame.m_value_range = range;
+            frame.m_x_range = x_range;
+            const bool is_empty = plot.is_empty() || range.is_empty();
+            const auto transform = is_empty ? ValueTransform() : ValueTransform::create(range, plot.height);
+            if constexpr (is_rgba) {
+                if (frame.m_line_mode == LineMode::ANTI_ALIASED && !std::is_constant_evaluated()) {
+                    render_anti_aliased(data, is_empty, transform, columns, execution, frame);
+                    return;
+                }
+            }
+            if (std::is_constant_evaluated() || execution.get_policy() == ExecutionPolicy::SEQUENTIAL) {
+                frame.draw_underlay(0, frame.m_rows);
+                if (!is_empty) {
+                    render_series<StaticWidth>(data, 0, num_series, transform, columns, frame.plot_origin(), plot.width, frame.m_cols, frame.m_palette);
+                }
+                frame.draw_overlay(0, frame.m_rows);
+                return;
+            }
+            if constexpr (is_rgba) {
+                if (execution.get_policy() == ExecutionPolicy::PARALLEL_SERIES) {
+                    render_parallel_series<StaticWidth>(data, is_empty, transform, columns, execution, frame);
+                    return;
+                }
+            }
+            render_parallel_row_tiles(data, is_empty, transform, columns, execution, frame);
+        }
+
+        // The value axis of a render, the fixed range of the frame or else the union of the series ranges. Series
+        // found in the range cache of execution are not scanned, the others are decimated into columns while their
+        // range is computed, so every sample is read once per render.
+        template <typename SeriesSet, typename Pixel>
+        constexpr static auto prepare_series(const SeriesSet& data, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& frame, DecimatedColumns& columns) -> ValueRange {
+            if (!frame.m_value_range.is_empty()) {
+                return frame.m_value_range;
+            }
+            const size_t num_series = get_num_series(data);
+            const size_t width = frame.m_plot_area.width;
+            ValueRange range;
+            if (std::is_constant_evaluated()) {
+                for (size_t series_idx = 0; series_idx < num_series; ++series_idx) {
+                    visit_series(data, series_idx, [&range, width](const auto& series) {
+                        const auto stats = compute_stats(series, width);
+                        range.include(stats.m_range.m_min);
+                        range.include(stats.m_range.m_max);
+                    });
+                }
+                return range;
+            }
+
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::DECIMATE);
+            PJPLOT_PROFILE_BYTES(timer, get_num_bytes(data));
+            RangeCache* cache = execution.get_range_cache();
+            auto stats = get_thread_scratch<SeriesStats>(num_series);
+            auto summaries = get_thread_scratch<ColumnSummary<double>>(num_series * width);
+            auto is_built = get_thread_scratch<uint8_t, DecimatedColumns>(num_series);
+            for_each_task(execution, num_series, [&](size_t series_idx) {
+                visit_series(data, series_idx, [&](const auto& series) {
+                    const auto key = get_cache_key(series);
+                    // series without an address, i.e. computed from an expression, are never cached
+                    RangeCache* series_cache = key.m_data != nullptr ? cache : nullptr;
+                    is_built[series_idx] = 0;
+                    if (series_cache != nullptr && series_cache->find(key, stats[series_idx])) {
+                        return;
+                    }
+                    ColumnSummary<double>* series_columns = width > 0 && series.size() > width ? summaries.data() + series_idx * width : nullptr;
+                    stats[series_idx] = compute_stats(series, width, series_columns);
+                    is_built[series_idx] = series_columns != nullptr ? 1 : 0;
+                    if (series_cache != nullptr) {
+                        series_cache->insert(key, stats[series_idx]);
+                    }
+                });
+            });
+            for (const auto& series_stats : stats) {
+                range.include(series_stats.m_range.m_min);
+                range.include(series_stats.m_range.m_max);
+            }
+            columns = DecimatedColumns{summaries.data(), is_built.data(), width};
+            return range;
+        }
+
+        // the value axis and column summaries of data drawn on the x axis x_range, see prepare_series()
+        template <typename SeriesSet, typename Pixel>
+        constexpr static auto prepare_columns(const SeriesSet& data, ValueRange, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& frame, DecimatedColumns& columns) -> ValueRange {
+            return prepare_series(data, execution, frame, columns);
+        }
+
+        template <typename T, typename Pixel>
+        static auto prepare_columns(const MultiSeriesView<T>& data, ValueRange x_range, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& frame, DecimatedColumns& columns) -> ValueRange {
+            if (!data.is_positioned()) {
+                return prepare_series(data, execution, frame, columns);
+            }
+            return prepare_positioned(data, x_range, execution, frame, columns);
+        }
+
+        // The value axis of series placed by x-value or of different lengths. Their samples cannot be found from the
+        // column index, so every series is binned into the columns of x_range as its range is computed and the block
+        // loop only reads the summaries, which are built even when the frame fixes the value axis.
+        template <typename T, typename Pixel>
+        static auto prepare_positioned(const MultiSeriesView<T>& data, ValueRange x_range, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& frame, DecimatedColumns& columns) -> ValueRange {
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::DECIMATE);
+            PJPLOT_PROFILE_BYTES(timer, get_num_bytes(data) + (data.has_x_values() ? data.get_num_samples() * sizeof(double) : 0));
+            const size_t num_series = data.get_num_series();
+            const size_t width = frame.m_plot_area.width;
+            auto ranges = get_thread_scratch<ValueRange, DecimatedColumns>(num_series);
+            auto summaries = get_thread_scratch<ColumnSummary<double>>(num_series * width);
+            auto is_built = get_thread_scratch<uint8_t, DecimatedColumns>(num_series);
+            for_each_task(execution, num_series, [&](size_t series_idx) {
+                visit_series(data, series_idx, [&](const auto& series) {
+                    ranges[series_idx] = bin_positioned(series, data.get_x_values(series_idx), x_range, width, summaries.data() + series_idx * width);
+                });
+                is_built[series_idx] = 1;
+            });
+            columns = DecimatedColumns{summaries.data(), is_built.data(), width};
+            if (!frame.m_value_range.is_empty()) {
+                return frame.m_value_range;
+            }
+            ValueRange range;
+            for (const auto& series_range : ranges) {
+                range.include(series_range.m_min);
+                range.include(series_range.m_max);
+            }
+            return range;
+        }
+
+        // Bin a series into the width columns of x_range, sample k sitting at x_values[k], or at k when x_values is
+        // empty, and return its value range. Columns left empty between two samples are filled in by linear
+        // interpolation so sparse series stay connected, while a NaN sample or x-value breaks the line as in the
+        // index path; an interpolated column counts as one sample. The column being binned is summarised in
+        // registers and only stored once the samples move on, as ascending x-values visit each column once.
+        template <typename Series>
+        [[nodiscard]] constexpr static auto bin_positioned(const Series& series, std::span<const double> x_values, ValueRange x_range, size_t width, ColumnSummary<double>* columns) noexcept -> ValueRange {
+            ValueRange range;
+            std::fill(columns, columns + width, ColumnSummary<double>{});
+            const double scale = width > 1 && x_range.m_max > x_range.m_min ? static_cast<double>(width - 1) / (x_range.m_max - x_range.m_min) : 0.0;
+            const double max_col = width > 0 ? static_cast<double>(width) - 0.5 : 0.0;
+            ColumnSummary<double> current;
+            size_t current_col = width;
+            // no NaN between the current column and the next sample
+            bool is_connected = false;
+            for (size_t k = 0; k < series.size(); ++k) {
+                const auto val = static_cast<double>(series[k]);
+                const double x = x_values.empty() ? static_cast<double>(k) : x_values[k];
+                // both are finite exactly when v - v is 0 for each, tested at once instead of is_finite_sample() twice
+                if (!((val - val) + (x - x) == 0.0)) {
+                    is_connected = false;
+                    continue;
+                }
+                if (width == 0) {
+                    range.include(val);
+                    continue;
+                }
+                // rounds to the nearest column, the position being clamped to at least 0 first; the signed conversion
+                // is a single instruction where the unsigned one branches
+                const auto col = static_cast<size_t>(static_cast<int64_t>(std::clamp((x - x_range.m_min) * scale + 0.5, 0.0, max_col)));
+                if (col != current_col) {
+                    if (current_col < width) {
+                        store_column(columns[current_col], current);
+                        if (is_connected && current_col < col) {
+                            const double prev = current.m_last;
+                            const auto span = static_cast<double>(col - current_col);
+                            for (size_t c = current_col + 1; c < col; ++c) {
+                                const double filled = prev + (val - prev) * static_cast<double>(c - current_col) / span;
+                                columns[c] = ColumnSummary<double>{filled, filled, filled, filled, 1};
+                            }
+                        }
+                    }
+                    current = ColumnSummary<double>{val, val, val, val, 0};
+                    current_col = col;
+                }
+                current.m_min = val < current.m_min ? val : current.m_min;
+                current.m_max = val > current.m_max ? val : current.m_max;
+                current.m_last = val;
+                ++current.m_count;
+                is_connected = true;
+            }
+            if (current_col < width) {
+                store_column(columns[current_col], current);
+            }
+            // interpolated columns lie between their neighbours, so the stored columns span the samples exactly
+            for (size_t col = 0; col < width; ++col) {
+                if (!columns[col].is_empty()) {
+                    range.include(columns[col].m_min);
+                    range.include(columns[col].m_max);
+                }
+            }
+            return range;
+        }
+
+        // store the summary of a run of samples in column, merging it with what an earlier run left there when the
+        // x-values are not ascending
+        constexpr static void store_column(ColumnSummary<double>& column, const ColumnSummary<double>& summary) noexcept {
+            if (column.is_empty()) {
+                column = summary;
+                return;
+            }
+            column.m_min = std::min(column.m_min, summary.m_min);
+            column.m_max = std::max(column.m_max, summary.m_max);
+            column.m_last = summary.m_last;
+            column.m_count += summary.m_count;
+        }
+
+        // the x axis of a render counting samples from 0, or that of the series of a MultiSeriesView
+        template <typename SeriesSet>
+        [[nodiscard]] constexpr static auto get_x_range(const SeriesSet& data) noexcept -> ValueRange {
+            const size_t series_length = get_series_length(data);
+            return series_length > 0 ? ValueRange{0.0, static_cast<double>(series_length - 1)} : ValueRange{};
+        }
+
+        template <typename T>
+        [[nodiscard]] constexpr static auto get_x_range(const MultiSeriesView<T>& data) noexcept -> ValueRange {
+            return data.get_x_range();
+        }
+
+        // bytes of samples held by the series of data
+        template <typename SeriesSet>
+        [[nodiscard]] constexpr static auto get_num_bytes(const SeriesSet& data) -> size_t {
+            size_t num_bytes = 0;
+            for (size_t series_idx = 0; series_idx < get_num_series(data); ++series_idx) {
+                visit_series(data, series_idx, [&num_bytes](const auto& series) {
+                    num_bytes += series.size() * sizeof(series[0]);
+                });
+            }
+            return num_bytes;
+        }
+
+        template <typename ElementType>
+        [[nodiscard]] static auto get_cache_key(std::span<const ElementType> series) noexcept -> RangeCache::Key {
+            return RangeCache::make_key(series.data(), series.size());
+        }
+
+        template <typename ElementType>
+        [[nodiscard]] static auto get_cache_key(const StridedView<const ElementType, DynamicSize1>& series) noexcept -> RangeCache::Key {
+            return RangeCache::make_key(series.data(), series.size(), series.get_strides()[0]);
+        }
+
+        template <typename Expr>
+        [[nodiscard]] static auto get_cache_key(const ExpressionSlice<Expr>&) noexcept -> RangeCache::Key {
+            return RangeCache::Key{};
+        }
+
+        // samples with a validity bitmap may change validity in place, so they are never cached
+        template <typename T>
+        [[nodiscard]] static auto get_cache_key(const MaskedSeries<T>&) noexcept -> RangeCache::Key {
+            return RangeCache::Key{};
+        }
+
+        template <typename T>
+        [[nodiscard]] constexpr static auto get_num_series(const MultiSeriesView<T>& data) noexcept -> size_t {
+            return data.get_num_series();
+        }
+
+        template <typename ElementType>
+        [[nodiscard]] constexpr static auto get_num_series(const StridedView<const ElementType, DynamicSize2>& data) noexcept -> size_t {
+            return data.shape().rows();
+        }
+
+        template <typename Expr>
+        [[nodiscard]] constexpr static auto get_num_series(const ExpressionRows<Expr>& data) noexcept -> size_t {
+            return data.m_num_series;
+        }
+
+        [[nodiscard]] constexpr static auto get_num_series(std::span<const v_SeriesSpan> data) noexcept -> size_t {
+            return data.size();
+        }
+
+        // samples in the longest series, which spans the whole width of the plot
+        template <typename ElementType>
+        [[nodiscard]] constexpr static auto get_series_length(const StridedView<const ElementType, DynamicSize2>& data) noexcept -> size_t {
+            return data.shape().cols();
+        }
+
+        template <typename Expr>
+        [[nodiscard]] constexpr static auto get_series_length(const ExpressionRows<Expr>& data) noexcept -> size_t {
+            return data.m_series_length;
+        }
+
+        template <typename T>
+        [[nodiscard]] constexpr static auto get_series_length(const MultiSeriesView<T>& data) noexcept -> size_t {
+            return data.get_max_series_length();
+        }
+
+        [[nodiscard]] constexpr static auto get_series_length(std::span<const v_SeriesSpan> data) noexcept -> size_t {
+            size_t len = 0;
+            for (const auto& series : data) {
+                len = std::max(len, std::visit([](const auto& samples) { return samples.size(); }, series));
+            }
+            return len;
+        }
+
+        // call fn with series series_idx in its own sample type
+        template <typename Fn>
+        constexpr static void visit_series(std::span<const v_SeriesSpan> data, size_t series_idx, const Fn& fn) {
+            std::visit(fn, data[series_idx]);
+        }
+
+        // call fn with series series_idx of a MultiSeriesView as a std::span, or as a MaskedSeries with a validity bitmap
+        template <typename T, typename Fn>
+        constexpr static void visit_series(const MultiSeriesView<T>& data, size_t series_idx, const Fn& fn) {
+            if (data.has_validity()) {
+                fn(data.get_masked_samples(series_idx));
+            } else {
+                fn(data.get_samples(series_idx));
+            }
+        }
+
+        // call fn with series series_idx of an expression as an ExpressionSlice, computing its samples as they are read
+        template <typename Expr, typename Fn>
+        constexpr static void visit_series(const ExpressionRows<Expr>& data, size_t series_idx, const Fn& fn) {
+            fn(ExpressionSlice<Expr>(*data.m_expr, series_idx * data.m_series_length, data.m_series_length));
+        }
+
+        // call fn with series series_idx of data, as a std::span when its samples are adjacent so the common dense
+        // layout keeps unit-stride inner loops, otherwise as a 1-D StridedView
+        template <typename ElementType, typename Fn>
+        constexpr static void visit_series(const StridedView<const ElementType, DynamicSize2>& data, size_t series_idx, const Fn& fn) {
+            const auto& strides = data.get_strides();
+            const ElementType* first = data.data() + series_idx * strides[0];
+            if (strides[1] == 1) {
+                fn(std::span<const ElementType>(first, data.shape().cols()));
+            } else {
+                fn(StridedView<const ElementType, DynamicSize1>(DynamicSize1(data.shape().cols()), first, {strides[1]}));
+            }
+        }
+
+        // draw series [series_begin, series_end) into a width wide plot area starting at origin, block by block.
+        // Indexed images look the series colours up in palette.
+        template <size_t StaticWidth, typename SeriesSet, typename Pixel>
+        constexpr static void render_series(const SeriesSet& data, size_t series_begin, size_t series_end, const ValueTransform& transform, const DecimatedColumns& columns, Pixel* origin, size_t width, size_t stride, const Palette* palette = nullptr) {
+            std::array<int32_t, k_block_cols> lo{};
+            std::array<int32_t, k_block_cols> hi{};
+            for (size_t series_idx = series_begin; series_idx < series_end; ++series_idx) {
+                const auto colour = to_pixel<Pixel>(get_series_colour(series_idx), palette);
+                const auto* series_columns = columns.get(series_idx);
+                visit_series(data, series_idx, [&](const auto& series) {
+                    if constexpr (StaticWidth > 0) {
+                        render_blocks_fixed<StaticWidth>(series, transform, series_columns, origin, stride, colour, lo.data(), hi.data());
+                    } else {
+                        for (size_t col_begin = 0; col_begin < width; col_begin += k_block_cols) {
+                            const size_t n = std::min(k_block_cols, width - col_begin);
+                            const auto bounds = compute_block(series, transform, width, col_begin, n, lo.data(), hi.data(), series_columns);
+                            fill_spans(origin, stride, col_begin, n, lo.data(), hi.data(), bounds, colour);
+                        }
+                    }
+                });
+            }
+        }
+
+        // The block loop for a plot Width columns wide: the number of full blocks and the width of the last one are
+        // constants, so every block is filled by a kernel specialised for its exact width.
+        template <size_t Width, typename Series, typename Pixel>
+        constexpr static void render_blocks_fixed(const Series& series, const ValueTransform& transform, const ColumnSummary<double>* columns, Pixel* origin, size_t stride, Pixel colour, int32_t* lo, int32_t* hi) {
+            constexpr size_t num_full = Width / k_block_cols;
+            constexpr size_t tail = Width % k_block_cols;
+            for (size_t block = 0; block < num_full; ++block) {
+                const size_t col_begin = block * k_block_cols;
+                const auto bounds = compute_block(series, transform, Width, col_begin, k_block_cols, lo, hi, columns);
+                span_fill_rows_fixed<k_block_cols>(origin + col_begin, stride, lo, hi, bounds, colour);
+            }
+            if constexpr (tail > 0) {
+                constexpr size_t col_begin = num_full * k_block_cols;
+                const auto bounds = compute_block(series, transform, Width, col_begin, tail, lo, hi, columns);
+                span_fill_rows_fixed<tail>(origin + col_begin, stride, lo, hi, bounds, colour);
+            }
+        }
+
+        // Series are split into one contiguous group per thread. The first group draws straight into the image,
+        // the others into transparent layers that are composited on top in group order, so overlapping series
+        // end up exactly as in the sequential path.
+        template <size_t StaticWidth, typename SeriesSet>
+        static void render_parallel_series(const SeriesSet& data, bool is_empty, const ValueTransform& transform, const DecimatedColumns& columns, const ExecutionOptions& execution, const RenderFrame& frame) {
+            ThreadPool& pool = execution.get_thread_pool();
+            const size_t num_series = get_num_series(data);
+            const Rect plot = frame.m_plot_area;
+            const size_t nele = frame.m_rows * frame.m_cols;
+            const size_t num_groups = is_empty ? 1 : std::clamp<size_t>(pool.get_concurrency(), 1, std::max<size_t>(num_series, 1));
+            auto layers = get_thread_scratch<RGBA>((num_groups - 1) * nele);
+            pool.parallel_for(num_groups, [&](size_t group) {
+                RGBA* target = group == 0 ? frame.m_pixels : layers.data() + (group - 1) * nele;
+                if (group == 0) {
+                    frame.draw_underlay(0, frame.m_rows);
+                } else {
+                    std::fill(target, target + nele, RGBA(0, 0, 0, 0));
+                }
+                if (!is_empty) {
+                    render_series<StaticWidth>(data, group * num_series / num_groups, (group + 1) * num_series / num_groups, transform, columns, target + plot.y * frame.m_cols + plot.x, plot.width, frame.m_cols);
+                }
+            });
+            const size_t tile_rows = execution.get_tile_rows();
+            pool.parallel_for((frame.m_rows + tile_rows - 1) / tile_rows, [&](size_t tile) {
+                const size_t row_begin = tile * tile_rows;
+                const size_t row_end = std::min(frame.m_rows, (tile + 1) * tile_rows);
+                const size_t end = row_end * frame.m_cols;
+                for (size_t group = 1; group < num_groups; ++group) {
+                    const RGBA* layer = layers.data() + (group - 1) * nele;
+                    for (size_t i = row_begin * frame.m_cols; i < end; ++i) {
+                        frame.m_pixels[i] = layer[i].m_a != 0 ? layer[i] : frame.m_pixels[i];
+                    }
+                }
+                frame.draw_overlay(row_begin, row_end);
+            });
+        }
+
+        // The row runs of every series are computed up front, one task per series, then each task fills the
+        // background and draws every series clipped to its own band of rows, keeping the band hot in cache.
+        template <typename SeriesSet, typename Pixel>
+        static void render_parallel_row_tiles(const SeriesSet& data, bool is_empty, const ValueTransform& transform, const DecimatedColumns& columns, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& frame) {
+            const auto spans = compute_series_spans(data, is_empty, transform, columns, execution, frame.m_plot_area.width);
+            const size_t tile_rows = execution.get_tile_rows();
+            execution.get_thread_pool().parallel_for((frame.m_rows + tile_rows - 1) / tile_rows, [&](size_t tile) {
+                const size_t row_begin = tile * tile_rows;
+                const size_t row_end = std::min(frame.m_rows, (tile + 1) * tile_rows);
+                frame.draw_underlay(row_begin, row_end);
+                fill_series_spans(spans, frame, frame.m_pixels, frame.m_cols, Rect{0, row_begin, frame.m_cols, row_end - row_begin});
+                frame.draw_overlay(row_begin, row_end);
+            });
+        }
+
+        // the row runs of every series in the width columns of the plot, one task per series
+        template <typename SeriesSet>
+        static auto compute_series_spans(const SeriesSet& data, bool is_empty, const ValueTransform& transform, const DecimatedColumns& columns, const ExecutionOptions& execution, size_t width) -> SeriesSpans {
+            const size_t num_blocks = (width + k_block_cols - 1) / k_block_cols;
+            const size_t num_active = is_empty ? 0 : get_num_series(data);
+            auto spans = get_thread_scratch<int32_t>(2 * num_active * width);
+            auto bounds = get_thread_scratch<Vec2<int32_t>>(num_active * num_blocks);
+            for_each_task(execution, num_active, [&](size_t series_idx) {
+                int32_t* lo = spans.data() + 2 * series_idx * width;
+                int32_t* hi = lo + width;
+                visit_series(data, series_idx, [&](const auto& series) {
+                    for (size_t block = 0; block < num_blocks; ++block) {
+                        const size_t col_begin = block * k_block_cols;
+                        const size_t n = std::min(k_block_cols, width - col_begin);
+                        bounds[series_idx * num_blocks + block] = compute_block(series, transform, width, col_begin, n, lo + col_begin, hi + col_begin, columns.get(series_idx));
+                    }
+                });
+            });
+            return SeriesSpans{spans.data(), bounds.data(), num_active, width};
+        }
+
+        // Anti-aliased lines. The fractional row extent of every series in every column is computed up front, one
+        // task per series, then each band of rows is a task that accumulates the coverage of one series at a time
+        // into an Img2F and resolves it onto the band in a single blend pass, so pixels are blended once per series
+        // and the band stays hot in cache. The sequential policy runs the same bands on the calling thread.
+        template <typename SeriesSet>
+        static void render_anti_aliased(const SeriesSet& data, bool is_empty, const ValueTransform& transform, const DecimatedColumns& columns, const ExecutionOptions& execution, const RenderFrame& frame) {
+            const auto extents = compute_series_extents(data, is_empty, transform, columns, execution, frame.m_plot_area.width);
+            const size_t tile_rows = execution.get_tile_rows();
+            for_each_task(execution, (frame.m_rows + tile_rows - 1) / tile_rows, [&](size_t tile) {
+                const size_t row_begin = tile * tile_rows;
+                const size_t row_end = std::min(frame.m_rows, (tile + 1) * tile_rows);
+                frame.draw_underlay(row_begin, row_end);
+                blend_series_extents(extents, frame, frame.m_pixels, frame.m_cols, Rect{0, row_begin, frame.m_cols, row_end - row_begin});
+                frame.draw_overlay(row_begin, row_end);
+            });
+        }
+
+        // the fractional row extent of every series in the width columns of the plot, one task per series
+        template <typename SeriesSet>
+        static auto compute_series_extents(const SeriesSet& data, bool is_empty, const ValueTransform& transform, const DecimatedColumns& columns, const ExecutionOptions& execution, size_t width) -> SeriesExtents {
+            const size_t num_blocks = (width + k_block_cols - 1) / k_block_cols;
+            const size_t num_active = is_empty ? 0 : get_num_series(data);
+            auto extents = get_thread_scratch<float>(2 * num_active * width);
+            auto bounds = get_thread_scratch<Vec2<int32_t>>(num_active * num_blocks);
+            for_each_task(execution, num_active, [&](size_t series_idx) {
+                float* top = extents.data() + 2 * series_idx * width;
+                float* bottom = top + width;
+                visit_series(data, series_idx, [&](const auto& series) {
+                    for (size_t block = 0; block < num_blocks; ++block) {
+                        const size_t col_begin = block * k_block_cols;
+                        const size_t n = std::min(k_block_cols, width - col_begin);
+                        CoverageSpanSink sink{transform, top + col_begin, bottom + col_begin};
+                        visit_block_ranges(series, width, col_begin, n, columns.get(series_idx), sink);
+                        bounds[series_idx * num_blocks + block] = sink.m_bounds;
+                    }
+                });
+            });
+            return SeriesExtents{extents.data(), bounds.data(), num_active, width};
+        }
+
+        // blend the extents of every series, in series order, inside the image region clip; pixels address the
+        // image as for fill_series_spans()
+        static void blend_series_extents(const SeriesExtents& extents, const RenderFrame& frame, RGBA* pixels, size_t stride, Rect clip) {
+            const Rect plot = frame.m_plot_area;
+            const Rect area = plot.intersect(clip);
+            if (extents.m_num_series == 0 || area.is_empty()) {
+                return;
+            }
+            const CoverageRowFn coverage_row = get_coverage_row();
+            const BlendRowFn blend_row = get_blend_row();
+            const size_t width = extents.m_width;
+            const size_t num_blocks = (width + k_block_cols - 1) / k_block_cols;
+            // the region in plot area coordinates
+            const auto first_row = static_cast<int32_t>(area.y - plot.y);
+            const auto last_row = first_row + static_cast<int32_t>(area.height) - 1;
+            const size_t col_first = area.x - plot.x;
+            const size_t col_end = col_first + area.width;
+            Mat2View<float, DynamicSize2> coverage(DynamicSize2(area.height, area.width), get_thread_scratch<float, CoverageTag>(area.height * area.width).data());
+            float* coverage_data = coverage.data().data();
+            RGBA* origin = pixels + plot.y * stride + plot.x;
+            for (size_t series_idx = 0; series_idx < extents.m_num_series; ++series_idx) {
+                const float* top = extents.m_extents + 2 * series_idx * width;
+                const float* bottom = top + width;
+                const auto colour = get_series_colour(series_idx);
+                for (size_t block = col_first / k_block_cols; block * k_block_cols < col_end; ++block) {
+                    const size_t col_begin = std::max(block * k_block_cols, col_first);
+                    const size_t n = std::min((block + 1) * k_block_cols, col_end) - col_begin;
+                    const auto block_bounds = extents.m_bounds[series_idx * num_blocks + block];
+                    for (int32_t y = std::max(block_bounds.x, first_row); y <= std::min(block_bounds.y, last_row); ++y) {
+                        coverage_row(coverage_data + static_cast<size_t>(y - first_row) * area.width + col_begin - col_first, top + col_begin, bottom + col_begin, static_cast<float>(y), n);
+                    }
+                }
+                for (size_t block = col_first / k_block_cols; block * k_block_cols < col_end; ++block) {
+                    const size_t col_begin = std::max(block * k_block_cols, col_first);
+                    const size_t n = std::min((block + 1) * k_block_cols, col_end) - col_begin;
+                    const auto block_bounds = extents.m_bounds[series_idx * num_blocks + block];
+                    for (int32_t y = std::max(block_bounds.x, first_row); y <= std::min(block_bounds.y, last_row); ++y) {
+                        blend_row(origin + static_cast<size_t>(y) * stride + col_begin, coverage_data + static_cast<size_t>(y - first_row) * area.width + col_begin - col_first, colour, n);
+                    }
+                }
+            }
+        }
+
+        // the chart render_series_set() draws, laid out and reduced to row runs, or to extents when anti-aliased
+        template <typename SeriesSet>
+        static auto prepare_series_set(const SeriesSet& data, const ExecutionOptions& execution, const RenderFrame& target) -> PreparedChart {
+            PreparedChart chart{target};
+            RenderFrame& frame = chart.m_frame;
+            frame.m_damage = nullptr;
+            const ValueRange x_range = get_x_range(data);
+            DecimatedColumns columns;
+            const ValueRange range = prepare_columns(data, x_range, execution, frame, columns);
+            frame.m_value_range = range;
+            frame.m_x_range = x_range;
+            const Rect plot = frame.m_plot_area;
+            const bool is_empty = plot.is_empty() || range.is_empty();
+            const auto transform = is_empty ? ValueTransform() : ValueTransform::create(range, plot.height);
+            if (frame.m_line_mode == LineMode::ANTI_ALIASED) {
+                chart.m_extents = compute_series_extents(data, is_empty, transform, columns, execution, plot.width);
+            } else {
+                chart.m_spans = compute_series_spans(data, is_empty, transform, columns, execution, plot.width);
+            }
+            return chart;
+        }
+
+        // linearly interpolated value at fractional sample position t, invalid neighbours resolve to the nearest sample
+        template <typename Series>
+        [[nodiscard]] constexpr static auto interpolate(const Series& series, double t) noexcept -> double {
+            const auto idx = static_cast<size_t>(t);
+            const auto val = static_cast<double>(series[idx]);
+            if (idx + 1 >= series.size()) {
+                return val;
+            }
+            const auto next = static_cast<double>(series[idx + 1]);
+            const double frac = t - static_cast<double>(idx);
+            if (!is_finite_sample(val) || !is_finite_sample(next)) {
+                return frac < 0.5 ? val : next;
+            }
+            return val + (next - val) * frac;
+        }
+    };
+
+    // colour stops of the density tone map, from the sparsest to the densest pixels
+    inline constexpr std::array<RGBA, 5> k_density_ramp = {
+        RGBA(68, 1, 84, 255),
+        RGBA(59, 82, 139, 255),
+        RGBA(33, 145, 140, 255),
+        RGBA(94, 201, 98, 255),
+        RGBA(253, 231, 37, 255),
+    };
+
+    // colour of the density ramp at t in [0, 1]
+    [[nodiscard]] constexpr auto sample_density_ramp(double t) noexcept -> RGBA {
+        const double pos = std::clamp(t, 0.0, 1.0) * static_cast<double>(k_density_ramp.size() - 1);
+        const size_t idx = std::min(static_cast<size_t>(pos), k_density_ramp.size() - 2);
+        return mix_rgba(k_density_ramp[idx], k_density_ramp[idx + 1], pos - static_cast<double>(idx));
+    }
+
+    // Rasterizes (x, y) point clouds, stored interleaved as x0 y0 x1 y1 ... with the series back to back.
+    // Below the density threshold every point is stamped as a square marker. The parallel path first sorts the
+    // points into bands of image rows with a counting sort, so each task owns a band, no pixel is written by two
+    // threads and markers overlap in the same order as in the sequential path. Above the threshold the points are
+    // binned into per-pixel counts and tone mapped, so the cost of a point stays one increment however many
+    // markers would have been drawn on top of each other.
+    class ScatterRasterizer {
+    public:
+        // fewest points worth a task of their own
+        static constexpr size_t k_min_chunk_points = 4096;
+
+        // maps points onto the pixels of a plot area, created from the bounds of the points
+        struct PointTransform {
+            ValueTransform m_x;
+            ValueTransform m_y;
+            bool m_is_empty = true; ///< no finite points or an empty plot area, nothing is drawn
+            ValueRange m_x_range{}; ///< bounds of the points the transform was created from
+            ValueRange m_y_range{};
+        };
+
+        // draw series_length points per series into a frame owned by the caller
+        template <typename ElementType>
+        static void render_into(std::span<const ElementType> plot_data, size_t series_length, size_t num_series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const RenderFrame& target) {
+            static_assert(std::is_arithmetic_v<ElementType>, "Error: scatter charts require arithmetic sample types");
+            const size_t num_points = series_length * num_series;
+            if (plot_data.size() < 2 * num_points) {
+                throw std::invalid_argument("Error: plot data is smaller than 2 * series_length * num_series");
+            }
+            render_points(plot_data.first(2 * num_points), UniformSeries{series_length}, appearance, execution, target);
+        }
+
+        // draw the points of an expression laid out like plot_data above, computing each coordinate as it is read
+        template <ArrayExpression Expr>
+        static void render_into(const Expr& plot_data, size_t series_length, size_t num_series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const RenderFrame& target) {
+            static_assert(std::is_arithmetic_v<typename Expr::value_type>, "Error: scatter charts require arithmetic sample types");
+            const size_t num_points = series_length * num_series;
+            if (plot_data.nele() < 2 * num_points) {
+                throw std::invalid_argument("Error: plot data is smaller than 2 * series_length * num_series");
+            }
+            render_points(ExpressionSlice<Expr>(plot_data, 0, 2 * num_points), UniformSeries{series_length}, appearance, execution, target);
+        }
+
+        // Draw every sample of a MultiSeriesView as a point at (x-value, sample), the x-value being the position of
+        // the sample in its series without x-values. Invalid samples are skipped.
+        template <typename T>
+        static void render_into(const MultiSeriesView<T>& data, const AppearanceOptions& appearance, const ExecutionOptions& execution, const RenderFrame& target) {
+            static_assert(std::is_arithmetic_v<T>, "Error: scatter charts require arithmetic sample types");
+            render_points(SeriesPoints<T>{&data}, [&data](size_t k) { return data.get_series_index(k); }, appearance, execution, target);
+        }
+
+        // the mode used to draw num_points points, resolving ScatterMode::AUTO against the density threshold
+        [[nodiscard]] constexpr static auto resolve_mode(const AppearanceOptions& appearance, size_t num_points) noexcept -> ScatterMode {
+            if (appearance.get_scatter_mode() != ScatterMode::AUTO) {
+                return appearance.get_scatter_mode();
+            }
+            return num_points > appearance.get_density_threshold() ? ScatterMode::DENSITY : ScatterMode::MARKERS;
+        }
+
+        // Transform fitting every point with finite coordinates into plot. Points is a span of interleaved coordinates
+        // or an expression slice, anything with a size() and operator[].
+        template <typename Points>
+        [[nodiscard]] static auto create_transform(const Points& points, Rect plot, const ExecutionOptions& execution) -> PointTransform {
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::DECIMATE);
+            PJPLOT_PROFILE_BYTES(timer, points.size() * sizeof(points[0]));
+            const size_t num_points = points.size() / 2;
+            const size_t num_chunks = get_num_chunks(execution, num_points, k_min_chunk_points);
+            auto ranges = get_thread_scratch<ValueRange>(2 * num_chunks);
+            for_each_task(execution, num_chunks, [&](size_t chunk) {
+                ValueRange x_range;
+                ValueRange y_range;
+                for (size_t k = chunk * num_points / num_chunks, k_end = (chunk + 1) * num_points / num_chunks; k < k_end; ++k) {
+                    if (is_finite_sample(points[2 * k]) && is_finite_sample(points[2 * k + 1])) {
+                        x_range.include(points[2 * k]);
+                        y_range.include(points[2 * k + 1]);
+                    }
+                }
+                ranges[2 * chunk] = x_range;
+                ranges[2 * chunk + 1] = y_range;
+            });
+            ValueRange x_range;
+            ValueRange y_range;
+            for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+                x_range.include(ranges[2 * chunk].m_min);
+                x_range.include(ranges[2 * chunk].m_max);
+                y_range.include(ranges[2 * chunk + 1].m_min);
+                y_range.include(ranges[2 * chunk + 1].m_max);
+            }
+            if (plot.is_empty() || x_range.is_empty()) {
+                return PointTransform{};
+            }
+            return PointTransform{ValueTransform::create(x_range, plot.width), ValueTransform::create(y_range, plot.height), false, x_range, y_range};
+        }
+
+        // Bin the points into counts, one cell per pixel of the plot area transform was created for, and return the
+        // largest count. Each task counts a chunk of the points into its own grid and the grids are then summed band
+        // by band, so no counter is shared between threads.
+        template <typename Points, Size2 CountSize, bool IsOwning, typename Allocator>
+        static auto bin_density(const Points& points, const PointTransform& transform, const ExecutionOptions& execution, ArrayNd<float, CountSize, IsOwning, Allocator>& counts) -> float {
+            const size_t width = counts.get_size().cols();
+            const size_t nele = counts.nele();
+            float* dst = counts.data().data();
+            if (transform.m_is_empty) {
+                std::fill(dst, dst + nele, 0.0F);
+                return 0.0F;
+            }
+            const size_t num_points = points.size() / 2;
+            // a grid per task only pays off once every task has at least as many points as there are pixels
+            const size_t num_chunks = get_num_chunks(execution, num_points, std::max(nele, k_min_chunk_points));
+            auto grids = get_thread_scratch<uint32_t>(num_chunks * nele);
+            for_each_task(execution, num_chunks, [&](size_t chunk) {
+                uint32_t* grid = grids.data() + chunk * nele;
+                std::fill(grid, grid + nele, 0U);
+                for (size_t k = chunk * num_points / num_chunks, k_end = (chunk + 1) * num_points / num_chunks; k < k_end; ++k) {
+                    Vec2<int32_t> pixel;
+                    if (project(points, k, transform, pixel)) {
+                        ++grid[static_cast<size_t>(pixel.y) * width + static_cast<size_t>(pixel.x)];
+                    }
+                }
+            });
+            const size_t tile_rows = execution.get_tile_rows();
+            const size_t num_tiles = (counts.get_size().rows() + tile_rows - 1) / tile_rows;
+            auto tile_max = get_thread_scratch<float>(num_tiles);
+            for_each_task(execution, num_tiles, [&](size_t tile) {
+                const size_t begin = tile * tile_rows * width;
+                const size_t end = std::min(nele, (tile + 1) * tile_rows * width);
+                float band_max = 0.0F;
+                for (size_t i = begin; i < end; ++i) {
+                    uint32_t count = 0;
+                    for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+                        count += grids[chunk * nele + i];
+                    }
+                    dst[i] = static_cast<float>(count);
+                    band_max = std::max(band_max, dst[i]);
+                }
+                tile_max[tile] = band_max;
+            });
+            return num_tiles > 0 ? *std::max_element(tile_max.begin(), tile_max.end()) : 0.0F;
+        }
+
+    private:
+        struct TileOffsetsTag {};
+        struct DensityTag {};
+
+        // a point in plot area coordinates sorted into a band of rows, with the colour of its series
+        struct BinnedPoint {
+            Vec2<int32_t> m_pixel;
+            RGBA m_colour;
+        };
+
+        // one task per chunk of at least min_points points, and a single chunk for the sequential policy
+        [[nodiscard]] static auto get_num_chunks(const ExecutionOptions& execution, size_t num_points, size_t min_points) -> size_t {
+            if (execution.get_policy() == ExecutionPolicy::SEQUENTIAL) {
+                return 1;
+            }
+            return std::clamp<size_t>(num_points / min_points, 1, execution.get_thread_pool().get_concurrency());
+        }
+
+        // series of point k in a flat layout of series_length points per series
+        struct UniformSeries {
+            size_t m_series_length = 0;
+
+            [[nodiscard]] constexpr auto operator()(size_t k) const noexcept -> size_t {
+                return k / m_series_length;
+            }
+        };
+
+        // the samples of a MultiSeriesView read as interleaved coordinates, see render_into()
+        template <typename T>
+        struct SeriesPoints {
+            const MultiSeriesView<T>* m_data = nullptr;
+
+            [[nodiscard]] constexpr auto size() const noexcept -> size_t {
+                return 2 * m_data->get_num_samples();
+            }
+
+            [[nodiscard]] constexpr auto operator[](size_t idx) const noexcept -> double {
+                const size_t k = idx / 2;
+                if (idx % 2 == 0) {
+                    if (m_data->has_x_values()) {
+                        return m_data->get_x_values()[k];
+                    }
+                    return static_cast<double>(k - m_data->get_series_offset(m_data->get_series_index(k)));
+                }
+                if (m_data->has_validity() && !is_bit_set(m_data->get_validity(), k)) {
+                    return std::numeric_limits<double>::quiet_NaN();
+                }
+                return static_cast<double>(m_data->data()[k]);
+            }
+        };
+
+        // The 2 * num_points interleaved coordinates of a render, see create_transform(). series_of maps a point to
+        // the series whose colour it is drawn in.
+        template <typename Points, typename SeriesOf>
+        static void render_points(const Points& points, const SeriesOf& series_of, const AppearanceOptions& appearance, const ExecutionOptions& execution, const RenderFrame& target) {
+            // a full render rewrites every pixel, so the damage is reported once here rather than from the workers
+            target.report(Rect{0, 0, target.m_cols, target.m_rows});
+            RenderFrame frame = target;
+            frame.m_damage = nullptr;
+            const auto transform = create_transform(points, frame.m_plot_area, execution);
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::RASTERIZE);
+            PJPLOT_PROFILE_BYTES(timer, points.size() * sizeof(points[0]) + frame.m_rows * frame.m_cols * sizeof(RGBA));
+            frame.m_x_range = transform.m_x_range;
+            frame.m_value_range = transform.m_y_range;
+            if (resolve_mode(appearance, points.size() / 2) == ScatterMode::DENSITY) {
+                render_density(points, transform, execution, frame);
+            } else {
+                render_markers(points, series_of, appearance.get_marker_radius(), transform, execution, frame);
+            }
+        }
+
+        // the pixel of point k in plot area coordinates, false if either coordinate is not finite
+        template <typename Points>
+        [[nodiscard]] constexpr static auto project(const Points& points, size_t k, const PointTransform& transform, Vec2<int32_t>& pixel) noexcept -> bool {
+            const auto x = points[2 * k];
+            const auto y = points[2 * k + 1];
+            if (!is_finite_sample(x) || !is_finite_sample(y)) {
+                return false;
+            }
+            pixel = Vec2<int32_t>{transform.m_x.to_col(static_cast<double>(x)), transform.m_y.to_row(static_cast<double>(y))};
+            return true;
+        }
+
+        // fill the marker centred on pixel (plot area coordinates), clipped to clip (image coordinates)
+        static void stamp_marker(const RenderFrame& frame, Vec2<int32_t> pixel, size_t radius, RGBA colour, Rect clip) noexcept {
+            const size_t col = frame.m_plot_area.x + static_cast<size_t>(pixel.x);
+            const size_t row = frame.m_plot_area.y + static_cast<size_t>(pixel.y);
+            const size_t col_begin = col - std::min(col, radius);
+            const size_t row_begin = row - std::min(row, radius);
+            fill_rect(frame.m_pixels, frame.m_cols, Rect{col_begin, row_begin, col + radius + 1 - col_begin, row + radius + 1 - row_begin}, colour, clip);
+        }
+
+        template <typename Points, typename SeriesOf>
+        static void render_markers(const Points& points, const SeriesOf& series_of, size_t radius, const PointTransform& transform, const ExecutionOptions& execution, const RenderFrame& frame) {
+            const Rect plot = frame.m_plot_area;
+            const size_t num_points = transform.m_is_empty ? 0 : points.size() / 2;
+            if (execution.get_policy() == ExecutionPolicy::SEQUENTIAL) {
+                frame.draw_underlay(0, frame.m_rows);
+                for (size_t k = 0; k < num_points; ++k) {
+                    Vec2<int32_t> pixel;
+                    if (project(points, k, transform, pixel)) {
+                        stamp_marker(frame, pixel, radius, get_series_colour(series_of(k)), plot);
+                    }
+                }
+                frame.draw_overlay(0, frame.m_rows);
+                return;
+            }
+
+            // the bands of image rows the marker of a point covers, markers are clipped to the plot area
+            const size_t tile_rows = execution.get_tile_rows();
+            const size_t num_tiles = (frame.m_rows + tile_rows - 1) / tile_rows;
+            const auto tile_range = [&](Vec2<int32_t> pixel) {
+                const auto row = static_cast<size_t>(pixel.y);
+                const size_t first = plot.y + row - std::min(row, radius);
+                const size_t last = plot.y + std::min(row + radius, plot.height - 1);
+                return Vec2<size_t>{first / tile_rows, last / tile_rows};
+            };
+
+            // counting sort of the points by band: count per (chunk, band), prefix sum in band then chunk order and
+            // scatter, which keeps the points of every band in their original order
+            const size_t num_chunks = get_num_chunks(execution, num_points, k_min_chunk_points);
+            auto offsets = get_thread_scratch<size_t>(num_chunks * num_tiles);
+            std::fill(offsets.begin(), offsets.end(), 0);
+            const auto for_each_point = [&](size_t chunk, const auto& fn) {
+                for (size_t k = chunk * num_points / num_chunks, k_end = (chunk + 1) * num_points / num_chunks; k < k_end; ++k) {
+                    Vec2<int32_t> pixel;
+                    if (project(points, k, transform, pixel)) {
+                        fn(k, pixel, tile_range(pixel));
+                    }
+                }
+            };
+            for_each_task(execution, num_chunks, [&](size_t chunk) {
+                size_t* chunk_counts = offsets.data() + chunk * num_tiles;
+                for_each_point(chunk, [chunk_counts](size_t, Vec2<int32_t>, Vec2<size_t> tiles) {
+                    for (size_t tile = tiles.x; tile <= tiles.y; ++tile) {
+                        ++chunk_counts[tile];
+                    }
+                });
+            });
+            auto tile_offsets = get_thread_scratch<size_t, TileOffsetsTag>(num_tiles + 1);
+            size_t total = 0;
+            for (size_t tile = 0; tile < num_tiles; ++tile) {
+                tile_offsets[tile] = total;
+                for (size_t chunk = 0; chunk < num_chunks; ++chunk) {
+                    const size_t count = offsets[chunk * num_tiles + tile];
+                    offsets[chunk * num_tiles + tile] = total;
+                    total += count;
+                }
+            }
+            tile_offsets[num_tiles] = total;
+            auto binned = get_thread_scratch<BinnedPoint>(total);
+            for_each_task(execution, num_chunks, [&](size_t chunk) {
+                size_t* cursors = offsets.data() + chunk * num_tiles;
+                for_each_point(chunk, [&](size_t k, Vec2<int32_t> pixel, Vec2<size_t> tiles) {
+                    const BinnedPoint point{pixel, get_series_colour(series_of(k))};
+                    for (size_t tile = tiles.x; tile <= tiles.y; ++tile) {
+                        binned[cursors[tile]++] = point;
+                    }
+                });
+            });
+
+            for_each_task(execution, num_tiles, [&](size_t tile) {
+                const size_t row_begin = tile * tile_rows;
+                const size_t row_end = std::min(frame.m_rows, (tile + 1) * tile_rows);
+                frame.draw_underlay(row_begin, row_end);
+                const Rect clip = plot.intersect(Rect{0, row_begin, frame.m_cols, row_end - row_begin});
+                for (size_t i = tile_offsets[tile]; i < tile_offsets[tile + 1]; ++i) {
+                    stamp_marker(frame, binned[i].m_pixel, radius, binned[i].m_colour, clip);
+                }
+                frame.draw_overlay(row_begin, row_end);
+            });
+        }
+
+        template <typename Points>
+        static void render_density(const Points& points, const PointTransform& transform, const ExecutionOptions& execution, const RenderFrame& frame) {
+            const Rect plot = frame.m_plot_area;
+            Mat2View<float, DynamicSize2> counts(DynamicSize2(plot.height, plot.width), get_thread_scratch<float, DensityTag>(plot.height * plot.width).data());
+            const float max_count = bin_density(points, transform, execution, counts);
+
+            // log tone map, so sparse outliers stay visible next to the dense core, through a lookup table of the ramp
+            std::array<RGBA, 256> lut{};
+            for (size_t i = 0; i < lut.size(); ++i) {
+                lut[i] = sample_density_ramp(static_cast<double>(i) / static_cast<double>(lut.size() - 1));
+            }
+            const double scale = max_count > 0.0F ? static_cast<double>(lut.size() - 1) / std::log1p(static_cast<double>(max_count)) : 0.0;
+            const float* src = counts.data().data();
+
+            const size_t tile_rows = execution.get_tile_rows();
+            for_each_task(execution, (frame.m_rows + tile_rows - 1) / tile_rows, [&](size_t tile) {
+                const size_t row_begin = tile * tile_rows;
+                const size_t row_end = std::min(frame.m_rows, (tile + 1) * tile_rows);
+                frame.draw_underlay(row_begin, row_end);
+                const Rect band = plot.intersect(Rect{0, row_begin, frame.m_cols, row_end - row_begin});
+                for (size_t row = band.y; row < band.y + band.height; ++row) {
+                    const float* count_row = src + (row - plot.y) * plot.width;
+                    RGBA* dst = frame.m_pixels + row * frame.m_cols + plot.x;
+                    for (size_t col = 0; col < plot.width; ++col) {
+                        if (count_row[col] > 0.0F) {
+                            dst[col] = lut[static_cast<size_t>(std::log1p(static_cast<double>(count_row[col])) * scale + 0.5)];
+                        }
+                    }
+                }
+                frame.draw_overlay(row_begin, row_end);
+            });
+        }
+    };
+
+    // sum, count and extremes of the finite samples under a bar, the aggregation stage of the bar renderer
+    struct BinSummary {
+        double m_sum = 0.0;
+        double m_min = std::numeric_limits<double>::infinity();
+        double m_max = -std::numeric_limits<double>::infinity();
+        size_t m_count = 0;
+
+        constexpr void merge(const BinSummary& other) noexcept {
+            m_sum += other.m_sum;
+            m_min = other.m_min < m_min ? other.m_min : m_min;
+            m_max = other.m_max > m_max ? other.m_max : m_max;
+            m_count += other.m_count;
+        }
+
+        // height of the bar, NaN when there are no finite samples so the bar is not drawn
+        [[nodiscard]] constexpr auto get(BarAggregation aggregation) const noexcept -> double {
+            if (m_count == 0) {
+                return std::numeric_limits<double>::quiet_NaN();
+            }
+            switch (aggregation) {
+                case BarAggregation::SUM:
+                    return m_sum;
+                case BarAggregation::MIN:
+                    return m_min;
+                case BarAggregation::MAX:
+                    return m_max;
+                default:
+                    return m_sum / static_cast<double>(m_count);
+            }
+        }
+    };
+
+    template <typename T>
+    constexpr auto summarise_samples_scalar(const T* data, size_t n) noexcept -> BinSummary {
+        BinSummary summary;
+        for (size_t i = 0; i < n; ++i) {
+            if (!is_finite_sample(data[i])) {
+                continue;
+            }
+            const auto val = static_cast<double>(data[i]);
+            summary.m_sum += val;
+            summary.m_min = val < summary.m_min ? val : summary.m_min;
+            summary.m_max = val > summary.m_max ? val : summary.m_max;
+            ++summary.m_count;
+        }
+        return summary;
+    }
+
+    // The vector kernels mask out non-finite lanes (x - x is 0 only for finite x): masked lanes add 0 to the sum and
+    // +/-inf to the extremes. Float sums are accumulated in double, like the scalar path.
+#if defined(PJPLOT_SIMD_X86)
+    inline auto summarise_samples_sse2(const double* data, size_t n) noexcept -> BinSummary {
+        const __m128d zero = _mm_setzero_pd();
+        const __m128d pos_inf = _mm_set1_pd(std::numeric_limits<double>::infinity());
+        const __m128d neg_inf = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+        __m128d v_sum = zero;
+        __m128d v_min = pos_inf;
+        __m128d v_max = neg_inf;
+        size_t count = 0;
+        size_t x = 0;
+        for (; x + 2 <= n; x += 2) {
+            const __m128d val = _mm_loadu_pd(data + x);
+            const __m128d finite = _mm_cmpeq_pd(_mm_sub_pd(val, val), zero);
+            const __m128d masked = _mm_and_pd(finite, val);
+            v_sum = _mm_add_pd(v_sum, masked);
+            v_min = _mm_min_pd(v_min, _mm_or_pd(masked, _mm_andnot_pd(finite, pos_inf)));
+            v_max = _mm_max_pd(v_max, _mm_or_pd(masked, _mm_andnot_pd(finite, neg_inf)));
+            count += static_cast<size_t>(std::popcount(static_cast<unsigned>(_mm_movemask_pd(finite))));
+        }
+        std::array<double, 2> sum{};
+        std::array<double, 2> min{};
+        std::array<double, 2> max{};
+        _mm_storeu_pd(sum.data(), v_sum);
+        _mm_storeu_pd(min.data(), v_min);
+        _mm_storeu_pd(max.data(), v_max);
+        BinSummary summary{sum[0] + sum[1], std::min(min[0], min[1]), std::max(max[0], max[1]), count};
+        summary.merge(summarise_samples_scalar(data + x, n - x));
+        return summary;
+    }
+
+    inline auto summarise_samples_sse2(const float* data, size_t n) noexcept -> BinSummary {
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 pos_inf = _mm_set1_ps(std::numeric_limits<float>::infinity());
+        const __m128 neg_inf = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        __m128d v_sum_lo = _mm_setzero_pd();
+        __m128d v_sum_hi = _mm_setzero_pd();
+        __m128 v_min = pos_inf;
+        __m128 v_max = neg_inf;
+        size_t count = 0;
+        size_t x = 0;
+        for (; x + 4 <= n; x += 4) {
+            const __m128 val = _mm_loadu_ps(data + x);
+            const __m128 finite = _mm_cmpeq_ps(_mm_sub_ps(val, val), zero);
+            const __m128 masked = _mm_and_ps(finite, val);
+            v_sum_lo = _mm_add_pd(v_sum_lo, _mm_cvtps_pd(masked));
+            v_sum_hi = _mm_add_pd(v_sum_hi, _mm_cvtps_pd(_mm_movehl_ps(masked, masked)));
+            v_min = _mm_min_ps(v_min, _mm_or_ps(masked, _mm_andnot_ps(finite, pos_inf)));
+            v_max = _mm_max_ps(v_max, _mm_or_ps(masked, _mm_andnot_ps(finite, neg_inf)));
+            count += static_cast<size_t>(std::popcount(static_cast<unsigned>(_mm_movemask_ps(finite))));
+        }
+        std::array<double, 2> sum{};
+        std::array<float, 4> min{};
+        std::array<float, 4> max{};
+        _mm_storeu_pd(sum.data(), _mm_add_pd(v_sum_lo, v_sum_hi));
+        _mm_storeu_ps(min.data(), v_min);
+        _mm_storeu_ps(max.data(), v_max);
+        BinSummary summary{sum[0] + sum[1], *std::min_element(min.begin(), min.end()), *std::max_element(max.begin(), max.end()), count};
+        summary.merge(summarise_samples_scalar(data + x, n - x));
+        return summary;
+    }
+#endif
+
+#if defined(PJPLOT_SIMD_NEON)
+    inline auto summarise_samples_neon(const double* data, size_t n) noexcept -> BinSummary {
+        const float64x2_t zero = vdupq_n_f64(0.0);
+        const float64x2_t pos_inf = vdupq_n_f64(std::numeric_limits<double>::infinity());
+        const float64x2_t neg_inf = vdupq_n_f64(-std::numeric_limits<double>::infinity());
+        float64x2_t v_sum = zero;
+        float64x2_t v_min = pos_inf;
+        float64x2_t v_max = neg_inf;
+        uint64x2_t v_count = vdupq_n_u64(0);
+        size_t x = 0;
+        for (; x + 2 <= n; x += 2) {
+            const float64x2_t val = vld1q_f64(data + x);
+            const uint64x2_t finite = vceqq_f64(vsubq_f64(val, val), zero);
+            v_sum = vaddq_f64(v_sum, vbslq_f64(finite, val, zero));
+            v_min = vminq_f64(v_min, vbslq_f64(finite, val, pos_inf));
+            v_max = vmaxq_f64(v_max, vbslq_f64(finite, val, neg_inf));
+            v_count = vsubq_u64(v_count, finite);
+        }
+        BinSummary summary{vaddvq_f64(v_sum), vminvq_f64(v_min), vmaxvq_f64(v_max), static_cast<size_t>(vaddvq_u64(v_count))};
+        summary.merge(summarise_samples_scalar(data + x, n - x));
+        return summary;
+    }
+
+    inline auto summarise_samples_neon(const float* data, size_t n) noexcept -> BinSummary {
+        const float32x4_t zero = vdupq_n_f32(0.0F);
+        const float32x4_t pos_inf = vdupq_n_f32(std::numeric_limits<float>::infinity());
+        const float32x4_t neg_inf = vdupq_n_f32(-std::numeric_limits<float>::infinity());
+        float64x2_t v_sum = vdupq_n_f64(0.0);
+        float32x4_t v_min = pos_inf;
+        float32x4_t v_max = neg_inf;
+        uint64x2_t v_count = vdupq_n_u64(0);
+        size_t x = 0;
+        for (; x + 4 <= n; x += 4) {
+            const float32x4_t val = vld1q_f32(data + x);
+            const uint32x4_t finite = vceqq_f32(vsubq_f32(val, val), zero);
+            const float32x4_t masked = vbslq_f32(finite, val, zero);
+            v_sum = vaddq_f64(v_sum, vaddq_f64(vcvt_f64_f32(vget_low_f32(masked)), vcvt_high_f64_f32(masked)));
+            v_min = vminq_f32(v_min, vbslq_f32(finite, val, pos_inf));
+            v_max = vmaxq_f32(v_max, vbslq_f32(finite, val, neg_inf));
+            v_count = vpadalq_u32(v_count, vshrq_n_u32(finite, 31));
+        }
+        BinSummary summary{vaddvq_f64(v_sum), vminvq_f32(v_min), vmaxvq_f32(v_max), static_cast<size_t>(vaddvq_u64(v_count))};
+        summary.merge(summarise_samples_scalar(data + x, n - x));
+        return summary;
+    }
+#endif
+
+    // summary of n contiguous samples, vectorized for float and double and scalar for the other sample types
+    template <typename T>
+    constexpr auto summarise_samples(const T* data, size_t n) noexcept -> BinSummary {
+#if defined(PJPLOT_SIMD_X86) || defined(PJPLOT_SIMD_NEON)
+        if constexpr (std::is_same_v<T, double> || std::is_same_v<T, float>) {
+            if (!std::is_constant_evaluated()) {
+#  if defined(PJPLOT_SIMD_X86)
+                return summarise_samples_sse2(data, n);
+#  else
+                return summarise_samples_neon(data, n);
+#  endif
+            }
+        }
+#endif
+        return summarise_samples_scalar(data, n);
+    }
+
+    // extremes of the finite samples in one bucket of a LodIndex level, empty (m_min > m_max) when there are none
+    template <typename T>
+    struct LodBucket {
+        T m_min = std::numeric_limits<T>::max();
+        T m_max = std::numeric_limits<T>::lowest();
+
+        [[nodiscard]] constexpr auto is_empty() const noexcept -> bool {
+            return m_min > m_max;
+        }
+
+        constexpr void merge(const LodBucket& other) noexcept {
+            m_min = other.m_min < m_min ? other.m_min : m_min;
+            m_max = other.m_max > m_max ? other.m_max : m_max;
+        }
+    };
+
+    // Level-of-detail index of a long series for interactive zoom and pan. Level l of the pyramid holds a min/max
+    // bucket per 2^(base_level + l) samples, up to a single bucket for the whole series, so a line chart of any
+    // x-range reads a few buckets per output column from the level matching its zoom instead of rescanning the
+    // samples. Windows zoomed in below the finest level read the samples, at most 2^(base_level + 1) per column,
+    // which keeps the index to about 2 / 2^base_level buckets per sample. append() extends it as data arrives and
+    // write() / load() keep it next to a mapped source file.
+    template <typename T>
+        requires std::is_arithmetic_v<T>
+    class LodIndex {
+    public:
+        static constexpr size_t k_default_base_level = 6;
+
+        LodIndex() : LodIndex(k_default_base_level) {
+
+        }
+
+        explicit LodIndex(size_t base_level)
+        : m_base_level(base_level) {
+            if (base_level == 0 || base_level >= 48) {
+                throw std::invalid_argument("Error: level-of-detail base level must be in [1, 48)");
+            }
+        }
+
+        // the index of samples, built in one pass
+        [[nodiscard]] static auto build(std::span<const T> samples, size_t base_level = k_default_base_level) -> LodIndex {
+            LodIndex index(base_level);
+            index.append(samples);
+            return index;
+        }
+
+        // Extend the index by samples appended to the series. Only the buckets the new samples fall into are
+        // updated, so the cost is proportional to the new data.
+        void append(std::span<const T> samples) {
+            if (samples.empty()) {
+                return;
+            }
+            const size_t old_num_samples = m_num_samples;
+            m_num_samples += samples.size();
+            if (m_levels.empty()) {
+                m_levels.emplace_back(DynamicSize1(0));
+            }
+            auto& finest = m_levels[0];
+            finest.resize(DynamicSize1(get_num_buckets(0)));
+            const size_t bucket_samples = size_t{1} << m_base_level;
+            for (size_t idx = old_num_samples, pos = 0; pos < samples.size();) {
+                const size_t bucket = idx >> m_base_level;
+                const size_t n = std::min((bucket + 1) * bucket_samples - idx, samples.size() - pos);
+                const auto summary = summarise_samples(samples.data() + pos, n);
+                if (summary.m_count > 0) {
+                    finest[bucket].merge(LodBucket<T>{static_cast<T>(summary.m_min), static_cast<T>(summary.m_max)});
+                }
+                pos += n;
+                idx += n;
+            }
+            // rebuild the coarser buckets over the changed ones, adding levels until one bucket covers the series
+            size_t first_changed = old_num_samples >> m_base_level;
+            for (size_t level = 1; m_levels[level - 1].nele() > 1; ++level) {
+                if (level == m_levels.size()) {
+                    m_levels.emplace_back(DynamicSize1(0));
+                    first_changed = 0;
+                }
+                const auto& finer = m_levels[level - 1];
+                auto& coarser = m_levels[level];
+                first_changed /= 2;
+                coarser.resize(DynamicSize1(get_num_buckets(level)));
+                for (size_t bucket = first_changed; bucket < coarser.nele(); ++bucket) {
+                    LodBucket<T> merged = finer[2 * bucket];
+                    if (2 * bucket + 1 < finer.nele()) {
+                        merged.merge(finer[2 * bucket + 1]);
+                    }
+                    coarser[bucket] = merged;
+                }
+            }
+        }
+
+        [[nodiscard]] auto get_num_samples() const noexcept -> size_t {
+            return m_num_samples;
+        }
+
+        [[nodiscard]] auto get_base_level() const noexcept -> size_t {
+            return m_base_level;
+        }
+
+        [[nodiscard]] auto get_num_levels() const noexcept -> size_t {
+            return m_levels.size();
+        }
+
+        // samples per bucket of level
+        [[nodiscard]] auto get_bucket_samples(size_t level) const noexcept -> size_t {
+            return size_t{1} << (m_base_level + level);
+        }
+
+        [[nodiscard]] auto get_level(size_t level) const -> std::span<const LodBucket<T>> {
+            if (level >= m_levels.size()) {
+                throw std::invalid_argument("Error: level-of-detail level out of range");
+            }
+            return m_levels[level].data();
+        }
+
+        // Summaries of samples [x_begin, x_end) drawn across width columns, column c owning the samples given by
+        // MinMaxDecimator::column_begin(). The level is the coarsest with buckets of at most half a column, each
+        // column merges the buckets starting inside it, so a bucket may stray up to half a column over the border.
+        // Only the first and last sample of every column are read from samples, to connect the line to its neighbours.
+        // Returns false, writing nothing, when the window is too short for the index and the samples should be read.
+        auto summarise_columns(std::span<const T> samples, size_t x_begin, size_t x_end, size_t width, ColumnSummary<double>* columns) const -> bool {
+            if (x_begin >= x_end || x_end > m_num_samples || samples.size() < m_num_samples) {
+                throw std::invalid_argument("Error: x-range is empty or past the end of the level-of-detail index, or the index covers more samples than were given");
+            }
+            const size_t len = x_end - x_begin;
+            const size_t half_column = width > 0 ? len / (2 * width) : 0;
+            if (half_column < (size_t{1} << m_base_level)) {
+                return false;
+            }
+            const size_t level = std::min<size_t>(static_cast<size_t>(std::bit_width(half_column)) - 1 - m_base_level, m_levels.size() - 1);
+            const size_t shift = m_base_level + level;
+            const size_t round_up = (size_t{1} << shift) - 1;
+            const auto& buckets = m_levels[level];
+            for (size_t col = 0; col < width; ++col) {
+                const size_t begin = x_begin + MinMaxDecimator::column_begin(col, len, width);
+                const size_t end = x_begin + MinMaxDecimator::column_begin(col + 1, len, width);
+                size_t bucket = (begin + round_up) >> shift;
+                size_t bucket_end = (end + round_up) >> shift;
+                if (bucket >= bucket_end) {
+                    // no bucket starts in the column, fall back to the one it lies in
+                    bucket = begin >> shift;
+                    bucket_end = bucket + 1;
+                }
+                LodBucket<T> merged;
+                for (; bucket < bucket_end; ++bucket) {
+                    merged.merge(buckets[bucket]);
+                }
+                ColumnSummary<double> summary;
+                if (!merged.is_empty()) {
+                    // a line through a non-finite end sample enters or leaves the column through its centre instead
+                    summary.m_min = static_cast<double>(merged.m_min);
+                    summary.m_max = static_cast<double>(merged.m_max);
+                    const double centre = (summary.m_min + summary.m_max) * 0.5;
+                    summary.m_first = is_finite_sample(samples[begin]) ? static_cast<double>(samples[begin]) : centre;
+                    summary.m_last = is_finite_sample(samples[end - 1]) ? static_cast<double>(samples[end - 1]) : centre;
+                    summary.m_count = 1;
+                }
+                columns[col] = summary;
+            }
+            return true;
+        }
+
+        // where the index of the samples in source_path is kept
+        [[nodiscard]] static auto get_index_path(const std::string& source_path) -> std::string {
+            return source_path + ".lod";
+        }
+
+        // Serialize the index, in the byte order of this machine like mapped samples. load() of the bytes restores
+        // it, including the partly filled buckets at the end, so a loaded index can carry on with append().
+        template <ByteSink Sink>
+        void write(Sink&& sink) const {
+            const Header header{k_magic, k_type_tag, static_cast<uint32_t>(sizeof(T)), m_base_level, m_num_samples, m_levels.size()};
+            sink(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(&header), sizeof(header)));
+            for (const auto& level : m_levels) {
+                const auto buckets = level.data();
+                sink(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(buckets.data()), buckets.size_bytes()));
+            }
+        }
+
+        // the index written by write(), e.g. MappedFile::get_bytes() of the file at get_index_path()
+        [[nodiscard]] static auto load(std::span<const std::byte> bytes) -> ResultWithValue<LodIndex> {
+            Header header{};
+            if (bytes.size() < sizeof(header)) {
+                return ResultWithValue<LodIndex>::Failure("Error: level-of-detail index is truncated");
+            }
+            std::memcpy(&header, bytes.data(), sizeof(header));
+            if (header.m_magic != k_magic || header.m_type_tag != k_type_tag || header.m_sample_size != sizeof(T)) {
+                return ResultWithValue<LodIndex>::Failure("Error: not a level-of-detail index of " + std::string(PjPlot::to_string<T>()) + " samples");
+            }
+            if (header.m_base_level == 0 || header.m_base_level >= 48) {
+                return ResultWithValue<LodIndex>::Failure("Error: level-of-detail index has an invalid base level");
+            }
+            LodIndex index(static_cast<size_t>(header.m_base_level));
+            index.m_num_samples = static_cast<size_t>(header.m_num_samples);
+            // the levels append() builds for this many samples, checked before any of them is allocated
+            if (header.m_num_levels != get_num_levels(index.m_num_samples, index.m_base_level)) {
+                return ResultWithValue<LodIndex>::Failure("Error: level-of-detail index has the wrong number of levels for its samples");
+            }
+            size_t offset = sizeof(header);
+            for (size_t level = 0; level < header.m_num_levels; ++level) {
+                const size_t num_buckets = index.get_num_buckets(level);
+                if ((bytes.size() - offset) / sizeof(LodBucket<T>) < num_buckets) {
+                    return ResultWithValue<LodIndex>::Failure("Error: level-of-detail index is truncated");
+                }
+                auto& buckets = index.m_levels.emplace_back(DynamicSize1(num_buckets));
+                std::memcpy(buckets.data().data(), bytes.data() + offset, num_buckets * sizeof(LodBucket<T>));
+                offset += num_buckets * sizeof(LodBucket<T>);
+            }
+            if (offset != bytes.size()) {
+                return ResultWithValue<LodIndex>::Failure("Error: level-of-detail index has trailing bytes");
+            }
+            return ResultWithValue<LodIndex>(std::move(index));
+        }
+
+    private:
+        static constexpr std::array<char, 8> k_magic = {'P', 'J', 'L', 'O', 'D', '0', '0', '1'};
+        static constexpr auto k_type_tag = static_cast<uint32_t>(v_AllowedTypes(T{}).index());
+
+        struct Header {
+            std::array<char, 8> m_magic;
+            uint32_t m_type_tag;
+            uint32_t m_sample_size;
+            uint64_t m_base_level;
+            uint64_t m_num_samples;
+            uint64_t m_num_levels;
+        };
+
+        [[nodiscard]] auto get_num_buckets(size_t level) const noexcept -> size_t {
+            const size_t shift = m_base_level + level;
+            return (m_num_samples >> shift) + ((m_num_samples & ((size_t{1} << shift) - 1)) != 0 ? 1 : 0);
+        }
+
+        // levels of an index of num_samples, halving the buckets until one covers the series as append() does
+        [[nodiscard]] static auto get_num_levels(size_t num_samples, size_t base_level) noexcept -> size_t {
+            if (num_samples == 0) {
+                return 0;
+            }
+            size_t num_buckets = (num_samples >> base_level) + ((num_samples & ((size_t{1} << base_level) - 1)) != 0 ? 1 : 0);
+            size_t num_levels = 1;
+            for (; num_buckets > 1; ++num_levels) {
+                num_buckets = (num_buckets + 1) / 2;
+            }
+            return num_levels;
+        }
+
+        size_t m_base_level;
+        size_t m_num_samples = 0;
+        std::vector<Array1d<LodBucket<T>, DynamicSize1>> m_levels; ///< finest first
+    };
+
+    // Bar charts, the bars of the series are drawn side by side in equal width slots. The samples are reduced to one
+    // value per bar in a single vectorized pass, then the bar columns of every series are turned into [lo, hi] row
+    // runs and filled with the span kernels of the line rasterizer, which store whole rows of a bar at a time.
+    class BarRasterizer {
+    public:
+        static constexpr size_t k_default_num_bins = 32;
+
+        // draw num_series series of series_length samples, back to back, into a frame owned by the caller
+        template <typename ElementType, typename Pixel>
+        static void render_into(std::span<const ElementType> plot_data, size_t series_length, size_t num_series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target) {
+            static_assert(std::is_arithmetic_v<ElementType>, "Error: bar charts require arithmetic sample types");
+            check_size(plot_data, series_length, num_series);
+            render_samples(plot_data, FlatLayout{series_length, num_series}, appearance, execution, target);
+        }
+
+        // draw the series of an expression laid out like plot_data above, without materialising it
+        template <ArrayExpression Expr, typename Pixel>
+        static void render_into(const Expr& plot_data, size_t series_length, size_t num_series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target) {
+            static_assert(std::is_arithmetic_v<typename Expr::value_type>, "Error: bar charts require arithmetic sample types");
+            check_size(plot_data, series_length, num_series);
+            render_samples(plot_data, FlatLayout{series_length, num_series}, appearance, execution, target);
+        }
+
+        // Draw the series of a MultiSeriesView. Bar slot i covers the same run of sample positions in every series,
+        // split from the longest one, so a shorter series has no bars past its end. Invalid samples are skipped and
+        // x-values are not used, bars are placed by position.
+        template <typename T, typename Pixel>
+        static void render_into(const MultiSeriesView<T>& data, const AppearanceOptions& appearance, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target) {
+            static_assert(std::is_arithmetic_v<T>, "Error: bar charts require arithmetic sample types");
+            if (data.has_validity()) {
+                render_samples(data.get_masked_samples(), data, appearance, execution, target);
+            } else {
+                render_samples(std::span<const T>(data.data(), data.get_num_samples()), data, appearance, execution, target);
+            }
+        }
+
+        // lay out num_series series of series_length samples, back to back, and reduce them to row runs without
+        // drawing anything, see LineRasterizer::draw_chart()
+        template <typename ElementType>
+        static auto prepare_chart(std::span<const ElementType> plot_data, size_t series_length, size_t num_series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const RenderFrame& target) -> PreparedChart {
+            static_assert(std::is_arithmetic_v<ElementType>, "Error: bar charts require arithmetic sample types");
+            check_size(plot_data, series_length, num_series);
+            PreparedChart chart{target};
+            chart.m_frame.m_damage = nullptr;
+            chart.m_spans = compute_bar_spans(plot_data, FlatLayout{series_length, num_series}, appearance, execution, chart.m_frame);
+            return chart;
+        }
+
+        // bars per series for a width wide plot, at least one and few enough for every bar to get a column
+        [[nodiscard]] constexpr static auto get_num_bars(const AppearanceOptions& appearance, size_t series_length, size_t num_series, size_t width) noexcept -> size_t {
+            size_t num_bars = appearance.get_num_bars();
+            if (num_bars == 0) {
+                num_bars = appearance.get_bar_aggregation() == BarAggregation::HISTOGRAM ? k_default_num_bins : series_length;
+            }
+            return std::clamp<size_t>(num_bars, 1, std::max<size_t>(width / std::max<size_t>(num_series, 1), 1));
+        }
+
+        // Reduce every series to num_bars values, written series after series into values. For the aggregations
+        // bar i covers an equal run of consecutive samples and is NaN when none of them is finite; for histograms
+        // it is the number of samples in bin i of the range of all series. Samples is a std::span or an expression.
+        template <typename Samples>
+        static void aggregate(const Samples& plot_data, size_t series_length, size_t num_series, size_t num_bars, BarAggregation aggregation, const ExecutionOptions& execution, std::span<double> values) {
+            if (plot_data.size() < series_length * num_series) {
+                throw std::invalid_argument("Error: bar aggregation buffers are smaller than the number of bars or samples");
+            }
+            aggregate(plot_data, FlatLayout{series_length, num_series}, num_bars, aggregation, execution, values);
+        }
+
+        // As above for samples laid out by layout, a MultiSeriesView or the flat layout, series i being the
+        // get_series_length(i) samples of plot_data from get_series_offset(i). Bar i covers the same run of positions
+        // in every series, a shorter series having NaN bars past its end.
+        template <typename Samples, typename Layout>
+        static void aggregate(const Samples& plot_data, const Layout& layout, size_t num_bars, BarAggregation aggregation, const ExecutionOptions& execution, std::span<double> values) {
+            const size_t num_series = layout.get_num_series();
+            if (values.size() < num_series * num_bars) {
+                throw std::invalid_argument("Error: bar aggregation buffers are smaller than the number of bars or samples");
+            }
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::DECIMATE);
+            PJPLOT_PROFILE_BYTES(timer, layout.get_num_samples() * sizeof(plot_data[0]));
+            const size_t num_tasks = get_num_tasks(execution, num_series);
+            if (aggregation == BarAggregation::HISTOGRAM) {
+                histogram(plot_data, layout, num_bars, num_tasks, execution, values);
+                return;
+            }
+            // the bars of all series are split evenly between the tasks, each bar is one vectorized pass over its samples
+            const size_t series_length = layout.get_max_series_length();
+            const size_t total_bars = num_series * num_bars;
+            for_each_task(execution, num_tasks, [&](size_t task) {
+                for (size_t idx = task * total_bars / num_tasks, idx_end = (task + 1) * total_bars / num_tasks; idx < idx_end; ++idx) {
+                    const size_t series_idx = idx / num_bars;
+                    const size_t bar = idx % num_bars;
+                    const size_t length = layout.get_series_length(series_idx);
+                    const size_t begin = std::min(bar * series_length / num_bars, length);
+                    const size_t end = std::min((bar + 1) * series_length / num_bars, length);
+                    values[idx] = summarise_run(plot_data, layout.get_series_offset(series_idx) + begin, end - begin).get(aggregation);
+                }
+            });
+        }
+
+    private:
+        // num_series series of series_length samples back to back, with the accessors of MultiSeriesView
+        struct FlatLayout {
+            size_t m_series_length = 0;
+            size_t m_num_series = 0;
+
+            [[nodiscard]] constexpr auto get_num_series() const noexcept -> size_t {
+                return m_num_series;
+            }
+
+            [[nodiscard]] constexpr auto get_series_offset(size_t series_idx) const noexcept -> size_t {
+                return series_idx * m_series_length;
+            }
+
+            [[nodiscard]] constexpr auto get_series_length(size_t) const noexcept -> size_t {
+                return m_series_length;
+            }
+
+            [[nodiscard]] constexpr auto get_max_series_length() const noexcept -> size_t {
+                return m_series_length;
+            }
+
+            [[nodiscard]] constexpr auto get_num_samples() const noexcept -> size_t {
+                return m_series_length * m_num_series;
+            }
+        };
+
+        template <typename Samples>
+        static void check_size(const Samples& plot_data, size_t series_length, size_t num_series) {
+            if (plot_data.size() < series_length * num_series) {
+                throw std::invalid_argument("Error: plot data is smaller than series_length * num_series");
+            }
+        }
+
+        // render_into() for samples in a std::span or an expression, laid out by layout
+        template <typename Samples, typename Layout, typename Pixel>
+        static void render_samples(const Samples& plot_data, const Layout& layout, const AppearanceOptions& appearance, const ExecutionOptions& execution, const BasicRenderFrame<Pixel>& target) {
+            // a full render rewrites every pixel, so the damage is reported once here rather than from the workers
+            target.report(Rect{0, 0, target.m_cols, target.m_rows});
+            BasicRenderFrame<Pixel> frame = target;
+            frame.m_damage = nullptr;
+            const auto spans = compute_bar_spans(plot_data, layout, appearance, execution, frame);
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::RASTERIZE);
+            PJPLOT_PROFILE_BYTES(timer, frame.m_rows * frame.m_cols * sizeof(Pixel));
+
+            // the sequential policy fills the image in one band
+            const size_t tile_rows = execution.get_policy() == ExecutionPolicy::SEQUENTIAL ? std::max<size_t>(frame.m_rows, 1) : execution.get_tile_rows();
+            for_each_task(execution, (frame.m_rows + tile_rows - 1) / tile_rows, [&](size_t tile) {
+                const size_t row_begin = tile * tile_rows;
+                const size_t row_end = std::min(frame.m_rows, (tile + 1) * tile_rows);
+                frame.draw_underlay(row_begin, row_end);
+                LineRasterizer::fill_series_spans(spans, frame, frame.m_pixels, frame.m_cols, Rect{0, row_begin, frame.m_cols, row_end - row_begin});
+                frame.draw_overlay(row_begin, row_end);
+            });
+        }
+
+        // Aggregate the bars and turn every series into row runs, setting the axes of frame to the ones drawn.
+        template <typename Samples, typename Layout, typename Pixel>
+        static auto compute_bar_spans(const Samples& plot_data, const Layout& layout, const AppearanceOptions& appearance, const ExecutionOptions& execution, BasicRenderFrame<Pixel>& frame) -> SeriesSpans {
+            const size_t series_length = layout.get_max_series_length();
+            const size_t num_series = layout.get_num_series();
+            const Rect plot = frame.m_plot_area;
+            const size_t num_bars = get_num_bars(appearance, series_length, num_series, plot.width);
+            auto values = get_thread_scratch<double>(num_series * num_bars);
+            aggregate(plot_data, layout, num_bars, appearance.get_bar_aggregation(), execution, values);
+
+            // bars grow from 0, so it is always on the value axis unless the axis is fixed
+            ValueRange range = frame.m_value_range;
+            if (range.is_empty()) {
+                range.include(0.0);
+                for (const double val : values) {
+                    range.include(val);
+                }
+            }
+            const bool is_empty = plot.is_empty() || values.empty();
+            const auto transform = is_empty ? ValueTransform() : ValueTransform::create(range, plot.height);
+            // the slots divide the samples evenly, so the x axis counts samples; histogram bins are not labelled
+            frame.m_value_range = is_empty ? ValueRange{} : range;
+            frame.m_x_range = is_empty || appearance.get_bar_aggregation() == BarAggregation::HISTOGRAM ? ValueRange{} : ValueRange{0.0, static_cast<double>(series_length)};
+            const size_t width = plot.width;
+            const size_t num_blocks = (width + LineRasterizer::k_block_cols - 1) / LineRasterizer::k_block_cols;
+            const size_t num_active = is_empty ? 0 : num_series;
+            auto spans = get_thread_scratch<int32_t>(2 * num_active * width);
+            auto bounds = get_thread_scratch<Vec2<int32_t>>(num_active * num_blocks);
+            for_each_task(execution, num_active, [&](size_t series_idx) {
+                int32_t* lo = spans.data() + 2 * series_idx * width;
+                compute_spans(values.subspan(series_idx * num_bars, num_bars), series_idx, num_series, transform, width, lo, lo + width, bounds.data() + series_idx * num_blocks);
+            });
+            return SeriesSpans{spans.data(), bounds.data(), num_active, width};
+        }
+
+        // one task per series, or a few per thread when there are fewer series than threads
+        [[nodiscard]] static auto get_num_tasks(const ExecutionOptions& execution, size_t num_series) -> size_t {
+            if (execution.get_policy() == ExecutionPolicy::SEQUENTIAL) {
+                return 1;
+            }
+            return std::max<size_t>(num_series, 4 * execution.get_thread_pool().get_concurrency());
+        }
+
+        // summary of the n samples from begin, read in place from a span
+        template <typename ElementType>
+        [[nodiscard]] static auto summarise_run(std::span<const ElementType> plot_data, size_t begin, size_t n) noexcept -> BinSummary {
+            return summarise_samples(plot_data.data() + begin, n);
+        }
+
+        // an expression is computed k_expression_block elements at a time into a stack buffer, so its run still goes
+        // through the vectorized summary without materialising more than a block
+        template <ArrayExpression Expr>
+        [[nodiscard]] static auto summarise_run(const Expr& plot_data, size_t begin, size_t n) noexcept -> BinSummary {
+            std::array<typename Expr::value_type, k_expression_block> block;
+            BinSummary summary;
+            for (size_t offset = 0; offset < n; offset += k_expression_block) {
+                const size_t count = std::min(k_expression_block, n - offset);
+                PJPLOT_IVDEP
+                for (size_t i = 0; i < count; ++i) {
+                    block[i] = plot_data[begin + offset + i];
+                }
+                summary.merge(summarise_samples(block.data(), count));
+            }
+            return summary;
+        }
+
+        template <typename Samples, typename Layout>
+        static void histogram(const Samples& plot_data, const Layout& layout, size_t num_bins, size_t num_tasks, const ExecutionOptions& execution, std::span<double> counts) {
+            const size_t num_series = layout.get_num_series();
+            auto summaries = get_thread_scratch<BinSummary>(num_series);
+            for_each_task(execution, num_series, [&](size_t series_idx) {
+                summaries[series_idx] = summarise_run(plot_data, layout.get_series_offset(series_idx), layout.get_series_length(series_idx));
+            });
+            BinSummary all;
+            for (const auto& summary : summaries) {
+                all.merge(summary);
+            }
+            std::fill(counts.begin(), counts.begin() + static_cast<std::ptrdiff_t>(num_series * num_bins), 0.0);
+            if (all.m_count == 0) {
+                return;
+            }
+            // a flat data set puts every sample into the first bin
+            const double scale = all.m_max > all.m_min ? static_cast<double>(num_bins) / (all.m_max - all.m_min) : 0.0;
+            const size_t num_groups = std::min(num_tasks, num_series);
+            for_each_task(execution, num_groups, [&](size_t group) {
+                for (size_t series_idx = group * num_series / num_groups, series_end = (group + 1) * num_series / num_groups; series_idx < series_end; ++series_idx) {
+                    const size_t offset = layout.get_series_offset(series_idx);
+                    const size_t length = layout.get_series_length(series_idx);
+                    double* bins = counts.data() + series_idx * num_bins;
+                    for (size_t k = 0; k < length; ++k) {
+                        const auto val = plot_data[offset + k];
+                        if (is_finite_sample(val)) {
+                            const auto bin = static_cast<size_t>((static_cast<double>(val) - all.m_min) * scale);
+                            bins[std::min(bin, num_bins - 1)] += 1.0;
+                        }
+                    }
+                }
+            });
+        }
+
+        // the row run of every column of one series, empty outside its bars, and the rows touched by each block
+        static void compute_spans(std::span<const double> values, size_t series_idx, size_t num_series, const ValueTransform& transform, size_t width, int32_t* lo, int32_t* hi, Vec2<int32_t>* block_bounds) noexcept {
+            constexpr size_t k_block_cols = LineRasterizer::k_block_cols;
+            std::fill(lo, lo + width, std::numeric_limits<int32_t>::max());
+            std::fill(hi, hi + width, std::numeric_limits<int32_t>::min());
+            const size_t num_blocks = (width + k_block_cols - 1) / k_block_cols;
+            std::fill(block_bounds, block_bounds + num_blocks, Vec2<int32_t>{std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min()});
+            const int32_t base_row = transform.to_row(0.0);
+            const size_t num_bars = values.size();
+            for (size_t bar = 0; bar < num_bars; ++bar) {
+                if (!is_finite_sample(values[bar])) {
+                    continue;
+                }
+                const int32_t value_row = transform.to_row(values[bar]);
+                const int32_t top = std::min(base_row, value_row);
+                const int32_t bottom = std::max(base_row, value_row);
+                const auto cols = get_bar_columns(bar, series_idx, num_bars, num_series, width);
+                std::fill(lo + cols.x, lo + cols.y, top);
+                std::fill(hi + cols.x, hi + cols.y, bottom);
+                for (size_t block = cols.x / k_block_cols; block * k_block_cols < cols.y; ++block) {
+                    block_bounds[block].x = std::min(block_bounds[block].x, top);
+                    block_bounds[block].y = std::max(block_bounds[block].y, bottom);
+                }
+            }
+        }
+
+        // Columns [x, y) of a bar. Bar slot i spans [i * width / num_bars, (i + 1) * width / num_bars), a tenth of the
+        // slot is left free either side and the rest is shared between the series.
+        [[nodiscard]] constexpr static auto get_bar_columns(size_t bar, size_t series_idx, size_t num_bars, size_t num_series, size_t width) noexcept -> Vec2<size_t> {
+            const size_t slot_begin = bar * width / num_bars;
+            const size_t slot_end = (bar + 1) * width / num_bars;
+            const size_t gap = (slot_end - slot_begin) / 10;
+            const size_t begin = slot_begin + gap;
+            const size_t inner = slot_end - gap - begin;
+            return Vec2<size_t>{begin + series_idx * inner / num_series, begin + (series_idx + 1) * inner / num_series};
+        }
+    };
+
+    // Draws a PreparedChart as fixed-size tiles, so that an image far larger than memory allows, e.g. a 20000 x 20000
+    // poster, never exists as a whole: peak memory is one tile per thread, or one band of tile rows when the tiles
+    // go to an encoder. A tile stays in cache while the background, the series and the overlay are drawn over each
+    // other, and holds exactly the pixels the whole chart has there.
+    class TiledRenderer {
+    public:
+        template <Size2 TileSize>
+        [[nodiscard]] constexpr static auto get_num_tiles(size_t rows, size_t cols, TileSize tile_size) noexcept -> size_t {
+            return ((rows + tile_size.rows() - 1) / tile_size.rows()) * ((cols + tile_size.cols() - 1) / tile_size.cols());
+        }
+
+        // tile idx of a rows x cols image, counting in row-major order, with the last row and column of tiles cut
+        // to the image
+        template <Size2 TileSize>
+        [[nodiscard]] constexpr static auto get_tile(size_t rows, size_t cols, TileSize tile_size, size_t idx) noexcept -> Rect {
+            const size_t tiles_per_row = (cols + tile_size.cols() - 1) / tile_size.cols();
+            const size_t x = (idx % tiles_per_row) * tile_size.cols();
+            const size_t y = (idx / tiles_per_row) * tile_size.rows();
+            return Rect{x, y, std::min(tile_size.cols(), cols - x), std::min(tile_size.rows(), rows - y)};
+        }
+
+        // Draw every tile into a buffer of tile_size pixels and hand it to sink(Rect tile, std::span<const RGBA>
+        // pixels), the pixels holding the rows of the tile, tile.width pixels each, and valid only during the call.
+        // The sequential policy draws the tiles one after another in row-major order, the others draw them in
+        // parallel on the pool and call sink from the drawing threads, concurrently and in no particular order.
+        template <Size2 TileSize, typename TileSink>
+        static void render(const PreparedChart& chart, const ExecutionOptions& execution, TileSize tile_size, const TileSink& sink) {
+            check_tile_size(tile_size);
+            const size_t rows = chart.m_frame.m_rows;
+            const size_t cols = chart.m_frame.m_cols;
+            for_each_task(execution, get_num_tiles(rows, cols, tile_size), [&](size_t idx) {
+                const Rect tile = get_tile(rows, cols, tile_size, idx);
+                auto buffer = get_thread_scratch<RGBA, TileTag>(tile_size.rows() * tile_size.cols());
+                // the buffer shifted back to the image origin, only the pixels inside the tile are written
+                RGBA* pixels = buffer.data() - (tile.y * tile.width + tile.x);
+                LineRasterizer::draw_chart(chart, pixels, tile.width, tile);
+                sink(tile, std::span<const RGBA>(buffer.data(), tile.width * tile.height));
+            });
+        }
+
+        // Draw the image in bands of tile_size.rows() full rows, each band one tile at a time or its tiles in
+        // parallel, and hand the bands to sink(size_t row_begin, std::span<const RGBA> pixels) top to bottom on the
+        // calling thread, e.g. to stream them through an ImageRowEncoder.
+        template <Size2 TileSize, typename BandSink>
+        static void render_bands(const PreparedChart& chart, const ExecutionOptions& execution, TileSize tile_size, const BandSink& sink) {
+            check_tile_size(tile_size);
+            const size_t rows = chart.m_frame.m_rows;
+            const size_t cols = chart.m_frame.m_cols;
+            const size_t tiles_per_row = (cols + tile_size.cols() - 1) / tile_size.cols();
+            auto band = get_thread_scratch<RGBA, BandTag>(std::min(tile_size.rows(), rows) * cols);
+            for (size_t row_begin = 0; row_begin < rows; row_begin += tile_size.rows()) {
+                const size_t band_rows = std::min(tile_size.rows(), rows - row_begin);
+                RGBA* pixels = band.data() - row_begin * cols;
+                for_each_task(execution, tiles_per_row, [&](size_t tile_col) {
+                    const size_t x = tile_col * tile_size.cols();
+                    LineRasterizer::draw_chart(chart, pixels, cols, Rect{x, row_begin, std::min(tile_size.cols(), cols - x), band_rows});
+                });
+                sink(row_begin, std::span<const RGBA>(band.data(), band_rows * cols));
+            }
+        }
+
+    private:
+        struct TileTag {};
+        struct BandTag {};
+
+        template <Size2 TileSize>
+        static void check_tile_size(TileSize tile_size) {
+            if (tile_size.rows() == 0 || tile_size.cols() == 0) {
+                throw std::invalid_argument("Error: tiles must have at least one row and one column");
+            }
+        }
+    };
+
+    enum class ChartType {
+        LINE, BAR, SCATTER, COUNT
+    };
+
+    // Tagged sizes for Chart::Params, which say at the call site which number is which and may be given in either order
+    struct SeriesLength {
+        size_t m_value = 0;
+    };
+
+    struct NumSeries {
+        size_t m_value = 0;
+    };
+
+    template <ChartType Type>
+        requires (Type < ChartType::COUNT) // valid chart type
+    class Chart{
+    public: 
+        // Line charts read num_series series of series_length samples, back to back. Scatter charts read
+        // series_length (x, y) points per series, stored interleaved as x0 y0 x1 y1 ...
+        // Two plain sizes are easily swapped, which still fits the buffer and draws the wrong chart without an error,
+        // so prefer the tagged constructors, e.g. Params(NumSeries{5}, SeriesLength{1024}). Series of different
+        // lengths or with x-values have no flat layout and are plotted through a MultiSeriesView instead.
+        class Params {
+        public:
+            constexpr Params(size_t series_length, size_t num_series) 
+            : m_series_length(series_length), m_num_series(num_series) {
+
+            }
+
+            constexpr Params(SeriesLength series_length, NumSeries num_series) noexcept
+            : m_series_length(series_length.m_value), m_num_series(num_series.m_value) {
+
+            }
+
+            constexpr Params(NumSeries num_series, SeriesLength series_length) noexcept
+            : m_series_length(series_length.m_value), m_num_series(num_series.m_value) {
+
+            }
+
+            // samples, or points, the flat layout holds
+            [[nodiscard]] constexpr auto get_num_samples() const noexcept -> size_t {
+                return m_series_length * m_num_series;
+            }
+
+            [[nodiscard]] constexpr auto get_series_length() const noexcept -> size_t {
+                return m_series_length;
+            }
+
+            [[nodiscard]] constexpr auto get_num_series() const noexcept -> size_t {
+                return m_num_series;
+            }
+        private:
+            size_t m_series_length;
+            size_t m_num_series;
+        };
+
+        template <UnderlyingType ElementType, Size2 OutSize, typename Allocator = DefaultImageAllocator<RGBA>>
+        [[nodiscard]] constexpr static auto get_plot(std::span<const ElementType> plot_data, Params params, const AppearanceOptions& appearance, OutSize out_size) -> Img2<OutSize, Allocator> {
+            // every pixel is drawn, starting with the background, so the buffer is not cleared first
+            Img2<OutSize, Allocator> img(out_size, k_uninitialized);
+            get_plot<ElementType, OutSize>(plot_data, params, appearance, img);
+            return img;
+        }
+
+        // Render during constant evaluation, so constexpr data can be baked into a constexpr image:
+        //   constexpr auto img = LineChart::get_static_plot<StaticSize2<32, 48>>(get_test_data(), params, appearance);
+        // The width and height are compile-time constants, the series are drawn with the fixed width block kernels.
+        template <Size2 OutSize, UnderlyingType ElementType, size_t N>
+            requires (OutSize::is_static_size::value)
+        [[nodiscard]] consteval static auto get_static_plot(const std::array<ElementType, N>& plot_data, Params params, const AppearanceOptions& appearance) -> Img2<OutSize> {
+            return get_plot<ElementType, OutSize>(std::span<const ElementType>(plot_data), params, appearance, OutSize{});
+        }
+
+        template <UnderlyingType ElementType, Size2 OutSize, typename Allocator>
+        constexpr static auto get_plot(std::span<const ElementType> plot_data, Params params, const AppearanceOptions& appearance, Img2<OutSize, Allocator>& img_out) -> void {
+            get_plot<ElementType, OutSize>(plot_data, params, appearance, ExecutionOptions(), img_out);
+        }
+
+        template <UnderlyingType ElementType, Size2 OutSize, typename Allocator = DefaultImageAllocator<RGBA>>
+        [[nodiscard]] constexpr static auto get_plot(std::span<const ElementType> plot_data, Params params, const AppearanceOptions& appearance, const ExecutionOptions& execution, OutSize out_size) -> Img2<OutSize, Allocator> {
+            // every pixel is drawn, starting with the background, so the buffer is not cleared first
+            Img2<OutSize, Allocator> img(out_size, k_uninitialized);
+            get_plot<ElementType, OutSize>(plot_data, params, appearance, execution, img);
+            return img;
+        }
+
+        template <UnderlyingType ElementType, Size2 OutSize, typename Allocator>
+        constexpr static auto get_plot(std::span<const ElementType> plot_data, Params params, const AppearanceOptions& appearance, const ExecutionOptions& execution, Img2<OutSize, Allocator>& img_out) -> void {
+            get_plot<ElementType, OutSize>(plot_data, params, appearance, execution, nullptr, img_out);
+        }
+
+        // render with a grid layer, created for the size of img_out, drawn behind and around the series.
+        // Regions written to img_out are added to damage when given.
+        template <UnderlyingType ElementType, Size2 OutSize, typename Allocator>
+        constexpr static auto get_plot(std::span<const ElementType> plot_data, Params params, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) -> void {
+            if constexpr (Type == ChartType::LINE) {
+                LineRasterizer::render<ElementType, OutSize>(plot_data, params.get_series_length(), params.get_num_series(), appearance, execution, grid, img_out, damage);
+            } else if constexpr (Type == ChartType::SCATTER) {
+                ScatterRasterizer::render_into(plot_data, params.get_series_length(), params.get_num_series(), appearance, execution, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+            } else if constexpr (Type == ChartType::BAR) {
+                BarRasterizer::render_into(plot_data, params.get_series_length(), params.get_num_series(), appearance, execution, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+            } else {
+                draw_empty_frame(appearance, grid, img_out, damage);
+            }
+        }
+
+        // Lay the chart out for a rows x cols image and reduce its series to row runs without drawing anything, so it
+        // can be drawn a region at a time, e.g. in tiles by TiledRenderer. Scatter charts have no prepared form, their
+        // markers and density maps are drawn from the points over the whole image.
+        template <UnderlyingType ElementType>
+        [[nodiscard]] static auto prepare_chart(std::span<const ElementType> plot_data, Params params, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, size_t rows, size_t cols) -> PreparedChart {
+            static_assert(Type != ChartType::SCATTER, "Error: scatter charts cannot be drawn in tiles");
+            const auto frame = RenderFrame::create(nullptr, rows, cols, appearance, grid);
+            if constexpr (Type == ChartType::LINE) {
+                return LineRasterizer::prepare_chart(plot_data, params.get_series_length(), params.get_num_series(), execution, frame);
+            } else if constexpr (Type == ChartType::BAR) {
+                return BarRasterizer::prepare_chart(plot_data, params.get_series_length(), params.get_num_series(), appearance, execution, frame);
+            } else {
+                return PreparedChart{frame};
+            }
+        }
+
+        // Render into an 8-bit palette image, img_out taking the palette of appearance unless it already holds an
+        // equal one. Lines are always aliased, anti-aliasing needs blends the palette cannot hold, and scatter
+        // charts, whose density maps are tone mapped, have no indexed path.
+        template <UnderlyingType ElementType, Size2 OutSize, typename Allocator>
+        static auto get_plot(std::span<const ElementType> plot_data, Params params, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, IndexedImg2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) -> void {
+            static_assert(Type != ChartType::SCATTER, "Error: scatter charts cannot be drawn into an indexed image");
+            img_out.set_palette(Palette::create(appearance));
+            const auto frame = IndexedRenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage, img_out.get_palette().get());
+            if constexpr (Type == ChartType::LINE) {
+                LineRasterizer::render_into_sized<OutSize>(plot_data, params.get_series_length(), params.get_num_series(), execution, frame);
+            } else if constexpr (Type == ChartType::BAR) {
+                BarRasterizer::render_into(plot_data, params.get_series_length(), params.get_num_series(), appearance, execution, frame);
+            } else {
+                frame.draw_underlay(0, frame.m_rows);
+                frame.draw_overlay(0, frame.m_rows);
+            }
+        }
+
+        // Render an expression over arrays, e.g. (samples - mean) / deviation * gain, laid out like plot_data above.
+        // Every engine computes the elements as it reads them, so no buffer is allocated for the result.
+        template <ArrayExpression Expr, Size2 OutSize, typename Allocator>
+        constexpr static auto get_plot(const Expr& plot_data, Params params, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) -> void {
+            if constexpr (Type == ChartType::LINE) {
+                LineRasterizer::render(plot_data, params.get_series_length(), params.get_num_series(), appearance, execution, grid, img_out, damage);
+            } else if constexpr (Type == ChartType::SCATTER) {
+                ScatterRasterizer::render_into(plot_data, params.get_series_length(), params.get_num_series(), appearance, execution, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+            } else if constexpr (Type == ChartType::BAR) {
+                BarRasterizer::render_into(plot_data, params.get_series_length(), params.get_num_series(), appearance, execution, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+            } else {
+                draw_empty_frame(appearance, grid, img_out, damage);
+            }
+        }
+
+        // render samples [x_begin, x_end) of a long series through its level-of-detail index, see LodIndex
+        template <UnderlyingType ElementType, Size2 OutSize, typename Allocator>
+        static auto get_plot(const LodIndex<ElementType>& index, std::type_identity_t<std::span<const ElementType>> samples, size_t x_begin, size_t x_end, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) -> void {
+            if constexpr (Type == ChartType::LINE) {
+                LineRasterizer::render(index, samples, x_begin, x_end, appearance, execution, grid, img_out, damage);
+            } else {
+                draw_empty_frame(appearance, grid, img_out, damage);
+            }
+        }
+
+        // render the rows of a (num_series x series_length) strided view in place, e.g. make_interleaved_view()
+        template <UnderlyingType ElementType, Size2 ViewSize, Size2 OutSize, typename Allocator>
+        constexpr static auto get_plot(const StridedView<const ElementType, ViewSize>& series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) -> void {
+            if constexpr (Type == ChartType::LINE) {
+                LineRasterizer::render<ElementType>(series, appearance, execution, grid, img_out, damage);
+            } else {
+                draw_empty_frame(appearance, grid, img_out, damage);
+            }
+        }
+
+        // Render the series of a MultiSeriesView, e.g. MultiSeriesView::from_flat() over the layout of Params, or the
+        // view of a MultiSeries holding ragged series with x-values and a validity bitmap. Scatter charts draw the
+        // samples at their x-values.
+        template <UnderlyingType ElementType, Size2 OutSize, typename Allocator>
+        static auto get_plot(const MultiSeriesView<ElementType>& series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) -> void {
+            if constexpr (Type == ChartType::LINE) {
+                LineRasterizer::render(series, appearance, execution, grid, img_out, damage);
+            } else if constexpr (Type == ChartType::SCATTER) {
+                ScatterRasterizer::render_into(series, appearance, execution, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+            } else if constexpr (Type == ChartType::BAR) {
+                BarRasterizer::render_into(series, appearance, execution, RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage));
+            } else {
+                draw_empty_frame(appearance, grid, img_out, damage);
+            }
+        }
+
+        // render a list of series with mixed sample types and lengths, each read in its own type
+        template <Size2 OutSize, typename Allocator>
+        constexpr static auto get_plot(std::span<const v_SeriesSpan> series, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) -> void {
+            if constexpr (Type == ChartType::LINE) {
+                LineRasterizer::render(series, appearance, execution, grid, img_out, damage);
+            } else {
+                draw_empty_frame(appearance, grid, img_out, damage);
+            }
+        }
+
+        // batch rendering, slice i of plot_data is a (num_series x series_length) chart drawn into slice i of imgs_out
+        template <UnderlyingType ElementType, Size3 InSize, Size3 OutSize>
+        static auto get_plots(const Mat3View<const ElementType, InSize>& plot_data, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, Mat3<RGBA, OutSize>& imgs_out) -> void {
+            if (plot_data.shape().slices() != imgs_out.slices()) {
+                throw std::invalid_argument("Error: number of output images does not match the number of input charts");
+            }
+            RGBA* pixels = imgs_out.data().data();
+            const size_t img_nele = imgs_out.rows() * imgs_out.cols();
+            get_plots_into<ElementType>(plot_data, appearance, execution, grid, [pixels, img_nele](size_t idx) { return pixels + idx * img_nele; }, imgs_out.rows(), imgs_out.cols());
+        }
+
+        // batch rendering into a set of equally sized images
+        template <UnderlyingType ElementType, Size3 InSize, Size2 OutSize, typename Allocator>
+        static auto get_plots(const Mat3View<const ElementType, InSize>& plot_data, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, std::span<Img2<OutSize, Allocator>> imgs_out) -> void {
+            if (plot_data.shape().slices() != imgs_out.size()) {
+                throw std::invalid_argument("Error: number of output images does not match the number of input charts");
+            }
+            if (imgs_out.empty()) {
+                return;
+            }
+            const size_t rows = imgs_out[0].rows();
+            const size_t cols = imgs_out[0].cols();
+            for (const auto& img : imgs_out) {
+                if (img.rows() != rows || img.cols() != cols) {
+                    throw std::invalid_argument("Error: batch output images must all be the same size");
+                }
+            }
+            get_plots_into<ElementType>(plot_data, appearance, execution, grid, [imgs_out](size_t idx) { return imgs_out[idx].data().data(); }, rows, cols);
+        }
+
+        // batch rendering into a set of equally sized palette images, which all end up sharing one palette
+        template <UnderlyingType ElementType, Size3 InSize, Size2 OutSize, typename Allocator>
+        static auto get_plots(const Mat3View<const ElementType, InSize>& plot_data, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, std::span<IndexedImg2<OutSize, Allocator>> imgs_out) -> void {
+            if (plot_data.shape().slices() != imgs_out.size()) {
+                throw std::invalid_argument("Error: number of output images does not match the number of input charts");
+            }
+            if (imgs_out.empty()) {
+                return;
+            }
+            const size_t rows = imgs_out[0].rows();
+            const size_t cols = imgs_out[0].cols();
+            for (const auto& img : imgs_out) {
+                if (img.rows() != rows || img.cols() != cols) {
+                    throw std::invalid_argument("Error: batch output images must all be the same size");
+                }
+            }
+            imgs_out[0].set_palette(Palette::create(appearance));
+            const auto& palette = imgs_out[0].get_palette();
+            for (auto& img : imgs_out.subspan(1)) {
+                if (img.get_palette() != palette) {
+                    img.set_palette(palette);
+                }
+            }
+            get_plots_into<ElementType>(plot_data, appearance, execution, grid, [imgs_out](size_t idx) { return imgs_out[idx].data().data(); }, rows, cols, palette.get());
+        }
+
+        struct TypeMapper {
+            using type = Params;
+        };
+
+    private:
+        // no engine for this chart type yet, draw the empty frame so every pixel is still written
+        template <Size2 OutSize, typename Allocator>
+        constexpr static void draw_empty_frame(const AppearanceOptions& appearance, const GridLayer* grid, Img2<OutSize, Allocator>& img_out, DamageRegion* damage) {
+            const auto frame = RenderFrame::create(img_out.data().data(), img_out.rows(), img_out.cols(), appearance, grid, damage);
+            frame.draw_underlay(0, frame.m_rows);
+            frame.draw_overlay(0, frame.m_rows);
+        }
+
+        template <UnderlyingType ElementType, Size3 InSize, typename TargetFn>
+        static auto get_plots_into(const Mat3View<const ElementType, InSize>& plot_data, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridLayer* grid, const TargetFn& target, size_t rows, size_t cols, const Palette* palette = nullptr) -> void {
+            const auto in_size = plot_data.shape();
+            if constexpr (Type == ChartType::LINE) {
+                LineRasterizer::render_batch(plot_data.data(), in_size.slices(), in_size.cols(), in_size.rows(), appearance, execution, grid, target, rows, cols, palette);
+            }
+        }
+    };
+
+    using LineChart = Chart<ChartType::LINE>;
+    using ScatterChart = Chart<ChartType::SCATTER>;
+    using BarChart = Chart<ChartType::BAR>;
+
+    // A stateful line chart for live data. Samples are appended to a ring buffer per series and the image is kept
+    // between frames: append() scrolls the plot area left by the number of newly completed columns and draws only
+    // those, so the cost of a frame is proportional to the new data rather than to the visible history.
+    // Each column summarises samples_per_column samples and is drawn once it is complete. With no fixed value range
+    // the axis grows to fit the data, which redraws the visible history once.
+    template <UnderlyingType ElementType, Size2 OutSize = DynamicSize2>
+    class StreamingLineChart {
+    public:
+        StreamingLineChart(OutSize out_size, size_t num_series, size_t samples_per_column, const AppearanceOptions& appearance = AppearanceOptions(), const GridOptions& grid = GridOptions())
+        : m_img(out_size), m_grid(GridLayer::create(grid, appearance, out_size.rows(), out_size.cols())), m_background(to_rgba(appearance.get_background_colour())), m_num_series(num_series), m_samples_per_column(samples_per_column) {
+            static_assert(std::is_arithmetic_v<ElementType>, "Error: line charts require arithmetic sample types");
+            if (samples_per_column == 0) {
+                throw std::invalid_argument("Error: samples_per_column must be at least 1");
+            }
+            // the ring holds the visible columns, one partially filled column and the sample before the first visible column
+            m_capacity = (m_grid.get_plot_area().width + 1) * samples_per_column + 1;
+            m_history = Mat2<ElementType, DynamicSize2>(DynamicSize2(num_series, m_capacity));
+            const auto frame = get_frame();
+            frame.draw_underlay(0, frame.m_rows);
+            frame.draw_overlay(0, frame.m_rows);
+        }
+
+        // fix the value axis to range, an empty range goes back to growing the axis to fit the data
+        void set_value_range(ValueRange range) {
+            m_is_fixed_range = !range.is_empty();
+            m_range = range;
+            draw_columns(0, m_grid.get_plot_area().width);
+        }
+
+        // append count samples to every series, samples holds num_series runs of count samples back to back
+        void append(std::span<const ElementType> samples) {
+            if (m_num_series == 0 || samples.size() % m_num_series != 0) {
+                throw std::invalid_argument("Error: appended samples must hold the same number of samples for every series");
+            }
+            const size_t count = samples.size() / m_num_series;
+            bool is_range_changed = false;
+            if (!m_is_fixed_range) {
+                const auto range = compute_value_range(samples);
+                if (!range.is_empty() && (m_range.is_empty() || range.m_min < m_range.m_min || range.m_max > m_range.m_max)) {
+                    // grow with some headroom so a slowly drifting signal doesn't redraw every frame
+                    ValueRange grown = m_range;
+                    grown.include(range.m_min);
+                    grown.include(range.m_max);
+                    const double pad = (grown.m_max - grown.m_min) * 0.1;
+                    m_range = ValueRange{grown.m_min - pad, grown.m_max + pad};
+                    is_range_changed = true;
+                }
+            }
+
+            // samples that would be overwritten within this call are never stored
+            const size_t skip = count > m_capacity ? count - m_capacity : 0;
+            ElementType* history = m_history.data().data();
+            for (size_t series_idx = 0; series_idx < m_num_series; ++series_idx) {
+                const ElementType* src = samples.data() + series_idx * count;
+                ElementType* dst = history + series_idx * m_capacity;
+                for (size_t i = skip; i < count; ++i) {
+                    dst[(m_num_samples + i) % m_capacity] = src[i];
+                }
+            }
+            m_num_samples += count;
+
+            const size_t width = m_grid.get_plot_area().width;
+            const size_t num_new = m_num_samples / m_samples_per_column - m_num_columns;
+            m_num_columns += num_new;
+            if (is_range_changed || num_new >= width) {
+                draw_columns(0, width);
+            } else if (num_new > 0) {
+                scroll(num_new);
+                draw_columns(width - num_new, width);
+                redraw_gridline_columns(num_new);
+            }
+        }
+
+        [[nodiscard]] auto get_image() const noexcept -> const Img2<OutSize>& {
+            return m_img;
+        }
+
+        // number of samples appended to each series so far
+        [[nodiscard]] auto get_num_samples() const noexcept -> size_t {
+            return m_num_samples;
+        }
+
+        // regions of the image changed since the last reset_damage(), the whole image after construction
+        [[nodiscard]] auto get_damage() const noexcept -> const DamageRegion& {
+            return m_damage;
+        }
+
+        void reset_damage() noexcept {
+            m_damage.reset();
+        }
+
+    private:
+        [[nodiscard]] auto get_frame() -> RenderFrame {
+            return RenderFrame{m_img.data().data(), m_img.rows(), m_img.cols(), m_grid.get_plot_area(), m_background, &m_grid, &m_damage};
+        }
+
+        // shift the plot area num_cols columns to the left, the rightmost columns are left for draw_columns
+        void scroll(size_t num_cols) {
+            const auto frame = get_frame();
+            const Rect plot = frame.m_plot_area;
+            RGBA* origin = frame.plot_origin();
+            for (size_t row = 0; row < plot.height; ++row) {
+                RGBA* dst = origin + row * frame.m_cols;
+                std::copy(dst + num_cols, dst + plot.width, dst);
+            }
+            frame.report(plot);
+        }
+
+        // vertical gridlines are fixed in the image, so the columns they scrolled away from and onto are redrawn
+        void redraw_gridline_columns(size_t num_scrolled) {
+            const Rect plot = m_grid.get_plot_area();
+            const size_t first_new = plot.width - num_scrolled;
+            for (const auto& line : m_grid.get_gridlines()) {
+                if (line.m_rect.width != 1 || line.m_rect.height < 2 || line.m_rect.x < plot.x) {
+                    continue;
+                }
+                const size_t col = line.m_rect.x - plot.x;
+                if (col >= num_scrolled && col - num_scrolled < first_new) {
+                    draw_columns(col - num_scrolled, col - num_scrolled + 1);
+                }
+                if (col < first_new) {
+                    draw_columns(col, col + 1);
+                }
+            }
+        }
+
+        // redraw plot area columns [col_begin, col_end) from the ring buffers
+        void draw_columns(size_t col_begin, size_t col_end) {
+            const auto frame = get_frame();
+            const Rect plot = frame.m_plot_area;
+            frame.draw_underlay(Rect{plot.x + col_begin, plot.y, col_end - col_begin, plot.height});
+            if (m_range.is_empty() || plot.is_empty()) {
+                return;
+            }
+            const auto transform = ValueTransform::create(m_range, plot.height);
+            const ElementType* history = m_history.data().data();
+            // global index of the oldest sample still in the ring
+            const size_t oldest = m_num_samples > m_capacity ? m_num_samples - m_capacity : 0;
+            std::array<int32_t, LineRasterizer::k_block_cols> lo{};
+            std::array<int32_t, LineRasterizer::k_block_cols> hi{};
+            for (size_t series_idx = 0; series_idx < m_num_series; ++series_idx) {
+                const ElementType* ring = history + series_idx * m_capacity;
+                for (size_t block = col_begin; block < col_end; block += LineRasterizer::k_block_cols) {
+                    const size_t n = std::min(LineRasterizer::k_block_cols, col_end - block);
+                    Vec2<int32_t> bounds{std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::min()};
+                    for (size_t i = 0; i < n; ++i) {
+                        ValueRange range;
+                        // the screen column block + i shows global column m_num_columns - width + block + i
+                        if (m_num_columns + block + i >= plot.width) {
+                            const size_t first = (m_num_columns + block + i - plot.width) * m_samples_per_column;
+                            // include the last sample of the previous column to connect the line
+                            for (size_t idx = std::max(first, oldest + 1) - 1; idx < first + m_samples_per_column; ++idx) {
+                                range.include(ring[idx % m_capacity]);
+                            }
+                        }
+                        if (range.is_empty()) {
+                            lo[i] = std::numeric_limits<int32_t>::max();
+                            hi[i] = std::numeric_limits<int32_t>::min();
+                            continue;
+                        }
+                        lo[i] = transform.to_row(range.m_max);
+                        hi[i] = transform.to_row(range.m_min);
+                        bounds.x = std::min(bounds.x, lo[i]);
+                        bounds.y = std::max(bounds.y, hi[i]);
+                    }
+                    LineRasterizer::fill_spans(frame.plot_origin(), frame.m_cols, block, n, lo.data(), hi.data(), bounds, get_series_colour(series_idx));
+                }
+            }
+        }
+
+        Img2<OutSize> m_img;
+        GridLayer m_grid;
+        RGBA m_background;
+        DamageRegion m_damage;
+        Mat2<ElementType, DynamicSize2> m_history; ///< one ring of m_capacity samples per series
+        size_t m_num_series = 0;
+        size_t m_samples_per_column = 1;
+        size_t m_capacity = 0;
+        size_t m_num_samples = 0;
+        size_t m_num_columns = 0;                  ///< number of completed columns
+        ValueRange m_range;
+        bool m_is_fixed_range = false;
+    };
+
+    template <class PlotType>
+    class plot_params_t {
+    public:
+        using type = typename PlotType::TypeMapper::type;
+    };
+
+    // The layout of a chart computed once from its Params, options and output size: the grid layer and the plot area
+    // it leaves, and the frame the engines draw through. execute() only validates the data and rasterizes, fitting
+    // the value axis in the decimation pass unless it is fixed, so a dashboard redrawing the same chart every frame
+    // pays for the layout and the grid lookup once. The plan holds copies of the options, changing them needs a new plan.
+    template <class PlotType, Size2 OutSize = DynamicSize2>
+    class RenderPlan {
+    public:
+        using Params = typename plot_params_t<PlotType>::type;
+
+        RenderPlan(Params params, OutSize out_size, const AppearanceOptions& appearance, const ExecutionOptions& execution, std::shared_ptr<const GridLayer> grid = nullptr)
+        : m_params(params), m_out_size(out_size), m_appearance(appearance), m_execution(execution), m_grid(std::move(grid)),
+          m_frame(RenderFrame::create(nullptr, out_size.rows(), out_size.cols(), appearance, m_grid.get())) {
+
+        }
+
+        // lay out a grid owned by the plan, options without a border leave the whole image to the series
+        RenderPlan(Params params, OutSize out_size, const AppearanceOptions& appearance, const ExecutionOptions& execution, const GridOptions& grid)
+        : RenderPlan(params, out_size, appearance, execution, grid.get_border_pixels() == 0 ? nullptr : std::make_shared<const GridLayer>(GridLayer::create(grid, appearance, out_size.rows(), out_size.cols()))) {}
+
+        // draw plot_data, laid out as described by the Params of the plan, into img_out
+        template <UnderlyingType ElementType, typename Allocator>
+        void execute(std::span<const ElementType> plot_data, Img2<OutSize, Allocator>& img_out, DamageRegion* damage = nullptr) const {
+            if (img_out.rows() != m_frame.m_rows || img_out.cols() != m_frame.m_cols) {
+                throw std::invalid_argument("Error: output image does not match the size the render plan was built for");
+            }
+            RenderFrame frame = m_frame;
+            frame.m_pixels = img_out.data().data();
+            frame.m_damage = damage;
+            const size_t series_length = m_params.get_series_length();
+            const size_t num_series = m_params.get_num_series();
+            if constexpr (std::is_same_v<PlotType, LineChart>) {
+                LineRasterizer::render_into_sized<OutSize>(plot_data, series_length, num_series, m_execution, frame);
+            } else if constexpr (std::is_same_v<PlotType, ScatterChart>) {
+                ScatterRasterizer::render_into(plot_data, series_length, num_series, m_appearance, m_execution, frame);
+            } else if constexpr (std::is_same_v<PlotType, BarChart>) {
+                BarRasterizer::render_into(plot_data, series_length, num_series, m_appearance, m_execution, frame);
+            } else {
+                frame.report(Rect{0, 0, frame.m_cols, frame.m_rows});
+                frame.draw_underlay(0, frame.m_rows);
+                frame.draw_overlay(0, frame.m_rows);
+            }
+        }
+
+        template <UnderlyingType ElementType, typename Allocator = DefaultImageAllocator<RGBA>>
+        [[nodiscard]] auto execute(std::span<const ElementType> plot_data) const -> Img2<OutSize, Allocator> {
+            // every pixel is drawn, starting with the background, so the buffer is not cleared first
+            Img2<OutSize, Allocator> img(m_out_size, k_uninitialized);
+            execute<ElementType>(plot_data, img);
+            return img;
+        }
+
+        [[nodiscard]] auto get_params() const noexcept -> Params {
+            return m_params;
+        }
+
+        [[nodiscard]] auto get_out_size() const noexcept -> OutSize {
+            return m_out_size;
+        }
+
+        // region of the image left for the series
+        [[nodiscard]] auto get_plot_area() const noexcept -> Rect {
+            return m_frame.m_plot_area;
+        }
+
+        // nullptr when the plan has no grid
+        [[nodiscard]] auto get_grid_layer() const noexcept -> const GridLayer* {
+            return m_grid.get();
+        }
+
+    private:
+        Params m_params;
+        OutSize m_out_size;
+        AppearanceOptions m_appearance;
+        ExecutionOptions m_execution;
+        std::shared_ptr<const GridLayer> m_grid;
+        RenderFrame m_frame;
+    };
+
+    // streams the rows of an image into one of the encoders, defined with them
+    template <typename Sink>
+    class ImageRowEncoder;
+
+    class Factory {
+    public:
+        constexpr Factory() {
+
+        }
+        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2, typename Allocator = DefaultImageAllocator<RGBA>>
+        [[nodiscard]] constexpr auto get_plot(std::span<const ElementType> plot_data, typename plot_params_t<PlotType>::type params, OutSize output_size) const -> Img2<OutSize, Allocator> {
+            Img2<OutSize, Allocator> img(output_size, k_uninitialized);
+            get_plot<PlotType, ElementType, OutSize>(plot_data, params, img);
+            return img;
+        }
+        
+        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2, typename Allocator>
+        constexpr auto get_plot(std::span<const ElementType> plot_data, typename plot_params_t<PlotType>::type params, Img2<OutSize, Allocator>& img_out) const -> void {
+            get_plot<PlotType, ElementType, OutSize>(plot_data, params, img_out, nullptr);
+        }
+
+        // as above, also adding the regions written to img_out to damage so only those need to be presented
+        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2, typename Allocator>
+        constexpr auto get_plot(std::span<const ElementType> plot_data, typename plot_params_t<PlotType>::type params, Img2<OutSize, Allocator>& img_out, DamageRegion& damage) const -> void {
+            get_plot<PlotType, ElementType, OutSize>(plot_data, params, img_out, &damage);
+        }
+
+        // plot into an 8-bit palette image, a quarter of the memory of an RGBA one; see Chart::get_plot for the limits
+        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2, typename Allocator = DefaultImageAllocator<uint8_t>>
+        [[nodiscard]] auto get_indexed_plot(std::span<const ElementType> plot_data, typename plot_params_t<PlotType>::type params, OutSize output_size) const -> IndexedImg2<OutSize, Allocator> {
+            IndexedImg2<OutSize, Allocator> img(output_size, k_uninitialized);
+            get_plot<PlotType, ElementType, OutSize>(plot_data, params, img);
+            return img;
+        }
+
+        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2, typename Allocator>
+        auto get_plot(std::span<const ElementType> plot_data, typename plot_params_t<PlotType>::type params, IndexedImg2<OutSize, Allocator>& img_out) const -> void {
+            with_grid_layer(img_out.rows(), img_out.cols(), [&](const GridLayer* grid) {
+                PlotType::template get_plot<ElementType, OutSize>(plot_data, params, m_appearance_options, m_execution_options, grid, img_out);
+            });
+        }
+
+        // plot the rows of a strided view of samples, e.g. interleaved or column-major data, without copying it
+        template <class PlotType, UnderlyingType ElementType, Size2 ViewSize, Size2 OutSize = DynamicSize2, typename Allocator = DefaultImageAllocator<RGBA>>
+        [[nodiscard]] constexpr auto get_plot(const StridedView<const ElementType, ViewSize>& series, OutSize output_size) const -> Img2<OutSize, Allocator> {
+            Img2<OutSize, Allocator> img(output_size, k_uninitialized);
+            get_plot<PlotType, ElementType, ViewSize, OutSize>(series, img);
+            return img;
+        }
+
+        template <class PlotType, UnderlyingType ElementType, Size2 ViewSize, Size2 OutSize = DynamicSize2, typename Allocator>
+        constexpr auto get_plot(const StridedView<const ElementType, ViewSize>& series, Img2<OutSize, Allocator>& img_out) const -> void {
+            with_grid_layer(img_out.rows(), img_out.cols(), [&](const GridLayer* grid) {
+                PlotType::template get_plot<ElementType>(series, m_appearance_options, m_execution_options, grid, img_out);
+            });
+        }
+
+        // Plot samples [x_begin, x_end) of a long series at any zoom in time proportional to the output width, reading
+        // the level-of-detail index built over the samples, e.g. a mapped trace of billions of samples
+        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2, typename Allocator = DefaultImageAllocator<RGBA>>
+        [[nodiscard]] auto get_plot(const LodIndex<ElementType>& index, std::type_identity_t<std::span<const ElementType>> samples, size_t x_begin, size_t x_end, OutSize output_size) const -> Img2<OutSize, Allocator> {
+            Img2<OutSize, Allocator> img(output_size, k_uninitialized);
+            get_plot<PlotType>(index, samples, x_begin, x_end, img);
+            return img;
+        }
+
+        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2, typename Allocator>
+        auto get_plot(const LodIndex<ElementType>& index, std::type_identity_t<std::span<const ElementType>> samples, size_t x_begin, size_t x_end, Img2<OutSize, Allocator>& img_out) const -> void {
+            with_grid_layer(img_out.rows(), img_out.cols(), [&](const GridLayer* grid) {
+                PlotType::get_plot(index, samples, x_begin, x_end, m_appearance_options, m_execution_options, grid, img_out);
+            });
+        }
+
+        // plot an expression over arrays, e.g. (samples - mean) / deviation * gain, without materialising it
+        template <class PlotType, ArrayExpression Expr, Size2 OutSize = DynamicSize2, typename Allocator = DefaultImageAllocator<RGBA>>
+        [[nodiscard]] constexpr auto get_plot(const Expr& plot_data, typename plot_params_t<PlotType>::type params, OutSize output_size) const -> Img2<OutSize, Allocator> {
+            Img2<OutSize, Allocator> img(output_size, k_uninitialized);
+            get_plot<PlotType>(plot_data, params, img);
+            return img;
+        }
+
+        template <class PlotType, ArrayExpression Expr, Size2 OutSize = DynamicSize2, typename Allocator>
+        constexpr auto get_plot(const Expr& plot_data, typename plot_params_t<PlotType>::type params, Img2<OutSize, Allocator>& img_out) const -> void {
+            with_grid_layer(img_out.rows(), img_out.cols(), [&](const GridLayer* grid) {
+                PlotType::get_plot(plot_data, params, m_appearance_options, m_execution_options, grid, img_out);
+            });
+        }
+
+        // plot a structure-of-arrays set of series, e.g. the view of a MultiSeries with ragged series and x-values
+        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2, typename Allocator = DefaultImageAllocator<RGBA>>
+        [[nodiscard]] auto get_plot(const MultiSeriesView<ElementType>& series, OutSize output_size) const -> Img2<OutSize, Allocator> {
+            Img2<OutSize, Allocator> img(output_size, k_uninitialized);
+            get_plot<PlotType>(series, img);
+            return img;
+        }
+
+        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2, typename Allocator>
+        auto get_plot(const MultiSeriesView<ElementType>& series, Img2<OutSize, Allocator>& img_out) const -> void {
+            with_grid_layer(img_out.rows(), img_out.cols(), [&](const GridLayer* grid) {
+                PlotType::get_plot(series, m_appearance_options, m_execution_options, grid, img_out);
+            });
+        }
+
+        // plot series of mixed sample types and lengths, e.g. {std::span<const uint8_t>(a), std::span<const float>(b)}
+        template <class PlotType, Size2 OutSize = DynamicSize2, typename Allocator = DefaultImageAllocator<RGBA>>
+        [[nodiscard]] constexpr auto get_plot(std::span<const v_SeriesSpan> series, OutSize output_size) const -> Img2<OutSize, Allocator> {
+            Img2<OutSize, Allocator> img(output_size, k_uninitialized);
+            get_plot<PlotType, OutSize>(series, img);
+            return img;
+        }
+
+        template <class PlotType, Size2 OutSize = DynamicSize2, typename Allocator>
+        constexpr auto get_plot(std::span<const v_SeriesSpan> series, Img2<OutSize, Allocator>& img_out) const -> void {
+            with_grid_layer(img_out.rows(), img_out.cols(), [&](const GridLayer* grid) {
+                PlotType::get_plot(series, m_appearance_options, m_execution_options, grid, img_out);
+            });
+        }
+
+        // render one chart per slice of plot_data, each slice holding num_series rows of series_length samples.
+        // The grid layer is looked up once and shared by every chart in the batch.
+        template <class PlotType, UnderlyingType ElementType, Size3 InSize, Size3 OutSize>
+        auto get_plots(const Mat3View<const ElementType, InSize>& plot_data, Mat3<RGBA, OutSize>& imgs_out) const -> void {
+            PJPLOT_PROFILE_SCOPE(scope, m_profiler);
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::PLOT);
+            const ArenaScope arena(&m_frame_arena);
+            const auto grid = get_grid_layer(imgs_out.rows(), imgs_out.cols());
+            PlotType::template get_plots<ElementType, InSize, OutSize>(plot_data, m_appearance_options, m_execution_options, grid.get(), imgs_out);
+        }
+
+        template <class PlotType, UnderlyingType ElementType, Size3 InSize, Size2 OutSize, typename Allocator>
+        auto get_plots(const Mat3View<const ElementType, InSize>& plot_data, std::span<Img2<OutSize, Allocator>> imgs_out) const -> void {
+            PJPLOT_PROFILE_SCOPE(scope, m_profiler);
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::PLOT);
+            const ArenaScope arena(&m_frame_arena);
+            const auto grid = imgs_out.empty() ? nullptr : get_grid_layer(imgs_out[0].rows(), imgs_out[0].cols());
+            PlotType::template get_plots<ElementType, InSize, OutSize>(plot_data, m_appearance_options, m_execution_options, grid.get(), imgs_out);
+        }
+
+        template <class PlotType, UnderlyingType ElementType, Size3 InSize, Size2 OutSize, typename Allocator>
+        auto get_plots(const Mat3View<const ElementType, InSize>& plot_data, std::span<IndexedImg2<OutSize, Allocator>> imgs_out) const -> void {
+            PJPLOT_PROFILE_SCOPE(scope, m_profiler);
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::PLOT);
+            const ArenaScope arena(&m_frame_arena);
+            const auto grid = imgs_out.empty() ? nullptr : get_grid_layer(imgs_out[0].rows(), imgs_out[0].cols());
+            PlotType::template get_plots<ElementType, InSize, OutSize>(plot_data, m_appearance_options, m_execution_options, grid.get(), imgs_out);
+        }
+
+        // Queue the render on the execution options' thread pool and return at once. The options and grid layer are
+        // captured by the call, so the factory may be reconfigured or destroyed while the render is pending, but
+        // plot_data must stay valid until the result is ready. A pool without workers renders before returning.
+        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2, typename Allocator = DefaultImageAllocator<RGBA>>
+        [[nodiscard]] auto get_plot_async(std::span<const ElementType> plot_data, typename plot_params_t<PlotType>::type params, OutSize output_size, std::stop_token stop = {}) const -> AsyncPlot<Img2<OutSize, Allocator>> {
+            using Result = Img2<OutSize, Allocator>;
+            auto& pool = m_execution_options.get_thread_pool();
+            auto state = std::make_shared<typename AsyncPlot<Result>::State>(pool, std::move(stop));
+            auto grid = get_grid_layer(output_size.rows(), output_size.cols());
+            pool.submit([state, plot_data, params, output_size, appearance = m_appearance_options, execution = m_execution_options, grid = std::move(grid), profiler = m_profiler]() noexcept {
+                state->complete([&]() {
+                    PJPLOT_PROFILE_SCOPE(scope, profiler);
+#if defined(PJPLOT_ENABLE_INSTRUMENTATION)
+                    state->m_frame = FrameProfiler::get_active();
+#endif
+                    PJPLOT_PROFILE_STAGE(timer, RenderStage::PLOT);
+                    PJPLOT_PROFILE_BYTES(timer, output_size.rows() * output_size.cols() * sizeof(RGBA));
+                    Result img(output_size, k_uninitialized);
+                    PlotType::template get_plot<ElementType, OutSize>(plot_data, params, appearance, execution, grid.get(), img, nullptr);
+                    return img;
+                });
+            });
+            return AsyncPlot<Result>(std::move(state));
+        }
+
+        // Render a chart of output_size in tiles of tile_size, e.g. a 20000 x 20000 poster, without holding the whole
+        // image: sink(Rect tile, std::span<const RGBA> pixels) receives every tile, see TiledRenderer::render()
+        template <class PlotType, UnderlyingType ElementType, Size2 TileSize = StaticSize2<512, 512>, typename TileSink>
+        auto get_tiled_plot(std::span<const ElementType> plot_data, typename plot_params_t<PlotType>::type params, DynamicSize2 output_size, const TileSink& sink, TileSize tile_size = TileSize{}) const -> void {
+            with_grid_layer(output_size.rows(), output_size.cols(), [&](const GridLayer* grid) {
+                const auto chart = PlotType::prepare_chart(plot_data, params, m_appearance_options, m_execution_options, grid, output_size.rows(), output_size.cols());
+                TiledRenderer::render(chart, m_execution_options, tile_size, sink);
+            });
+        }
+
+        // Render a chart of output_size a band of tile rows at a time and encode the bands as they are drawn, so the
+        // sink receives the same file as from ImageEncoder::encode() while only one band of the image is in memory
+        template <class PlotType, UnderlyingType ElementType, Size2 TileSize = StaticSize2<512, 512>, ByteSink Sink>
+        auto encode_tiled_plot(std::span<const ElementType> plot_data, typename plot_params_t<PlotType>::type params, DynamicSize2 output_size, ImageFormat format, Sink&& sink, CompressionLevel level = CompressionLevel::FAST, TileSize tile_size = TileSize{}) const -> void {
+            with_grid_layer(output_size.rows(), output_size.cols(), [&](const GridLayer* grid) {
+                const auto chart = PlotType::prepare_chart(plot_data, params, m_appearance_options, m_execution_options, grid, output_size.rows(), output_size.cols());
+                ImageRowEncoder<std::remove_reference_t<Sink>> encoder(output_size.rows(), output_size.cols(), format, sink, level);
+                TiledRenderer::render_bands(chart, m_execution_options, tile_size, [&encoder](size_t, std::span<const RGBA> pixels) {
+                    encoder.write_rows(pixels);
+                });
+                encoder.finish();
+            });
+        }
+
+        // a plan for drawing charts of this layout with the current options, the grid layer comes from the cache
+        template <class PlotType, Size2 OutSize = DynamicSize2>
+        [[nodiscard]] auto create_plan(typename plot_params_t<PlotType>::type params, OutSize output_size) const -> RenderPlan<PlotType, OutSize> {
+            return RenderPlan<PlotType, OutSize>(params, output_size, m_appearance_options, m_execution_options, get_grid_layer(output_size.rows(), output_size.cols()));
         }
-    };
 
-    // Alias for an image type (e.g., RGBA matrix)
-    template <Size2 Size>
-    using Img2 = Mat2<RGBA, Size>;
+        // the cached grid layer for a rows x cols image with the current options, nullptr when there is no border
+        [[nodiscard]] auto get_grid_layer(size_t rows, size_t cols) const -> std::shared_ptr<const GridLayer> {
+            if (m_grid_options.get_border_pixels() == 0) {
+                return nullptr;
+            }
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::GRID_LAYER);
+            return m_grid_cache.get(m_grid_options, m_appearance_options, rows, cols);
+        }
 
-    template <Size2 Size>
-    using Img2F = Mat2<float, Size>;
+        [[nodiscard]] constexpr auto get_appearance_options() noexcept -> AppearanceOptions& {
+            return m_appearance_options;
+        }
 
-    enum class Colour {
-        WHITE, BLACK, COUNT
-    };
+        [[nodiscard]] constexpr auto get_execution_options() noexcept -> ExecutionOptions& {
+            return m_execution_options;
+        }
 
+        [[nodiscard]] constexpr auto get_grid_options() noexcept -> GridOptions& {
+            return m_grid_options;
+        }
 
-    template <typename T, Size3 Size>
-    using Mat3View = ArrayNd<T, Size, false>;
+        // Profiler receiving the stages of every get_plot and get_plots call, nullptr to stop recording. The
+        // profiler must outlive its use here; nothing is recorded unless PJPLOT_ENABLE_INSTRUMENTATION is defined.
+        constexpr void set_profiler(FrameProfiler* profiler) noexcept {
+            m_profiler = profiler;
+        }
 
-    template <Colour Val>
-        requires (Val < Colour::COUNT)
-    [[nodiscard]] constexpr static auto to_string() -> std::string_view {
-        if constexpr (Val == Colour::WHITE) {
-            return "white";
-        } else if constexpr (Val == Colour::BLACK) {
-            return "black";
-        } else {
-            static_assert(always_false<void>::value, "Error: unhandled type");
+        [[nodiscard]] constexpr auto get_profiler() const noexcept -> FrameProfiler* {
+            return m_profiler;
         }
-    }
 
-#ifdef PJPLOT_ENABLE_TESTS
-    // little compile-time test to ensure all colour types are handled
-    template <size_t I = 0>
-    consteval static auto test_colour_to_string() -> bool{
-        if constexpr (I < static_cast<size_t>(Colour::COUNT)) {
-            constexpr auto s = to_string<static_cast<Colour>(I)>();
-            return test_colour_to_string<I+1>();
+        // Arena holding the scratch of every render, reset after each frame. reserve() it so even the first frames
+        // make no scratch allocations, or release() it to hand the memory back between bursts of rendering.
+        [[nodiscard]] constexpr auto get_frame_arena() const noexcept -> FrameArena& {
+            return m_frame_arena;
         }
-        return true;
-    }
-    constexpr static bool to_colour_to_string_test = test_colour_to_string();
-#endif
 
-    // runtime version 
-    [[nodiscard]] static auto to_string(Colour val) -> std::string_view {
-        switch (val) {
-            case Colour::WHITE:
-                return to_string<Colour::WHITE>();
-            case Colour::BLACK:
-                return to_string<Colour::BLACK>();
-            default:
-                // important for catching UB
-                throw std::invalid_argument("Error: unsupported colour type");
+    private:
+        template <class PlotType, UnderlyingType ElementType, Size2 OutSize, typename Allocator>
+        constexpr auto get_plot(std::span<const ElementType> plot_data, typename plot_params_t<PlotType>::type params, Img2<OutSize, Allocator>& img_out, DamageRegion* damage) const -> void {
+            with_grid_layer(img_out.rows(), img_out.cols(), [&](const GridLayer* grid) {
+                PlotType::template get_plot<ElementType, OutSize>(plot_data, params, m_appearance_options, m_execution_options, grid, img_out, damage);
+            });
         }
-    }
 
-    // a class to store the image elements for the grid, including lines, labels and ticks
-    // each element has a pair of x and y coordinates (representing the top-left corner), and a Mat2 of RGBA values
-    // the purpose is to quickly draw the grid on the image without having to iterate over the entire image
-    // can support either dynamic memory or static memory for each of the grid elements depending on user requirements
-    template <Size2 TitleSize, Size2 LabelSize, Size2 TickSize>
-    class GridData {
-    public:
+        // call fn with the grid layer for a rows x cols image, nullptr without a border or during constant evaluation
+        template <typename Fn>
+        constexpr void with_grid_layer(size_t rows, size_t cols, const Fn& fn) const {
+            PJPLOT_PROFILE_SCOPE(scope, m_profiler);
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::PLOT);
+            PJPLOT_PROFILE_BYTES(timer, rows * cols * sizeof(RGBA));
+            const ArenaScope arena(&m_frame_arena);
+            if (std::is_constant_evaluated() || m_grid_options.get_border_pixels() == 0) {
+                fn(nullptr);
+                return;
+            }
+            const auto grid = get_grid_layer(rows, cols);
+            fn(grid.get());
+        }
 
-    private:
-        template <typename T>
-        struct GridElement {
-            T m_element;
-            Vec2<size_t> m_offset;
-        };
-        static constexpr size_t k_max_num_labels = 2;
-        static constexpr size_t k_max_num_ticks = 20;
-        GridElement<Mat2<RGBA, TitleSize>> m_title;
-        GridElement<ArrayNd<Mat2<RGBA, LabelSize>, StaticSize1<k_max_num_labels>>> m_labels;
-        GridElement<ArrayNd<Mat2<RGBA, TickSize>, StaticSize1<k_max_num_ticks>>> m_ticks;
+        AppearanceOptions m_appearance_options;
+        ExecutionOptions m_execution_options;
+        GridOptions m_grid_options;
+        mutable GridCache m_grid_cache;
+        mutable FrameArena m_frame_arena;
+        FrameProfiler* m_profiler = nullptr;
     };
 
-    // a class to store the options for the grid, including whether to show x, y, x labels and y labels
-    class GridOptions {
+    // Dependency free encoders reading the pixels in place. Output reaches the sink in pieces of at most
+    // k_chunk_bytes, except uncompressed PNG which hands rows over straight from the image in pieces of under
+    // 64 KiB. The only scratch memory is a fixed buffer and, for compressed PNG, two scanlines and a hash table.
+    class ImageEncoder {
     public:
-        constexpr GridOptions() = default;
-
-
-        constexpr GridOptions(size_t border_pixels, bool show_x, bool show_y, bool show_x_labels, bool show_y_labels, bool show_minor_gridlines, bool show_major_gridlines) 
-        : m_border_pixels(border_pixels), m_show_x(show_x), m_show_y(show_y), m_show_x_labels(show_x_labels), m_show_y_labels(show_y_labels), m_show_minor_gridlines(show_minor_gridlines), m_show_major_gridlines(show_major_gridlines) {
+        static constexpr size_t k_chunk_bytes = 16384;
 
+        template <ByteSink Sink>
+        static void encode(std::span<const RGBA> pixels, size_t rows, size_t cols, ImageFormat format, Sink&& sink, CompressionLevel level = CompressionLevel::FAST) {
+            if (rows == 0 || cols == 0) {
+                throw std::invalid_argument("Error: cannot encode an empty image");
+            }
+            if (pixels.size() < rows * cols) {
+                throw std::invalid_argument("Error: pixel data is smaller than rows * cols");
+            }
+            if (rows > std::numeric_limits<uint32_t>::max() || cols > std::numeric_limits<uint32_t>::max() / 4) {
+                throw std::invalid_argument("Error: image is too large to encode");
+            }
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::ENCODE);
+            PJPLOT_PROFILE_BYTES(timer, rows * cols * sizeof(RGBA));
+            switch (format) {
+                case ImageFormat::PPM:
+                    return encode_ppm(pixels, rows, cols, sink);
+                case ImageFormat::QOI:
+                    return encode_qoi(pixels, rows, cols, sink);
+                case ImageFormat::PNG:
+                    return encode_png(pixels, rows, cols, sink, level);
+                default:
+                    throw std::invalid_argument("Error: unsupported image format");
+            }
         }
 
-        constexpr void set_border_pixels(size_t border_pixels) {
-            m_border_pixels = border_pixels;
+        template <Size2 ImgSize, ByteSink Sink, typename Allocator>
+        static void encode(const Img2<ImgSize, Allocator>& img, ImageFormat format, Sink&& sink, CompressionLevel level = CompressionLevel::FAST) {
+            encode(std::span<const RGBA>(img.data().data(), img.rows() * img.cols()), img.rows(), img.cols(), format, sink, level);
         }
 
-        constexpr void set_show_x(bool show_x) {
-            m_show_x = show_x;
+        // Encode palette indices. PNG keeps them as a palette image, a byte per pixel read in place with the
+        // palette written once, PPM and QOI look every pixel up as they go.
+        template <ByteSink Sink>
+        static void encode(std::span<const uint8_t> indices, const Palette& palette, size_t rows, size_t cols, ImageFormat format, Sink&& sink, CompressionLevel level = CompressionLevel::FAST) {
+            if (rows == 0 || cols == 0) {
+                throw std::invalid_argument("Error: cannot encode an empty image");
+            }
+            if (indices.size() < rows * cols) {
+                throw std::invalid_argument("Error: pixel data is smaller than rows * cols");
+            }
+            if (palette.size() == 0) {
+                throw std::invalid_argument("Error: cannot encode an indexed image with an empty palette");
+            }
+            if (rows > std::numeric_limits<uint32_t>::max() || cols > std::numeric_limits<uint32_t>::max() / 4) {
+                throw std::invalid_argument("Error: image is too large to encode");
+            }
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::ENCODE);
+            PJPLOT_PROFILE_BYTES(timer, rows * cols);
+            const PalettePixels pixels{indices.data(), &palette.get_table()};
+            switch (format) {
+                case ImageFormat::PPM:
+                    return encode_ppm(pixels, rows, cols, sink);
+                case ImageFormat::QOI:
+                    return encode_qoi(pixels, rows, cols, sink);
+                case ImageFormat::PNG:
+                    return encode_indexed_png(indices, palette, rows, cols, sink, level);
+                default:
+                    throw std::invalid_argument("Error: unsupported image format");
+            }
         }
 
-        constexpr void set_show_y(bool show_y) {
-            m_show_y = show_y;
+        template <Size2 ImgSize, ByteSink Sink, typename Allocator>
+        static void encode(const IndexedImg2<ImgSize, Allocator>& img, ImageFormat format, Sink&& sink, CompressionLevel level = CompressionLevel::FAST) {
+            if (!img.get_palette()) {
+                throw std::invalid_argument("Error: indexed image has no palette");
+            }
+            encode(std::span<const uint8_t>(img.data().data(), img.rows() * img.cols()), *img.get_palette(), img.rows(), img.cols(), format, sink, level);
         }
 
-        constexpr void set_show_x_labels(bool show_x_labels) {
-            m_show_x_labels = show_x_labels;
+    private:
+        template <typename> friend class ImageRowEncoder;
+
+        static_assert(sizeof(RGBA) == 4, "Error: RGBA pixels must be tightly packed to be encoded in place");
+
+        // collects small writes into k_chunk_bytes pieces before handing them to the sink
+        template <typename Sink>
+        class ChunkedWriter {
+        public:
+            explicit ChunkedWriter(Sink& sink)
+            : m_sink(sink) {
+
+            }
+
+            void put(uint8_t byte) {
+                if (m_size == m_buffer.size()) {
+                    flush();
+                }
+                m_buffer[m_size++] = byte;
+            }
+
+            void put(std::span<const uint8_t> bytes) {
+                for (const auto byte : bytes) {
+                    put(byte);
+                }
+            }
+
+            void put_u32(uint32_t val) {
+                put(static_cast<uint8_t>(val >> 24));
+                put(static_cast<uint8_t>(val >> 16));
+                put(static_cast<uint8_t>(val >> 8));
+                put(static_cast<uint8_t>(val));
+            }
+
+            void flush() {
+                if (m_size != 0) {
+                    m_sink(std::span<const uint8_t>(m_buffer.data(), m_size));
+                    m_size = 0;
+                }
+            }
+
+        private:
+            Sink& m_sink;
+            std::array<uint8_t, k_chunk_bytes> m_buffer;
+            size_t m_size = 0;
+        };
+
+        // the colours of palette indices, read by the PPM and QOI encoders like a span of RGBA
+        struct PalettePixels {
+            const uint8_t* m_indices = nullptr;
+            const std::array<RGBA, Palette::k_capacity>* m_table = nullptr;
+
+            [[nodiscard]] auto operator[](size_t idx) const noexcept -> RGBA {
+                return (*m_table)[m_indices[idx]];
+            }
+        };
+
+        // Pixels is a std::span<const RGBA> or PalettePixels
+        template <typename Pixels, typename Sink>
+        static void encode_ppm(const Pixels& pixels, size_t rows, size_t cols, Sink& sink) {
+            ChunkedWriter<Sink> writer(sink);
+            write_ppm_header(writer, rows, cols);
+            put_ppm_pixels(writer, pixels, rows * cols);
+            writer.flush();
         }
 
-        constexpr void set_show_y_labels(bool show_y_labels) {
-            m_show_y_labels = show_y_labels;
+        template <typename Sink>
+        static void write_ppm_header(ChunkedWriter<Sink>& writer, size_t rows, size_t cols) {
+            const std::string header = "P6\n" + std::to_string(cols) + " " + std::to_string(rows) + "\n255\n";
+            writer.put(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(header.data()), header.size()));
         }
 
-        constexpr void set_show_minor_gridlines(bool show_minor_gridlines) {
-            m_show_minor_gridlines = show_minor_gridlines;
+        template <typename Pixels, typename Sink>
+        static void put_ppm_pixels(ChunkedWriter<Sink>& writer, const Pixels& pixels, size_t n) {
+            // binary PPM has no alpha channel, it is dropped
+            for (size_t i = 0; i < n; ++i) {
+                const RGBA px = pixels[i];
+                writer.put(px.m_r);
+                writer.put(px.m_g);
+                writer.put(px.m_b);
+            }
         }
 
-        constexpr void set_show_major_gridlines(bool show_major_gridlines) {
-            m_show_major_gridlines = show_major_gridlines;
+        // the state a QOI stream carries from one pixel to the next, so an image can be encoded a band at a time
+        struct QoiState {
+            std::array<RGBA, 64> m_index{};
+            RGBA m_prev = RGBA(0, 0, 0, 255);
+            size_t m_run = 0;
+            size_t m_remaining = 0; ///< pixels of the image not encoded yet
+        };
+
+        // https://qoiformat.org/qoi-specification.pdf
+        template <typename Pixels, typename Sink>
+        static void encode_qoi(const Pixels& pixels, size_t rows, size_t cols, Sink& sink) {
+            ChunkedWriter<Sink> writer(sink);
+            auto state = write_qoi_header(writer, rows, cols);
+            put_qoi_pixels(state, writer, pixels, rows * cols);
+            write_qoi_end(writer);
+            writer.flush();
         }
 
-        [[nodiscard]] constexpr auto get_show_x() const noexcept -> bool {
-            return m_show_x;
+        template <typename Sink>
+        [[nodiscard]] static auto write_qoi_header(ChunkedWriter<Sink>& writer, size_t rows, size_t cols) -> QoiState {
+            writer.put(std::span<const uint8_t>(reinterpret_cast<const uint8_t*>("qoif"), 4));
+            writer.put_u32(static_cast<uint32_t>(cols));
+            writer.put_u32(static_cast<uint32_t>(rows));
+            writer.put(4); // channels
+            writer.put(0); // sRGB with linear alpha
+            QoiState state;
+            state.m_index.fill(RGBA(0, 0, 0, 0));
+            state.m_remaining = rows * cols;
+            return state;
         }
 
-        [[nodiscard]] constexpr auto get_show_y() const noexcept -> bool {
-            return m_show_y;
+        template <typename Pixels, typename Sink>
+        static void put_qoi_pixels(QoiState& state, ChunkedWriter<Sink>& writer, const Pixels& pixels, size_t n) {
+            auto& index = state.m_index;
+            RGBA prev = state.m_prev;
+            size_t run = state.m_run;
+            for (size_t i = 0; i < n; ++i) {
+                const RGBA px = pixels[i];
+                const bool is_last = --state.m_remaining == 0;
+                if (px == prev) {
+                    ++run;
+                    if (run == 62 || is_last) {
+                        writer.put(static_cast<uint8_t>(0xc0 | (run - 1)));
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run > 0) {
+                    writer.put(static_cast<uint8_t>(0xc0 | (run - 1)));
+                    run = 0;
+                }
+                const size_t hash = (px.m_r * 3 + px.m_g * 5 + px.m_b * 7 + px.m_a * 11) % 64;
+                if (index[hash] == px) {
+                    writer.put(static_cast<uint8_t>(hash));
+                } else {
+                    index[hash] = px;
+                    if (px.m_a == prev.m_a) {
+                        const auto vr = static_cast<int8_t>(px.m_r - prev.m_r);
+                        const auto vg = static_cast<int8_t>(px.m_g - prev.m_g);
+                        const auto vb = static_cast<int8_t>(px.m_b - prev.m_b);
+                        const int vg_r = vr - vg;
+                        const int vg_b = vb - vg;
+                        if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 && vb <= 1) {
+                            writer.put(static_cast<uint8_t>(0x40 | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2)));
+                        } else if (vg_r >= -8 && vg_r <= 7 && vg >= -32 && vg <= 31 && vg_b >= -8 && vg_b <= 7) {
+                            writer.put(static_cast<uint8_t>(0x80 | (vg + 32)));
+                            writer.put(static_cast<uint8_t>((vg_r + 8) << 4 | (vg_b + 8)));
+                        } else {
+                            writer.put(0xfe);
+                            writer.put(px.m_r);
+                            writer.put(px.m_g);
+                            writer.put(px.m_b);
+                        }
+                    } else {
+                        writer.put(0xff);
+                        writer.put(px.m_r);
+                        writer.put(px.m_g);
+                        writer.put(px.m_b);
+                        writer.put(px.m_a);
+                    }
+                }
+                prev = px;
+            }
+            state.m_prev = prev;
+            state.m_run = run;
         }
 
-        [[nodiscard]] constexpr auto get_show_x_labels() const noexcept -> bool {
-            return m_show_x_labels;
+        template <typename Sink>
+        static void write_qoi_end(ChunkedWriter<Sink>& writer) {
+            constexpr std::array<uint8_t, 8> end_marker = {0, 0, 0, 0, 0, 0, 0, 1};
+            writer.put(end_marker);
         }
 
-        [[nodiscard]] constexpr auto get_show_y_labels() const noexcept -> bool {
-            return m_show_y_labels;
+        [[nodiscard]] constexpr static auto make_crc_table() noexcept -> std::array<uint32_t, 256> {
+            std::array<uint32_t, 256> table{};
+            for (uint32_t n = 0; n < 256; ++n) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) != 0 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                table[n] = c;
+            }
+            return table;
         }
 
-        [[nodiscard]] constexpr auto get_show_minor_gridlines() const noexcept -> bool {
-            return m_show_minor_gridlines;
+        // running CRC-32 as used by PNG chunks, start from and finish with an xor of 0xffffffff
+        [[nodiscard]] constexpr static auto update_crc(uint32_t crc, std::span<const uint8_t> bytes) noexcept -> uint32_t {
+            constexpr auto table = make_crc_table();
+            for (const auto byte : bytes) {
+                crc = table[(crc ^ byte) & 0xff] ^ (crc >> 8);
+            }
+            return crc;
         }
 
-        [[nodiscard]] constexpr auto get_show_major_gridlines() const noexcept -> bool {
-            return m_show_major_gridlines;
-        }   
+        // running Adler-32 of the uncompressed zlib stream
+        struct Adler32 {
+            constexpr void update(std::span<const uint8_t> bytes) noexcept {
+                // 5552 is the largest run before the sums can overflow 32 bits
+                while (!bytes.empty()) {
+                    const auto run = bytes.first(std::min<size_t>(bytes.size(), 5552));
+                    for (const auto byte : run) {
+                        m_a += byte;
+                        m_b += m_a;
+                    }
+                    m_a %= 65521;
+                    m_b %= 65521;
+                    bytes = bytes.subspan(run.size());
+                }
+            }
 
-    private:
+            [[nodiscard]] constexpr auto get() const noexcept -> uint32_t {
+                return m_b << 16 | m_a;
+            }
 
-        size_t m_border_pixels = 0;
-        bool m_show_x = true;
-        bool m_show_y = true;
-        bool m_show_x_labels = true;
-        bool m_show_y_labels = true;
-        bool m_show_minor_gridlines = true;
-        bool m_show_major_gridlines = true;
-    };  
+            uint32_t m_a = 1;
+            uint32_t m_b = 0;
+        };
 
-    class AppearanceOptions {
-    public:
-        constexpr AppearanceOptions(){}
+        constexpr static void store_u32(uint8_t* dst, uint32_t val) noexcept {
+            dst[0] = static_cast<uint8_t>(val >> 24);
+            dst[1] = static_cast<uint8_t>(val >> 16);
+            dst[2] = static_cast<uint8_t>(val >> 8);
+            dst[3] = static_cast<uint8_t>(val);
+        }
 
-        [[nodiscard]] constexpr static auto create(Colour background, Colour text) noexcept-> ResultWithValue<AppearanceOptions> {
-            if (background < Colour::COUNT && text < Colour::COUNT) {
-                return ResultWithValue<AppearanceOptions>(AppearanceOptions(background, text));
+        // write one PNG chunk whose data is head followed by body, body is passed to the sink without copying
+        template <typename Sink>
+        static void write_png_chunk(Sink& sink, std::string_view type, std::span<const uint8_t> head, std::span<const uint8_t> body = {}) {
+            std::array<uint8_t, 8> header{};
+            store_u32(header.data(), static_cast<uint32_t>(head.size() + body.size()));
+            std::copy(type.begin(), type.end(), header.begin() + 4);
+            uint32_t crc = update_crc(0xffffffffu, std::span<const uint8_t>(header).subspan(4));
+            crc = update_crc(crc, head);
+            crc = update_crc(crc, body);
+            std::array<uint8_t, 4> trailer{};
+            store_u32(trailer.data(), crc ^ 0xffffffffu);
+            sink(std::span<const uint8_t>(header));
+            if (!head.empty()) {
+                sink(head);
+            }
+            if (!body.empty()) {
+                sink(body);
+            }
+            sink(std::span<const uint8_t>(trailer));
+        }
+
+        // the signature and the IHDR chunk of an 8 bit image, colour type 6 for RGBA or 3 for palette indices
+        template <typename Sink>
+        static void write_png_header(Sink& sink, size_t rows, size_t cols, uint8_t colour_type) {
+            constexpr std::array<uint8_t, 8> signature = {137, 80, 78, 71, 13, 10, 26, 10};
+            sink(std::span<const uint8_t>(signature));
+            std::array<uint8_t, 13> ihdr{};
+            store_u32(ihdr.data(), static_cast<uint32_t>(cols));
+            store_u32(ihdr.data() + 4, static_cast<uint32_t>(rows));
+            ihdr[8] = 8;  // bit depth
+            ihdr[9] = colour_type;
+            write_png_chunk(sink, "IHDR", ihdr);
+        }
+
+        template <typename Sink>
+        static void encode_png(std::span<const RGBA> pixels, size_t rows, size_t cols, Sink& sink, CompressionLevel level) {
+            write_png_header(sink, rows, cols, 6);
+            const auto bytes = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(pixels.data()), rows * cols * 4);
+            if (level == CompressionLevel::NONE) {
+                write_png_stored(bytes, rows, cols * 4, sink);
             } else {
-                return ResultWithValue<AppearanceOptions>::Failure("Error: invalid colour type");
+                write_png_deflate(bytes, rows, cols * 4, sink);
             }
+            write_png_chunk(sink, "IEND", {});
         }
-        constexpr void set_background_colour(Colour background) {
-            m_background_colour = background;
+
+        // colour type 3: the palette goes in PLTE, its alpha in tRNS unless it is opaque, then a byte per pixel
+        template <typename Sink>
+        static void encode_indexed_png(std::span<const uint8_t> indices, const Palette& palette, size_t rows, size_t cols, Sink& sink, CompressionLevel level) {
+            write_png_header(sink, rows, cols, 3);
+            std::array<uint8_t, 3 * Palette::k_capacity> plte{};
+            std::array<uint8_t, Palette::k_capacity> trns{};
+            for (size_t idx = 0; idx < palette.size(); ++idx) {
+                plte[3 * idx] = palette[idx].m_r;
+                plte[3 * idx + 1] = palette[idx].m_g;
+                plte[3 * idx + 2] = palette[idx].m_b;
+                trns[idx] = palette[idx].m_a;
+            }
+            write_png_chunk(sink, "PLTE", std::span<const uint8_t>(plte.data(), 3 * palette.size()));
+            if (!palette.is_opaque()) {
+                write_png_chunk(sink, "tRNS", std::span<const uint8_t>(trns.data(), palette.size()));
+            }
+            const auto bytes = indices.first(rows * cols);
+            if (level == CompressionLevel::NONE) {
+                write_png_stored(bytes, rows, cols, sink);
+            } else {
+                write_png_deflate(bytes, rows, cols, sink);
+            }
+            write_png_chunk(sink, "IEND", {});
         }
 
-        constexpr void set_text_colour(Colour text) {
-            m_text_colour = text;
+        // the Adler-32 and the next scanline of a stored PNG stream, carried from one band of rows to the next
+        struct PngStoredState {
+            Adler32 m_adler;
+            size_t m_row = 0;
+        };
+
+        template <typename Sink>
+        static void write_png_stored(std::span<const uint8_t> bytes, size_t rows, size_t row_bytes, Sink& sink) {
+            PngStoredState state;
+            put_png_stored_rows(state, bytes, rows, rows, row_bytes, sink);
+            finish_png_stored(state, sink);
         }
 
-        [[nodiscard]] constexpr auto get_background_colour() const noexcept {
-            return m_background_colour;
+        // Every scanline, the filter byte followed by the row, goes out as stored deflate blocks of at most 65535
+        // bytes, each in its own IDAT chunk with the row bytes passed to the sink straight from the image.
+        // bytes holds the next num_rows of the rows scanlines.
+        template <typename Sink>
+        static void put_png_stored_rows(PngStoredState& state, std::span<const uint8_t> bytes, size_t num_rows, size_t rows, size_t row_bytes, Sink& sink) {
+            constexpr size_t k_max_block = 65535;
+            constexpr uint8_t k_filter_none = 0;
+            Adler32& adler = state.m_adler;
+            for (size_t band_row = 0; band_row < num_rows; ++band_row) {
+                const size_t row = state.m_row + band_row;
+                const auto row_data = bytes.subspan(band_row * row_bytes, row_bytes);
+                for (size_t offset = 0; offset < row_bytes;) {
+                    const bool is_row_start = offset == 0;
+                    const size_t n = std::min(row_bytes - offset, k_max_block - (is_row_start ? 1 : 0));
+                    const bool is_final = row + 1 == rows && offset + n == row_bytes;
+                    const size_t block_len = n + (is_row_start ? 1 : 0);
+                    // zlib header, block header and filter byte
+                    std::array<uint8_t, 8> head{};
+                    size_t head_len = 0;
+                    if (row == 0 && is_row_start) {
+                        head[head_len++] = 0x78;
+                        head[head_len++] = 0x01;
+                    }
+                    head[head_len++] = is_final ? 1 : 0;
+                    head[head_len++] = static_cast<uint8_t>(block_len);
+                    head[head_len++] = static_cast<uint8_t>(block_len >> 8);
+                    head[head_len++] = static_cast<uint8_t>(~block_len);
+                    head[head_len++] = static_cast<uint8_t>(~block_len >> 8);
+                    if (is_row_start) {
+                        head[head_len++] = k_filter_none;
+                        adler.update(std::span<const uint8_t>(&k_filter_none, 1));
+                    }
+                    const auto body = row_data.subspan(offset, n);
+                    adler.update(body);
+                    write_png_chunk(sink, "IDAT", std::span<const uint8_t>(head.data(), head_len), body);
+                    offset += n;
+                }
+            }
+            state.m_row += num_rows;
         }
 
-        [[nodiscard]] constexpr auto get_text_colour() const noexcept {
-            return m_text_colour;
+        template <typename Sink>
+        static void finish_png_stored(const PngStoredState& state, Sink& sink) {
+            std::array<uint8_t, 4> checksum{};
+            store_u32(checksum.data(), state.m_adler.get());
+            write_png_chunk(sink, "IDAT", checksum);
         }
 
-    private:
+        // code and length of an entry of the fixed Huffman literal/length alphabet, bit reversed for LSB first output
+        struct HuffmanCode {
+            uint16_t m_code = 0;
+            uint8_t m_len = 0;
+        };
 
-        constexpr AppearanceOptions(Colour background, Colour text) 
-        : m_background_colour(background), m_text_colour(text) {
+        [[nodiscard]] constexpr static auto reverse_bits(uint32_t code, uint32_t len) noexcept -> uint16_t {
+            uint32_t res = 0;
+            for (uint32_t i = 0; i < len; ++i) {
+                res = res << 1 | ((code >> i) & 1);
+            }
+            return static_cast<uint16_t>(res);
+        }
 
+        [[nodiscard]] constexpr static auto make_fixed_literal_codes() noexcept -> std::array<HuffmanCode, 288> {
+            std::array<HuffmanCode, 288> codes{};
+            for (uint32_t sym = 0; sym < codes.size(); ++sym) {
+                uint32_t code = 0;
+                uint32_t len = 0;
+                if (sym < 144) {
+                    code = 0x30 + sym;
+                    len = 8;
+                } else if (sym < 256) {
+                    code = 0x190 + sym - 144;
+                    len = 9;
+                } else if (sym < 280) {
+                    code = sym - 256;
+                    len = 7;
+                } else {
+                    code = 0xc0 + sym - 280;
+                    len = 8;
+                }
+                codes[sym] = HuffmanCode{reverse_bits(code, len), static_cast<uint8_t>(len)};
+            }
+            return codes;
         }
 
-        Colour m_background_colour = Colour::WHITE;
-        Colour m_text_colour = Colour::BLACK;
-    };
+        // deflate output for the fast level, bits are packed LSB first and full buffers leave as IDAT chunks
+        template <typename Sink>
+        class DeflateWriter {
+        public:
+            explicit DeflateWriter(Sink& sink)
+            : m_sink(sink) {
 
+            }
 
-    enum class ChartType {
-        LINE, BAR, SCATTER, COUNT
-    };
+            void put_bits(uint32_t bits, uint32_t count) {
+                m_bits |= static_cast<uint64_t>(bits) << m_num_bits;
+                m_num_bits += count;
+                while (m_num_bits >= 8) {
+                    put_byte(static_cast<uint8_t>(m_bits));
+                    m_bits >>= 8;
+                    m_num_bits -= 8;
+                }
+            }
 
-    template <ChartType Type>
-        requires (Type < ChartType::COUNT) // valid chart type
-    class Chart{
-    public: 
-        class Params {
-        public:
-            constexpr Params(size_t series_length, size_t num_series) 
-            : m_series_length(series_length), m_num_series(num_series) {
+            void put_literal(uint32_t sym) {
+                constexpr auto codes = make_fixed_literal_codes();
+                put_bits(codes[sym].m_code, codes[sym].m_len);
+            }
+
+            void put_match(uint32_t length, uint32_t distance) {
+                constexpr std::array<uint16_t, 29> length_base = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+                constexpr std::array<uint8_t, 29> length_extra = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+                constexpr std::array<uint16_t, 30> distance_base = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+                constexpr std::array<uint8_t, 30> distance_extra = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+                const size_t len_idx = static_cast<size_t>(std::upper_bound(length_base.begin(), length_base.end(), length) - length_base.begin()) - 1;
+                put_literal(static_cast<uint32_t>(257 + len_idx));
+                put_bits(length - length_base[len_idx], length_extra[len_idx]);
+                const size_t dist_idx = static_cast<size_t>(std::upper_bound(distance_base.begin(), distance_base.end(), distance) - distance_base.begin()) - 1;
+                // fixed distance codes are the 5 bit index
+                put_bits(reverse_bits(static_cast<uint32_t>(dist_idx), 5), 5);
+                put_bits(distance - distance_base[dist_idx], distance_extra[dist_idx]);
+            }
 
+            // pad to a byte boundary, then append raw bytes
+            void put_aligned(std::span<const uint8_t> bytes) {
+                if (m_num_bits > 0) {
+                    put_bits(0, 8 - m_num_bits);
+                }
+                for (const auto byte : bytes) {
+                    put_byte(byte);
+                }
             }
+
+            void flush() {
+                if (m_size != 0) {
+                    write_png_chunk(m_sink, "IDAT", std::span<const uint8_t>(m_buffer.data(), m_size));
+                    m_size = 0;
+                }
+            }
+
         private:
-            size_t m_series_length;
-            size_t m_num_series;
+            void put_byte(uint8_t byte) {
+                if (m_size == m_buffer.size()) {
+                    flush();
+                }
+                m_buffer[m_size++] = byte;
+            }
+
+            Sink& m_sink;
+            std::array<uint8_t, k_chunk_bytes> m_buffer;
+            size_t m_size = 0;
+            uint64_t m_bits = 0;
+            uint32_t m_num_bits = 0;
         };
 
-        template <UnderlyingType ElementType, Size2 OutSize>
-        [[nodiscard]] constexpr static auto get_plot(std::span<const ElementType> plot_data, Params params, const AppearanceOptions&, OutSize out_size) -> Img2<OutSize> {
-            return Img2<OutSize>(out_size);
+        struct DeflateWindowTag {};
+
+        // number of leading bytes a and b have in common, up to limit, compared eight at a time
+        [[nodiscard]] static auto common_prefix(const uint8_t* a, const uint8_t* b, size_t limit) noexcept -> size_t {
+            size_t len = 0;
+            for (; len + 8 <= limit; len += 8) {
+                uint64_t lhs = 0;
+                uint64_t rhs = 0;
+                std::copy_n(a + len, 8, reinterpret_cast<uint8_t*>(&lhs));
+                std::copy_n(b + len, 8, reinterpret_cast<uint8_t*>(&rhs));
+                if (lhs != rhs) {
+                    const uint64_t diff = lhs ^ rhs;
+                    return len + static_cast<size_t>((std::endian::native == std::endian::little ? std::countr_zero(diff) : std::countl_zero(diff)) / 8);
+                }
+            }
+            while (len < limit && a[len] == b[len]) {
+                ++len;
+            }
+            return len;
         }
 
-        template <UnderlyingType ElementType, Size2 OutSize>
-        constexpr static auto get_plot(std::span<const ElementType> plot_data, Params params, const AppearanceOptions&, Img2<OutSize>&) -> void {
-            return;
+        template <typename Sink>
+        static void write_png_deflate(std::span<const uint8_t> bytes, size_t rows, size_t row_bytes, Sink& sink) {
+            PngDeflater<Sink> deflater(sink, row_bytes);
+            deflater.put_rows(bytes, rows);
+            deflater.finish();
         }
 
-        struct TypeMapper {
-            using type = Params;
-        };
-    };
+        // Single fixed-Huffman block with greedy LZ77. The window is the previous and the current scanline, which
+        // catches the long runs and repeated rows that make up most of a chart, without buffering the image.
+        // The window and hash table are the thread scratch of the thread creating the deflater, which runs one
+        // compressed PNG at a time.
+        template <typename Sink>
+        class PngDeflater {
+        public:
+            PngDeflater(Sink& sink, size_t row_bytes)
+            : m_writer(sink), m_row_bytes(row_bytes), m_stride(row_bytes + 1),
+              m_window(get_thread_scratch<uint8_t, DeflateWindowTag>(2 * m_stride)),
+              m_head(get_thread_scratch<size_t, DeflateWindowTag>(size_t(1) << k_hash_bits)) {
+                std::fill(m_head.begin(), m_head.end(), k_no_pos);
+                constexpr std::array<uint8_t, 2> zlib_header = {0x78, 0x01};
+                m_writer.put_aligned(zlib_header);
+                m_writer.put_bits(0b011, 3); // final block, fixed Huffman codes
+            }
 
-    using LineChart = Chart<ChartType::LINE>;
-    using ScatterChart = Chart<ChartType::SCATTER>;
-    using BarChart = Chart<ChartType::BAR>;
+            // compress the next num_rows scanlines, stored back to back in bytes
+            void put_rows(std::span<const uint8_t> bytes, size_t num_rows) {
+                const size_t stride = m_stride;
+                auto window = m_window;
+                auto head = m_head;
+                for (size_t band_row = 0; band_row < num_rows; ++band_row, ++m_row) {
+                    // hash entries are absolute stream positions, only those within the previous scanline are matched
+                    const size_t row_begin = m_row * stride;
+                    std::copy(window.begin() + stride, window.end(), window.begin());
+                    window[stride] = 0; // filter: none
+                    const auto row_data = bytes.subspan(band_row * m_row_bytes, m_row_bytes);
+                    std::copy(row_data.begin(), row_data.end(), window.begin() + stride + 1);
+                    m_adler.update(window.subspan(stride, stride));
+
+                    for (size_t i = stride; i < 2 * stride;) {
+                        const size_t remaining = 2 * stride - i;
+                        size_t match_len = 0;
+                        size_t match_dist = 0;
+                        if (remaining >= k_min_match) {
+                            const size_t key = hash(i);
+                            const size_t candidate = head[key];
+                            const size_t pos = row_begin + i - stride;
+                            head[key] = pos;
+                            if (candidate != k_no_pos && candidate + stride >= row_begin && pos - candidate <= k_max_distance) {
+                                const size_t src = candidate + stride - row_begin;
+                                match_len = common_prefix(window.data() + src, window.data() + i, std::min(remaining, k_max_match));
+                                match_dist = pos - candidate;
+                            }
+                        }
+                        if (match_len >= k_min_match) {
+                            m_writer.put_match(static_cast<uint32_t>(match_len), static_cast<uint32_t>(match_dist));
+                            i += match_len;
+                        } else {
+                            m_writer.put_literal(window[i]);
+                            ++i;
+                        }
+                    }
+                }
+            }
 
-    template <class PlotType>
-    class plot_params_t {
-    public:
-        using type = typename PlotType::TypeMapper::type;
+            void finish() {
+                m_writer.put_literal(256); // end of block
+                std::array<uint8_t, 4> checksum{};
+                store_u32(checksum.data(), m_adler.get());
+                m_writer.put_aligned(checksum);
+                m_writer.flush();
+            }
+
+        private:
+            static constexpr size_t k_min_match = 4;
+            static constexpr size_t k_max_match = 258;
+            static constexpr size_t k_max_distance = 32768;
+            static constexpr size_t k_hash_bits = 14;
+            static constexpr size_t k_no_pos = std::numeric_limits<size_t>::max();
+
+            [[nodiscard]] auto hash(size_t pos) const noexcept -> size_t {
+                uint32_t val = 0;
+                std::copy_n(m_window.data() + pos, 4, reinterpret_cast<uint8_t*>(&val));
+                return static_cast<size_t>((val * 2654435761u) >> (32 - k_hash_bits));
+            }
+
+            DeflateWriter<Sink> m_writer;
+            Adler32 m_adler;
+            size_t m_row_bytes;
+            size_t m_stride;                ///< a scanline with its filter byte
+            size_t m_row = 0;
+            std::span<uint8_t> m_window;    ///< [previous scanline][current scanline], each prefixed with its filter byte
+            std::span<size_t> m_head;
+        };
     };
 
-    class Factory {
+    // Encodes an RGBA image handed over a band of whole rows at a time, top to bottom, so an image streamed from
+    // a tiled render never has to be in memory at once, e.g. Factory::encode_tiled_plot. The header goes to the
+    // sink on construction and the end of the file once finish() has checked that every row was written. The
+    // output is the same as ImageEncoder::encode of the whole image.
+    template <typename Sink>
+    class ImageRowEncoder {
     public:
-        constexpr Factory() {
-
+        ImageRowEncoder(size_t rows, size_t cols, ImageFormat format, Sink& sink, CompressionLevel level = CompressionLevel::FAST)
+        : m_sink(sink), m_writer(sink), m_rows(rows), m_cols(cols), m_format(format) {
+            if (rows == 0 || cols == 0) {
+                throw std::invalid_argument("Error: cannot encode an empty image");
+            }
+            if (rows > std::numeric_limits<uint32_t>::max() || cols > std::numeric_limits<uint32_t>::max() / 4) {
+                throw std::invalid_argument("Error: image is too large to encode");
+            }
+            switch (format) {
+                case ImageFormat::PPM:
+                    ImageEncoder::write_ppm_header(m_writer, rows, cols);
+                    break;
+                case ImageFormat::QOI:
+                    m_qoi = ImageEncoder::write_qoi_header(m_writer, rows, cols);
+                    break;
+                case ImageFormat::PNG:
+                    ImageEncoder::write_png_header(m_sink, rows, cols, 6);
+                    if (level != CompressionLevel::NONE) {
+                        m_deflater.emplace(m_sink, cols * 4);
+                    }
+                    break;
+                default:
+                    throw std::invalid_argument("Error: unsupported image format");
+            }
         }
-        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2>
-        [[nodiscard]] constexpr auto get_plot(std::span<const ElementType> plot_data, typename plot_params_t<PlotType>::type params, OutSize output_size) const -> Img2<OutSize> {
-            return PlotType::template get_plot<ElementType, OutSize>(plot_data, params, m_appearance_options, output_size);
+
+        ImageRowEncoder(const ImageRowEncoder&) = delete;
+        auto operator=(const ImageRowEncoder&) -> ImageRowEncoder& = delete;
+
+        // encode the next pixels.size() / cols rows
+        void write_rows(std::span<const RGBA> pixels) {
+            if (pixels.size() % m_cols != 0) {
+                throw std::invalid_argument("Error: pixel data must hold whole rows of the image");
+            }
+            const size_t num_rows = pixels.size() / m_cols;
+            if (num_rows > m_rows - m_row) {
+                throw std::invalid_argument("Error: pixel data runs past the last row of the image");
+            }
+            PJPLOT_PROFILE_STAGE(timer, RenderStage::ENCODE);
+            PJPLOT_PROFILE_BYTES(timer, pixels.size() * sizeof(RGBA));
+            switch (m_format) {
+                case ImageFormat::PPM:
+                    ImageEncoder::put_ppm_pixels(m_writer, pixels, pixels.size());
+                    break;
+                case ImageFormat::QOI:
+                    ImageEncoder::put_qoi_pixels(m_qoi, m_writer, pixels, pixels.size());
+                    break;
+                default: {
+                    const auto bytes = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(pixels.data()), pixels.size() * 4);
+                    if (m_deflater) {
+                        m_deflater->put_rows(bytes, num_rows);
+                    } else {
+                        ImageEncoder::put_png_stored_rows(m_stored, bytes, num_rows, m_rows, m_cols * 4, m_sink);
+                    }
+                    break;
+                }
+            }
+            m_row += num_rows;
         }
-        
-        template <class PlotType, UnderlyingType ElementType, Size2 OutSize = DynamicSize2>
-        constexpr auto get_plot(std::span<const ElementType> plot_data, typename plot_params_t<PlotType>::type params, Img2<OutSize>& img_out) const -> void {
-            return PlotType::template get_plot<ElementType, OutSize>(plot_data, params, m_appearance_options, img_out);
+
+        // write the end of the file once every row has been written
+        void finish() {
+            if (m_row != m_rows) {
+                throw std::invalid_argument("Error: cannot finish an image before all of its rows are written");
+            }
+            switch (m_format) {
+                case ImageFormat::PPM:
+                    m_writer.flush();
+                    break;
+                case ImageFormat::QOI:
+                    ImageEncoder::write_qoi_end(m_writer);
+                    m_writer.flush();
+                    break;
+                default:
+                    if (m_deflater) {
+                        m_deflater->finish();
+                    } else {
+                        ImageEncoder::finish_png_stored(m_stored, m_sink);
+                    }
+                    ImageEncoder::write_png_chunk(m_sink, "IEND", {});
+                    break;
+            }
         }
 
-        [[nodiscard]] constexpr auto get_appearance_options() noexcept -> AppearanceOptions& {
-            return m_appearance_options;
+        [[nodiscard]] auto get_rows_written() const noexcept -> size_t {
+            return m_row;
         }
 
     private:
-        AppearanceOptions m_appearance_options;
+        Sink& m_sink;
+        ImageEncoder::ChunkedWriter<Sink> m_writer; ///< PPM and QOI output
+        ImageEncoder::QoiState m_qoi;
+        ImageEncoder::PngStoredState m_stored;
+        std::optional<ImageEncoder::PngDeflater<Sink>> m_deflater; ///< compressed PNG only
+        size_t m_rows;
+        size_t m_cols;
+        size_t m_row = 0; ///< rows written so far
+        ImageFormat m_format;
     };
 
 }
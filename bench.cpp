@@ -0,0 +1,453 @@
+#include "PjPlots.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Throughput benchmarks for the array types and every chart engine.
+//
+//   PjPlotsBench [--filter <substring>] [--min-time-ms <ms>] [--out <file.json>] [--list]
+//
+// Each case is run in batches until the minimum time is reached, and the best and median time per iteration over
+// the batches are reported. Results are written as JSON, to stdout unless --out is given, with progress on stderr. One
+// more iteration is run under a FrameProfiler afterwards, and its stage times and allocations are reported with the case.
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // keep the compiler from discarding a result that is otherwise unused
+    template <typename T>
+    inline void do_not_optimise(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile("" : : "r,m"(value) : "memory");
+#else
+        static volatile const T* sink;
+        sink = &value;
+#endif
+    }
+
+    struct BenchOptions {
+        std::string m_filter;
+        double m_min_time_ms = 100.0;
+        std::string m_out_path;
+        bool m_list_only = false;
+    };
+
+    struct BenchResult {
+        std::string m_name;
+        std::string m_group;
+        std::vector<std::pair<std::string, std::string>> m_params;
+        size_t m_iterations = 0;
+        double m_best_ns = 0.0;
+        double m_median_ns = 0.0;
+        double m_mean_ns = 0.0;
+        double m_items_per_second = 0.0; ///< items processed per iteration over the median time
+        double m_bytes_per_second = 0.0; ///< bytes read per iteration over the median time
+        PjPlot::FrameReport m_stages{};  ///< stages of one extra, profiled iteration, empty without instrumentation
+    };
+
+    class BenchRunner {
+    public:
+        explicit BenchRunner(BenchOptions options) : m_options(std::move(options)) {}
+
+        // time fn(), which processes items items and reads bytes bytes per call
+        template <typename Fn>
+        void run(std::string name, std::string group, std::vector<std::pair<std::string, std::string>> params, size_t items, size_t bytes, Fn&& fn) {
+            if (!m_options.m_filter.empty() && name.find(m_options.m_filter) == std::string::npos) {
+                return;
+            }
+            if (m_options.m_list_only) {
+                std::cout << name << '\n';
+                return;
+            }
+            std::cerr << name << " ... " << std::flush;
+
+            // warm up caches, scratch buffers and the grid cache, and size a batch to roughly a tenth of the time budget
+            const auto warm_start = Clock::now();
+            fn();
+            const double first_ns = std::max(elapsed_ns(warm_start), 1.0);
+            const double target_batch_ns = m_options.m_min_time_ms * 1e5;
+            const size_t batch = std::max<size_t>(1, static_cast<size_t>(target_batch_ns / first_ns));
+
+            std::vector<double> samples;
+            double total_ns = 0.0;
+            size_t iterations = 0;
+            while (samples.size() < k_min_batches || total_ns < m_options.m_min_time_ms * 1e6) {
+                const auto start = Clock::now();
+                for (size_t i = 0; i < batch; ++i) {
+                    fn();
+                }
+                const double ns = elapsed_ns(start);
+                samples.push_back(ns / static_cast<double>(batch));
+                total_ns += ns;
+                iterations += batch;
+            }
+            std::sort(samples.begin(), samples.end());
+
+            BenchResult result;
+            result.m_name = std::move(name);
+            result.m_group = std::move(group);
+            result.m_params = std::move(params);
+            result.m_iterations = iterations;
+            result.m_best_ns = samples.front();
+            result.m_median_ns = samples[samples.size() / 2];
+            result.m_mean_ns = total_ns / static_cast<double>(iterations);
+            result.m_items_per_second = static_cast<double>(items) * 1e9 / result.m_median_ns;
+            result.m_bytes_per_second = static_cast<double>(bytes) * 1e9 / result.m_median_ns;
+            if constexpr (PjPlot::k_instrumentation_enabled) {
+                // profiled separately, so the lock taken per stage stays out of the timed batches
+                PjPlot::FrameProfiler profiler;
+                {
+                    const PjPlot::ProfileScope scope(&profiler);
+                    fn();
+                }
+                result.m_stages = profiler.get_report();
+            }
+            std::cerr << result.m_median_ns / 1e3 << " us\n";
+            m_results.push_back(std::move(result));
+        }
+
+        void write_json(std::ostream& os) const {
+            os << "{\n";
+            os << "  \"context\": {\n";
+            os << "    \"compiler\": \"" << get_compiler() << "\",\n";
+            os << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+            os << "    \"min_time_ms\": " << m_options.m_min_time_ms << "\n";
+            os << "  },\n";
+            os << "  \"benchmarks\": [";
+            for (size_t i = 0; i < m_results.size(); ++i) {
+                const auto& r = m_results[i];
+                os << (i == 0 ? "\n" : ",\n");
+                os << "    {\"name\": \"" << r.m_name << "\", \"group\": \"" << r.m_group << "\", \"params\": {";
+                for (size_t p = 0; p < r.m_params.size(); ++p) {
+                    os << (p == 0 ? "" : ", ") << '"' << r.m_params[p].first << "\": \"" << r.m_params[p].second << '"';
+                }
+                os << "}, \"iterations\": " << r.m_iterations
+                   << ", \"best_ns\": " << r.m_best_ns
+                   << ", \"median_ns\": " << r.m_median_ns
+                   << ", \"mean_ns\": " << r.m_mean_ns
+                   << ", \"items_per_second\": " << r.m_items_per_second
+                   << ", \"bytes_per_second\": " << r.m_bytes_per_second;
+                write_stages(os, r.m_stages);
+                os << '}';
+            }
+            os << "\n  ]\n}\n";
+        }
+
+    private:
+        static constexpr size_t k_min_batches = 5;
+
+        // the stages that ran, with their wall time and the library allocations made while they ran
+        static void write_stages(std::ostream& os, const PjPlot::FrameReport& report) {
+            bool is_first = true;
+            for (size_t i = 0; i < report.m_stages.size(); ++i) {
+                const auto& stage = report.m_stages[i];
+                if (stage.m_calls == 0) {
+                    continue;
+                }
+                os << (is_first ? ", \"stages\": {" : ", ") << '"' << PjPlot::to_string(static_cast<PjPlot::RenderStage>(i)) << "\": {"
+                   << "\"calls\": " << stage.m_calls
+                   << ", \"wall_ns\": " << stage.m_wall_ns
+                   << ", \"bytes\": " << stage.m_bytes
+                   << ", \"allocations\": " << stage.m_allocations
+                   << ", \"allocated_bytes\": " << stage.m_allocated_bytes << '}';
+                is_first = false;
+            }
+            if (!is_first) {
+                os << '}';
+            }
+        }
+
+        [[nodiscard]] static auto elapsed_ns(Clock::time_point start) -> double {
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        }
+
+        [[nodiscard]] static auto get_compiler() -> std::string {
+#if defined(__clang__)
+            return "clang " __clang_version__;
+#elif defined(__GNUC__)
+            return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+            return "msvc " + std::to_string(_MSC_VER);
+#else
+            return "unknown";
+#endif
+        }
+
+        BenchOptions m_options;
+        std::vector<BenchResult> m_results;
+    };
+
+    // sum a rows x cols matrix through operator(), operator[] slices and the flat iterators
+    template <typename MatType>
+    void add_access_benchmarks(BenchRunner& runner, MatType& mat, std::string_view storage) {
+        const size_t rows = mat.rows();
+        const size_t cols = mat.cols();
+        size_t idx = 0;
+        for (auto& val : mat) {
+            val = static_cast<double>(idx++ % 1000);
+        }
+        const auto& k_mat = mat;
+        const size_t items = rows * cols;
+        const size_t bytes = items * sizeof(double);
+        const std::string size_name = std::to_string(rows) + "x" + std::to_string(cols);
+        const std::vector<std::pair<std::string, std::string>> params = {{"storage", std::string(storage)}, {"size", size_name}};
+        const std::string prefix = "access/" + std::string(storage) + "/";
+
+        runner.run(prefix + "operator_call/" + size_name, "access", params, items, bytes, [&] {
+            double sum = 0.0;
+            for (size_t i = 0; i < rows; ++i) {
+                for (size_t j = 0; j < cols; ++j) {
+                    sum += k_mat(i, j);
+                }
+            }
+            do_not_optimise(sum);
+        });
+
+        runner.run(prefix + "slice_index/" + size_name, "access", params, items, bytes, [&] {
+            double sum = 0.0;
+            for (size_t i = 0; i < rows; ++i) {
+                const auto slice = k_mat[i];
+                for (size_t j = 0; j < cols; ++j) {
+                    sum += slice[j];
+                }
+            }
+            do_not_optimise(sum);
+        });
+
+        runner.run(prefix + "iterator/" + size_name, "access", params, items, bytes, [&] {
+            double sum = 0.0;
+            for (const auto& val : k_mat) {
+                sum += val;
+            }
+            do_not_optimise(sum);
+        });
+
+        runner.run(prefix + "write_operator_call/" + size_name, "access", params, items, bytes, [&] {
+            for (size_t i = 0; i < rows; ++i) {
+                for (size_t j = 0; j < cols; ++j) {
+                    mat(i, j) = static_cast<double>(j);
+                }
+            }
+            do_not_optimise(mat.data().data());
+        });
+
+        runner.run(prefix + "write_slice_index/" + size_name, "access", params, items, bytes, [&] {
+            for (size_t i = 0; i < rows; ++i) {
+                auto slice = mat[i];
+                for (size_t j = 0; j < cols; ++j) {
+                    slice[j] = static_cast<double>(j);
+                }
+            }
+            do_not_optimise(mat.data().data());
+        });
+    }
+
+    void add_access_benchmarks(BenchRunner& runner) {
+        constexpr size_t k_rows = 600;
+        constexpr size_t k_cols = 600;
+        // static storage is held inline, so keep it off the stack
+        auto static_mat = std::make_unique<PjPlot::Mat2<double, PjPlot::StaticSize2<k_rows, k_cols>>>(PjPlot::StaticSize2<k_rows, k_cols>{});
+        add_access_benchmarks(runner, *static_mat, "static");
+        PjPlot::Mat2<double, PjPlot::DynamicSize2> dynamic_mat(PjPlot::DynamicSize2(k_rows, k_cols));
+        add_access_benchmarks(runner, dynamic_mat, "dynamic");
+    }
+
+    // a few periods of a sine per series with some noise, so lines span many rows per column
+    [[nodiscard]] auto make_series_data(size_t n) -> std::vector<double> {
+        std::vector<double> data(n);
+        uint32_t state = 0x9E3779B9u;
+        for (size_t i = 0; i < n; ++i) {
+            state = state * 1664525u + 1013904223u;
+            const double noise = static_cast<double>(state >> 8) / static_cast<double>(1u << 24) - 0.5;
+            data[i] = std::sin(static_cast<double>(i) * 0.001) + 0.25 * noise;
+        }
+        return data;
+    }
+
+    struct RenderCase {
+        size_t m_num_series;
+        size_t m_series_length;
+        size_t m_rows;
+        size_t m_cols;
+    };
+
+    // Image is an Img2, or an IndexedImg2 for the palette index variants of the engines
+    template <class PlotType, typename Image = PjPlot::Img2<PjPlot::DynamicSize2>>
+    void add_render_benchmark(BenchRunner& runner, const PjPlot::Factory& builder, std::string_view chart, std::span<const double> data, size_t values_per_sample, const RenderCase& c) {
+        const size_t samples = c.m_series_length * c.m_num_series;
+        const auto plot_data = data.first(samples * values_per_sample);
+        const std::string name = "render/" + std::string(chart)
+            + "/series=" + std::to_string(c.m_num_series)
+            + "/length=" + std::to_string(c.m_series_length)
+            + "/out=" + std::to_string(c.m_rows) + "x" + std::to_string(c.m_cols);
+        const std::vector<std::pair<std::string, std::string>> params = {
+            {"chart", std::string(chart)},
+            {"num_series", std::to_string(c.m_num_series)},
+            {"series_length", std::to_string(c.m_series_length)},
+            {"out_rows", std::to_string(c.m_rows)},
+            {"out_cols", std::to_string(c.m_cols)},
+        };
+        Image img(PjPlot::DynamicSize2(c.m_rows, c.m_cols), PjPlot::k_uninitialized);
+        const auto params_in = typename PjPlot::plot_params_t<PlotType>::type(c.m_series_length, c.m_num_series);
+        runner.run(name, "render", params, samples, plot_data.size_bytes(), [&] {
+            builder.get_plot<PlotType, double>(plot_data, params_in, img);
+            do_not_optimise(img.data().data());
+        });
+    }
+
+    // windows of one long trace drawn through its level-of-detail index, zoom being the fraction of the trace shown
+    void add_zoom_benchmarks(BenchRunner& runner, const PjPlot::Factory& builder, std::span<const double> data) {
+        const auto index = PjPlot::LodIndex<double>::build(data);
+        PjPlot::Img2<PjPlot::DynamicSize2> img(PjPlot::DynamicSize2(300, 600), PjPlot::k_uninitialized);
+        for (const size_t zoom : {1, 16, 1024}) {
+            const size_t length = data.size() / zoom;
+            const size_t begin = (data.size() - length) / 2;
+            const std::vector<std::pair<std::string, std::string>> params = {
+                {"chart", "line_lod"},
+                {"window_length", std::to_string(length)},
+                {"out_rows", "300"},
+                {"out_cols", "600"},
+            };
+            runner.run("render/line_lod/window=" + std::to_string(length) + "/out=300x600", "render", params, length, length * sizeof(double), [&] {
+                builder.get_plot<PjPlot::LineChart>(index, data, begin, begin + length, img);
+                do_not_optimise(img.data().data());
+            });
+        }
+    }
+
+    // 8 series with explicit, unevenly spaced x-values, binned into the columns by position rather than by index
+    void add_positioned_benchmarks(BenchRunner& runner, const PjPlot::Factory& builder, std::span<const double> data) {
+        constexpr size_t k_num_series = 8;
+        PjPlot::Img2<PjPlot::DynamicSize2> img(PjPlot::DynamicSize2(300, 600), PjPlot::k_uninitialized);
+        for (const size_t series_length : {1024, 131072}) {
+            std::vector<double> x_values(k_num_series * series_length);
+            for (size_t i = 0; i < x_values.size(); ++i) {
+                const auto k = static_cast<double>(i % series_length);
+                x_values[i] = k + 0.25 * std::sin(k);
+            }
+            const auto series = PjPlot::MultiSeriesView<double>::from_flat(data, series_length, k_num_series).with_x_values(x_values);
+            const std::vector<std::pair<std::string, std::string>> params = {
+                {"chart", "line_positioned"},
+                {"num_series", std::to_string(k_num_series)},
+                {"series_length", std::to_string(series_length)},
+                {"out_rows", "300"},
+                {"out_cols", "600"},
+            };
+            const size_t samples = k_num_series * series_length;
+            runner.run("render/line_positioned/series=8/length=" + std::to_string(series_length) + "/out=300x600", "render", params, samples, samples * 2 * sizeof(double), [&] {
+                builder.get_plot<PjPlot::LineChart>(series, img);
+                do_not_optimise(img.data().data());
+            });
+        }
+    }
+
+    // a print sized line chart drawn into one image, and in cache sized tiles handed to a sink that drops them
+    void add_tiled_benchmarks(BenchRunner& runner, const PjPlot::Factory& builder, std::span<const double> data) {
+        constexpr size_t k_num_series = 8;
+        constexpr size_t k_series_length = 131072;
+        constexpr size_t k_size = 4096;
+        const auto plot_data = data.first(k_num_series * k_series_length);
+        const auto params_in = PjPlot::LineChart::Params(PjPlot::NumSeries{k_num_series}, PjPlot::SeriesLength{k_series_length});
+        const std::vector<std::pair<std::string, std::string>> params = {
+            {"chart", "line"},
+            {"num_series", std::to_string(k_num_series)},
+            {"series_length", std::to_string(k_series_length)},
+            {"out_rows", std::to_string(k_size)},
+            {"out_cols", std::to_string(k_size)},
+        };
+        const std::string out = "/out=" + std::to_string(k_size) + "x" + std::to_string(k_size);
+        PjPlot::Img2<PjPlot::DynamicSize2> img(PjPlot::DynamicSize2(k_size, k_size), PjPlot::k_uninitialized);
+        runner.run("render/line_untiled/series=8/length=131072" + out, "render", params, plot_data.size(), plot_data.size_bytes(), [&] {
+            builder.get_plot<PjPlot::LineChart, double>(plot_data, params_in, img);
+            do_not_optimise(img.data().data());
+        });
+        runner.run("render/line_tiled/tile=512x512/series=8/length=131072" + out, "render", params, plot_data.size(), plot_data.size_bytes(), [&] {
+            builder.get_tiled_plot<PjPlot::LineChart, double>(plot_data, params_in, PjPlot::DynamicSize2(k_size, k_size), [](PjPlot::Rect, std::span<const PjPlot::RGBA> pixels) {
+                do_not_optimise(pixels.data());
+            });
+        });
+    }
+
+    void add_render_benchmarks(BenchRunner& runner) {
+        static constexpr std::array<size_t, 3> k_num_series = {1, 8, 32};
+        static constexpr std::array<size_t, 3> k_series_lengths = {1024, 16384, 131072};
+        static constexpr std::array<std::pair<size_t, size_t>, 2> k_out_sizes = {{{300, 600}, {1080, 1920}}};
+
+        // scatter charts read an x and a y value per sample
+        const auto data = make_series_data(2 * k_num_series.back() * k_series_lengths.back());
+        PjPlot::Factory builder;
+
+        for (const auto num_series : k_num_series) {
+            for (const auto series_length : k_series_lengths) {
+                for (const auto& [rows, cols] : k_out_sizes) {
+                    const RenderCase c{num_series, series_length, rows, cols};
+                    add_render_benchmark<PjPlot::LineChart>(runner, builder, "line", data, 1, c);
+                    add_render_benchmark<PjPlot::ScatterChart>(runner, builder, "scatter", data, 2, c);
+                    add_render_benchmark<PjPlot::BarChart>(runner, builder, "bar", data, 1, c);
+                    add_render_benchmark<PjPlot::LineChart, PjPlot::IndexedImg2<PjPlot::DynamicSize2>>(runner, builder, "line_indexed", data, 1, c);
+                    add_render_benchmark<PjPlot::BarChart, PjPlot::IndexedImg2<PjPlot::DynamicSize2>>(runner, builder, "bar_indexed", data, 1, c);
+                }
+            }
+        }
+        add_zoom_benchmarks(runner, builder, data);
+        add_positioned_benchmarks(runner, builder, data);
+        add_tiled_benchmarks(runner, builder, data);
+    }
+
+    [[nodiscard]] auto parse_args(int argc, char** argv) -> BenchOptions {
+        BenchOptions options;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg = argv[i];
+            const bool has_value = i + 1 < argc;
+            if (arg == "--filter" && has_value) {
+                options.m_filter = argv[++i];
+            } else if (arg == "--min-time-ms" && has_value) {
+                options.m_min_time_ms = std::max(std::stod(argv[++i]), 1.0);
+            } else if (arg == "--out" && has_value) {
+                options.m_out_path = argv[++i];
+            } else if (arg == "--list") {
+                options.m_list_only = true;
+            } else {
+                throw std::invalid_argument("Error: unknown argument " + std::string(arg));
+            }
+        }
+        return options;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    try {
+        options = parse_args(argc, argv);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << "\nusage: " << argv[0] << " [--filter <substring>] [--min-time-ms <ms>] [--out <file.json>] [--list]\n";
+        return 1;
+    }
+
+    BenchRunner runner(options);
+    add_access_benchmarks(runner);
+    add_render_benchmarks(runner);
+
+    if (options.m_list_only) {
+        return 0;
+    }
+    if (options.m_out_path.empty()) {
+        runner.write_json(std::cout);
+    } else {
+        std::ofstream out(options.m_out_path);
+        if (!out) {
+            std::cerr << "Error: could not open " << options.m_out_path << '\n';
+            return 1;
+        }
+        runner.write_json(out);
+    }
+    return 0;
+}
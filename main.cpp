@@ -1,6 +1,8 @@
 #include "PjPlots.h"
 #include <iostream>
 #include <cmath>
+#include <filesystem>
+#include <fstream>
 
 constexpr size_t k_num_series = 5;
 constexpr size_t k_series_length = 1024;
@@ -52,6 +54,13 @@ int main() {
         }
     }
 
+    // element access is bounds checked in debug builds only, at() always checks and get_unchecked() never does
+    std::cout << "mat(1, 2) = " << k_mat(1, 2) << ", at(1, 2) = " << k_mat.at(1, 2) << ", unchecked = " << k_mat.get_unchecked(1, 2) << '\n';
+
+    // reduce each row of the matrix to 60 min/max/first/last columns
+    const auto decimated = PjPlot::MinMaxDecimator::apply(k_mat, PjPlot::DynamicSize2(600, 60));
+    std::cout << "First decimated column holds " << decimated[0][0].m_count << " samples\n";
+
     double test = 0;
     for (const auto & val : mat) {
         test = val;
@@ -59,6 +68,7 @@ int main() {
 
     static_assert(std::is_same_v<PjPlot::StorageType<uint8_t, PjPlot::StaticSize2<600, 600>>, std::array<uint8_t, 360000>>);
     static_assert(std::is_same_v<PjPlot::StorageType<PjPlot::RGBA, PjPlot::DynamicSize2>, std::vector<PjPlot::RGBA>>);
+    static_assert(std::is_same_v<PjPlot::StorageType<PjPlot::RGBA, PjPlot::DynamicSize2, true, PjPlot::AlignedAllocator<PjPlot::RGBA>>, std::vector<PjPlot::RGBA, PjPlot::AlignedAllocator<PjPlot::RGBA>>>);
 
     if constexpr (std::is_same_v<PjPlot::StorageType<uint8_t, PjPlot::StaticSize2<600, 600>>, std::array<uint8_t, 360000>>) {
         std::cout << "Static sized array is working\n";
@@ -79,8 +89,302 @@ int main() {
     PjPlot::Factory builder;
     builder.get_appearance_options().set_background_colour(PjPlot::Colour::BLACK);
     builder.get_appearance_options().set_text_colour(PjPlot::Colour::WHITE);
-    const auto img = builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_num_series, k_series_length), PjPlot::StaticSize2<600, 600>{});
-    const auto img_dynamic = builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_num_series, k_series_length), PjPlot::DynamicSize2(600, 600));
+    const auto img = builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(PjPlot::NumSeries{k_num_series}, PjPlot::SeriesLength{k_series_length}), PjPlot::StaticSize2<600, 600>{});
+    const auto img_dynamic = builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(PjPlot::NumSeries{k_num_series}, PjPlot::SeriesLength{k_series_length}), PjPlot::DynamicSize2(600, 600));
+    builder.get_execution_options().set_policy(PjPlot::ExecutionPolicy::PARALLEL_ROW_TILES);
+    const auto img_tiled = builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(PjPlot::NumSeries{k_num_series}, PjPlot::SeriesLength{k_series_length}), PjPlot::DynamicSize2(600, 600));
+    std::cout << "Parallel render matches sequential: " << std::equal(img_tiled.begin(), img_tiled.end(), img_dynamic.begin()) << '\n';
+    builder.get_execution_options().set_policy(PjPlot::ExecutionPolicy::SEQUENTIAL);
+    std::cout << "Static size render matches dynamic: " << std::equal(img.begin(), img.end(), img_dynamic.begin()) << '\n';
+
+    // the constexpr test data rendered entirely at compile time into a constexpr image
+    static constexpr auto img_compile_time = PjPlot::LineChart::get_static_plot<PjPlot::StaticSize2<32, 48>>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::AppearanceOptions());
+    const auto img_run_time = PjPlot::LineChart::get_plot<double>(std::span<const double>(arr), PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::AppearanceOptions(), PjPlot::DynamicSize2(32, 48));
+    std::cout << "Compile-time render matches run-time: " << std::equal(img_compile_time.begin(), img_compile_time.end(), img_run_time.begin()) << '\n';
+
+    // interleaved samples (series-minor) are read in place through a strided view, no transpose copy
+    std::vector<double> interleaved(k_data_size);
+    for (size_t i = 0; i < k_data_size; ++i) {
+        interleaved[(i % k_series_length) * k_num_series + i / k_series_length] = arr[i];
+    }
+    const auto img_interleaved = builder.get_plot<PjPlot::LineChart, double>(PjPlot::make_interleaved_view<const double>(interleaved.data(), k_num_series, k_series_length), PjPlot::DynamicSize2(600, 600));
+    const auto img_series_major = builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(600, 600));
+    std::cout << "Interleaved render matches: " << std::equal(img_interleaved.begin(), img_interleaved.end(), img_series_major.begin()) << '\n';
+
+    // series of different sample types and lengths in one plot, each read in its own type
+    std::array<uint8_t, 256> raw_counts{};
+    std::array<float, 600> filtered{};
+    for (size_t i = 0; i < raw_counts.size(); ++i) {
+        raw_counts[i] = static_cast<uint8_t>(i);
+    }
+    for (size_t i = 0; i < filtered.size(); ++i) {
+        filtered[i] = static_cast<float>(128.0 + 100.0 * std::sin(static_cast<double>(i) * 0.02));
+    }
+    const std::array<PjPlot::v_SeriesSpan, 2> mixed_series = {std::span<const uint8_t>(raw_counts), std::span<const float>(filtered)};
+    const auto img_mixed = builder.get_plot<PjPlot::LineChart>(mixed_series, PjPlot::DynamicSize2(300, 600));
+    std::cout << "Rendered " << mixed_series.size() << " mixed-type series into a " << img_mixed.rows() << "x" << img_mixed.cols() << " image\n";
+
+    // the flat buffer seen as a structure-of-arrays set without copying, then ragged series at their own x-values
+    const auto flat_view = PjPlot::MultiSeriesView<double>::from_flat(arr, k_series_length, k_num_series);
+    const auto img_soa = builder.get_plot<PjPlot::LineChart>(flat_view, PjPlot::DynamicSize2(600, 600));
+    PjPlot::MultiSeries<double> ragged;
+    std::vector<double> event_times;
+    for (size_t i = 0; i < 40; ++i) {
+        event_times.push_back(static_cast<double>(i * i) * 0.5);
+    }
+    ragged.add_series(std::span<const double>(arr).first(k_series_length));
+    ragged.add_series(std::span<const double>(arr).subspan(k_series_length, event_times.size()), event_times);
+    ragged.set_valid(0, 500, false);
+    const auto img_ragged = builder.get_plot<PjPlot::LineChart>(ragged.get_view(), PjPlot::DynamicSize2(600, 600));
+    std::cout << "Flat view render matches: " << std::equal(img_soa.begin(), img_soa.end(), img_series_major.begin()) << ", ragged set of " << ragged.get_num_series() << " series holds " << ragged.get_num_samples() << " samples, " << img_ragged.rows() << "x" << img_ragged.cols() << " image\n";
+
+    // anti-aliased lines for publication output, selected per call on the appearance options
+    builder.get_appearance_options().set_line_mode(PjPlot::LineMode::ANTI_ALIASED);
+    const auto img_smooth = builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(600, 600));
+    builder.get_appearance_options().set_line_mode(PjPlot::LineMode::ALIASED);
+    std::cout << "Rendered " << PjPlot::to_string(PjPlot::LineMode::ANTI_ALIASED) << " lines, differs from aliased: " << !std::equal(img_smooth.begin(), img_smooth.end(), img_series_major.begin()) << '\n';
+
+    // a point cloud drawn as markers, and as a density plot once it passes the density threshold
+    std::vector<double> cloud(2 * 200000);
+    for (size_t i = 0; i < cloud.size() / 2; ++i) {
+        const double r = static_cast<double>(i % 1000) / 1000.0;
+        cloud[2 * i] = r * std::cos(static_cast<double>(i) * 0.37);
+        cloud[2 * i + 1] = r * std::sin(static_cast<double>(i) * 0.37) * 0.5 + cloud[2 * i] * 0.5;
+    }
+    builder.get_appearance_options().set_density_threshold(100000);
+    const auto img_markers = builder.get_plot<PjPlot::ScatterChart, double>(std::span<const double>(cloud).first(2 * 50000), PjPlot::ScatterChart::Params(25000, 2), PjPlot::DynamicSize2(400, 400));
+    const auto img_density = builder.get_plot<PjPlot::ScatterChart, double>(cloud, PjPlot::ScatterChart::Params(cloud.size() / 2, 1), PjPlot::DynamicSize2(400, 400));
+    for (const auto& [num_points, scatter_img] : {std::pair{size_t(50000), &img_markers}, std::pair{cloud.size() / 2, &img_density}}) {
+        std::cout << "Scattered " << num_points << " points as " << PjPlot::to_string(PjPlot::ScatterRasterizer::resolve_mode(builder.get_appearance_options(), num_points)) << " into a " << scatter_img->rows() << "x" << scatter_img->cols() << " image\n";
+    }
+
+    // bar charts of the test data reduced to 16 mean bars per series, and a histogram computed from the raw samples
+    builder.get_appearance_options().set_num_bars(16);
+    const auto img_bars = builder.get_plot<PjPlot::BarChart, double>(arr, PjPlot::BarChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(300, 600));
+    builder.get_appearance_options().set_bar_aggregation(PjPlot::BarAggregation::HISTOGRAM);
+    const auto img_histogram = builder.get_plot<PjPlot::BarChart, double>(std::span<const double>(cloud).first(cloud.size() / 2), PjPlot::BarChart::Params(cloud.size() / 2, 1), PjPlot::DynamicSize2(300, 600));
+    builder.get_appearance_options().set_bar_aggregation(PjPlot::BarAggregation::MEAN);
+    builder.get_appearance_options().set_num_bars(0);
+    std::cout << "Rendered " << img_bars.rows() << "x" << img_bars.cols() << " bar chart and " << img_histogram.rows() << "x" << img_histogram.cols() << " histogram\n";
+
+    // plot samples straight from a memory mapped file
+    const auto sample_path = (std::filesystem::temp_directory_path() / "pjplots_samples.bin").string();
+    std::ofstream(sample_path, std::ios::binary).write(reinterpret_cast<const char*>(arr.data()), sizeof(arr));
+    {
+        auto mapped = PjPlot::MappedFile::open(sample_path);
+        const auto img_mapped = builder.get_plot<PjPlot::LineChart, double>(mapped.get_value().as_span<double>(), PjPlot::LineChart::Params(PjPlot::NumSeries{k_num_series}, PjPlot::SeriesLength{k_series_length}), PjPlot::DynamicSize2(600, 600));
+        std::cout << "Mapped render matches in-memory: " << std::equal(img_mapped.begin(), img_mapped.end(), img_dynamic.begin()) << '\n';
+
+        // a level-of-detail index of the trace, kept next to it so zooming and panning never rescan the samples
+        const auto samples = mapped.get_value().as_span<double>();
+        const auto index_path = PjPlot::LodIndex<double>::get_index_path(sample_path);
+        {
+            std::ofstream index_file(index_path, std::ios::binary);
+            PjPlot::LodIndex<double>::build(samples).write([&index_file](std::span<const uint8_t> bytes) { index_file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size())); });
+        }
+        auto mapped_index = PjPlot::MappedFile::open(index_path);
+        auto index = PjPlot::LodIndex<double>::load(mapped_index.get_value().get_bytes());
+        const auto img_zoomed = builder.get_plot<PjPlot::LineChart>(index.get_value(), samples, k_series_length, 2 * k_series_length, PjPlot::DynamicSize2(300, 600));
+        std::cout << "Level-of-detail index: " << index.get_value().get_num_levels() << " levels over " << index.get_value().get_num_samples() << " samples, zoomed plot " << img_zoomed.rows() << "x" << img_zoomed.cols() << '\n';
+
+        // a truncated file, a level count that does not match the samples, or trailing bytes are all rejected
+        const auto index_bytes = mapped_index.get_value().get_bytes();
+        std::vector<std::byte> corrupt(index_bytes.begin(), index_bytes.end());
+        std::fill_n(corrupt.begin() + 32, 8, std::byte{0});
+        std::vector<std::byte> trailing(index_bytes.begin(), index_bytes.end());
+        trailing.push_back(std::byte{0});
+        const bool is_truncated_rejected = PjPlot::LodIndex<double>::load(index_bytes.first(index_bytes.size() - 1)).is_failure();
+        const bool is_corrupt_rejected = PjPlot::LodIndex<double>::load(corrupt).is_failure();
+        const bool is_trailing_rejected = PjPlot::LodIndex<double>::load(trailing).is_failure();
+        std::cout << "Damaged level-of-detail indices rejected: " << (is_truncated_rejected && is_corrupt_rejected && is_trailing_rejected) << '\n';
+    }
+    std::filesystem::remove(PjPlot::LodIndex<double>::get_index_path(sample_path));
+    std::filesystem::remove(sample_path);
+
+    // repeated renders of the same size recycle one buffer through the thread's frame pool, and the buffer is not
+    // cleared before the renderer draws the background over it
+    using PooledAllocator = PjPlot::DefaultInitAllocator<PjPlot::FramePoolAllocator<PjPlot::RGBA>>;
+    for (size_t i = 0; i < 3; ++i) {
+        const auto pooled = builder.get_plot<PjPlot::LineChart, double, PjPlot::DynamicSize2, PooledAllocator>(arr, PjPlot::LineChart::Params(PjPlot::NumSeries{k_num_series}, PjPlot::SeriesLength{k_series_length}), PjPlot::DynamicSize2(600, 600));
+    }
+    std::cout << "Frame pool buffers cached: " << PjPlot::FramePool::get_num_cached() << '\n';
+
+    // repeated renders of unchanged data take the value range of each series from a cache instead of its samples
+    PjPlot::RangeCache range_cache;
+    builder.get_execution_options().set_range_cache(&range_cache);
+    for (size_t i = 0; i < 3; ++i) {
+        const auto cached = builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(300, 600));
+    }
+    builder.get_execution_options().set_range_cache(nullptr);
+    PjPlot::SeriesStats first_stats;
+    if (range_cache.find(PjPlot::RangeCache::make_key(arr.data(), k_series_length), first_stats)) {
+        std::cout << "Cached range of series 0: [" << first_stats.m_range.m_min << ", " << first_stats.m_range.m_max << "], " << first_stats.m_num_non_finite << " skipped samples\n";
+    }
+
+    // axes are rasterized once and reused by every frame of the same size and options
+    // the title and axis labels are drawn into the cached tiles, the tick values are blitted from a shared glyph atlas
+    builder.get_grid_options().set_border_pixels(40);
+    builder.get_grid_options().set_title("Test data");
+    builder.get_grid_options().set_x_label("sample");
+    builder.get_grid_options().set_y_label("value");
+    PjPlot::Img2<PjPlot::DynamicSize2> frame(PjPlot::DynamicSize2(600, 600));
+    for (size_t i = 0; i < 3; ++i) {
+        builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(PjPlot::NumSeries{k_num_series}, PjPlot::SeriesLength{k_series_length}), frame);
+    }
+    std::array<char, PjPlot::k_max_tick_label> tick_label{};
+    std::cout << "Tick label of 1234.5678: " << PjPlot::format_tick_label(tick_label, 1234.5678, 1.0) << '\n';
+
+    // a dashboard chart laid out once and redrawn every frame from new samples
+    const auto plan = builder.create_plan<PjPlot::LineChart>(PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(600, 600));
+    for (size_t i = 0; i < 3; ++i) {
+        plan.execute<double>(arr, frame);
+    }
+    std::cout << "Render plan draws into a " << plan.get_plot_area().width << "x" << plan.get_plot_area().height << " plot area\n";
+    builder.get_grid_options().set_border_pixels(0);
+
+    // live chart, each append only draws the columns that scrolled into view
+    PjPlot::StreamingLineChart<double> live(PjPlot::DynamicSize2(200, 300), 1, 4);
+    size_t damaged_pixels = 0;
+    for (size_t i = 0; i < k_series_length; i += 8) {
+        live.reset_damage();
+        live.append(std::span<const double>(arr).subspan(i, 8));
+        for (const auto& rect : live.get_damage().get_rects()) {
+            damaged_pixels += rect.width * rect.height;
+        }
+    }
+    std::cout << "Streamed " << live.get_num_samples() << " samples, " << damaged_pixels << " pixels damaged\n";
+
+    // render each series as its own thumbnail in a single batch call
+    const PjPlot::Mat3View<const double, PjPlot::StaticSize3<k_num_series, 1, k_series_length>> thumbnail_data({}, arr.data());
+    PjPlot::Mat3<PjPlot::RGBA, PjPlot::DynamicSize3> thumbnails(PjPlot::DynamicSize3(k_num_series, 64, 64));
+    builder.get_plots<PjPlot::LineChart, double>(thumbnail_data, thumbnails);
+    std::cout << "Rendered " << thumbnails.slices() << " thumbnails\n";
+
+    // two callers sharing a pool: a thread waiting for its parallel_for only helps with its own tasks, so neither
+    // frame's scratch is reused underneath it and both match a sequential render
+    {
+        PjPlot::ThreadPool shared_pool(4);
+        PjPlot::Factory row_tiles;
+        PjPlot::Factory by_series;
+        for (auto* factory : {&row_tiles, &by_series}) {
+            factory->get_execution_options().set_thread_pool(&shared_pool);
+        }
+        row_tiles.get_execution_options().set_policy(PjPlot::ExecutionPolicy::PARALLEL_ROW_TILES);
+        by_series.get_execution_options().set_policy(PjPlot::ExecutionPolicy::PARALLEL_SERIES);
+        const auto sequential = PjPlot::Factory().get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(300, 600));
+        std::atomic<size_t> num_mismatched{0};
+        const auto render_frames = [&](const PjPlot::Factory& factory) {
+            for (size_t i = 0; i < 8; ++i) {
+                const auto frame = factory.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(300, 600));
+                num_mismatched += std::equal(frame.begin(), frame.end(), sequential.begin()) ? 0 : 1;
+            }
+        };
+        std::thread other_caller(render_frames, std::cref(by_series));
+        render_frames(row_tiles);
+        other_caller.join();
+        std::cout << "Concurrent parallel renders match sequential: " << (num_mismatched == 0) << '\n';
+
+        // a batch of thumbnails, one pool task per chart, alongside a frame holding its scratch across parallel_for
+        PjPlot::Mat3<PjPlot::RGBA, PjPlot::DynamicSize3> sequential_thumbnails(PjPlot::DynamicSize3(k_num_series, 64, 64));
+        PjPlot::Factory().get_plots<PjPlot::LineChart, double>(thumbnail_data, sequential_thumbnails);
+        std::thread batch_caller([&] {
+            for (size_t i = 0; i < 8; ++i) {
+                PjPlot::Mat3<PjPlot::RGBA, PjPlot::DynamicSize3> batch(PjPlot::DynamicSize3(k_num_series, 64, 64));
+                by_series.get_plots<PjPlot::LineChart, double>(thumbnail_data, batch);
+                num_mismatched += std::equal(batch.begin(), batch.end(), sequential_thumbnails.begin()) ? 0 : 1;
+            }
+        });
+        render_frames(row_tiles);
+        batch_caller.join();
+        std::cout << "Batched thumbnails alongside a parallel render match sequential: " << (num_mismatched == 0) << '\n';
+    }
+
+    // encode straight from the image, the sink only sees bounded pieces of the file
+    for (const auto level : {PjPlot::CompressionLevel::NONE, PjPlot::CompressionLevel::FAST}) {
+        size_t num_bytes = 0;
+        PjPlot::ImageEncoder::encode(img_dynamic, PjPlot::ImageFormat::PNG, [&num_bytes](std::span<const uint8_t> bytes) { num_bytes += bytes.size(); }, level);
+        std::cout << "PNG (" << PjPlot::to_string(level) << " compression): " << num_bytes << " bytes\n";
+    }
+
+    // draw palette indices, a byte per pixel, and only expand them to colours when encoding
+    const auto img_indexed = builder.get_indexed_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(600, 600));
+    const auto img_rgba = builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(600, 600));
+    const auto img_expanded = img_indexed.to_rgba();
+    size_t indexed_bytes = 0;
+    PjPlot::ImageEncoder::encode(img_indexed, PjPlot::ImageFormat::PNG, [&indexed_bytes](std::span<const uint8_t> bytes) { indexed_bytes += bytes.size(); });
+    std::cout << "Indexed plot uses " << img_indexed.get_palette()->size() << " colours, " << (std::equal(img_expanded.begin(), img_expanded.end(), img_rgba.begin()) ? "matches" : "differs from") << " the RGBA plot, PNG: " << indexed_bytes << " bytes\n";
+
+    // render in tiles that are handed over as they are drawn, and stream an encode a band of tiles at a time,
+    // so a poster sized chart never has to be held as one image
+    std::vector<PjPlot::RGBA> stitched(600 * 600);
+    std::mutex stitch_mutex;
+    size_t num_tiles = 0;
+    builder.get_tiled_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(600, 600), [&](PjPlot::Rect tile, std::span<const PjPlot::RGBA> pixels) {
+        std::lock_guard<std::mutex> lock(stitch_mutex);
+        for (size_t row = 0; row < tile.height; ++row) {
+            std::copy_n(pixels.begin() + static_cast<std::ptrdiff_t>(row * tile.width), tile.width, stitched.begin() + static_cast<std::ptrdiff_t>((tile.y + row) * 600 + tile.x));
+        }
+        ++num_tiles;
+    }, PjPlot::StaticSize2<256, 256>{});
+    size_t tiled_bytes = 0;
+    builder.encode_tiled_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(600, 600), PjPlot::ImageFormat::PNG, [&tiled_bytes](std::span<const uint8_t> bytes) { tiled_bytes += bytes.size(); });
+    std::cout << "Tiled render of " << num_tiles << " tiles " << (std::equal(stitched.begin(), stitched.end(), img_rgba.begin()) ? "matches" : "differs from") << " the full plot, streamed PNG: " << tiled_bytes << " bytes\n";
+
+    // per-stage timings of a plot, written as a Chrome trace; only recorded when PJPLOT_ENABLE_INSTRUMENTATION is defined
+    PjPlot::FrameProfiler profiler;
+    builder.set_profiler(&profiler);
+    const auto img_profiled = builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(600, 600));
+    builder.set_profiler(nullptr);
+    size_t trace_bytes = 0;
+    profiler.write_chrome_trace([&trace_bytes](std::span<const uint8_t> bytes) { trace_bytes += bytes.size(); });
+    std::cout << "Profiled " << profiler.get_num_frames() << " plot(s), rasterize took " << profiler.get_report().get(PjPlot::RenderStage::RASTERIZE).m_wall_ns << " ns, " << trace_bytes << " trace bytes\n";
+
+    // the scratch of every render comes from the factory's frame arena, reset after each frame. Once it has grown to
+    // the largest frame, renders make no library scratch allocations, which the profiler's allocation counters show;
+    // they count the library's own buffers, not std containers such as a default allocated output image
+    PjPlot::Img2<PjPlot::DynamicSize2> arena_frame(PjPlot::DynamicSize2(600, 600), PjPlot::k_uninitialized);
+    builder.set_profiler(&profiler);
+    for (size_t i = 0; i < 3; ++i) {
+        builder.get_plot<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), arena_frame);
+    }
+    builder.set_profiler(nullptr);
+    const size_t last_frame_allocations = profiler.get_num_frames() > 0 ? profiler.get_frame_report(profiler.get_num_frames() - 1).get(PjPlot::RenderStage::PLOT).m_allocations : 0;
+    std::cout << "Frame arena holds " << builder.get_frame_arena().get_capacity() << " bytes in " << builder.get_frame_arena().get_num_blocks() << " block(s), the last frame allocated " << last_frame_allocations << " scratch buffers\n";
+
+    // standardise the samples lazily, the chart computes each element as it reads it and no normalised copy is made
+    const PjPlot::Mat2View<const double, PjPlot::StaticSize2<k_num_series, k_series_length>> samples({}, arr.data());
+    const double mean = std::accumulate(arr.begin(), arr.end(), 0.0) / static_cast<double>(k_data_size);
+    const double deviation = std::sqrt(std::accumulate(arr.begin(), arr.end(), 0.0, [mean](double acc, double val) { return acc + (val - mean) * (val - mean); }) / static_cast<double>(k_data_size));
+    const auto standardised = (samples - mean) / deviation * 2.0;
+    const auto img_standardised = builder.get_plot<PjPlot::LineChart>(standardised, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(600, 600));
+    PjPlot::Mat2<double, PjPlot::DynamicSize2> standardised_copy(PjPlot::DynamicSize2(k_num_series, k_series_length));
+    standardised_copy = standardised;
+    std::cout << "Standardised " << img_standardised.rows() << "x" << img_standardised.cols() << " plot, first sample " << standardised_copy(0, 0) << '\n';
+
+    // render and encode in the background, each chart's PNG encode runs as its own job so the next render can start
+    std::vector<PjPlot::AsyncPlot<size_t>> encoded_plots;
+    std::stop_source disconnect;
+    for (size_t i = 0; i < 3; ++i) {
+        if (i == 2) {
+            // the last client has gone away, its render and encode are skipped
+            disconnect.request_stop();
+        }
+        encoded_plots.push_back(builder.get_plot_async<PjPlot::LineChart, double>(arr, PjPlot::LineChart::Params(k_series_length, k_num_series), PjPlot::DynamicSize2(300, 300), i == 2 ? disconnect.get_token() : std::stop_token{}).then([](PjPlot::Img2<PjPlot::DynamicSize2> img_async) {
+            size_t num_bytes = 0;
+            PjPlot::ImageEncoder::encode(img_async, PjPlot::ImageFormat::PNG, [&num_bytes](std::span<const uint8_t> bytes) { num_bytes += bytes.size(); });
+            return num_bytes;
+        }));
+    }
+    for (auto& encoded : encoded_plots) {
+        std::cout << "Async PNG: ";
+        try {
+            std::cout << encoded.get() << " bytes\n";
+        } catch (const PjPlot::PlotCancelledException& e) {
+            std::cout << e.what() << '\n';
+        }
+    }
+
+    std::cout << "Span fill kernel: "<< PjPlot::to_string(PjPlot::get_simd_level()) << '\n';
     std::cout << "I am a " << img.to_string() << ", my underlying type is: " << img.type_s() << '\n';
     const auto img2 = img;
 